@@ -51,7 +51,8 @@ from PARDg5GM import *
 
 def build_pardg5v_system(np):
     if buildEnv['TARGET_ISA'] == "x86":
-        pardsys = makePARDg5VSystem(test_mem_mode, options.num_cpus, bm[0])
+        pardsys = makePARDg5VSystem(test_mem_mode, options.num_cpus, bm[0],
+                                    options.root_complex)
     else:
         fatal("Incapable of building %s full system!", buildEnv['TARGET_ISA'])
 
@@ -85,15 +86,97 @@ def build_pardg5v_system(np):
     pardsys.cpu = [TestCPUClass(clk_domain=pardsys.cpu_clk_domain, cpu_id=i)
                     for i in xrange(np)]
 
+    # Device DMA leaves the IOHub here, through the upstream side of the
+    # root complex if it has one
+    dma_ranges = [AddrRange('3GB'), AddrRange(start='4GB', size='4GB')]
+    if options.root_complex:
+        pardsys.bridge.dma_ranges = dma_ranges
+        pardsys.bridge.dma_slave = pardsys.iobus.master
+        dma_port = pardsys.bridge.dma_master
+    else:
+        dma_port = pardsys.iobus.master
+
     if options.caches or options.l2cache:
         # By default the IOCache runs at the system clock
-        pardsys.iocache = IOCache(addr_ranges = [AddrRange('3GB'), AddrRange(start='4GB', size='4GB')])
-        pardsys.iocache.cpu_side = pardsys.iobus.master
+        pardsys.iocache = IOCache(addr_ranges = dma_ranges)
+        if options.iommu:
+            # Translate DMA before the IOCache, it caches host addresses
+            pardsys.iommu = PARDg5VIOMMU(ranges = dma_ranges)
+            pardsys.iommu.slave = dma_port
+            pardsys.iocache.cpu_side = pardsys.iommu.master
+        else:
+            pardsys.iocache.cpu_side = dma_port
         pardsys.iocache.mem_side = pardsys.membus.slave
     else:
-        pardsys.iobridge = Bridge(delay='50ns', ranges = [AddrRange('3GB'), AddrRange(start='4GB', size='4GB')])
-        pardsys.iobridge.slave = pardsys.iobus.master
-        pardsys.iobridge.master = pardsys.membus.slave
+        if options.iommu:
+            # The IOMMU takes the place of the bridge
+            pardsys.iommu = PARDg5VIOMMU(delay='50ns', ranges = dma_ranges)
+            pardsys.iommu.slave = dma_port
+            pardsys.iommu.master = pardsys.membus.slave
+        else:
+            pardsys.iobridge = Bridge(delay='50ns', ranges = dma_ranges)
+            pardsys.iobridge.slave = dma_port
+            pardsys.iobridge.master = pardsys.membus.slave
+        # Nothing below the bridge snoops, IDE DMA can move whole pages
+        for ide in [pardsys.cellx.ide0, pardsys.cellx.ide1,
+                    pardsys.cellx.ide2, pardsys.cellx.ide3]:
+            ide.burst_size = '4kB'
+
+    if options.io_sched:
+        # The IDE disks share one host disk, scheduled by IOHub shares
+        pardsys.cellx.io_sched = PARDg5VIOScheduler(cp=pardsys.iobus.cp)
+        for ide in [pardsys.cellx.ide0, pardsys.cellx.ide1,
+                    pardsys.cellx.ide2, pardsys.cellx.ide3]:
+            for disk in ide.disks:
+                disk.scheduler = pardsys.cellx.io_sched
+
+    if options.async_disk:
+        # Base images are read by host I/O threads ahead of the DMA
+        for ide in [pardsys.cellx.ide0, pardsys.cellx.ide1,
+                    pardsys.cellx.ide2, pardsys.cellx.ide3]:
+            for disk in ide.disks:
+                disk.image.child = PARDg5VAsyncDiskImage(
+                    image_file=disk.image.child.image_file)
+                disk.backend = disk.image.child
+
+    if options.pvblk:
+        # Paravirtual disk, every VF gets its own overlay of the image
+        def pvblk_image():
+            return CowDiskImage(child=RawDiskImage(read_only=True,
+                                                   image_file=bm[0].disk()),
+                                read_only=False)
+        pardsys.cellx.pvblk = PARDg5VBlockDevice(
+            image=pvblk_image(), num_vfs=options.pvblk_vfs,
+            vf_images=[pvblk_image() for i in xrange(options.pvblk_vfs)],
+            pci_func=0, pci_dev=10, pci_bus=0,
+            InterruptLine = 14,
+            InterruptPin = 1)
+        pardsys.cellx.pvblk.pio    = pardsys.iobus.master
+        pardsys.cellx.pvblk.config = pardsys.iobus.master
+        pardsys.cellx.pvblk.dma    = pardsys.iobus.slave
+
+    if options.pvnet:
+        # Paravirtual NIC, frames go to the host through the tap
+        pardsys.cellx.pvnet_tap = PARDg5VEtherTap(port=options.pvnet_port)
+        pardsys.cellx.pvnet = PARDg5VNetDevice(
+            tap=pardsys.cellx.pvnet_tap, num_vfs=options.pvnet_vfs,
+            pci_func=0, pci_dev=11, pci_bus=0,
+            InterruptLine = 15,
+            InterruptPin = 1)
+        pardsys.cellx.pvnet.pio    = pardsys.iobus.master
+        pardsys.cellx.pvnet.config = pardsys.iobus.master
+        pardsys.cellx.pvnet.dma    = pardsys.iobus.slave
+
+    # MSI/MSI-X messages go to the local APICs through the IOHub, the
+    # same way as those of the I/O APIC
+    pci_devices = [pardsys.cellx.ide0, pardsys.cellx.ide1,
+                   pardsys.cellx.ide2, pardsys.cellx.ide3]
+    if options.pvblk:
+        pci_devices.append(pardsys.cellx.pvblk)
+    if options.pvnet:
+        pci_devices.append(pardsys.cellx.pvnet)
+    for dev in pci_devices:
+        dev.int_master = pardsys.iobus.slave
 
     for i in xrange(np):
         pardsys.cpu[i].createThreads()
@@ -101,6 +184,10 @@ def build_pardg5v_system(np):
     CacheConfig.config_cache(options, pardsys)
     XMemConfig.config_mem(options, pardsys)
 
+    # State saved and restored by per-LDomain checkpoints
+    pardsys.ldom_state = [pardsys.mem_ctrl, pardsys.cellx.ich.io_apic,
+                          pardsys.iobus]
+
     return pardsys
 
 
@@ -108,6 +195,47 @@ def build_pardg5v_system(np):
 parser = optparse.OptionParser()
 Options.addCommonOptions(parser)
 Options.addFSOptions(parser)
+parser.add_option("--ldom-switch", action="store_true",
+                  help="Boot LDomains on the atomic cpu, switch an LDomain "
+                       "to the detailed cpu on PRM command or m5 switchcpu")
+parser.add_option("--dsid-stats-interval", type="string", default=None,
+                  help="Record per-DSid control plane counters to "
+                       "dsid_stats.bin at this interval, e.g. 100us")
+parser.add_option("--cp-server", type="string", default=None,
+                  help="Serve control planes on this Unix socket, "
+                       "see util/cpclient.py")
+parser.add_option("--resource-policy", type="choice", default=None,
+                  choices=["pid", "threshold"],
+                  help="Run a closed-loop resource policy on the system "
+                       "CPs, configured by --policy-args")
+parser.add_option("--policy-args", type="string", default="",
+                  help="Comma separated policy params, e.g. "
+                       "cp=0,dsid=1,counter=boots,param_addr=0x8,kp=0.5")
+parser.add_option("--policy-period", type="int", default=100000,
+                  help="Cycles between two policy invocations")
+parser.add_option("--iommu", action="store_true",
+                  help="Translate device DMA by per-DSid I/O page tables")
+parser.add_option("--root-complex", action="store_true",
+                  help="Connect the I/O devices through a PCI-Express root "
+                       "complex instead of plain bridges, for both host "
+                       "accesses and device DMA")
+parser.add_option("--io-sched", action="store_true",
+                  help="Schedule the IDE disks on one shared device by "
+                       "per-DSid I/O shares")
+parser.add_option("--async-disk", action="store_true",
+                  help="Prefetch IDE disk reads from the host image on "
+                       "I/O threads")
+parser.add_option("--pvblk", action="store_true",
+                  help="Add a paravirtual ring-based block device")
+parser.add_option("--pvblk-vfs", type="int", default=0,
+                  help="Virtual functions of the paravirtual block device")
+parser.add_option("--pvnet", action="store_true",
+                  help="Add a paravirtual ring-based NIC behind an EtherTap")
+parser.add_option("--pvnet-vfs", type="int", default=0,
+                  help="Virtual functions of the paravirtual NIC")
+parser.add_option("--pvnet-port", type="int", default=3500,
+                  help="TCP port the EtherTap of the paravirtual NIC "
+                       "listens on")
 (options, args) = parser.parse_args()
 if args:
     print "Error: script doesn't take any positional arguments"
@@ -139,6 +267,35 @@ root.prm = prm
 pardsys.cp.connectToNetwork(prm.cpn)
 pardsys.iobus.cp.connectToNetwork(prm.cpn)
 pardsys.cellx.ich.cp.connectToNetwork(prm.cpn)
+pardsys.mem_ctrl.cp.connectToNetwork(prm.cpn)
+cps = [pardsys.cp, pardsys.iobus.cp, pardsys.cellx.ich.cp, pardsys.mem_ctrl.cp]
+if options.iommu:
+    pardsys.iommu.cp.connectToNetwork(prm.cpn)
+    cps.append(pardsys.iommu.cp)
+if options.root_complex:
+    pardsys.bridge.cp.connectToNetwork(prm.cpn)
+    cps.append(pardsys.bridge.cp)
+
+if options.dsid_stats_interval:
+    root.dsid_stats = StatsRecorder(
+        control_planes = cps,
+        interval = options.dsid_stats_interval)
+
+if options.cp_server:
+    root.cp_server = CPServer(
+        control_planes = cps,
+        path = options.cp_server)
+
+if options.resource_policy:
+    policy_class = { "pid" : PIDPolicy,
+                     "threshold" : ThresholdPolicy }[options.resource_policy]
+    policy_args = dict(arg.split('=', 1)
+                       for arg in options.policy_args.split(',') if arg)
+    root.resource_ctrl = ResourceController(
+        control_planes = cps,
+        policies = [policy_class(**policy_args)],
+        period = options.policy_period,
+        clk_domain = pardsys.clk_domain)
 
 #### Change default UART port
 prm.pc.com_1.terminal.port = 4456;
@@ -44,7 +44,7 @@ def x86IOAddress(port):
     IO_address_space_base = 0x8000000000000000
     return IO_address_space_base + port
 
-def connectX86ClassicSystem(x86_sys, numCPUs):
+def connectX86ClassicSystem(x86_sys, numCPUs, root_complex = False):
     # Constants similar to x86_traits.hh
     IO_address_space_base = 0x8000000000000000
     pci_config_address_space_base = 0xc000000000000000
@@ -55,7 +55,13 @@ def connectX86ClassicSystem(x86_sys, numCPUs):
 
     # North Bridge
     x86_sys.iobus = PARDg5VIOHub()
-    x86_sys.bridge = Bridge(delay='50ns')
+    if root_complex:
+        # CPU accesses to devices cross a PCI-Express link as TLPs.
+        # The caller connects dma_slave/dma_master between the IOHub
+        # and the DMA path to memory, so DMA crosses it as well
+        x86_sys.bridge = RootComplex(delay='50ns')
+    else:
+        x86_sys.bridge = Bridge(delay='50ns')
     x86_sys.iobus.attachRemappedMaster(x86_sys.bridge)
     x86_sys.bridge.slave = x86_sys.membus.io_port
     # Allow the bridge to pass through:
@@ -99,7 +105,8 @@ def connectX86ClassicSystem(x86_sys, numCPUs):
     x86_sys.system_port = x86_sys.membus.slave
 
 
-def makePARDg5VSystem(mem_mode, numCPUs = 1, mdesc = None):
+def makePARDg5VSystem(mem_mode, numCPUs = 1, mdesc = None,
+                      root_complex = False):
     self = PARDg5VSystem()
 
     if not mdesc:
@@ -114,7 +121,7 @@ def makePARDg5VSystem(mem_mode, numCPUs = 1, mdesc = None):
     self.cellx = CellX()
 
     # Create and connect the busses required by each memory system
-    connectX86ClassicSystem(self, numCPUs)
+    connectX86ClassicSystem(self, numCPUs, root_complex)
 
     self.intrctrl = IntrControl()
 
@@ -169,13 +169,13 @@ def scriptCheckpoints(options, maxtick, cptdir):
             checkpoint_inst += options.checkpoint_restore
 
         print "Creating checkpoint at inst:%d" % (checkpoint_inst)
-        exit_event = m5.simulate()
+        exit_event = simulate()
         exit_cause = exit_event.getCause()
         print "exit cause = %s" % exit_cause
 
         # skip checkpoint instructions should they exist
         while exit_cause == "checkpoint":
-            exit_event = m5.simulate()
+            exit_event = simulate()
             exit_cause = exit_event.getCause()
 
         if exit_cause == "a thread reached the max instruction count":
@@ -189,10 +189,10 @@ def scriptCheckpoints(options, maxtick, cptdir):
         period = int(period)
         num_checkpoints = 0
 
-        exit_event = m5.simulate(when - m5.curTick())
+        exit_event = simulate(when - m5.curTick())
         exit_cause = exit_event.getCause()
         while exit_cause == "checkpoint":
-            exit_event = m5.simulate(when - m5.curTick())
+            exit_event = simulate(when - m5.curTick())
             exit_cause = exit_event.getCause()
 
         if exit_cause == "simulate() limit reached":
@@ -205,23 +205,65 @@ def scriptCheckpoints(options, maxtick, cptdir):
         while num_checkpoints < max_checkpoints and \
                 exit_cause == "simulate() limit reached":
             if (sim_ticks + period) > maxtick:
-                exit_event = m5.simulate(maxtick - sim_ticks)
+                exit_event = simulate(maxtick - sim_ticks)
                 exit_cause = exit_event.getCause()
                 break
             else:
-                exit_event = m5.simulate(period)
+                exit_event = simulate(period)
                 exit_cause = exit_event.getCause()
                 sim_ticks += period
                 while exit_event.getCause() == "checkpoint":
-                    exit_event = m5.simulate(sim_ticks - m5.curTick())
+                    exit_event = simulate(sim_ticks - m5.curTick())
                 if exit_event.getCause() == "simulate() limit reached":
                     m5.checkpoint(joinpath(cptdir, "cpt.%d"))
                     num_checkpoints += 1
 
     return exit_event
 
+def ldomCheckpoint(restore):
+    """Run LDomain checkpoint/restore commands queued by the PRM.
+
+       PARDg5VSystem saves or restores an LDomain when it is resumed
+       from a drained state, so that its cpus and devices are quiescent.
+       Dirty cache lines are written back first so the memory image is
+       complete; a restore also drops lines of the previous owner.
+    """
+    root = Root.getInstance()
+    m5.drain(root)
+    m5.memWriteback(root)
+    if restore:
+        m5.memInvalidate(root)
+    m5.resume(root)
+
+def simulate(*args, **kwargs):
+    """m5.simulate() that serves LDomain requests of the PRM.
+
+       LDomain checkpoints are run and the simulation goes on to the
+       requested tick. LDomain switches are left to the caller if
+       switch_ldom is set, and ignored otherwise.
+    """
+    switch_ldom = kwargs.pop('switch_ldom', False)
+    end = None
+    if args:
+        end = m5.curTick() + args[0]
+
+    while True:
+        if end is None:
+            exit_event = m5.simulate()
+        else:
+            exit_event = m5.simulate(end - m5.curTick())
+        exit_cause = exit_event.getCause()
+
+        if exit_cause == "ldomain checkpoint":
+            ldomCheckpoint(exit_event.getCode())
+        elif exit_cause == "switch ldomain" and not switch_ldom:
+            warn("Ignore switch of LDomain %d, run with --ldom-switch" % \
+                 exit_event.getCode())
+        else:
+            return exit_event
+
 def benchCheckpoints(options, maxtick, cptdir):
-    exit_event = m5.simulate(maxtick - m5.curTick())
+    exit_event = simulate(maxtick - m5.curTick())
     exit_cause = exit_event.getCause()
 
     num_checkpoints = 0
@@ -234,7 +276,7 @@ def benchCheckpoints(options, maxtick, cptdir):
             exit_cause = "maximum %d checkpoints dropped" % max_checkpoints
             break
 
-        exit_event = m5.simulate(maxtick - m5.curTick())
+        exit_event = simulate(maxtick - m5.curTick())
         exit_cause = exit_event.getCause()
 
     return exit_event
@@ -242,7 +284,7 @@ def benchCheckpoints(options, maxtick, cptdir):
 def repeatSwitch(testsys, repeat_switch_cpu_list, maxtick, switch_freq):
     print "starting switch loop"
     while True:
-        exit_event = m5.simulate(switch_freq)
+        exit_event = simulate(switch_freq)
         exit_cause = exit_event.getCause()
 
         if exit_cause != "simulate() limit reached":
@@ -256,9 +298,60 @@ def repeatSwitch(testsys, repeat_switch_cpu_list, maxtick, switch_freq):
         repeat_switch_cpu_list = tmp_cpu_list
 
         if (maxtick - m5.curTick()) <= switch_freq:
-            exit_event = m5.simulate(maxtick - m5.curTick())
+            exit_event = simulate(maxtick - m5.curTick())
+            return exit_event
+
+def ldomSwitch(testsys, ldom_timing_cpus, ldom_detailed_cpus, maxtick):
+    """Switch the cpus of a single LDomain to the detailed model.
+
+       Every LDomain boots on the tagged atomic cpu. When the PRM issues
+       a switch command (or the guest executes m5 switchcpu), only the
+       cpus owned by that LDomain are handed over to the detailed cpu.
+       The memory mode is system wide, so the remaining atomic cpus are
+       moved to the tagged timing cpu at the same time; LDomains that
+       already left the atomic cpu are not touched.
+    """
+    np = len(testsys.cpu)
+    current_cpus = [testsys.cpu[i] for i in xrange(np)]
+
+    while True:
+        exit_event = simulate(maxtick - m5.curTick(), switch_ldom=True)
+        exit_cause = exit_event.getCause()
+
+        if exit_cause == "switch ldomain":
+            cpu_mask = testsys.getLDomCpuMask(exit_event.getCode())
+        elif exit_cause == "switchcpu":
+            # m5 switchcpu does not tell which cpu executed it, it is only
+            # usable while a single LDomain is left on the atomic cpu
+            booting = set(testsys.getCpuLDomain(i) for i in xrange(np)
+                          if current_cpus[i] == testsys.cpu[i])
+            booting.discard(-1)
+            if len(booting) != 1:
+                warn("Ignore ambiguous m5 switchcpu, use the PRM switch " \
+                     "command instead")
+                continue
+            cpu_mask = testsys.getLDomCpuMask(booting.pop())
+        else:
             return exit_event
 
+        switch_cpu_list = []
+        for i in xrange(np):
+            if cpu_mask & (1 << i):
+                if current_cpus[i] != ldom_detailed_cpus[i]:
+                    switch_cpu_list.append((current_cpus[i],
+                                            ldom_detailed_cpus[i]))
+            elif current_cpus[i] == testsys.cpu[i]:
+                switch_cpu_list.append((current_cpus[i], ldom_timing_cpus[i]))
+
+        if not switch_cpu_list:
+            continue
+
+        print "Switch LDomain cpus (mask 0x%x) @ tick %s" % \
+                (cpu_mask, m5.curTick())
+        m5.switchCpus(testsys, switch_cpu_list)
+        for old_cpu, new_cpu in switch_cpu_list:
+            current_cpus[current_cpus.index(old_cpu)] = new_cpu
+
 def run(options, root, testsys, cpu_class):
     if options.checkpoint_dir:
         cptdir = options.checkpoint_dir
@@ -279,6 +372,14 @@ def run(options, root, testsys, cpu_class):
     if options.repeat_switch and options.take_checkpoints:
         fatal("Can't specify both --repeat-switch and --take-checkpoints")
 
+    ldom_switch = getattr(options, "ldom_switch", False)
+    if ldom_switch and not options.caches:
+        fatal("Must specify --caches when using --ldom-switch")
+
+    if ldom_switch and (cpu_class or options.standard_switch or
+                        options.repeat_switch):
+        fatal("Can't combine --ldom-switch with other cpu switch options")
+
     np = options.num_cpus
     switch_cpus = None
 
@@ -391,6 +492,29 @@ def run(options, root, testsys, cpu_class):
         switch_cpu_list = [(testsys.cpu[i], switch_cpus[i]) for i in xrange(np)]
         switch_cpu_list1 = [(switch_cpus[i], switch_cpus_1[i]) for i in xrange(np)]
 
+    if ldom_switch:
+        if testsys.cpu[0].memory_mode() != 'atomic':
+            fatal("--ldom-switch requires LDomains to boot on an atomic cpu")
+
+        ldom_timing_cpus = [XCpuConfig.get("tagged_timing")(
+                                switched_out=True, cpu_id=(i))
+                            for i in xrange(np)]
+        ldom_detailed_cpus = [XCpuConfig.get("tagged_detailed")(
+                                  switched_out=True, cpu_id=(i))
+                              for i in xrange(np)]
+
+        for i in xrange(np):
+            for switch_cpu in (ldom_timing_cpus[i], ldom_detailed_cpus[i]):
+                switch_cpu.system = testsys
+                switch_cpu.workload = testsys.cpu[i].workload
+                switch_cpu.clk_domain = testsys.cpu[i].clk_domain
+
+            if options.maxinsts:
+                ldom_detailed_cpus[i].max_insts_any_thread = options.maxinsts
+
+        testsys.ldom_timing_cpus = ldom_timing_cpus
+        testsys.ldom_detailed_cpus = ldom_detailed_cpus
+
     # set the checkpoint in the cpu before m5.instantiate is called
     if options.take_checkpoints != None and \
            (options.simpoint or options.at_instruction):
@@ -455,14 +579,14 @@ def run(options, root, testsys, cpu_class):
         if options.standard_switch:
             print "Switch at instruction count:%s" % \
                     str(testsys.cpu[0].max_insts_any_thread)
-            exit_event = m5.simulate()
+            exit_event = simulate()
         elif cpu_class and options.fast_forward:
             print "Switch at instruction count:%s" % \
                     str(testsys.cpu[0].max_insts_any_thread)
-            exit_event = m5.simulate()
+            exit_event = simulate()
         else:
             print "Switch at curTick count:%s" % str(10000)
-            exit_event = m5.simulate(10000)
+            exit_event = simulate(10000)
         print "Switched CPUS @ tick %s" % (m5.curTick())
 
         m5.switchCpus(testsys, switch_cpu_list)
@@ -473,9 +597,9 @@ def run(options, root, testsys, cpu_class):
 
             #warmup instruction count may have already been set
             if options.warmup_insts:
-                exit_event = m5.simulate()
+                exit_event = simulate()
             else:
-                exit_event = m5.simulate(options.standard_switch)
+                exit_event = simulate(options.standard_switch)
             print "Switching CPUS @ tick %s" % (m5.curTick())
             print "Simulation ends instruction count:%d" % \
                     (testsys.switch_cpus_1[0].max_insts_any_thread)
@@ -507,6 +631,9 @@ def run(options, root, testsys, cpu_class):
         if options.repeat_switch and maxtick > options.repeat_switch:
             exit_event = repeatSwitch(testsys, repeat_switch_cpu_list,
                                       maxtick, options.repeat_switch)
+        elif ldom_switch:
+            exit_event = ldomSwitch(testsys, ldom_timing_cpus,
+                                    ldom_detailed_cpus, maxtick)
         else:
             exit_event = benchCheckpoints(options, maxtick, cptdir)
 
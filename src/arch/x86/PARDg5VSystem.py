@@ -57,6 +57,19 @@ class PARDg5VSystem(System):
     cp = Param.PARDg5VSystemCP(PARDg5VSystemCP(),
                                "Control plane for PARDg5VSystem")
 
+    # Per-LDomain checkpoints, see PARDg5VSystem 'C'/'R' commands
+    ldom_state = VectorParam.SimObject([], "Objects holding per-LDomain "
+                                       "state (ILDomSerializable)")
+    ldom_cpt_dir = Param.String("ldom-cpt", "Directory of LDomain "
+                                "checkpoints, relative to outdir")
+
+    @classmethod
+    def export_methods(cls, code):
+        code('''
+      uint64_t getLDomCpuMask(int DSid);
+      int getCpuLDomain(int cpuId);
+''')
+
     def connect(self, cpn):
         self.cp.connect(cpn)
 
@@ -29,10 +29,125 @@
  */
 
 #include "arch/x86/pard_interrupts.hh"
+#include "cpu/base.hh"
+#include "cpu/thread_context.hh"
+#include "sim/system.hh"
 
 namespace X86ISA {
+
+uint64_t PardInterrupts::routeGeneration = 0;
+
+Tick
+PardInterrupts::write(PacketPtr pkt)
+{
+    uint32_t ldr = readReg(APIC_LOGICAL_DESTINATION);
+    Tick latency = Interrupts::write(pkt);
+    if (readReg(APIC_LOGICAL_DESTINATION) != ldr)
+        routeGeneration++;
+    return latency;
+}
+
+void
+PardInterrupts::unserialize(Checkpoint *cp, const std::string &section)
+{
+    // The logical destination register may change under a router
+    Interrupts::unserialize(cp, section);
+    routeGeneration++;
+}
+
+PardApicRouter::PardApicRouter(System *_sys)
+    : sys(_sys), generation(PardInterrupts::getRouteGeneration())
+{
+}
+
+void
+PardApicRouter::checkGeneration()
+{
+    // Drop all cached routes if any local APIC changed DSid or LDR
+    if (generation != PardInterrupts::getRouteGeneration()) {
+        logicalRoutes.clear();
+        apicOwners.clear();
+        generation = PardInterrupts::getRouteGeneration();
+    }
+}
+
+PardInterrupts *
+PardApicRouter::getLocalApic(int context)
+{
+    // Convert LocalApic pointer to PARDX86LocalApic
+    PardInterrupts *localApic = dynamic_cast<PardInterrupts *>(
+        sys->getThreadContext(context)->
+        getCpuPtr()->getInterruptController());
+    panic_if(!localApic, "%s is not a PARDX86LocalApic.\n",
+             sys->getThreadContext(context)->
+             getCpuPtr()->getInterruptController());
+    return localApic;
+}
+
+const ApicList &
+PardApicRouter::getLogicalRoute(uint16_t DSid, uint8_t destination)
+{
+    checkGeneration();
+
+    uint32_t key = ((uint32_t)DSid << 8) | destination;
+    auto it = logicalRoutes.find(key);
+    if (it != logicalRoutes.end())
+        return it->second;
+
+    ApicList &apics = logicalRoutes[key];
+    for (int i = 0; i < sys->numContexts(); i++) {
+        PardInterrupts *localApic = getLocalApic(i);
+
+        // Only send interrupt to localApic with requested DSid
+        if (localApic->getDSid() != DSid)
+            continue;
+
+        if ((localApic->readReg(APIC_LOGICAL_DESTINATION) >> 24) &
+                destination) {
+            apics.push_back(localApic->getInitialApicId());
+        }
+    }
+
+    return apics;
+}
+
+void
+PardApicRouter::buildOwners()
+{
+    checkGeneration();
+
+    if (apicOwners.empty()) {
+        for (int i = 0; i < sys->numContexts(); i++) {
+            PardInterrupts *localApic = getLocalApic(i);
+            apicOwners[localApic->getInitialApicId()] = localApic->getDSid();
+        }
+    }
 }
 
+bool
+PardApicRouter::isOwner(uint16_t DSid, int apicId)
+{
+    buildOwners();
+
+    auto it = apicOwners.find(apicId);
+    return (it != apicOwners.end()) && (it->second == DSid);
+}
+
+ApicList
+PardApicRouter::getOwnedApics(uint16_t DSid)
+{
+    buildOwners();
+
+    ApicList apics;
+    for (auto &owner : apicOwners) {
+        if (owner.second == DSid)
+            apics.push_back(owner.first);
+    }
+    return apics;
+}
+
+} // namespace X86ISA
+
 X86ISA::PardInterrupts *
 PARDX86LocalApicParams::create()
 {
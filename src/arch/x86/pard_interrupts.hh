@@ -31,9 +31,13 @@
 #ifndef __ARCH_X86_PARD_INTERRUPTS_HH__
 #define __ARCH_X86_PARD_INTERRUPTS_HH__
 
+#include <map>
+
 #include "arch/x86/interrupts.hh"
 #include "params/PARDX86LocalApic.hh"
 
+class System;
+
 namespace X86ISA {
 
 class PardInterrupts : public Interrupts
@@ -41,11 +45,28 @@ class PardInterrupts : public Interrupts
   protected:
     uint16_t DSid;
 
+    /**
+     * Bumped whenever any local APIC changes its DSid or logical
+     * destination register, so that interrupt routers (e.g. the I/O APIC)
+     * know when their cached <DSid, logical destination> routes go stale.
+     */
+    static uint64_t routeGeneration;
+
   public:
 
-    void updateDSid(uint16_t _DSid) { DSid = _DSid; }
+    void updateDSid(uint16_t _DSid) {
+        if (DSid != _DSid)
+            routeGeneration++;
+        DSid = _DSid;
+    }
     const uint16_t getDSid() const { return DSid; }
 
+    static uint64_t getRouteGeneration() { return routeGeneration; }
+
+    Tick write(PacketPtr pkt);
+
+    void unserialize(Checkpoint *cp, const std::string &section);
+
   public:
     typedef PARDX86LocalApicParams Params;
 
@@ -59,6 +80,39 @@ class PardInterrupts : public Interrupts
     }
 };
 
+/**
+ * PardApicRouter resolves interrupt destinations of a DSid into local
+ * APIC ids. Results are cached until any local APIC changes its DSid
+ * or LDR, it is shared by the I/O APIC and MSI capable PARD devices.
+ */
+class PardApicRouter
+{
+  protected:
+    System *sys;
+
+    /** Logical routes, indexed by (DSid << 8 | destination) */
+    std::map<uint32_t, ApicList> logicalRoutes;
+    /** DSid of each local APIC, indexed by APIC id */
+    std::map<int, uint16_t> apicOwners;
+    uint64_t generation;
+
+    void checkGeneration();
+    void buildOwners();
+    PardInterrupts *getLocalApic(int context);
+
+  public:
+    PardApicRouter(System *_sys);
+
+    /** Local APICs of DSid selected by a logical destination */
+    const ApicList &getLogicalRoute(uint16_t DSid, uint8_t destination);
+
+    /** Check if physical APIC apicId belongs to DSid */
+    bool isOwner(uint16_t DSid, int apicId);
+
+    /** APIC ids of all local APICs owned by DSid, for broadcasts */
+    ApicList getOwnedApics(uint16_t DSid);
+};
+
 }
 
 #endif	// __ARCH_X86_PARD_INTERRUPTS_HH__
@@ -40,6 +40,16 @@ PardTLB::PardTLB(const Params *p)
 {
 }
 
+void
+PardTLB::takeOverFrom(BaseTLB *otlb)
+{
+    TLB::takeOverFrom(otlb);
+
+    PardTLB *old_tlb = dynamic_cast<PardTLB *>(otlb);
+    panic_if(!old_tlb, "PardTLB can only take over from another PardTLB.\n");
+    DSid = old_tlb->DSid;
+}
+
 } // namespace X86ISA
 
 X86ISA::PardTLB *
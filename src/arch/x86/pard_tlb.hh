@@ -50,6 +50,13 @@ namespace X86ISA
         PardTLB(const Params *p);
 
         void updateDSid(uint16_t _DSid) { DSid = _DSid; }
+        uint16_t getDSid() const { return DSid; }
+
+        /**
+         * Keep the DSid of the LDomain when a CPU of another model
+         * takes over this TLB, e.g. switching from atomic to O3.
+         */
+        void takeOverFrom(BaseTLB *otlb);
 
       protected:
 
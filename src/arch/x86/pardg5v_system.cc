@@ -28,25 +28,44 @@
  * Authors: Jiuyue Ma
  */
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+
 #include "arch/x86/pardg5v_system.hh"
 #include "arch/x86/pard_interrupts.hh"
 #include "arch/x86/pard_tlb.hh"
 #include "base/loader/object_file.hh"
 #include "base/loader/symtab.hh"
+#include "base/output.hh"
 #include "cpu/thread_context.hh"
 #include "cpu/base.hh"
 #include "debug/Loader.hh"
 #include "debug/PARDg5VSystem.hh"
 #include "params/PARDg5VSystem.hh"
+#include "sim/serialize.hh"
+#include "sim/sim_exit.hh"
 
 using namespace X86ISA;
 
 
 PARDg5VSystem::PARDg5VSystem(Params *p)
     : System(p), cp(p->cp), 
-      physProxy(this->getSystemPort(), this->cacheLineSize())
+      physProxy(this->getSystemPort(), this->cacheLineSize()),
+      ldomState(p->ldom_state.begin(), p->ldom_state.end()),
+      checkpointOpsEvent(this, false, Event::CPU_Switch_Pri),
+      checkpointExitEvent(this, false, Event::Maximum_Pri)
 {
     cp->registerCommandHandler(static_cast<ICommandHandler *>(this));
+
+    for (auto obj : ldomState) {
+        fatal_if(!dynamic_cast<ILDomSerializable *>(obj),
+                 "%s: %s holds no per-LDomain state.\n",
+                 name(), obj->name());
+    }
 }
 
 PARDg5VSystem::~PARDg5VSystem()
@@ -74,8 +93,26 @@ PARDg5VSystem::handleCommand(int cmd, uint64_t arg1, uint64_t arg2, uint64_t arg
     // Check PARDg5VSystem commands
     if (cmd == 'B') {		// bootup ldom
         startupLDomain(DSid);
+        cp->incrStat(DSid, "boots", 1);
     } else if (cmd == 'K') {	// kill ldom
         killLDomain(DSid);
+        cp->incrStat(DSid, "kills", 1);
+    } else if (cmd == 'W') {	// switch ldom to detailed cpu
+        switchLDomain(DSid);
+        cp->incrStat(DSid, "switches", 1);
+    } else if (cmd == 'C') {	// checkpoint ldom to image arg2
+        if (ldomCheckpointDir((int)arg2, true).empty())
+            return false;
+        requestLDomCheckpoint(cmd, DSid, (int)arg2);
+    } else if (cmd == 'R') {	// restore image arg2 into ldom
+        // Report a bad image id to the PRM now, the restore itself only
+        // runs after the system is drained
+        if (!ldomImageExists((int)arg2)) {
+            warn("LDomain checkpoint image %d not found\n", (int)arg2);
+            cp->incrStat(DSid, "restore_errors", 1);
+            return false;
+        }
+        requestLDomCheckpoint(cmd, DSid, (int)arg2);
     } else {
         return false;
     }
@@ -182,6 +219,275 @@ PARDg5VSystem::killLDomain(uint16_t DSid)
     warn("Ignore unimpl kill logical domain.\n");
 }
 
+void
+PARDg5VSystem::switchLDomain(uint16_t DSid)
+{
+    uint64_t cpuMask;
+    if (cp->getCpuMask(DSid, &cpuMask) < 0) {
+        warn("Try to switch unknown system with DSid: %d\n", DSid);
+        return;
+    }
+
+    DPRINTF(PARDg5VSystem, "LDomain#%X: Request cpu switch, CpuMask: 0x%x\n",
+            DSid, cpuMask);
+
+    // CPU models can only be replaced from the python side, so exit the
+    // simulation loop with the DSid, the config script looks up the cpus
+    // owned by this ldom with getLDomCpuMask(). The memory mode is system
+    // wide, so the script also moves the atomic cpus of the other ldoms
+    // to the timing cpu.
+    exitSimLoop("switch ldomain", DSid);
+}
+
+uint64_t
+PARDg5VSystem::getLDomCpuMask(int DSid)
+{
+    uint64_t cpuMask;
+    if (cp->getCpuMask(DSid, &cpuMask) < 0)
+        return 0;
+    return cpuMask;
+}
+
+int
+PARDg5VSystem::getCpuLDomain(int cpuId)
+{
+    uint16_t DSid;
+    if (cp->getCpuOwner(cpuId, &DSid) < 0)
+        return -1;
+    return DSid;
+}
+
+void
+PARDg5VSystem::requestLDomCheckpoint(int cmd, uint16_t DSid, int image)
+{
+    LDomCheckpointOp op = { cmd, DSid, image };
+    pendingCheckpointOps.push_back(op);
+
+    // Thread contexts and devices are only consistent in a drained
+    // system, the config script drains and resumes on this exit. Exit
+    // after the last event of this tick, so every op issued in the same
+    // tick is known when the exit code is chosen.
+    if (!checkpointExitEvent.scheduled())
+        schedule(checkpointExitEvent, curTick());
+}
+
+void
+PARDg5VSystem::exitForCheckpointOps()
+{
+    // A restore also asks the script to invalidate caches, lines of the
+    // previous owner must not hide the lazily restored memory
+    bool restore = false;
+    for (auto &op : pendingCheckpointOps)
+        restore |= op.cmd == 'R';
+    exitSimLoop("ldomain checkpoint", restore ? 1 : 0);
+}
+
+void
+PARDg5VSystem::drainResume()
+{
+    System::drainResume();
+
+    // Cpus resume after us, activating a restored thread now would
+    // race with their own rescheduling
+    if (!pendingCheckpointOps.empty() && !checkpointOpsEvent.scheduled())
+        schedule(checkpointOpsEvent, curTick());
+}
+
+void
+PARDg5VSystem::processCheckpointOps()
+{
+    for (auto &op : pendingCheckpointOps) {
+        if (op.cmd == 'C') {
+            if (!checkpointLDomain(op.DSid, op.image))
+                cp->incrStat(op.DSid, "checkpoint_errors", 1);
+        } else {
+            if (!restoreLDomain(op.DSid, op.image))
+                cp->incrStat(op.DSid, "restore_errors", 1);
+        }
+    }
+    pendingCheckpointOps.clear();
+}
+
+std::string
+PARDg5VSystem::ldomCheckpointDir(int image, bool create)
+{
+    std::string base = params()->ldom_cpt_dir;
+    if (base.empty() || base[0] != '/')
+        base = simout.resolve(base);
+    std::string dir = csprintf("%s/ldom.%d", base, image);
+
+    if (create) {
+        if ((mkdir(base.c_str(), 0775) == -1 && errno != EEXIST) ||
+            (mkdir(dir.c_str(), 0775) == -1 && errno != EEXIST)) {
+            warn("couldn't mkdir %s\n", dir);
+            return "";
+        }
+    }
+    return dir;
+}
+
+bool
+PARDg5VSystem::ldomImageExists(int image)
+{
+    std::string file = ldomCheckpointDir(image, false) + "/m5.cpt";
+    return access(file.c_str(), R_OK) == 0;
+}
+
+bool
+PARDg5VSystem::getLDomThreads(uint16_t DSid, std::vector<ThreadContext *> &tcs)
+{
+    uint64_t cpuMask;
+    if (cp->getCpuMask(DSid, &cpuMask) < 0)
+        return false;
+    for (int i=0; i<threadContexts.size(); i++) {
+        if (1<<i & cpuMask)
+            tcs.push_back(threadContexts[i]);
+    }
+    return true;
+}
+
+bool
+PARDg5VSystem::checkpointLDomain(uint16_t DSid, int image)
+{
+    std::vector<ThreadContext *> tcs;
+    if (!getLDomThreads(DSid, tcs)) {
+        warn("Try to checkpoint unknown system with DSid: %d\n", DSid);
+        return false;
+    }
+    std::string dir = ldomCheckpointDir(image, true);
+    if (dir.empty())
+        return false;
+    std::ofstream os((dir + "/m5.cpt").c_str());
+    if (!os.is_open()) {
+        warn("Can't open LDomain checkpoint in %s\n", dir);
+        return false;
+    }
+
+    DPRINTF(PARDg5VSystem, "LDomain#%X: checkpoint to %s\n", DSid, dir);
+
+    os << "## LDomain checkpoint generated: " << curTick() << "\n";
+
+    // Cpus, sections keyed by thread index so the image restores into
+    // cpus of any other DSid
+    os << "\n[" << name() << "]\n";
+    int numThreads = tcs.size();
+    std::vector<uint8_t> active;
+    for (auto tc : tcs)
+        active.push_back(tc->status() == ThreadContext::Active);
+    paramOut(os, "DSid", DSid);
+    SERIALIZE_SCALAR(numThreads);
+    arrayParamOut(os, "active", active);
+
+    for (int i = 0; i < numThreads; i++) {
+        BaseCPU *cpu = tcs[i]->getCpuPtr();
+        os << "\n[" << csprintf("%s.xc.%d", name(), i) << "]\n";
+        cpu->serializeThread(os, tcs[i]->threadId());
+        os << "\n[" << csprintf("%s.interrupts.%d", name(), i) << "]\n";
+        cpu->getInterruptController()->serialize(os);
+    }
+
+    for (auto obj : ldomState) {
+        os << "\n[" << obj->name() << "]\n";
+        dynamic_cast<ILDomSerializable *>(obj)->serializeLDom(DSid, dir, os);
+    }
+
+    cp->incrStat(DSid, "checkpoints", 1);
+    return true;
+}
+
+bool
+PARDg5VSystem::restoreLDomain(uint16_t DSid, int image)
+{
+    std::vector<ThreadContext *> tcs;
+    if (!getLDomThreads(DSid, tcs)) {
+        warn("Try to restore unknown system with DSid: %d\n", DSid);
+        return false;
+    }
+
+    // Only a DSid that is not running can take a checkpoint
+    for (auto tc : tcs) {
+        if (tc->status() == ThreadContext::Active) {
+            warn("Try to restore into running system with DSid: %d\n", DSid);
+            return false;
+        }
+    }
+
+    // Checkpoint and paramIn are fatal on a missing file or key, the
+    // image may have gone away since the command was accepted
+    if (!ldomImageExists(image)) {
+        warn("LDomain checkpoint image %d not found\n", image);
+        return false;
+    }
+    std::string dir = ldomCheckpointDir(image, false);
+    Checkpoint checkpoint(dir);
+    Checkpoint *cp = &checkpoint;
+    const std::string section = name();
+
+    std::string value;
+    if (!cp->find(section, "DSid", value) ||
+        !cp->find(section, "numThreads", value) ||
+        !cp->find(section, "active", value)) {
+        warn("LDomain checkpoint image %d in %s is incomplete\n", image, dir);
+        return false;
+    }
+
+    uint16_t savedDSid;
+    int numThreads;
+    std::vector<uint8_t> active;
+    paramIn(cp, section, "DSid", savedDSid);
+    UNSERIALIZE_SCALAR(numThreads);
+    arrayParamIn(cp, section, "active", active);
+
+    if (numThreads != tcs.size()) {
+        warn("Can't restore LDomain of %d cpus into DSid %d with %d cpus\n",
+             numThreads, DSid, tcs.size());
+        return false;
+    }
+
+    DPRINTF(PARDg5VSystem, "LDomain#%X: restore %s (saved from DSid %X)\n",
+            DSid, dir, savedDSid);
+
+    for (int i = 0; i < numThreads; i++) {
+        ThreadContext *tc = tcs[i];
+        BaseCPU *cpu = tc->getCpuPtr();
+        cpu->unserializeThread(cp, csprintf("%s.xc.%d", name(), i),
+                               tc->threadId());
+
+        // Local APIC keeps its own id, only the guest visible state of
+        // the saved LDomain is taken over
+        PardInterrupts *localApic = dynamic_cast<PardInterrupts *>(
+            cpu->getInterruptController());
+        assert(localApic);
+        uint32_t apicId = localApic->readReg(APIC_ID);
+        localApic->unserialize(cp, csprintf("%s.interrupts.%d", name(), i));
+        localApic->setRegNoEffect(APIC_ID, apicId);
+        localApic->updateDSid(DSid);
+
+        // Translations of the previous owner are stale
+        PardTLB *itb = dynamic_cast<PardTLB *>(tc->getITBPtr());
+        PardTLB *dtb = dynamic_cast<PardTLB *>(tc->getDTBPtr());
+        assert(itb && dtb);
+        itb->updateDSid(DSid);
+        dtb->updateDSid(DSid);
+        itb->flushAll();
+        dtb->flushAll();
+    }
+
+    for (auto obj : ldomState) {
+        dynamic_cast<ILDomSerializable *>(obj)->unserializeLDom(
+            DSid, cp, obj->name());
+    }
+
+    for (int i = 0; i < numThreads; i++) {
+        if (active[i])
+            tcs[i]->activate();
+    }
+
+    this->cp->incrStat(DSid, "restores", 1);
+    DPRINTF(PARDg5VSystem, "LDomain 0x%x restore OK\n", DSid);
+    return true;
+}
+
 /*
 static void
 installSegDesc(ThreadContext *tc, SegmentRegIndex seg,
@@ -428,12 +734,11 @@ PARDg5VSystem::initBSPState(uint16_t DSid, ThreadContext *tcBSP)
     // We should now be in long mode. Yay!
 
     // Write out all valid config data (size!=0) provided by PRM
-    // e.g. SMBios/DMI, IntelMP, E820
-    for (int i=0; i<cp->getSegmentCount(DSid); i++) {
-        const Segment *seg = cp->getSegment(DSid, i);
-        if (seg->size)
-            writeOutSegment(DSid, seg->base, seg->size, seg->offset);
-    }
+    // e.g. SMBios/DMI, IntelMP, E820, ACPI, initrd, kernel
+    std::vector<Segment> segs;
+    panic_if(cp->getSegments(DSid, segs) < 0,
+             "Error get boot segments of DSid %d.\n", DSid);
+    writeOutSegments(DSid, segs);
 
     // Set MTRR Register
     tc->setMiscReg(MISCREG_MTRR_PHYS_BASE_0, 0x0000000000000006);       // Base: 0x0, Type: WriteBack
@@ -448,24 +753,50 @@ PARDg5VSystem::initBSPState(uint16_t DSid, ThreadContext *tcBSP)
     tc->setIntReg(INTREG_RSI, realModeData);
 }
 
-void
-PARDg5VSystem::writeOutSegment(uint16_t DSid,
-                               Addr base, int size, int offset)
+static bool
+segmentBaseLess(const Segment &a, const Segment &b)
 {
-    const uint8_t *ptr = NULL;
+    return a.base < b.base;
+}
 
-    // get config memory ptr
-    ptr = cp->getConfigMem(offset, size);
-    panic_if(!ptr, "Error read config memory @ 0x%x size 0x%x.\n",
-                   offset, size);
+void
+PARDg5VSystem::writeOutSegments(uint16_t DSid, std::vector<Segment> &segs)
+{
+    // Sort by guest address and merge segments contiguous both in guest
+    // memory and in config memory, so each run is one bulk writeBlob
+    std::sort(segs.begin(), segs.end(), segmentBaseLess);
 
-    // write out to system memory
     physProxy.updateDSid(DSid);
-    physProxy.writeBlob(base, ptr, size);
 
-    DPRINTF(PARDg5VSystem, "writeOutSegment DSid=0x%x,"
-                           "base=0x%x, size=0x%x, offset=0x%x\n",
-                           DSid, base, size, offset);
+    size_t i = 0;
+    while (i < segs.size()) {
+        Addr base = segs[i].base;
+        uint64_t offset = segs[i].offset;
+        uint64_t size = segs[i].size;
+
+        for (i++; i < segs.size(); i++) {
+            if (segs[i].base != base + size ||
+                segs[i].offset != offset + size)
+                break;
+            size += segs[i].size;
+        }
+
+        // write out to system memory, one chunk per config memory page
+        const ConfigMemory &cfgmem = cp->getConfigMem();
+        panic_if(!cfgmem.valid(offset, size),
+                 "Error read config memory @ 0x%x size 0x%x.\n",
+                 offset, size);
+        for (uint64_t done = 0; done < size; ) {
+            uint64_t n = ConfigMemory::chunk(offset + done, size - done);
+            physProxy.writeBlob(base + done, cfgmem.peek(offset + done), n);
+            done += n;
+        }
+        cp->incrStat(DSid, "boot_bytes", size);
+
+        DPRINTF(PARDg5VSystem, "writeOutSegments DSid=0x%x,"
+                               "base=0x%x, size=0x%x, offset=0x%x\n",
+                               DSid, base, size, offset);
+    }
 }
 
 
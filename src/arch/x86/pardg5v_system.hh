@@ -62,6 +62,29 @@ class PARDg5VSystem : public System,
        */
       PARDg5VPortProxy physProxy;
 
+      /** State of an LDomain outside its cpus, e.g. memory, devices */
+      std::vector<SimObject *> ldomState;
+
+      /**
+       * LDomain checkpoint ('C') and restore ('R') commands, deferred
+       * until the system is drained and resumed by the config script.
+       */
+      struct LDomCheckpointOp {
+          int cmd;
+          uint16_t DSid;
+          int image;
+      };
+      std::vector<LDomCheckpointOp> pendingCheckpointOps;
+
+      /** Run the ops before any cpu ticks again after resuming */
+      void processCheckpointOps();
+      EventWrapper<PARDg5VSystem, &PARDg5VSystem::processCheckpointOps>
+          checkpointOpsEvent;
+      /** Exit to the config script once all ops of this tick are queued */
+      void exitForCheckpointOps();
+      EventWrapper<PARDg5VSystem, &PARDg5VSystem::exitForCheckpointOps>
+          checkpointExitEvent;
+
   public:
 
     typedef PARDg5VSystemParams Params;
@@ -71,6 +94,15 @@ class PARDg5VSystem : public System,
   public:
 
     virtual void initState();
+    virtual void drainResume();
+
+    /**
+     * LDomain cpu ownership, exported to the config script which
+     * switches the cpus of an LDomain. Unknown LDomains have an empty
+     * mask, cpus without an LDomain return -1.
+     */
+    uint64_t getLDomCpuMask(int DSid);
+    int getCpuLDomain(int cpuId);
 
   public:
     // __override__ ICommandHandler::handleCommand()
@@ -80,9 +112,19 @@ class PARDg5VSystem : public System,
 
     void startupLDomain(uint16_t DSid);
     void killLDomain(uint16_t DSid);
+    void switchLDomain(uint16_t DSid);
+
+    void requestLDomCheckpoint(int cmd, uint16_t DSid, int image);
+    /** Image directory, empty if it can't be created */
+    std::string ldomCheckpointDir(int image, bool create);
+    bool ldomImageExists(int image);
+    bool getLDomThreads(uint16_t DSid, std::vector<ThreadContext *> &tcs);
+    /** Failures are counted in the checkpoint/restore_errors stats */
+    bool checkpointLDomain(uint16_t DSid, int image);
+    bool restoreLDomain(uint16_t DSid, int image);
 
     void initBSPState(uint16_t DSid, ThreadContext *tcBSP);
-    void writeOutSegment(uint16_t DSid, Addr base, int size, int offset);
+    void writeOutSegments(uint16_t DSid, std::vector<Segment> &segs);
 
   protected:
 
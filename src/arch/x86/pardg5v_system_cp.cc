@@ -33,66 +33,121 @@
  * Definition of PARDg5V system control plane.
  */
 
+#include <cstring>
+
 #include "arch/x86/pardg5v_system_cp.hh"
 #include "debug/ControlPlane.hh"
+#include "sim/serialize.hh"
 
 PARDg5VSystemCP::PARDg5VSystemCP(const Params *p)
     : ControlPlane(p),
       param_table_entries(p->param_table_entries),
-      stat_table_entries(p->stat_table_entries)
+      stat_table_entries(p->stat_table_entries),
+      configMem(CFGMEM_SIZE)
 {
     // Construct SystemInfo struct
     sysinfo.cpuNr = 8;
     sysinfo.memSize = (uint64_t)8<<30;
 
-    // Allocate ConfigMemory
-    configMem = new char[CFGMEM_SIZE];
-
     // Allocate ConfigTable
     paramTable = new struct ParamEntry[param_table_entries];
     statTable  = new struct StatEntry[stat_table_entries];
     memset(paramTable, 0, sizeof(struct ParamEntry)*param_table_entries);
     memset(statTable,  0, sizeof(struct StatEntry) *stat_table_entries);
+
+    // Per-DSid counters, updated by PARDg5VSystem
+    registerCounter("boots");
+    registerCounter("kills");
+    registerCounter("switches");
+    registerCounter("boot_bytes");
+    registerCounter("checkpoints");
+    registerCounter("restores");
+    registerCounter("checkpoint_errors");
+    registerCounter("restore_errors");
 }
 
 PARDg5VSystemCP::~PARDg5VSystemCP()
 {
-    delete[] configMem;
     delete[] paramTable;
     delete[] statTable;
 }
 
-const Segment * 
-PARDg5VSystemCP::getSegment(uint16_t DSid, int idx)
+struct ParamEntry *
+PARDg5VSystemCP::findParamEntry(uint16_t DSid)
 {
-    assert(idx < PARAMTABLE_SEGMENT_COUNT);
-
     for (int i=0; i<param_table_entries; i++) {
         if ((paramTable[i].flags & FLAG_VALID)
               && (paramTable[i].DSid == DSid)) {
-            return &paramTable[i].segs[idx];
+            return &paramTable[i];
         }
     }
 
     return NULL;
 }
 
-const uint8_t *
-PARDg5VSystemCP::getConfigMem(int offset, int size)
+int
+PARDg5VSystemCP::getSegments(uint16_t DSid, std::vector<Segment> &segs)
 {
-    if (offset+size > CFGMEM_SIZE)
-        return NULL;
-    return (const uint8_t *)configMem + offset;
+    struct ParamEntry *entry = findParamEntry(DSid);
+
+    segs.clear();
+    if (!entry)
+        return -ENOENT;
+
+    for (int i=0; i<PARAMTABLE_SEGMENT_COUNT; i++) {
+        if (entry->segs[i].size)
+            segs.push_back(entry->segs[i]);
+    }
+
+    if (!(entry->flags & FLAG_SEGCHAIN))
+        return segs.size();
+
+    // Walk descriptor chain, bounded in case PRM builds a loop
+    uint32_t desc_off = entry->seg_chain;
+    int max_descs = CFGMEM_SIZE / sizeof(struct SegmentDesc);
+    while (desc_off != SEGDESC_END) {
+        struct SegmentDesc desc;
+        if (desc_off > CFGMEM_SIZE - sizeof(desc) || max_descs-- == 0) {
+            warn("PARDg5VSystemCP: broken segment chain of DSid %d "
+                 "@ 0x%x\n", DSid, desc_off);
+            return -EINVAL;
+        }
+        configMem.read(desc_off, &desc, sizeof(desc));
+
+        if (desc.size) {
+            Segment seg;
+            seg.base = desc.base;
+            seg.size = desc.size;
+            seg.offset = desc.offset;
+            segs.push_back(seg);
+        }
+        desc_off = desc.next;
+    }
+
+    DPRINTF(ControlPlane, "DSid %d: %d boot segments\n", DSid, segs.size());
+    return segs.size();
 }
 
 int
 PARDg5VSystemCP::getCpuMask(uint16_t DSid, uint64_t *mask)
 {
+    struct ParamEntry *entry = findParamEntry(DSid);
+
     assert(mask);
+    if (!entry)
+        return -ENOENT;
+    *mask = entry->cpuMask;
+    return 0;
+}
+
+int
+PARDg5VSystemCP::getCpuOwner(int cpu, uint16_t *DSid)
+{
+    assert(DSid);
     for (int i=0; i<param_table_entries; i++) {
         if ((paramTable[i].flags & FLAG_VALID)
-              && (paramTable[i].DSid == DSid)) {
-            *mask = paramTable[i].cpuMask;
+              && (paramTable[i].cpuMask & (1ULL << cpu))) {
+            *DSid = paramTable[i].DSid;
             return 0;
         }
     }
@@ -126,11 +181,6 @@ PARDg5VSystemCP::parseAddr(uint32_t addr)
             }
         }
         break;
-      case ADDRTYPE_CFGMEM:
-        offset = cfgmem_addr2offset(addr);
-        if (offset <= CFGMEM_SIZE - sizeof(uint64_t))
-            ptr = configMem;
-        break;
       case ADDRTYPE_SYSINFO:
         offset = sysinfo_addr2offset(addr);
         if (offset <= sizeof(sysinfo) - sizeof(uint64_t))
@@ -149,6 +199,14 @@ PARDg5VSystemCP::queryTable(uint16_t DSid, uint32_t addr)
     DPRINTF(ControlPlane, "queryTable(DSid=%d, addr=0x%x)\n",
             DSid, addr);
 
+    // ConfigMemory is sparse, access it by copy
+    if ((addr & ADDRTYPE_MASK) == ADDRTYPE_CFGMEM) {
+        uint64_t data = 0xFFFFFFFFFFFFFFFF;
+        if (configMem.valid(cfgmem_addr2offset(addr), sizeof(data)))
+            configMem.read(cfgmem_addr2offset(addr), &data, sizeof(data));
+        return data;
+    }
+
     pdata = parseAddr(addr);
     if (!pdata) {
         warn("PARDg5VSystemCP: unknown addr 0x%x", addr);
@@ -166,6 +224,14 @@ PARDg5VSystemCP::updateTable(uint16_t DSid, uint32_t addr, uint64_t data)
     DPRINTF(ControlPlane, "updateTable(DSid=%d, addr=0x%x, data=0x%x)\n",
             DSid, addr, data);
 
+    if ((addr & ADDRTYPE_MASK) == ADDRTYPE_CFGMEM) {
+        if (configMem.valid(cfgmem_addr2offset(addr), sizeof(data)))
+            configMem.write(cfgmem_addr2offset(addr), &data, sizeof(data));
+        else
+            warn("PARDg5VSystemCP: unknown addr 0x%x", addr);
+        return;
+    }
+
     pdata = parseAddr(addr);
     if (!pdata) {
         warn("PARDg5VSystemCP: unknown addr 0x%x", addr);
@@ -175,6 +241,26 @@ PARDg5VSystemCP::updateTable(uint16_t DSid, uint32_t addr, uint64_t data)
     *pdata = data;
 }
 
+void
+PARDg5VSystemCP::serialize(std::ostream &os)
+{
+    arrayParamOut(os, "paramTable", (uint8_t *)paramTable,
+                  sizeof(struct ParamEntry) * param_table_entries);
+    arrayParamOut(os, "statTable", (uint8_t *)statTable,
+                  sizeof(struct StatEntry) * stat_table_entries);
+    configMem.serialize("configMem", os);
+}
+
+void
+PARDg5VSystemCP::unserialize(Checkpoint *cp, const std::string &section)
+{
+    arrayParamIn(cp, section, "paramTable", (uint8_t *)paramTable,
+                 sizeof(struct ParamEntry) * param_table_entries);
+    arrayParamIn(cp, section, "statTable", (uint8_t *)statTable,
+                 sizeof(struct StatEntry) * stat_table_entries);
+    configMem.unserialize("configMem", cp, section);
+}
+
 PARDg5VSystemCP *
 PARDg5VSystemCPParams::create()
 {
@@ -57,12 +57,22 @@
  *     |10|**********************|  256B  |
  *     +--+----------------------+--------+
  *
+ * Boot segments: besides the PARAMTABLE_SEGMENT_COUNT inline segments,
+ * a ParamEntry with FLAG_SEGCHAIN set points (seg_chain) to a chain of
+ * SegmentDesc stored in ConfigMemory, terminated by SEGDESC_END:
+ *
+ *     ParamEntry.seg_chain --> SegmentDesc --> SegmentDesc --> END
+ *                              (base,size,      ...
+ *                               offset,next)
  */
 
 #ifndef __ARCH_X86_PARDG5V_SYSTEM_CP_HH__
 #define __ARCH_X86_PARDG5V_SYSTEM_CP_HH__
 
+#include <vector>
+
 #include "params/PARDg5VSystemCP.hh"
+#include "prm/ConfigMemory.hh"
 #include "prm/ControlPlane.hh"
 
 #define CFGMEM_BITS	24
@@ -78,6 +88,21 @@ struct Segment {
 #define PARAMTABLE_SEGMENT_COUNT	4
 
 #define FLAG_VALID			0x8000
+#define FLAG_SEGCHAIN			0x4000
+
+/**
+ * Boot segment descriptor in ConfigMemory, chained by config memory
+ * offset of the next descriptor.
+ */
+struct SegmentDesc {
+    uint64_t base;
+    uint32_t size;
+    uint32_t offset;
+    uint32_t next;
+    uint32_t __padding;
+};
+
+#define SEGDESC_END			0xFFFFFFFF
 
 struct ParamEntry {
     uint16_t DSid;
@@ -86,6 +111,8 @@ struct ParamEntry {
     uint64_t cpuMask;
     uint64_t bsp_entry_addr;
     struct Segment segs[PARAMTABLE_SEGMENT_COUNT];
+    uint32_t seg_chain;
+    uint32_t __padding2;
 };
 
 struct StatEntry {
@@ -109,7 +136,7 @@ class PARDg5VSystemCP : public ControlPlane
     struct ParamEntry *paramTable;
     struct StatEntry  *statTable;
     struct SystemInfo sysinfo;
-    char *configMem;
+    ConfigMemory configMem;
 
   public:
     typedef PARDg5VSystemCPParams Params;
@@ -117,16 +144,26 @@ class PARDg5VSystemCP : public ControlPlane
     ~PARDg5VSystemCP();
 
   public:
-    int getSegmentCount(uint16_t DSid) { return PARAMTABLE_SEGMENT_COUNT; }
-    const Segment * getSegment(uint16_t DSid, int idx);
+    /**
+     * Collect all non-empty boot segments of DSid, inline segments first
+     * and then the descriptor chain.
+     * @return number of segments, or negative errno
+     */
+    int getSegments(uint16_t DSid, std::vector<Segment> &segs);
     int getCpuMask(uint16_t DSid, uint64_t *mask);
-    const uint8_t *getConfigMem(int offset, int size);
+    /** Find the LDomain whose cpuMask includes cpu */
+    int getCpuOwner(int cpu, uint16_t *DSid);
+    const ConfigMemory &getConfigMem() const { return configMem; }
 
     virtual uint64_t queryTable(uint16_t DSid, uint32_t addr);
     virtual void updateTable(uint16_t DSid, uint32_t addr, uint64_t data);
 
+    virtual void serialize(std::ostream &os);
+    virtual void unserialize(Checkpoint *cp, const std::string &section);
+
   private:
     uint64_t * parseAddr(uint32_t addr);
+    struct ParamEntry *findParamEntry(uint16_t DSid);
 
   protected:
     const Params * param() const
@@ -50,7 +50,7 @@ class TaggedAtomicSimpleCPU(AtomicSimpleCPU):
                                            pio_addr=0x2000000000000000)
             _localApic = self.interrupts
         else:
-            super(self, TaggedAtomicSimpleCPU).createInterruptController()
+            super(TaggedAtomicSimpleCPU, self).createInterruptController()
 
 class TaggedTimingSimpleCPU(TimingSimpleCPU):
     itb = PARDX86TLB()
@@ -65,9 +65,23 @@ class TaggedTimingSimpleCPU(TimingSimpleCPU):
                                            pio_addr=0x2000000000000000)
             _localApic = self.interrupts
         else:
-            super(self, TaggedAtomicSimpleCPU).createInterruptController()
+            super(TaggedTimingSimpleCPU, self).createInterruptController()
 
 class TaggedDerivO3CPU(DerivO3CPU):
+    itb = PARDX86TLB()
+    dtb = PARDX86TLB()
+
+    def createInterruptController(self):
+        if buildEnv['TARGET_ISA'] == 'x86':
+            self.apic_clk_domain = DerivedClockDomain(clk_domain =
+                                                      Parent.clk_domain,
+                                                      clk_divider = 16)
+            self.interrupts = PARDX86LocalApic(clk_domain = self.apic_clk_domain,
+                                           pio_addr=0x2000000000000000)
+            _localApic = self.interrupts
+        else:
+            super(TaggedDerivO3CPU, self).createInterruptController()
+
     def connectCachedPorts(self, bus):
         from TagXBar import TagXBar
         self.tagbus = TagXBar()
@@ -47,7 +47,7 @@ class I82094AX(BasicPioDevice):
             "Latency for an interrupt to propagate through this device.")
     external_int_pic = Param.SimObject(NULL, "External PIC, if any")
 
-    max_guests = Param.Int(8, "MAximum guests support")
+    max_guests = Param.Int(0, "Maximum guests support, 0 for unlimited")
 
     def pin(self, line):
         return X86IntSinkPin(device=self, number=line)
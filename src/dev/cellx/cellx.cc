@@ -81,6 +81,12 @@ CellX::postPciInt(int line)
     ich->ioApic->signalInterrupt(line);
 }
 
+void
+CellX::postPciInt(uint16_t DSid, int line)
+{
+    ich->ioApic->signalGuestInterrupt(DSid, line);
+}
+
 void
 CellX::clearPciInt(int line)
 {
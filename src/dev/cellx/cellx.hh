@@ -75,6 +75,12 @@ class CellX : public Platform
      */
     virtual void postPciInt(int line);
 
+    /**
+     * Post a pci interrupt to the LDomain DSid only, for lines shared
+     * by the functions of an SR-IOV device.
+     */
+    void postPciInt(uint16_t DSid, int line);
+
     /**
      * Clear a posted PCI->CPU interrupt
      */
@@ -30,6 +30,8 @@
  *          Jiuyue Ma
  */
 
+#include <algorithm>
+
 #include "arch/x86/intmessage.hh"
 #include "arch/x86/pard_interrupts.hh"
 #include "cpu/base.hh"
@@ -45,7 +47,8 @@ X86ISA::I82094AX::I82094AX(Params *p)
     : BasicPioDevice(p, 20), IntDevice(this, p->int_latency),
       ich(NULL),
       extIntPic(dynamic_cast<I8259*>(p->external_int_pic)),
-      lowestPriorityOffset(0)
+      lowestPriorityOffset(0),
+      router(p->system)
 {
     // This assumes there's only one I/O APIC in the system and since the apic
     // id is stored in a 8-bit field with 0xff meaning broadcast, the id must
@@ -59,30 +62,93 @@ X86ISA::I82094AX::I82094AX(Params *p)
     /**
      * XXX: PARD Extended
      */
-    assert(p->max_guests < 0xFF);
+    assert(p->max_guests >= 0 && p->max_guests <= 0x10000);
     max_guests = p->max_guests;
 
-    // Replicate RegSel register
-    while (regSelVector.size() < p->max_guests)
-        regSelVector.push_back(0);
+    // Guests are allocated on first access, starting from this state
+    defaultGuest.DSid = 0xFFFF;
+    defaultGuest.regSel = 0;
+    defaultGuest.broadcastSeen = 0;
+    RedirTableEntry entry = 0;
+    entry.mask = 1;
+    for (int i = 0; i < TableSize; i++)
+        defaultGuest.redirTable[i] = entry;
 
-    // Interrupt Redirect Table
-    redirTableVector.resize(max_guests);
-    for (int id=0; id<max_guests; id++) {
-        redirTableVector[id] = new RedirTableEntry[TableSize];
-        RedirTableEntry entry = 0;
-        entry.mask = 1;
-        for (int i = 0; i < TableSize; i++)
-            redirTableVector[id][i] = entry;
-    }
     for (int i = 0; i < TableSize; i++)
         pinStates[i] = false;
 }
 
 X86ISA::I82094AX::~I82094AX()
 {
-    for (int id=0; id<max_guests; id++)
-        delete[] redirTableVector[id];
+}
+
+X86ISA::I82094AX::GuestState &
+X86ISA::I82094AX::getGuest(uint16_t DSid)
+{
+    auto it = guestIndex.find(DSid);
+    if (it == guestIndex.end()) {
+        panic_if(max_guests && guests.size() >= max_guests,
+                 "I/O APIC: too many guests (%d), DSid %d.\n",
+                 max_guests, DSid);
+        guests.push_back(defaultGuest);
+        guests.back().DSid = DSid;
+        guests.back().broadcastSeen = broadcastLog.size();
+        guestIndex[DSid] = guests.size() - 1;
+        DPRINTF(I82094AX, "Allocate state for DSid %d.\n", DSid);
+        return guests.back();
+    }
+
+    // Catch up with broadcast writes issued since last access
+    GuestState &guest = guests[it->second];
+    if (guest.broadcastSeen < broadcastLog.size()) {
+        while (guest.broadcastSeen < broadcastLog.size()) {
+            const std::pair<uint8_t, uint32_t> &w =
+                broadcastLog[guest.broadcastSeen++];
+            writeRedirEntry(guest, w.first, w.second);
+        }
+        foldBroadcastLog();
+    }
+    return guest;
+}
+
+void
+X86ISA::I82094AX::foldBroadcastLog()
+{
+    // Drop the log prefix that every allocated guest has applied
+    uint32_t applied = broadcastLog.size();
+    for (int i = 0; i < guests.size() && applied; i++)
+        applied = std::min(applied, guests[i].broadcastSeen);
+    if (!applied)
+        return;
+
+    broadcastLog.erase(broadcastLog.begin(), broadcastLog.begin() + applied);
+    for (int i = 0; i < guests.size(); i++)
+        guests[i].broadcastSeen -= applied;
+    DPRINTF(I82094AX, "Fold %d broadcast writes, %d pending.\n",
+            applied, broadcastLog.size());
+}
+
+const X86ISA::I82094AX::GuestState &
+X86ISA::I82094AX::peekGuest(uint16_t DSid)
+{
+    // Do not allocate for DSids that never touched the I/O APIC
+    if (guestIndex.find(DSid) == guestIndex.end())
+        return defaultGuest;
+    return getGuest(DSid);
+}
+
+void
+X86ISA::I82094AX::writeRedirEntry(GuestState &guest,
+                                  uint8_t offset, uint32_t value)
+{
+    int index = (offset - 0x10) / 2;
+    if (offset % 2) {
+        guest.redirTable[index].topDW = value;
+        guest.redirTable[index].topReserved = 0;
+    } else {
+        guest.redirTable[index].bottomDW = value;
+        guest.redirTable[index].bottomReserved = 0;
+    }
 }
 
 void
@@ -119,7 +185,7 @@ X86ISA::I82094AX::read(PacketPtr pkt)
 {
     assert(pkt->getSize() == 4);
     Addr offset = pkt->getAddr() - pioAddr;
-    uint8_t &regSel = regSelVector[pkt->getDSid()];
+    uint8_t regSel = peekGuest(pkt->getDSid()).regSel;
     switch(offset) {
       case 0:
         pkt->set<uint32_t>(regSel);
@@ -139,13 +205,13 @@ X86ISA::I82094AX::write(PacketPtr pkt)
 {
     assert(pkt->getSize() == 4);
     Addr offset = pkt->getAddr() - pioAddr;
-    uint8_t &regSel = regSelVector[pkt->getDSid()];
     switch(offset) {
       case 0:
-        regSel = pkt->get<uint32_t>();
+        getGuest(pkt->getDSid()).regSel = pkt->get<uint32_t>();
         break;
       case 16:
-        writeReg(pkt->getDSid(), regSel, pkt->get<uint32_t>());
+        writeReg(pkt->getDSid(), getGuest(pkt->getDSid()).regSel,
+                 pkt->get<uint32_t>());
         break;
       default:
         panic("Illegal write to I/O APIC.\n");
@@ -157,9 +223,16 @@ X86ISA::I82094AX::write(PacketPtr pkt)
 void
 X86ISA::I82094AX::writeReg(uint8_t offset, uint32_t value)
 {
-    uint16_t DSid;
-    for (DSid=0; DSid<max_guests; DSid++)
-        writeReg(DSid, offset, value);
+    if (offset >= 0x10 && offset <= (0x10 + TableSize * 2)) {
+        // Applied lazily to existing guests, see getGuest()
+        writeRedirEntry(defaultGuest, offset, value);
+        if (!guests.empty())
+            broadcastLog.push_back(std::make_pair(offset, value));
+        DPRINTF(I82094AX,
+                "Broadcast %#x to I/O APIC register %#x .\n", value, offset);
+    } else {
+        writeReg(defaultGuest.DSid, offset, value);
+    }
 }
 
 void
@@ -172,15 +245,7 @@ X86ISA::I82094AX::writeReg(uint16_t DSid, uint8_t offset, uint32_t value)
     } else if (offset == 0x2) {
         arbId = bits(value, 31, 24);
     } else if (offset >= 0x10 && offset <= (0x10 + TableSize * 2)) {
-        int index = (offset - 0x10) / 2;
-        RedirTableEntry * &redirTable = redirTableVector[DSid];
-        if (offset % 2) {
-            redirTable[index].topDW = value;
-            redirTable[index].topReserved = 0;
-        } else {
-            redirTable[index].bottomDW = value;
-            redirTable[index].bottomReserved = 0;
-        }
+        writeRedirEntry(getGuest(DSid), offset, value);
     } else {
         warn("Access to undefined I/O APIC register %#x.\n", offset);
     }
@@ -200,7 +265,7 @@ X86ISA::I82094AX::readReg(uint16_t DSid, uint8_t offset)
         result = arbId << 24;
     } else if (offset >= 0x10 && offset <= (0x10 + TableSize * 2)) {
         int index = (offset - 0x10) / 2;
-        RedirTableEntry * &redirTable = redirTableVector[DSid];
+        const RedirTableEntry *redirTable = peekGuest(DSid).redirTable;
         if (offset % 2) {
             result = redirTable[index].topDW;
         } else {
@@ -217,11 +282,8 @@ X86ISA::I82094AX::readReg(uint16_t DSid, uint8_t offset)
 void
 X86ISA::I82094AX::signalInterrupt(int line)
 {
-    // TODO:
     // Check ICH control plane, figure out <DSid, logical line>
-    std::vector<std::pair<uint16_t, int> > targets;
-    ich->cp->remapInterrupt(line, targets);
-    for (auto t : targets)
+    for (auto t : ich->cp->getInterruptTargets(line))
         signalInterrupt(t.first, t.second);
 
 /*
@@ -231,13 +293,21 @@ X86ISA::I82094AX::signalInterrupt(int line)
 */
 }
 
+void
+X86ISA::I82094AX::signalGuestInterrupt(uint16_t DSid, int line)
+{
+    for (auto t : ich->cp->getInterruptTargets(line)) {
+        if (t.first == DSid)
+            signalInterrupt(t.first, t.second);
+    }
+}
+
 void
 X86ISA::I82094AX::signalInterrupt(uint16_t DSid, int line)
 {
     DPRINTF(I82094AX, "Received interrupt %d.\n", line);
     assert(line < TableSize);
-    RedirTableEntry * &redirTable = redirTableVector[DSid];
-    RedirTableEntry entry = redirTable[line];
+    RedirTableEntry entry = peekGuest(DSid).redirTable[line];
     if (entry.mask) {
         DPRINTF(I82094AX, "Entry was masked.\n");
         return;
@@ -270,24 +340,7 @@ X86ISA::I82094AX::signalInterrupt(uint16_t DSid, int line)
                 apics.push_back(message.destination);
             }
         } else {
-            for (int i = 0; i < numContexts; i++) {
-                // Convert LocalApic pointer to PARDX86LocalApic
-                PardInterrupts *localApic = dynamic_cast<PardInterrupts *>(
-                    sys->getThreadContext(i)->
-                    getCpuPtr()->getInterruptController());
-                panic_if(!localApic, "%s is not a PARDX86LocalApic.\n",
-                         sys->getThreadContext(i)->
-                         getCpuPtr()->getInterruptController());
-
-                // Only send interrupt to localApic with requested DSid
-                if (localApic->getDSid() != DSid)
-                    continue;
-
-                if ((localApic->readReg(APIC_LOGICAL_DESTINATION) >> 24) &
-                        message.destination) {
-                    apics.push_back(localApic->getInitialApicId());
-                }
-            }
+            apics = router.getLogicalRoute(DSid, message.destination);
             if (message.deliveryMode == DeliveryMode::LowestPriority &&
                     apics.size()) {
                 // The manual seems to suggest that the chipset just does
@@ -344,38 +397,110 @@ X86ISA::I82094AX::lowerInterruptPin(int number)
 void
 X86ISA::I82094AX::serialize(std::ostream &os)
 {
-    SERIALIZE_VECTOR(regSelVector);
     SERIALIZE_SCALAR(initialApicId);
     SERIALIZE_SCALAR(id);
     SERIALIZE_SCALAR(arbId);
     SERIALIZE_SCALAR(lowestPriorityOffset);
     SERIALIZE_SCALAR(max_guests);
-    for (int i=0; i<max_guests; i++) {
-        uint64_t* redirTableArray = (uint64_t*)redirTableVector[i];
-        SERIALIZE_INDEXED_ARRAY(redirTableArray, i, TableSize);
+
+    uint64_t *defaultRedirTable = (uint64_t *)defaultGuest.redirTable;
+    SERIALIZE_ARRAY(defaultRedirTable, TableSize);
+
+    // Only allocated guests are saved, after catching up broadcasts
+    std::vector<uint16_t> guestDSids;
+    std::vector<uint8_t> guestRegSels;
+    for (int i = 0; i < guests.size(); i++) {
+        GuestState &guest = getGuest(guests[i].DSid);
+        guestDSids.push_back(guest.DSid);
+        guestRegSels.push_back(guest.regSel);
+        uint64_t *redirTableArray = (uint64_t *)guest.redirTable;
+        SERIALIZE_INDEXED_ARRAY(redirTableArray, guest.DSid, TableSize);
     }
+    SERIALIZE_VECTOR(guestDSids);
+    SERIALIZE_VECTOR(guestRegSels);
     SERIALIZE_ARRAY(pinStates, TableSize);
 }
 
 void
 X86ISA::I82094AX::unserialize(Checkpoint *cp, const std::string &section)
 {
-    uint64_t redirTableArray[TableSize];
-    UNSERIALIZE_VECTOR(regSelVector);
     UNSERIALIZE_SCALAR(initialApicId);
     UNSERIALIZE_SCALAR(id);
     UNSERIALIZE_SCALAR(arbId);
     UNSERIALIZE_SCALAR(lowestPriorityOffset);
     UNSERIALIZE_SCALAR(max_guests);
-    for (int id=0; id < max_guests; id++) {
-        UNSERIALIZE_INDEXED_ARRAY(redirTableArray, id, TableSize);
+
+    uint64_t redirTableArray[TableSize];
+    guests.clear();
+    guestIndex.clear();
+    broadcastLog.clear();
+
+    // Checkpoints taken before per-guest allocation keep one register
+    // selector and redirection table for each of the max_guests DSids.
+    std::string oldRegSels;
+    if (cp->find(section, "regSelVector", oldRegSels)) {
+        std::vector<uint8_t> regSelVector;
+        UNSERIALIZE_VECTOR(regSelVector);
+        for (int g = 0; g < max_guests; g++) {
+            GuestState &guest = getGuest(g);
+            guest.regSel = g < regSelVector.size() ? regSelVector[g] : 0;
+            UNSERIALIZE_INDEXED_ARRAY(redirTableArray, g, TableSize);
+            for (int i = 0; i < TableSize; i++)
+                guest.redirTable[i] = (RedirTableEntry)redirTableArray[i];
+        }
+        UNSERIALIZE_ARRAY(pinStates, TableSize);
+        return;
+    }
+
+    uint64_t defaultRedirTable[TableSize];
+    UNSERIALIZE_ARRAY(defaultRedirTable, TableSize);
+    for (int i = 0; i < TableSize; i++)
+        defaultGuest.redirTable[i] = (RedirTableEntry)defaultRedirTable[i];
+
+    std::vector<uint16_t> guestDSids;
+    std::vector<uint8_t> guestRegSels;
+    UNSERIALIZE_VECTOR(guestDSids);
+    UNSERIALIZE_VECTOR(guestRegSels);
+
+    for (int g = 0; g < guestDSids.size(); g++) {
+        GuestState &guest = getGuest(guestDSids[g]);
+        guest.regSel = guestRegSels[g];
+        UNSERIALIZE_INDEXED_ARRAY(redirTableArray, guestDSids[g], TableSize);
         for (int i = 0; i < TableSize; i++)
-            redirTableVector[id][i] = (RedirTableEntry)redirTableArray[i];
+            guest.redirTable[i] = (RedirTableEntry)redirTableArray[i];
     }
 
     UNSERIALIZE_ARRAY(pinStates, TableSize);
 }
 
+void
+X86ISA::I82094AX::serializeLDom(uint16_t DSid, const std::string &dir,
+                                std::ostream &os)
+{
+    const GuestState &guest = peekGuest(DSid);
+    uint8_t regSel = guest.regSel;
+    uint64_t redirTable[TableSize];
+    for (int i = 0; i < TableSize; i++)
+        redirTable[i] = guest.redirTable[i];
+    SERIALIZE_SCALAR(regSel);
+    SERIALIZE_ARRAY(redirTable, TableSize);
+}
+
+void
+X86ISA::I82094AX::unserializeLDom(uint16_t DSid, Checkpoint *cp,
+                                  const std::string &section)
+{
+    GuestState &guest = getGuest(DSid);
+    uint8_t regSel;
+    uint64_t redirTable[TableSize];
+    UNSERIALIZE_SCALAR(regSel);
+    UNSERIALIZE_ARRAY(redirTable, TableSize);
+    guest.regSel = regSel;
+    for (int i = 0; i < TableSize; i++)
+        guest.redirTable[i] = (RedirTableEntry)redirTable[i];
+    DPRINTF(I82094AX, "Restore redirection table of DSid %d.\n", DSid);
+}
+
 X86ISA::I82094AX *
 I82094AXParams::create()
 {
@@ -35,10 +35,12 @@
 
 #include <map>
 
+#include "arch/x86/pard_interrupts.hh"
 #include "base/bitunion.hh"
 #include "dev/x86/intdev.hh"
 #include "dev/io_device.hh"
 #include "params/I82094AX.hh"
+#include "prm/interfaces.hh"
 
 class PARDg5VICH;
 
@@ -48,7 +50,8 @@ namespace X86ISA
 class I8259;
 class Interrupts;
 
-class I82094AX : public BasicPioDevice, public IntDevice
+class I82094AX : public BasicPioDevice, public IntDevice,
+                 public ILDomSerializable
 {
   public:
     BitUnion64(RedirTableEntry)
@@ -72,10 +75,9 @@ class I82094AX : public BasicPioDevice, public IntDevice
   protected:
     I8259 * extIntPic;
 
-    // XXX: Maximum guests support
+    // XXX: Maximum guests support, 0 for unlimited
     int max_guests;
 
-    std::vector<uint8_t> regSelVector;                // XXX: PARD extended
     uint8_t initialApicId;
     uint8_t id;
     uint8_t arbId;
@@ -87,9 +89,35 @@ class I82094AX : public BasicPioDevice, public IntDevice
     // to deal with the arbitration and APIC bus guck.
     static const uint8_t APICVersion = 0x14;
 
-    std::vector<RedirTableEntry *> redirTableVector;  // XXX: PARD extended
+    /**
+     * XXX: PARD extended
+     * Per-DSid I/O APIC state, allocated on first access and kept in a
+     * contiguous vector. Broadcast writes are applied to defaultGuest
+     * (the state new guests start from) and logged; an existing guest
+     * replays the log entries it has not seen yet when it is accessed,
+     * and the prefix applied by all guests is then folded away.
+     */
+    struct GuestState {
+        uint16_t DSid;
+        uint8_t regSel;
+        uint32_t broadcastSeen;
+        RedirTableEntry redirTable[TableSize];
+    };
+    std::vector<GuestState> guests;
+    std::map<uint16_t, int> guestIndex;
+    GuestState defaultGuest;
+    std::vector<std::pair<uint8_t, uint32_t> > broadcastLog;
+
+    GuestState &getGuest(uint16_t DSid);
+    void foldBroadcastLog();
+    const GuestState &peekGuest(uint16_t DSid);
+    void writeRedirEntry(GuestState &guest, uint8_t offset, uint32_t value);
+
     bool pinStates[TableSize];
 
+    /** Cached <DSid, logical destination> to local APIC routes */
+    PardApicRouter router;
+
   public:
     typedef I82094AXParams Params;
 
@@ -118,6 +146,8 @@ class I82094AX : public BasicPioDevice, public IntDevice
                                   PortID idx = InvalidPortID);
 
     void signalInterrupt(int line);
+    // Physical line of a device function owned by DSid only
+    void signalGuestInterrupt(uint16_t DSid, int line);
     void raiseInterruptPin(int number);
     void lowerInterruptPin(int number);
 
@@ -127,6 +157,12 @@ class I82094AX : public BasicPioDevice, public IntDevice
   public:
     virtual void serialize(std::ostream &os);
     virtual void unserialize(Checkpoint *cp, const std::string &section);
+
+    // Redirection table of a single guest, for LDomain checkpoints
+    virtual void serializeLDom(uint16_t DSid, const std::string &dir,
+                               std::ostream &os);
+    virtual void unserializeLDom(uint16_t DSid, Checkpoint *cp,
+                                 const std::string &section);
 };
 
 } // namespace X86ISA
@@ -54,6 +54,8 @@ PARDg5VICHCP::PARDg5VICHCP(const Params *p)
         {{ _IO(0x3e8), 8, 6 }, { _IO(0x70), 4, 8 }, { _IO(0x48), 4, 2 }, { 0xFEC00000, 0x14, 0xFFFF }},
         {{ _IO(0x2e8), 8, 7 }, { _IO(0x70), 4, 8 }, { _IO(0x4C), 4, 3 }, { 0xFEC00000, 0x14, 0xFFFF }},
     };
+
+    rebuildInterruptRoutes();
 }
 
 PARDg5VICHCP::~PARDg5VICHCP()
@@ -91,6 +93,11 @@ PARDg5VICHCP::updateTable(uint16_t DSid, uint32_t addr, uint64_t data)
     }
 
     *pdata = data;
+
+    // interrupt lines or DSid of an entry may changed
+    if ((addr & ADDRTYPE_MASK) == ADDRTYPE_CFGTBL &&
+        cfgtbl_addr2type(addr) == CFGTBL_TYPE_PARAM)
+        rebuildInterruptRoutes();
 }
 
 uint64_t *
@@ -170,16 +177,25 @@ PARDg5VICHCP::remapInterrupt(
     int line,
     std::vector<std::pair<uint16_t, int> > &targets)
 {
-    targets.clear();
-    for (int i=0; i<param_table_entries; i++) {
-        if (paramTable[i].intlines[line] != -1) {
-            targets.push_back(std::pair<uint16_t, int>(
-                paramTable[i].DSid,
-                paramTable[i].intlines[line]));
+    targets = getInterruptTargets(line);
+    return !targets.empty();
+}
+
+void
+PARDg5VICHCP::rebuildInterruptRoutes()
+{
+    for (int line=0; line<ICH_INTLINES_NR; line++) {
+        intRoutes[line].clear();
+        for (int i=0; i<param_table_entries; i++) {
+            if (paramTable[i].intlines[line] != -1) {
+                intRoutes[line].push_back(std::pair<uint16_t, int>(
+                    paramTable[i].DSid,
+                    paramTable[i].intlines[line]));
+            }
         }
     }
 
-    return !targets.empty();
+    DPRINTF(ControlPlane, "Interrupt routes rebuilt.\n");
 }
 
 PARDg5VICHCP *
@@ -47,6 +47,7 @@
 
 
 #define ICH_COMPOMENTS_NR       4
+#define ICH_INTLINES_NR         24
 
 /**
  * Config Table
@@ -56,7 +57,7 @@ struct ParamEntry {
     uint16_t DSid;
     uint16_t selected;
     uint64_t regbase[ICH_COMPOMENTS_NR];
-    int intlines[24];
+    int intlines[ICH_INTLINES_NR];
 };
 
 /**
@@ -74,12 +75,21 @@ struct ICHInfo {
 
 class PARDg5VICHCP : public ControlPlane
 {
+  public:
+    typedef std::vector<std::pair<uint16_t, int> > InterruptTargets;
+
   protected:
     int param_table_entries;
     int compoments_nr;
     struct ParamEntry *paramTable;
     struct ICH_COMPOMENT (*compoments)[ICH_COMPOMENTS_NR];
 
+    /**
+     * <DSid, logical line> targets of each physical interrupt line,
+     * rebuilt from paramTable whenever the PRM updates it.
+     */
+    InterruptTargets intRoutes[ICH_INTLINES_NR];
+
   public:
     typedef PARDg5VICHCPParams Params;
     PARDg5VICHCP(const Params *p);
@@ -93,9 +103,14 @@ class PARDg5VICHCP : public ControlPlane
                    Addr *base, Addr*remapped) const;
     bool remapInterrupt(int line,
                    std::vector<std::pair<uint16_t, int> > &targets);
+    const InterruptTargets &getInterruptTargets(int line) const {
+        assert(line >= 0 && line < ICH_INTLINES_NR);
+        return intRoutes[line];
+    }
 
   private:
     uint64_t *parseAddr(uint32_t addr);
+    void rebuildInterruptRoutes();
 
   protected:
     const Params *param() const
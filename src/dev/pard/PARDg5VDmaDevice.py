@@ -35,4 +35,8 @@ class PARDg5VDmaDevice(PioDevice):
     cxx_header = "dev/pard/dma_device.hh"
     abstract = True
     dma = MasterPort("DMA port")
+    # DMA packets span a cache line by default. Larger bursts cut the
+    # packet count, but are only safe when nothing below the device
+    # snoops or caches DMA traffic.
+    burst_size = Param.MemorySize('0B', "DMA packet size, 0 for a cache line")
 
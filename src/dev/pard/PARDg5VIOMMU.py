@@ -0,0 +1,65 @@
+# Copyright (c) 2015 Institute of Computing Technology, CAS
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met: redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer;
+# redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the
+# documentation and/or other materials provided with the distribution;
+# neither the name of the copyright holders nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+# Authors: Jiuyue Ma
+
+from m5.params import *
+from m5.proxy import *
+from ControlPlane import ControlPlane
+from XBridge import XBridge
+
+class PARDg5VIOMMUCP(ControlPlane):
+    type = 'PARDg5VIOMMUCP'
+    cxx_header = 'dev/pard/iommu_cp.hh'
+
+    # CPN address 5:0
+    cp_dev = 5
+    cp_fun = 0
+    # Type 'T' Translation, IDENT: PARDg5VIOMMU
+    Type = 0x54
+    IDENT = "PARDg5VIOMMU"
+
+    param_table_entries = Param.Int(32, "Number of parameter table entries")
+
+class PARDg5VIOMMU(XBridge):
+    type = 'PARDg5VIOMMU'
+    cxx_header = "dev/pard/iommu.hh"
+
+    # IOMMU Control Plane, holds the I/O page table root of each DSid
+    cp = Param.PARDg5VIOMMUCP(PARDg5VIOMMUCP(),
+                              "Control plane for PARDg5-V IOMMU")
+    system = Param.System(Parent.any, "System the IOMMU belongs to")
+
+    iotlb_sets = Param.Unsigned(64, "IOTLB sets, a power of 2")
+    iotlb_ways = Param.Unsigned(4, "IOTLB ways")
+    iotlb_latency = Param.Cycles(2, "IOTLB lookup latency")
+    walkers = Param.Unsigned(4, "Page table walks in flight")
+
+    # DSids without a param table row keep untranslated DMA, or fault
+    default_bypass = Param.Bool(True,
+        "Pass DMA of DSids without a page table untranslated")
+
+    ldoms = Param.Unsigned(64, "DSids with their own IOTLB statistics")
@@ -34,10 +34,22 @@ from PARDg5VPci import PARDg5VPciDevice
 from Ide import IdeID
 from DiskImage import DiskImage
 
+class PARDg5VIOScheduler(SimObject):
+    type = 'PARDg5VIOScheduler'
+    cxx_header = "dev/pard/io_sched.hh"
+    cp = Param.PARDg5VIOHubCP(NULL, "IOHub control plane with I/O shares")
+    latency = Param.Latency('100us', "Fixed service time of a request")
+    bandwidth = Param.MemoryBandwidth('200MB/s', "Device bandwidth")
+    burst = Param.Latency('10ms', "Time a rate limited DSid can save up")
+
 class PARDg5VIdeDisk(SimObject):
     type = 'PARDg5VIdeDisk'
     cxx_header = "dev/pard/ide_disk.hh"
     delay = Param.Latency('1us', "Fixed disk delay in microseconds")
+    scheduler = Param.PARDg5VIOScheduler(NULL,
+        "Shared device DMA transfers queue at, replaces delay")
+    backend = Param.PARDg5VAsyncDiskImage(NULL,
+        "Host image read commands prefetch from, a child of image")
     driveID = Param.IdeID('master', "Drive ID")
     image = Param.DiskImage("Disk image")
 
@@ -0,0 +1,58 @@
+# Copyright (c) 2015 Institute of Computing Technology, CAS
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met: redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer;
+# redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the
+# documentation and/or other materials provided with the distribution;
+# neither the name of the copyright holders nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+# Authors: Jiuyue Ma
+
+from m5.params import *
+from PARDg5VPci import PARDg5VPciDevice
+from PARDg5VEtherTap import PARDg5VEtherTap
+
+class PARDg5VNetDevice(PARDg5VPciDevice):
+    type = 'PARDg5VNetDevice'
+    cxx_header = "dev/pard/pv_net.hh"
+    tap = Param.PARDg5VEtherTap(NULL, "Tap the device sends frames to")
+    hardware_address = Param.EthernetAddr(NextEthernetAddr,
+        "Ethernet address of the physical function, VF i takes the "
+        "i + 1-th address after it")
+    intr_delay = Param.Latency('10us',
+        "Minimum time between two interrupts of a function after reset")
+    rx_fifo_size = Param.Unsigned(256,
+        "Frames held per function while the guest has no RX buffers")
+    queue_max = Param.Unsigned(1024, "Largest ring the device accepts")
+
+    # Not a virtio ID, guests need the PARD paravirtual network driver
+    VendorID = 0x8086
+    DeviceID = 0x7F01
+    Command = 0x0
+    Status = 0x0
+    Revision = 0x0
+    ClassCode = 0x02
+    SubClassCode = 0x00
+    ProgIF = 0x00
+    BAR0 = 0x00000000
+    BAR0Size = '128B'
+    InterruptLine = 0x1f
+    InterruptPin = 0x01
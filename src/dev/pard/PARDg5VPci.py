@@ -45,6 +45,10 @@ class PARDg5VPciDevice(PARDg5VDmaDevice):
     pci_func = Param.Int("PCI function code")
     pio_latency = Param.Latency('30ns', "Programmed IO latency")
     config_latency = Param.Latency('20ns', "Config read or write latency")
+    int_master = MasterPort("Port for sending MSI/MSI-X messages to LAPICs")
+    msi_latency = Param.Latency('1ns', "Latency for an MSI to propagate")
+    num_vfs = Param.Unsigned(0, "Per-DSid virtual functions, 0 if the "
+                             "device is only assigned whole")
 
     VendorID = Param.UInt16("Vendor ID")
     DeviceID = Param.UInt16("Device ID")
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/** @file
+ * Read-only disk image served by host I/O worker threads
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "base/misc.hh"
+#include "base/trace.hh"
+#include "debug/DiskImageRead.hh"
+#include "dev/pard/async_disk_image.hh"
+
+PARDg5VAsyncDiskImage::PARDg5VAsyncDiskImage(const Params *p)
+    : DiskImage(p), file(p->image_file), fd(-1), sectors(0),
+      cacheSectors(p->cache_sectors), stopping(false)
+{
+    fatal_if(!p->read_only, "%s: asynchronous images are read-only, use "
+             "one as the child of a CowDiskImage\n", name());
+    fatal_if(p->threads == 0, "%s: needs at least one worker thread\n",
+             name());
+
+    fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+        panic("%s: error opening %s: %s\n", name(), file, strerror(errno));
+    off_t bytes = lseek(fd, 0, SEEK_END);
+    if (bytes < 0)
+        panic("%s: can't get the size of %s\n", name(), file);
+    sectors = bytes / SectorSize;
+    initialized = true;
+
+    for (int i = 0; i < p->threads; i++)
+        workers.push_back(std::thread(&PARDg5VAsyncDiskImage::work, this));
+}
+
+PARDg5VAsyncDiskImage::~PARDg5VAsyncDiskImage()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    workAvail.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+    close(fd);
+}
+
+void
+PARDg5VAsyncDiskImage::regStats()
+{
+    DiskImage::regStats();
+
+    prefetched
+        .name(name() + ".prefetched")
+        .desc("Sectors read ahead by the workers")
+        ;
+    hits
+        .name(name() + ".hits")
+        .desc("Sector reads served from prefetched data")
+        ;
+    stalls
+        .name(name() + ".stalls")
+        .desc("Sector reads that waited for a worker")
+        ;
+    misses
+        .name(name() + ".misses")
+        .desc("Sector reads done synchronously")
+        ;
+}
+
+std::streampos
+PARDg5VAsyncDiskImage::size() const
+{
+    return sectors;
+}
+
+bool
+PARDg5VAsyncDiskImage::readSectors(uint8_t *data, std::streampos first,
+                                   unsigned count, int &error) const
+{
+    size_t left = count * SectorSize;
+    off_t offset = first * SectorSize;
+    while (left) {
+        ssize_t bytes = pread(fd, data, left, offset);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0) {
+            error = bytes < 0 ? errno : EIO;
+            return false;
+        }
+        data += bytes;
+        offset += bytes;
+        left -= bytes;
+    }
+    return true;
+}
+
+void
+PARDg5VAsyncDiskImage::work()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        while (!stopping && jobs.empty())
+            workAvail.wait(guard);
+        if (stopping)
+            return;
+
+        JobPtr job = jobs.front();
+        jobs.pop_front();
+
+        // Several workers read at once, only the queues need the lock
+        guard.unlock();
+        int error = 0;
+        readSectors(&job->data[0], job->first, job->count, error);
+        guard.lock();
+
+        job->error = error;
+        job->done = true;
+        workDone.notify_all();
+    }
+}
+
+void
+PARDg5VAsyncDiskImage::prefetch(std::streampos sector, unsigned count)
+{
+    if (sector >= sectors || count == 0)
+        return;
+    if (sector + (std::streamoff)count > sectors)
+        count = sectors - sector;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        // Sectors still cached from an earlier prefetch are not read
+        // again, cached ones inside the range are read but not taken
+        while (count && cached.count(sector)) {
+            sector += (std::streamoff)1;
+            count--;
+        }
+        while (count && cached.count(sector + (std::streamoff)(count - 1)))
+            count--;
+        if (count == 0)
+            return;
+
+        JobPtr job = std::make_shared<Job>();
+        job->first = sector;
+        job->count = count;
+        job->data.resize(count * SectorSize);
+        job->done = false;
+        job->error = 0;
+
+        DPRINTF(DiskImageRead, "prefetch %d sectors from %d\n",
+                count, sector);
+
+        for (unsigned i = 0; i < count; i++) {
+            std::streampos pos = sector + (std::streamoff)i;
+            if (cached.insert(std::make_pair(pos, job)).second)
+                order.push_back(std::make_pair(pos, std::weak_ptr<Job>(job)));
+        }
+        // Sectors of aborted or overwritten reads are never taken
+        while (order.size() > cacheSectors) {
+            auto it = cached.find(order.front().first);
+            if (it != cached.end() &&
+                it->second == order.front().second.lock())
+                cached.erase(it);
+            order.pop_front();
+        }
+        jobs.push_back(job);
+    }
+    workAvail.notify_one();
+    prefetched += count;
+}
+
+std::streampos
+PARDg5VAsyncDiskImage::read(uint8_t *data, std::streampos offset) const
+{
+    if (offset >= sectors)
+        panic("%s: access out of bounds\n", name());
+
+    std::unique_lock<std::mutex> guard(lock);
+    auto it = cached.find(offset);
+    if (it != cached.end()) {
+        JobPtr job = it->second;
+        cached.erase(it);
+        if (!job->done) {
+            stalls++;
+            while (!job->done)
+                workDone.wait(guard);
+        }
+        if (job->error)
+            panic("%s: error reading %s: %s\n", name(), file,
+                  strerror(job->error));
+        hits++;
+        memcpy(data, &job->data[(offset - job->first) * SectorSize],
+               SectorSize);
+        return SectorSize;
+    }
+    guard.unlock();
+
+    misses++;
+    int error = 0;
+    if (!readSectors(data, offset, 1, error))
+        panic("%s: error reading %s: %s\n", name(), file, strerror(error));
+    return SectorSize;
+}
+
+std::streampos
+PARDg5VAsyncDiskImage::write(const uint8_t *data, std::streampos offset)
+{
+    panic("%s: write to read-only image\n", name());
+    M5_DUMMY_RETURN
+}
+
+PARDg5VAsyncDiskImage *
+PARDg5VAsyncDiskImageParams::create()
+{
+    return new PARDg5VAsyncDiskImage(this);
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/** @file
+ * Read-only disk image served by host I/O worker threads
+ */
+
+#ifndef __DEV_PARD_ASYNC_DISK_IMAGE_HH__
+#define __DEV_PARD_ASYNC_DISK_IMAGE_HH__
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "base/statistics.hh"
+#include "dev/disk_image.hh"
+#include "params/PARDg5VAsyncDiskImage.hh"
+
+/**
+ * Raw disk image whose reads can be issued ahead of time. A disk calls
+ * prefetch() when a read command starts, a pool of worker threads then
+ * reads the sectors with pread() while the simulation goes on. read()
+ * takes a prefetched sector from memory, waiting for its worker if the
+ * host is slower than the simulated disk. Sectors nobody asked for are
+ * read synchronously.
+ *
+ * The image is read-only, so when the host I/O completes can't change
+ * what the simulation sees. Use it as the child of a CowDiskImage.
+ */
+class PARDg5VAsyncDiskImage : public DiskImage
+{
+  protected:
+    struct Job
+    {
+        std::streampos first;
+        unsigned count;
+        std::vector<uint8_t> data;
+        bool done;
+        int error;
+    };
+    typedef std::shared_ptr<Job> JobPtr;
+
+    std::string file;
+    int fd;
+    std::streampos sectors;
+
+    /** Guards everything below, shared with the workers */
+    mutable std::mutex lock;
+    mutable std::condition_variable workAvail;
+    mutable std::condition_variable workDone;
+
+    /** Jobs no worker picked up yet */
+    std::deque<JobPtr> jobs;
+    /** Prefetched sectors not read yet, and the job reading each */
+    mutable std::map<std::streampos, JobPtr> cached;
+    /**
+     * Prefetch order, the oldest sectors are dropped first. A sector
+     * read and prefetched again has an older entry of another job.
+     */
+    std::deque<std::pair<std::streampos, std::weak_ptr<Job> > > order;
+    const unsigned cacheSectors;
+    bool stopping;
+
+    std::vector<std::thread> workers;
+
+    void work();
+    /** Read count sectors from first, false on a host error */
+    bool readSectors(uint8_t *data, std::streampos first,
+                     unsigned count, int &error) const;
+
+    Stats::Scalar prefetched;
+    mutable Stats::Scalar hits;
+    mutable Stats::Scalar stalls;
+    mutable Stats::Scalar misses;
+
+  public:
+    typedef PARDg5VAsyncDiskImageParams Params;
+    PARDg5VAsyncDiskImage(const Params *p);
+    ~PARDg5VAsyncDiskImage();
+
+    /** Start reading count sectors from sector in the background */
+    void prefetch(std::streampos sector, unsigned count);
+
+    virtual std::streampos size() const;
+    virtual std::streampos read(uint8_t *data, std::streampos offset) const;
+    virtual std::streampos write(const uint8_t *data, std::streampos offset);
+
+    virtual void regStats();
+};
+
+#endif // __DEV_PARD_ASYNC_DISK_IMAGE_HH__
@@ -44,18 +44,82 @@
  *          Jiuyue Ma
  */
 
+#include <new>
+
 #include "base/chunk_generator.hh"
+#include "base/intmath.hh"
 #include "debug/DMA.hh"
 #include "debug/Drain.hh"
 #include "dev/pard/dma_device.hh"
 #include "sim/system.hh"
 
-PARDg5VDmaPort::PARDg5VDmaPort(MemObject *dev, System *s)
-    : MasterPort(dev->name() + ".dma", dev), device(dev), sendEvent(this),
-      sys(s), masterId(s->getMasterId(dev->name())),
+PARDg5VDmaPort::PARDg5VDmaPort(MemObject *dev, System *s,
+                               unsigned burstSize)
+    : MasterPort(dev->name() + ".dma", dev), device(dev),
+      chunkSize(burstSize ? burstSize : s->cacheLineSize()),
+      sendEvent(this), sys(s), masterId(s->getMasterId(dev->name())),
       pendingCount(0), drainManager(NULL),
       inRetry(false)
-{ }
+{
+    fatal_if(chunkSize < s->cacheLineSize() || !isPowerOf2(chunkSize),
+             "%s: DMA burst size %d is not a power of 2 multiple of the "
+             "cache line size.\n", name(), chunkSize);
+}
+
+PARDg5VDmaPort::~PARDg5VDmaPort()
+{
+    for (auto req : reqPool)
+        delete req;
+    for (auto mem : pktPool)
+        ::operator delete(mem);
+}
+
+void
+PARDg5VDmaPort::PacketRing::push_back(PacketPtr pkt)
+{
+    if (count == ring.size()) {
+        std::vector<PacketPtr> grown(ring.size() * 2);
+        for (size_t i = 0; i < count; i++)
+            grown[i] = ring[(head + i) % ring.size()];
+        ring.swap(grown);
+        head = 0;
+    }
+    ring[(head + count) % ring.size()] = pkt;
+    count++;
+}
+
+PacketPtr
+PARDg5VDmaPort::allocPacket(Packet::Command cmd, uint16_t DSid, Addr addr,
+                            int size, Request::Flags flag)
+{
+    Request *req;
+    if (reqPool.empty()) {
+        req = new Request(addr, size, flag, masterId);
+    } else {
+        req = reqPool.back();
+        reqPool.pop_back();
+        req->setPhys(addr, size, flag, masterId);
+    }
+    req->setDSid(DSid);
+    req->taskId(ContextSwitchTaskId::DMA);
+
+    void *mem;
+    if (pktPool.empty()) {
+        mem = ::operator new(sizeof(Packet));
+    } else {
+        mem = pktPool.back();
+        pktPool.pop_back();
+    }
+    return new (mem) Packet(req, cmd);
+}
+
+void
+PARDg5VDmaPort::freePacket(PacketPtr pkt)
+{
+    reqPool.push_back(pkt->req);
+    pkt->~Packet();
+    pktPool.push_back(pkt);
+}
 
 void
 PARDg5VDmaPort::handleResp(PacketPtr pkt, Tick delay)
@@ -92,9 +156,8 @@ PARDg5VDmaPort::handleResp(PacketPtr pkt, Tick delay)
         delete state;
     }
 
-    // delete the request that we created and also the packet
-    delete pkt->req;
-    delete pkt;
+    // recycle the request that we created and also the packet
+    freePacket(pkt);
 
     // we might be drained at this point, if so signal the drain event
     if (pendingCount == 0 && drainManager) {
@@ -115,7 +178,7 @@ PARDg5VDmaPort::recvTimingResp(PacketPtr pkt)
 }
 
 PARDg5VDmaDevice::PARDg5VDmaDevice(const Params *p)
-    : PioDevice(p), dmaPort(this, sys), _DSid(-1)
+    : PioDevice(p), dmaPort(this, sys, p->burst_size), _DSid(-1)
 { }
 
 void
@@ -161,7 +224,7 @@ PARDg5VDmaPort::dmaAction(Packet::Command cmd, uint16_t DSid, Addr addr,
 {
     // one DMA request sender state for every action, that is then
     // split into many requests and packets based on the block size,
-    // i.e. cache line size
+    // i.e. cache line size, or the burst size if there is one
     DmaReqState *reqState = new DmaReqState(event, size, delay);
 
     if (DSid == -1) {
@@ -172,12 +235,9 @@ PARDg5VDmaPort::dmaAction(Packet::Command cmd, uint16_t DSid, Addr addr,
 
     DPRINTF(DMA, "Starting DMA for addr: %#x size: %d sched: %d\n", addr, size,
             event ? event->scheduled() : -1);
-    for (ChunkGenerator gen(addr, size, sys->cacheLineSize());
+    for (ChunkGenerator gen(addr, size, chunkSize);
          !gen.done(); gen.next()) {
-        Request *req = new Request(gen.addr(), gen.size(), flag, masterId);
-        req->setDSid(DSid);
-        req->taskId(ContextSwitchTaskId::DMA);
-        PacketPtr pkt = new Packet(req, cmd);
+        PacketPtr pkt = allocPacket(cmd, DSid, gen.addr(), gen.size(), flag);
 
         // Increment the data pointer on a write
         if (data)
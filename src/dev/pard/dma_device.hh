@@ -46,7 +46,7 @@
 #ifndef __DEV_PARD_DMA_DEVICE_HH__
 #define __DEV_PARD_DMA_DEVICE_HH__
 
-#include <deque>
+#include <vector>
 
 #include "dev/io_device.hh"
 #include "params/PARDg5VDmaDevice.hh"
@@ -109,8 +109,44 @@ class PARDg5VDmaPort : public MasterPort
     /** The device that owns this port. */
     MemObject *device;
 
-    /** Use a deque as we never do any insertion or removal in the middle */
-    std::deque<PacketPtr> transmitList;
+    /**
+     * Transmit list, a ring as packets only ever leave at the front.
+     * It doubles when full, which settles at the deepest DMA queue of
+     * the device.
+     */
+    class PacketRing
+    {
+      private:
+        std::vector<PacketPtr> ring;
+        size_t head;
+        size_t count;
+
+      public:
+        PacketRing() : ring(64), head(0), count(0) {}
+
+        bool empty() const { return count == 0; }
+        size_t size() const { return count; }
+        PacketPtr front() const { return ring[head]; }
+        void pop_front() { head = (head + 1) % ring.size(); count--; }
+        void push_back(PacketPtr pkt);
+    };
+
+    PacketRing transmitList;
+
+    /**
+     * Requests and packets of completed chunks, recycled by the next
+     * DMA action instead of going back to the heap. Pooled packets are
+     * destructed, only their storage is kept.
+     */
+    std::vector<Request *> reqPool;
+    std::vector<void *> pktPool;
+
+    PacketPtr allocPacket(Packet::Command cmd, uint16_t DSid, Addr addr,
+                          int size, Request::Flags flag);
+    void freePacket(PacketPtr pkt);
+
+    /** Bytes per DMA packet, a cache line unless bursts are enabled */
+    const unsigned chunkSize;
 
     /** Event used to schedule a future sending from the transmit list. */
     EventWrapper<PARDg5VDmaPort, &PARDg5VDmaPort::sendDma> sendEvent;
@@ -142,7 +178,8 @@ class PARDg5VDmaPort : public MasterPort
 
   public:
 
-    PARDg5VDmaPort(MemObject *dev, System *s);
+    PARDg5VDmaPort(MemObject *dev, System *s, unsigned burstSize = 0);
+    ~PARDg5VDmaPort();
 
     void dmaAction(Packet::Command cmd, uint16_t DSid, Addr addr, int size,
                    Event *event, uint8_t *data, Tick delay,
@@ -169,6 +206,8 @@ class PARDg5VDmaDevice : public PioDevice
      */
     void setDSid(uint16_t DSid)
     { _DSid = DSid; }
+    uint16_t getDSid() const
+    { return _DSid; }
     void dmaWrite(Addr addr, int size, Event *event, uint8_t *data,
                   Tick delay = 0)
     {
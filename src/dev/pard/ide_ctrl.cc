@@ -626,6 +626,35 @@ PARDg5VIdeController::Channel::unserialize(const std::string &base, Checkpoint *
     select(selectBit);
 }
 
+void
+PARDg5VIdeController::serializeLDom(uint16_t DSid, const std::string &dir,
+                                    std::ostream &os)
+{
+    PARDg5VIdeDisk *disks[] = { primary.master, primary.slave,
+                                secondary.master, secondary.slave };
+    for (int i = 0; i < 4; i++) {
+        std::string overlay = csprintf("%s.disk%d.cow", name(), i);
+        if (disks[i] && disks[i]->saveOverlay(dir + "/" + overlay))
+            paramOut(os, csprintf("disk%d", i), overlay);
+    }
+}
+
+void
+PARDg5VIdeController::unserializeLDom(uint16_t DSid, Checkpoint *cp,
+                                      const std::string &section)
+{
+    PARDg5VIdeDisk *disks[] = { primary.master, primary.slave,
+                                secondary.master, secondary.slave };
+    for (int i = 0; i < 4; i++) {
+        std::string overlay;
+        if (!optParamIn(cp, section, csprintf("disk%d", i), overlay))
+            continue;
+        if (!disks[i] || !disks[i]->loadOverlay(cp->cptDir + "/" + overlay))
+            warn("%s: no overlay disk%d to restore %s into.\n",
+                 name(), i, overlay);
+    }
+}
+
 PARDg5VIdeController *
 PARDg5VIdeControllerParams::create()
 {
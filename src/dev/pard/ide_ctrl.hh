@@ -44,6 +44,7 @@
 #include "dev/pard/pcidev.hh"
 #include "dev/pcireg.h"
 #include "params/PARDg5VIdeController.hh"
+#include "prm/interfaces.hh"
 
 class PARDg5VIdeDisk;
 
@@ -51,7 +52,8 @@ class PARDg5VIdeDisk;
  * Device model for an Intel PIIX4 IDE controller
  */
 
-class PARDg5VIdeController : public PARDg5VPciDevice
+class PARDg5VIdeController : public PARDg5VPciDevice,
+                             public ILDomSerializable
 {
   private:
     // Bus master IDE status register bit fields
@@ -159,5 +161,11 @@ class PARDg5VIdeController : public PARDg5VPciDevice
 
     void serialize(std::ostream &os);
     void unserialize(Checkpoint *cp, const std::string &section);
+
+    // Disk overlays of the LDomain this controller is assigned to
+    void serializeLDom(uint16_t DSid, const std::string &dir,
+                       std::ostream &os);
+    void unserializeLDom(uint16_t DSid, Checkpoint *cp,
+                         const std::string &section);
 };
 #endif // __IDE_PARD_CTRL_HH_
@@ -59,8 +59,10 @@
 #include "config/the_isa.hh"
 #include "debug/IdeDisk.hh"
 #include "dev/disk_image.hh"
+#include "dev/pard/async_disk_image.hh"
 #include "dev/pard/ide_ctrl.hh"
 #include "dev/pard/ide_disk.hh"
+#include "dev/pard/io_sched.hh"
 #include "sim/core.hh"
 #include "sim/sim_object.hh"
 
@@ -69,6 +71,7 @@ using namespace TheISA;
 
 PARDg5VIdeDisk::PARDg5VIdeDisk(const Params *p)
     : SimObject(p), ctrl(NULL), image(p->image), diskDelay(p->delay),
+      scheduler(p->scheduler), backend(p->backend),
       dmaTransferEvent(this), dmaReadCG(NULL), dmaReadWaitEvent(this),
       dmaWriteCG(NULL), dmaWriteWaitEvent(this), dmaPrdReadEvent(this),
       dmaReadEvent(this), dmaWriteEvent(this)
@@ -385,7 +388,12 @@ PARDg5VIdeDisk::doDmaDataRead()
     DPRINTF(IdeDisk, "doDmaRead, diskDelay: %d totalDiskDelay: %d\n",
             diskDelay, totalDiskDelay);
 
-    schedule(dmaReadWaitEvent, curTick() + totalDiskDelay);
+    // A write to the disk, it takes its turn on a shared device
+    if (scheduler)
+        scheduler->submit(ctrl->getDSid(), curPrd.getByteCount(), true,
+                          &dmaReadWaitEvent);
+    else
+        schedule(dmaReadWaitEvent, curTick() + totalDiskDelay);
 }
 
 void
@@ -501,7 +509,11 @@ PARDg5VIdeDisk::doDmaDataWrite()
     DPRINTF(IdeDisk, "doDmaWrite, bytesRead: %d cmdBytesLeft: %d\n",
             bytesRead, cmdBytesLeft);
 
-    schedule(dmaWriteWaitEvent, curTick() + totalDiskDelay);
+    if (scheduler)
+        scheduler->submit(ctrl->getDSid(), curPrd.getByteCount(), false,
+                          &dmaWriteWaitEvent);
+    else
+        schedule(dmaWriteWaitEvent, curTick() + totalDiskDelay);
 }
 
 void
@@ -670,6 +682,8 @@ PARDg5VIdeDisk::startCommand()
             cmdBytes = cmdBytesLeft = (cmdReg.sec_count * SectorSize);
 
         curSector = getLBABase();
+        if (backend)
+            backend->prefetch(curSector, cmdBytes / SectorSize);
 
         /** @todo make this a scheduled event to simulate disk delay */
         devState = Prepare_Data_In;
@@ -708,6 +722,10 @@ PARDg5VIdeDisk::startCommand()
 
         curSector = getLBABase();
 
+        // Read the sectors from the host while the transfer is set up
+        if (backend && !dmaRead)
+            backend->prefetch(curSector, cmdBytes / SectorSize);
+
         devState = Prepare_Data_Dma;
         action = ACT_DMA_READY;
         break;
@@ -1064,6 +1082,27 @@ PARDg5VIdeDisk::updateState(DevAction_t action)
     }
 }
 
+bool
+PARDg5VIdeDisk::saveOverlay(const string &file) const
+{
+    CowDiskImage *cow = dynamic_cast<CowDiskImage *>(image);
+    if (!cow)
+        return false;
+    cow->save(file);
+    return true;
+}
+
+bool
+PARDg5VIdeDisk::loadOverlay(const string &file)
+{
+    CowDiskImage *cow = dynamic_cast<CowDiskImage *>(image);
+    if (!cow)
+        return false;
+    if (!cow->open(file))
+        fatal("%s: could not open disk overlay %s.\n", name(), file);
+    return true;
+}
+
 void
 PARDg5VIdeDisk::serialize(ostream &os)
 {
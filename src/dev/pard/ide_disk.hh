@@ -59,6 +59,8 @@
 #include "sim/eventq.hh"
 
 class ChunkGenerator;
+class PARDg5VAsyncDiskImage;
+class PARDg5VIOScheduler;
 
 #define DMA_BACKOFF_PERIOD      200
 
@@ -218,6 +220,12 @@ class PARDg5VIdeDisk : public SimObject
     /** The disk delay in microseconds. */
     int diskDelay;
 
+    /** Shared device the DMA transfers queue at, NULL if not shared */
+    PARDg5VIOScheduler *scheduler;
+
+    /** Host image the reads are prefetched from, NULL if none */
+    PARDg5VAsyncDiskImage *backend;
+
   private:
     /** Drive identification structure for this disk */
     struct ataparams driveID;
@@ -367,6 +375,18 @@ class PARDg5VIdeDisk : public SimObject
 
     inline Addr pciToDma(Addr pciAddr);
 
+    /**
+     * Save the copy-on-write overlay of the disk image to file.
+     * @return false if the image has no overlay
+     */
+    bool saveOverlay(const std::string &file) const;
+
+    /**
+     * Replace the copy-on-write overlay with the one saved in file.
+     * @return false if the image has no overlay
+     */
+    bool loadOverlay(const std::string &file);
+
     /**
      * Serialize this object to the given output stream.
      * @param os The stream to serialize to.
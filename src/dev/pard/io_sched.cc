@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/** @file
+ * Per-DSid scheduler for disks sharing one storage device
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "base/trace.hh"
+#include "debug/Drain.hh"
+#include "debug/PARDg5VIOSched.hh"
+#include "dev/pard/io_sched.hh"
+#include "dev/pard/iohub_cp.hh"
+#include "sim/core.hh"
+#include "sim/serialize.hh"
+#include "sim/stats.hh"
+
+PARDg5VIOScheduler::PARDg5VIOScheduler(const Params *p)
+    : SimObject(p), cp(p->cp), latency(p->latency),
+      bandwidth(p->bandwidth), burst(p->burst), busyUntil(0), vtime(0),
+      drainManager(NULL), dispatchEvent(this)
+{
+}
+
+void
+PARDg5VIOScheduler::regStats()
+{
+    using namespace Stats;
+
+    SimObject::regStats();
+
+    requests
+        .init(2)
+        .name(name() + ".requests")
+        .desc("Requests served")
+        .flags(total)
+        ;
+    requests.subname(0, "read");
+    requests.subname(1, "write");
+    bytes
+        .init(2)
+        .name(name() + ".bytes")
+        .desc("Bytes transferred")
+        .flags(total)
+        ;
+    bytes.subname(0, "read");
+    bytes.subname(1, "write");
+    throttled
+        .name(name() + ".throttled")
+        .desc("Requests held back by a rate limit")
+        ;
+    queueLatency
+        .name(name() + ".queueLatency")
+        .desc("Total ticks requests waited for the device")
+        ;
+    busyTicks
+        .name(name() + ".busyTicks")
+        .desc("Ticks the device was busy")
+        ;
+    avgQueueLatency
+        .name(name() + ".avgQueueLatency")
+        .desc("Average ticks a request waited for the device")
+        ;
+    avgQueueLatency = queueLatency / sum(requests);
+    utilization
+        .name(name() + ".utilization")
+        .desc("Fraction of time the device was busy")
+        ;
+    utilization = busyTicks / simTicks;
+}
+
+void
+PARDg5VIOScheduler::submit(uint16_t DSid, unsigned bytes, bool write,
+                           Event *event)
+{
+    DSidQueue &queue = queues[DSid];
+
+    IORequest req;
+    req.bytes = bytes;
+    req.write = write;
+    req.event = event;
+    req.arrival = curTick();
+    req.service = latency + (Tick)(bytes * bandwidth);
+    req.throttled = false;
+
+    // Tags of heavier DSids advance slower, a DSid that was idle
+    // starts at the current virtual time
+    uint32_t weight = cp ? cp->getIOWeight(DSid) : 1;
+    req.tag = std::max(vtime, queue.lastTag) + req.service / weight;
+    queue.lastTag = req.tag;
+    queue.reqs.push_back(req);
+
+    DPRINTF(PARDg5VIOSched, "DSid %d %s %d bytes, weight %d tag %d\n",
+            DSid, write ? "write" : "read", bytes, weight, req.tag);
+
+    // Dispatch may be waiting for a throttled DSid, a new request of
+    // an unthrottled one can go as soon as the disk is free
+    Tick when = std::max(curTick(), busyUntil);
+    if (!dispatchEvent.scheduled())
+        schedule(dispatchEvent, when);
+    else if (dispatchEvent.when() > when)
+        reschedule(dispatchEvent, when);
+}
+
+Tick
+PARDg5VIOScheduler::refill(uint16_t DSid, DSidQueue &queue)
+{
+    uint64_t bps = cp ? cp->getIOByteRate(DSid) : 0;
+    uint32_t iops = cp ? cp->getIORate(DSid) : 0;
+    const IORequest &head = queue.reqs.front();
+
+    double elapsed = (double)(curTick() - queue.lastRefill) /
+                     SimClock::Frequency;
+    double window = (double)burst / SimClock::Frequency;
+    queue.lastRefill = curTick();
+
+    // Buckets hold at least the head request, or it could never go
+    Tick ready = curTick();
+    if (bps) {
+        double cap = std::max(bps * window, (double)head.bytes);
+        queue.byteTokens = std::min(cap, queue.byteTokens + elapsed * bps);
+        if (queue.byteTokens < head.bytes) {
+            double wait = (head.bytes - queue.byteTokens) / bps;
+            ready = std::max(ready, curTick() +
+                             (Tick)ceil(wait * SimClock::Frequency));
+        }
+    } else {
+        queue.byteTokens = 0;
+    }
+    if (iops) {
+        double cap = std::max(iops * window, 1.0);
+        queue.iopsTokens = std::min(cap, queue.iopsTokens + elapsed * iops);
+        if (queue.iopsTokens < 1.0) {
+            double wait = (1.0 - queue.iopsTokens) / iops;
+            ready = std::max(ready, curTick() +
+                             (Tick)ceil(wait * SimClock::Frequency));
+        }
+    } else {
+        queue.iopsTokens = 0;
+    }
+    return ready;
+}
+
+bool
+PARDg5VIOScheduler::idle() const
+{
+    for (auto &it : queues) {
+        if (!it.second.reqs.empty())
+            return false;
+    }
+    return true;
+}
+
+void
+PARDg5VIOScheduler::dispatch()
+{
+    if (busyUntil > curTick()) {
+        schedule(dispatchEvent, busyUntil);
+        return;
+    }
+
+    // Smallest tag among the queues with tokens for their head
+    uint16_t DSid = 0;
+    DSidQueue *best = NULL;
+    Tick next = MaxTick;
+    for (auto &it : queues) {
+        DSidQueue &queue = it.second;
+        if (queue.reqs.empty())
+            continue;
+
+        Tick ready = refill(it.first, queue);
+        if (ready > curTick()) {
+            IORequest &head = queue.reqs.front();
+            if (!head.throttled) {
+                head.throttled = true;
+                throttled++;
+            }
+            next = std::min(next, ready);
+            continue;
+        }
+
+        if (!best || queue.reqs.front().tag < best->reqs.front().tag) {
+            best = &queue;
+            DSid = it.first;
+        }
+    }
+
+    if (!best) {
+        // Everybody waits for tokens
+        if (next != MaxTick)
+            schedule(dispatchEvent, next);
+        return;
+    }
+
+    IORequest req = best->reqs.front();
+    best->reqs.pop_front();
+    best->byteTokens -= req.bytes;
+    best->iopsTokens -= 1.0;
+
+    Tick wait = curTick() - req.arrival;
+    vtime = req.tag;
+    busyUntil = curTick() + req.service;
+
+    DPRINTF(PARDg5VIOSched, "serve DSid %d %d bytes after %d ticks, "
+            "done at %d\n", DSid, req.bytes, wait, busyUntil);
+
+    requests[req.write]++;
+    bytes[req.write] += req.bytes;
+    queueLatency += wait;
+    busyTicks += req.service;
+    if (cp)
+        cp->recordIO(DSid, req.bytes, wait + req.service, req.throttled);
+
+    // The disk goes on once the device is done
+    schedule(req.event, busyUntil);
+
+    if (!idle()) {
+        schedule(dispatchEvent, busyUntil);
+    } else if (drainManager) {
+        DPRINTF(Drain, "%s done draining queues\n", name());
+        drainManager->signalDrainDone();
+        drainManager = NULL;
+    }
+}
+
+unsigned int
+PARDg5VIOScheduler::drain(DrainManager *dm)
+{
+    // Requests in service are saved with their disk's event, queued
+    // ones have to go first
+    if (!idle()) {
+        drainManager = dm;
+        setDrainState(Drainable::Draining);
+        return 1;
+    }
+
+    setDrainState(Drainable::Drained);
+    return 0;
+}
+
+void
+PARDg5VIOScheduler::serialize(std::ostream &os)
+{
+    assert(idle());
+    SERIALIZE_SCALAR(busyUntil);
+    SERIALIZE_SCALAR(vtime);
+}
+
+void
+PARDg5VIOScheduler::unserialize(Checkpoint *cp, const std::string &section)
+{
+    UNSERIALIZE_SCALAR(busyUntil);
+    UNSERIALIZE_SCALAR(vtime);
+}
+
+PARDg5VIOScheduler *
+PARDg5VIOSchedulerParams::create()
+{
+    return new PARDg5VIOScheduler(this);
+}
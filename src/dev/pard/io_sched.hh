@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/** @file
+ * Per-DSid scheduler for disks sharing one storage device
+ */
+
+#ifndef __DEV_PARD_IO_SCHED_HH__
+#define __DEV_PARD_IO_SCHED_HH__
+
+#include <deque>
+#include <map>
+
+#include "base/statistics.hh"
+#include "params/PARDg5VIOScheduler.hh"
+#include "sim/eventq.hh"
+#include "sim/sim_object.hh"
+
+class PARDg5VIOHubCP;
+
+/**
+ * Storage device shared by the disks of several LDomains. The device
+ * serves one request at a time, a request takes a fixed latency plus
+ * its bytes at the device bandwidth.
+ *
+ * Every DSid has its own queue. The next request is picked by
+ * self-clocked fair queueing, so each DSid gets device time in
+ * proportion to the weight the IOHub control plane gives it. A DSid
+ * may also be limited in bytes and requests per second, by token
+ * buckets that hold up to one burst worth of tokens. A queue out of
+ * tokens waits, the others may use the device meanwhile.
+ */
+class PARDg5VIOScheduler : public SimObject
+{
+  protected:
+    struct IORequest
+    {
+        unsigned bytes;
+        bool write;
+        /** Event of the disk, scheduled when the request is done */
+        Event *event;
+        Tick arrival;
+        Tick service;
+        /** Virtual finish time */
+        Tick tag;
+        bool throttled;
+    };
+
+    struct DSidQueue
+    {
+        std::deque<IORequest> reqs;
+        Tick lastTag;
+        double byteTokens;
+        double iopsTokens;
+        Tick lastRefill;
+    };
+
+    std::map<uint16_t, DSidQueue> queues;
+
+    /** Control plane holding weights and limits, may be NULL */
+    PARDg5VIOHubCP *cp;
+
+    const Tick latency;
+    /** Device bandwidth in ticks per byte */
+    const double bandwidth;
+    /** Time the token buckets can save up for */
+    const Tick burst;
+
+    /** Device is busy with a request until then */
+    Tick busyUntil;
+    /** Tag of the request served last */
+    Tick vtime;
+
+    DrainManager *drainManager;
+
+    void dispatch();
+    EventWrapper<PARDg5VIOScheduler,
+                 &PARDg5VIOScheduler::dispatch> dispatchEvent;
+
+    /**
+     * Add the tokens earned since the last refill.
+     * @return tick the head request has enough tokens, curTick() if
+     * it can go now
+     */
+    Tick refill(uint16_t DSid, DSidQueue &queue);
+
+    bool idle() const;
+
+    Stats::Vector requests;
+    Stats::Vector bytes;
+    Stats::Scalar throttled;
+    Stats::Scalar queueLatency;
+    Stats::Scalar busyTicks;
+    Stats::Formula avgQueueLatency;
+    Stats::Formula utilization;
+
+  public:
+    typedef PARDg5VIOSchedulerParams Params;
+    PARDg5VIOScheduler(const Params *p);
+
+    /**
+     * Queue a request of DSid, event is scheduled once the device has
+     * served it.
+     */
+    void submit(uint16_t DSid, unsigned bytes, bool write, Event *event);
+
+    virtual void regStats();
+    virtual unsigned int drain(DrainManager *dm);
+
+    virtual void serialize(std::ostream &os);
+    virtual void unserialize(Checkpoint *cp, const std::string &section);
+};
+
+#endif // __DEV_PARD_IO_SCHED_HH__
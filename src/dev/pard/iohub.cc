@@ -28,10 +28,12 @@
  * Authors: Jiuyue Ma
  */
 
+#include <algorithm>
+
 #include "arch/x86/x86_traits.hh"
 #include "dev/pard/iohub.hh"
+#include "dev/pard/pcidev.hh"
 #include "dev/cellx/cellx.hh"
-#include "dev/pcidev.hh"
 
 using namespace X86ISA;
 
@@ -82,6 +84,7 @@ PARDg5VIOHub::~PARDg5VIOHub()
 {
     pciConfigShadow.clear();
     pciIoShadow.clear();
+    pciidToDevice.clear();
     for (auto dev : devices)
         delete dev;
     devices.clear();
@@ -109,6 +112,7 @@ PARDg5VIOHub::startup()
     uint32_t basePciIOMem  = 0xC1000000;
     pciConfigShadow.clear();
     pciIoShadow.clear();
+    pciidToDevice.clear();
 
     // Check each pci device's BARx size
     for (auto port : masterPorts) {
@@ -121,6 +125,17 @@ PARDg5VIOHub::startup()
         assert(device);
 
         device->pciid = CellX::calcPciID(configAddr);
+        device->configAddr = configAddr;
+        for (int id = 0; id < devices.size(); id++) {
+            if (devices[id] == device)
+                pciidToDevice[device->pciid] = id;
+        }
+
+        PARDg5VPciDevice *pci =
+            dynamic_cast<PARDg5VPciDevice *>(device->owner);
+        device->pard_compatible = (pci != NULL);
+        device->numVFs = pci ? pci->numVFs() : 0;
+        device->vfUserBAR.clear();
 
         // Query InterruptLine of each PCI device
         {
@@ -163,7 +178,7 @@ PARDg5VIOHub::startup()
             (type ? basePciIOPort : basePciIOMem) += shadow->sizeBAR[i];
         }
         pciConfigShadow.insert(RangeSize(configAddr+PCI0_BASE_ADDR0, 20),
-                               shadow);
+                               device);
     }
 
     cp->recvDeviceChange(devices);
@@ -182,21 +197,16 @@ PARDg5VIOHub::remapAddr(Addr addr, uint16_t DSid)
         addr = remapped + (addr-base);
 */
 
-    // Check device mask, hidden non-assigned devices
+    // Check device set, hidden non-assigned devices
     if ((addr & 0xF000000000000000) == PhysAddrPrefixPciConfig) {
         // XXX: Make 0000:31:7 INVALID device
         static const Addr InvalidPciConfigAddress = calcPciConfigAddr(0, 31, 7);
 
-        // get device mask
-        uint32_t device_mask = cp->getDeviceMask(DSid);
+        // check device set
+        auto p = pciidToDevice.find(CellX::calcPciID(addr));
+        if (p != pciidToDevice.end() && cp->isAssigned(DSid, p->second))
+            return addr;
 
-        // check device mask
-        for (int i=0; i<32 && device_mask!=0; i++) {
-            if ((device_mask & (1<<i)) &&
-                (devices[i]->pciid == CellX::calcPciID(addr)))
-                return addr;
-        }
- 
         return InvalidPciConfigAddress;
     }
     else {
@@ -222,8 +232,10 @@ PARDg5VIOHub::hookPciAccess(PacketPtr pkt)
             offset <= PCI0_BASE_ADDR4)
         {
             int barnum = BAR_NUMBER(offset);
-            struct PCI_CONFIG_SHADOW *shadow =
+            struct PCI_DEVICE *dev =
                                pciConfigShadow.find(pkt->getAddr())->second;
+            struct PCI_CONFIG_SHADOW *shadow = &dev->configShadow;
+            uint32_t *userBAR = getUserBAR(dev, pkt->getDSid());
 
             // for write request to BAR register, we shadow it
             if (pkt->isRequest() && pkt->isWrite()) {
@@ -232,18 +244,18 @@ PARDg5VIOHub::hookPciAccess(PacketPtr pkt)
                 if (base == 0xFFFFFFFE || base == 0)
                     return;
 
-                shadow->userBAR[barnum] = pkt->get<uint32_t>();
+                userBAR[barnum] = pkt->get<uint32_t>();
                 pciIoShadow[pkt->getDSid()].insert(
-                    RangeSize((type ? x86IOAddress(shadow->userBAR[barnum])
-                                    : shadow->userBAR[barnum]) & 0xFFFFFFFFFFFFFFFE,
+                    RangeSize((type ? x86IOAddress(userBAR[barnum])
+                                    : userBAR[barnum]) & 0xFFFFFFFFFFFFFFFE,
                                shadow->sizeBAR[barnum]),
-                    shadow->uniqBAR[barnum]-shadow->userBAR[barnum]);
+                    shadow->uniqBAR[barnum]-userBAR[barnum]);
                 pkt->set<uint32_t>(shadow->uniqBAR[barnum]);
             }
             // for read response, check shadow and reture original user BAR
             else if (pkt->isResponse() && pkt->isRead()) {
                 if (pkt->get<uint32_t>() == shadow->uniqBAR[barnum])
-                    pkt->set<uint32_t>(shadow->userBAR[barnum]);
+                    pkt->set<uint32_t>(userBAR[barnum]);
             }
 /* Let them go!
             // Oops, we are not expect other packet type
@@ -256,6 +268,168 @@ PARDg5VIOHub::hookPciAccess(PacketPtr pkt)
     }
 }
 
+std::vector<struct PCI_DEVICE *>
+PARDg5VIOHub::getAssignedDevices(uint16_t DSid)
+{
+    std::vector<struct PCI_DEVICE *> assigned;
+    for (int id : cp->getDeviceIDs(DSid)) {
+        if (id < devices.size())
+            assigned.push_back(devices[id]);
+    }
+    return assigned;
+}
+
+uint32_t *
+PARDg5VIOHub::getUserBAR(struct PCI_DEVICE *dev, uint16_t DSid)
+{
+    if (!dev->numVFs)
+        return dev->configShadow.userBAR;
+
+    // A new VF starts with unassigned BARs of the same type
+    std::vector<uint32_t> &userBAR = dev->vfUserBAR[DSid];
+    if (userBAR.empty()) {
+        for (int i=0; i<5; i++)
+            userBAR.push_back(dev->configShadow.uniqBAR[i] & 0x1);
+    }
+    return &userBAR[0];
+}
+
+bool
+PARDg5VIOHub::assignDevice(int id, uint16_t DSid)
+{
+    struct PCI_DEVICE *dev = getPciDevice(id);
+    if (!dev) {
+        warn("%s: no device#%d to assign to DSid#%d.\n", name(), id, DSid);
+        return false;
+    }
+
+    if (dev->numVFs) {
+        PARDg5VPciDevice *pci = static_cast<PARDg5VPciDevice *>(dev->owner);
+        if (!pci->attachVF(DSid)) {
+            warn("%s: all %d VFs of dev#%d taken, DSid#%d not assigned.\n",
+                 name(), dev->numVFs, id, DSid);
+            return false;
+        }
+        dev->vfUserBAR.erase(DSid);
+    } else {
+        static_cast<PARDg5VDmaDevice *>(dev->owner)->setDSid(DSid);
+    }
+    return true;
+}
+
+void
+PARDg5VIOHub::releaseDevice(int id, uint16_t DSid)
+{
+    struct PCI_DEVICE *dev = getPciDevice(id);
+    if (!dev)
+        return;
+
+    if (dev->numVFs) {
+        static_cast<PARDg5VPciDevice *>(dev->owner)->detachVF(DSid);
+        dev->vfUserBAR.erase(DSid);
+    } else {
+        static_cast<PARDg5VDmaDevice *>(dev->owner)->setDSid(-1);
+    }
+}
+
+void
+PARDg5VIOHub::writeDeviceConfig(struct PCI_DEVICE *dev, uint16_t DSid,
+                                int offset, int size, uint32_t value)
+{
+    // Bypass the remapper hooks, value is already the one device sees
+    Request request(dev->configAddr + offset, size, Request::UNCACHEABLE,
+                    Request::funcMasterId);
+    request.setDSid(DSid);
+    Packet pkt(&request, MemCmd::WriteReq);
+    pkt.allocate();
+    if (size == 2)
+        pkt.set<uint16_t>(value);
+    else
+        pkt.set<uint32_t>(value);
+    masterPorts[findPort(dev->configAddr)]->sendFunctional(&pkt);
+}
+
+void
+PARDg5VIOHub::serializeLDom(uint16_t DSid, const std::string &dir,
+                            std::ostream &os)
+{
+    std::vector<struct PCI_DEVICE *> assigned = getAssignedDevices(DSid);
+    int numDevices = assigned.size();
+    SERIALIZE_SCALAR(numDevices);
+
+    for (int d = 0; d < numDevices; d++) {
+        struct PCI_DEVICE *dev = assigned[d];
+
+        // PCI command register enables the BARs below
+        Request request(dev->configAddr + PCI_COMMAND, 2,
+                        Request::UNCACHEABLE, Request::funcMasterId);
+        request.setDSid(DSid);
+        Packet pkt(&request, MemCmd::ReadReq);
+        pkt.allocate();
+        masterPorts[findPort(dev->configAddr)]->sendFunctional(&pkt);
+
+        paramOut(os, csprintf("dev%d.command", d), pkt.get<uint16_t>());
+        arrayParamOut(os, csprintf("dev%d.userBAR", d),
+                      getUserBAR(dev, DSid), 5);
+    }
+
+    // Device private state, one section per device
+    for (int d = 0; d < numDevices; d++) {
+        ILDomSerializable *owner =
+            dynamic_cast<ILDomSerializable *>(assigned[d]->owner);
+        if (!owner)
+            continue;
+        os << "\n[" << csprintf("%s.dev%d", name(), d) << "]\n";
+        owner->serializeLDom(DSid, dir, os);
+    }
+}
+
+void
+PARDg5VIOHub::unserializeLDom(uint16_t DSid, Checkpoint *cp,
+                              const std::string &section)
+{
+    std::vector<struct PCI_DEVICE *> assigned = getAssignedDevices(DSid);
+    int numDevices;
+    UNSERIALIZE_SCALAR(numDevices);
+    if (numDevices != assigned.size()) {
+        warn("%s: LDomain had %d devices, DSid %d has %d.\n",
+             name(), numDevices, DSid, assigned.size());
+        numDevices = std::min<int>(numDevices, assigned.size());
+    }
+
+    pciIoShadow.erase(DSid);
+    for (int d = 0; d < numDevices; d++) {
+        struct PCI_DEVICE *dev = assigned[d];
+        struct PCI_CONFIG_SHADOW *shadow = &dev->configShadow;
+        uint32_t *userBAR = getUserBAR(dev, DSid);
+        uint16_t command;
+        paramIn(cp, section, csprintf("dev%d.command", d), command);
+        arrayParamIn(cp, section, csprintf("dev%d.userBAR", d),
+                     userBAR, 5);
+
+        // Same as a guest BAR write seen by hookPciAccess()
+        for (int i=0; i<5; i++) {
+            uint32_t base = userBAR[i] & 0xFFFFFFFE;
+            uint32_t type = userBAR[i] & 0x00000001;
+            if (base == 0xFFFFFFFE || base == 0)
+                continue;
+            pciIoShadow[DSid].insert(
+                RangeSize((type ? x86IOAddress(userBAR[i])
+                                : userBAR[i]) & 0xFFFFFFFFFFFFFFFE,
+                           shadow->sizeBAR[i]),
+                shadow->uniqBAR[i]-userBAR[i]);
+            writeDeviceConfig(dev, DSid, PCI0_BASE_ADDR0 + i*4, 4,
+                              shadow->uniqBAR[i]);
+        }
+        writeDeviceConfig(dev, DSid, PCI_COMMAND, 2, command);
+
+        ILDomSerializable *owner = dynamic_cast<ILDomSerializable *>(
+            dev->owner);
+        if (owner)
+            owner->unserializeLDom(DSid, cp, csprintf("%s.dev%d", section, d));
+    }
+}
+
 PARDg5VIOHubRemapper *
 PARDg5VIOHubRemapperParams::create()
 {
@@ -32,12 +32,14 @@
 #define __DEV_PARDG5V_IOHUB_HH__
 
 #include <set>
+#include <unordered_map>
 
 #include "dev/pard/iohub_cp.hh"
 #include "mem/noncoherent_xbar.hh"
 #include "mem/tag_addr_mapper.hh"
 #include "params/PARDg5VIOHub.hh"
 #include "params/PARDg5VIOHubRemapper.hh"
+#include "prm/interfaces.hh"
 
 struct PCI_CONFIG_SHADOW {
     uint32_t uniqBAR[5];
@@ -48,14 +50,18 @@ struct PCI_CONFIG_SHADOW {
 struct PCI_DEVICE {
     MemObject *owner;
     uint16_t pciid;
+    Addr configAddr;
     uint8_t interruptLine;
     bool pard_compatible;
+    unsigned numVFs;
     std::vector<PortID> ports;
     struct PCI_CONFIG_SHADOW configShadow;
+    // BARs each DSid wrote to its VF, uniqBAR is shared by all VFs
+    std::map<uint16_t, std::vector<uint32_t> > vfUserBAR;
 };
 
 
-class PARDg5VIOHub : public NoncoherentXBar
+class PARDg5VIOHub : public NoncoherentXBar, public ILDomSerializable
 {
     friend class PARDg5VIOHubRemapper;
     friend class PARDg5VIOHubCP;
@@ -82,8 +88,8 @@ class PARDg5VIOHub : public NoncoherentXBar
 
             static const std::string system_devices_name[] = {
                 ".cellx.behind_pci", ".cellx.pciconfig", ".apicbridge",
-                ".iobridge", ".iocache", ".ich" };
-            for (int i=0; i<6; i++) {
+                ".iobridge", ".iocache", ".iommu", ".ich" };
+            for (int i=0; i<7; i++) {
                 if (slaveOwner.name().find(system_devices_name[i])
                       != std::string::npos)
                 {
@@ -99,9 +105,11 @@ class PARDg5VIOHub : public NoncoherentXBar
   protected:
     // All PCI devices
     std::vector<struct PCI_DEVICE *> devices;
+    // pciid ==> device id
+    std::unordered_map<uint16_t, int> pciidToDevice;
 
-    // ConfigPort ==> uniqBAR[5]
-    AddrRangeMap<struct PCI_CONFIG_SHADOW *> pciConfigShadow;
+    // BAR registers in ConfigPort ==> device
+    AddrRangeMap<struct PCI_DEVICE *> pciConfigShadow;
     // PioPort: <DSid, UserAddr> ==> uniqAddr
     std::map<uint16_t, AddrRangeMap<Addr> > pciIoShadow;
 
@@ -110,6 +118,24 @@ class PARDg5VIOHub : public NoncoherentXBar
     Addr remapAddr(Addr addr, uint16_t DSid);
     void hookPciAccess(PacketPtr pkt);
 
+    /** Devices assigned to DSid, in device id order */
+    std::vector<struct PCI_DEVICE *> getAssignedDevices(uint16_t DSid);
+    void writeDeviceConfig(struct PCI_DEVICE *dev, uint16_t DSid,
+                           int offset, int size, uint32_t value);
+
+    /** BARs as DSid wrote them, its VF's for devices with VFs */
+    uint32_t *getUserBAR(struct PCI_DEVICE *dev, uint16_t DSid);
+
+    /**
+     * Hand device id to DSid, or take it back. Devices with VFs give
+     * each DSid its own, others are owned by one DSid at a time.
+     * @return false if the device has no free VF left
+     * @{
+     */
+    bool assignDevice(int id, uint16_t DSid);
+    void releaseDevice(int id, uint16_t DSid);
+    /** @} */
+
     struct PCI_DEVICE * getPciDevice(MemObject *owner)
     {
         for (auto dev : devices)
@@ -123,10 +149,12 @@ class PARDg5VIOHub : public NoncoherentXBar
 
     void regDevicePort(MemObject &owner, PortID port)
     {
-        struct PCI_DEVICE *dev = new PCI_DEVICE;
+        struct PCI_DEVICE *dev;
         if ((dev = getPciDevice(&owner)) == NULL) {
             dev = new PCI_DEVICE;
             dev->owner = &owner;
+            dev->pard_compatible = false;
+            dev->numVFs = 0;
             devices.push_back(dev);
         }
         dev->ports.push_back(port);
@@ -140,6 +168,16 @@ class PARDg5VIOHub : public NoncoherentXBar
 
     virtual void startup();
 
+    /**
+     * Shadow BARs of the devices assigned to an LDomain, and the state
+     * of those devices themselves. Devices of the restoring DSid take
+     * over the saved state in device id order.
+     */
+    virtual void serializeLDom(uint16_t DSid, const std::string &dir,
+                               std::ostream &os);
+    virtual void unserializeLDom(uint16_t DSid, Checkpoint *cp,
+                                 const std::string &section);
+
 };
 
 class PARDg5VIOHubRemapper : public TagAddrMapper
@@ -28,10 +28,11 @@
  * Authors: Jiuyue Ma
  */
 
+#include <algorithm>
+
 #include "arch/x86/x86_traits.hh"
 #include "debug/ControlPlane.hh"
 #include "mem/mem_object.hh"
-#include "dev/pard/dma_device.hh"
 #include "dev/pard/iohub_cp.hh"
 #include "dev/pard/iohub.hh"
 #include "dev/pcireg.h"               // for PCI_CONFIG_SIZE
@@ -48,12 +49,18 @@ PARDg5VIOHubCP::PARDg5VIOHubCP(const Params *p)
     memset(&ioInfo, 0, sizeof(ioInfo));
     ioInfo.device_ptr = 0xFFFF;
     ioInfo.device_nr = 0;
+    ioInfo.page_devices = IOH_PAGE_DEVICES;
 
     // Allocate ConfigTable
     paramTable = new struct ParamEntry[param_table_entries];
     statTable = new struct StatEntry[stat_table_entries];
     memset(paramTable, 0, sizeof(struct ParamEntry)*param_table_entries);
     memset(statTable,  0, sizeof(struct StatEntry) *stat_table_entries);
+    deviceSets.resize(param_table_entries, std::vector<uint64_t>(1, 0));
+
+    // Per-DSid counters, updated by the I/O scheduler
+    ioRequestsCounter = registerCounter("io_requests");
+    ioBytesCounter = registerCounter("io_bytes");
 }
 
 PARDg5VIOHubCP::~PARDg5VIOHubCP()
@@ -98,6 +105,25 @@ PARDg5VIOHubCP::updateTable(uint16_t DSid, uint32_t addr, uint64_t data)
         return;
     }
 
+    if ((char *)pdata >= (char *)statTable &&
+        (char *)pdata <  (char *)statTable+stat_table_entries*sizeof(struct StatEntry))
+    {
+        warn("PARDg5VIOHubCP: write to read-only addr 0x%x", addr);
+        return;
+    }
+
+    // Only the page selector of the device list is writable
+    if ((char *)pdata >= (char *)&ioInfo &&
+        (char *)pdata <  (char *)&ioInfo + sizeof(ioInfo))
+    {
+        if (pdata != (uint64_t *)&ioInfo) {
+            warn("PARDg5VIOHubCP: write to read-only addr 0x%x", addr);
+            return;
+        }
+        selectPage(((struct IOHubInfo *)&data)->device_page);
+        return;
+    }
+
     old_data = *pdata;
     *pdata = data;
 
@@ -105,30 +131,73 @@ PARDg5VIOHubCP::updateTable(uint16_t DSid, uint32_t addr, uint64_t data)
         (char *)pdata <  (char *)paramTable+param_table_entries*sizeof(struct ParamEntry))
     {
         int idx = ((uint64_t)pdata - (uint64_t)paramTable)/sizeof(struct ParamEntry);
+        rowCache.clear();
+
+        // A new owner of the row starts with fresh statistics
+        if (idx < stat_table_entries &&
+            (statTable[idx].DSid != paramTable[idx].DSid ||
+             !(paramTable[idx].flags & FLAG_VALID)))
+            memset(&statTable[idx], 0, sizeof(struct StatEntry));
+
         if ((char *)pdata <= (char *)&paramTable[idx].device_mask &&
             (char *)pdata+sizeof(*pdata)
               >= (char *)&paramTable[idx].device_mask+sizeof(paramTable[idx].device_mask))
         {
-            uint32_t *p_old_device_mask = (uint32_t *)((char *)&old_data + offsetof(struct ParamEntry, device_mask) - ((char *)pdata-(char *)&paramTable[idx]));
-            uint32_t *p_device_mask = &paramTable[idx].device_mask;
-
-            if (paramTable[idx].flags & FLAG_VALID) {
-                uint32_t changed_mask = *p_device_mask ^ *p_old_device_mask;
-                for (int i=0; i<32; i++) {
-                    if (changed_mask & (uint32_t)1<<i) {
-                        if (*p_device_mask & (uint32_t)1<<i) {
-                            DPRINTFN("ASSIGN DSid#%d ==> dev#%d.\n", paramTable[idx].DSid, i);
-                            static_cast<PARDg5VDmaDevice *>(iohub->getPciDevice(i)->owner)->setDSid(paramTable[idx].DSid);
-                        }
-                        else {
-                            DPRINTFN("RELEASE DSid#%d ==> dev#%d.\n", paramTable[idx].DSid, i);
-                            static_cast<PARDg5VDmaDevice *>(iohub->getPciDevice(i)->owner)->setDSid(-1);
-                        }
-                    }
-                }
+            // device_mask is the low half of the first device set word
+            uint64_t &bits = deviceSets[idx][0];
+            uint64_t old_bits = bits;
+            bits = (bits & ~(uint64_t)0xFFFFFFFF) |
+                   paramTable[idx].device_mask;
+            applyDeviceSet(idx, 0, old_bits);
+        }
+        return;
+    }
+
+    // Otherwise a word of a device set
+    for (int row = 0; row < param_table_entries; row++) {
+        std::vector<uint64_t> &set = deviceSets[row];
+        if (pdata >= &set[0] && pdata < &set[0] + set.size()) {
+            applyDeviceSet(row, pdata - &set[0], old_data);
+            break;
+        }
+    }
+}
+
+void
+PARDg5VIOHubCP::applyDeviceSet(int row, int word, uint64_t old_bits)
+{
+    uint64_t &bits = deviceSets[row][word];
+    uint16_t DSid = paramTable[row].DSid;
+
+    if (paramTable[row].flags & FLAG_VALID) {
+        uint64_t changed = bits ^ old_bits;
+        for (int i = 0; i < 64 && changed; i++) {
+            uint64_t bit = (uint64_t)1 << i;
+            if (!(changed & bit))
+                continue;
+            changed &= ~bit;
+
+            int id = word * 64 + i;
+            if (bits & bit) {
+                DPRINTFN("ASSIGN DSid#%d ==> dev#%d.\n", DSid, id);
+                // Out of VFs, the device stays hidden
+                if (!iohub->assignDevice(id, DSid))
+                    bits &= ~bit;
+            } else {
+                DPRINTFN("RELEASE DSid#%d ==> dev#%d.\n", DSid, id);
+                iohub->releaseDevice(id, DSid);
             }
         }
     }
+
+    if (word == 0)
+        paramTable[row].device_mask = (uint32_t)bits;
+}
+
+int
+PARDg5VIOHubCP::snapshotStats(uint16_t DSid, uint8_t *buf, int size)
+{
+    return copyStatRows(DSid, statTable, stat_table_entries, buf, size);
 }
 
 uint64_t *
@@ -149,6 +218,16 @@ PARDg5VIOHubCP::parseAddr(uint32_t addr)
                 if ((row < param_table_entries) &&
                     (offset <= sizeof(struct ParamEntry) - sizeof(uint64_t)))
                     ptr = (char *)&paramTable[row];
+                else if ((row < param_table_entries) &&
+                         (offset >= IOH_DEVSET_OFFSET) &&
+                         (offset % sizeof(uint64_t) == 0)) {
+                    // Device set words, as many as there are devices
+                    std::vector<uint64_t> &set = deviceSets[row];
+                    unsigned word = (offset - IOH_DEVSET_OFFSET) /
+                                    sizeof(uint64_t);
+                    if (word < set.size())
+                        return &set[word];
+                }
                 break;
               case CFGTBL_TYPE_STAT:
                 if ((row < stat_table_entries) &&
@@ -173,46 +252,144 @@ void
 PARDg5VIOHubCP::recvDeviceChange(
     const std::vector<struct PCI_DEVICE *> &devices)
 {
-    // ioInfo header
-    ioInfo.device_nr = devices.size();
-    ioInfo.device_ptr = (devices.size() == 0) ? 0xFFFF
-                        : (uint64_t)(&((struct IOHubInfo *)NULL)->devices[0]);
-    if (ioInfo.device_nr == 0) {
+    panic_if(devices.size() > IOH_MAX_DEVICES,
+             "%s: %d devices, at most %d supported.\n",
+             name(), devices.size(), IOH_MAX_DEVICES);
+
+    // Every device set gets a bit for each device
+    unsigned words = std::max<unsigned>(1, (devices.size() + 63) / 64);
+    for (auto &set : deviceSets)
+        set.resize(words, 0);
+
+    ioInfo.device_total = devices.size();
+    if (devices.size() == 0)
         warn("No device registered to PARDg5VIOHubCP.\n");
-        return;
-    }
 
     // build iohub device info
-    struct IOHubDevice *devInfo = NULL;
+    deviceInfo.resize(devices.size());
     for (int id=0; id<devices.size(); id++) {
         auto dev = devices[id];
-        devInfo = &ioInfo.devices[id];
+        struct IOHubDevice *devInfo = &deviceInfo[id];
 
-        devInfo->next_ptr  = (id == devices.size()-1) ? 0xFFFF 
-                             : (uint64_t)
-                               (&((struct IOHubInfo *)NULL)->devices[id+1]);
+        memset(devInfo, 0, sizeof(struct IOHubDevice));
         devInfo->id        = id;
         devInfo->flags     = dev->pard_compatible ? 1 : 0;
         devInfo->pciid     = dev->pciid;
         devInfo->interrupt = dev->interruptLine;
+        devInfo->num_vfs   = dev->numVFs;
         strncpy(devInfo->ident, dev->owner->name().c_str(), 32);
     }
+
+    selectPage(0);
 }
 
-uint32_t
-PARDg5VIOHubCP::getDeviceMask(uint16_t DSid)
+void
+PARDg5VIOHubCP::selectPage(uint16_t page)
+{
+    unsigned first = page * IOH_PAGE_DEVICES;
+    unsigned nr = first < deviceInfo.size() ?
+        std::min<unsigned>(IOH_PAGE_DEVICES, deviceInfo.size() - first) : 0;
+
+    // ioInfo header
+    memset(ioInfo.devices, 0, sizeof(ioInfo.devices));
+    ioInfo.device_page = page;
+    ioInfo.device_nr = nr;
+    ioInfo.device_ptr = (nr == 0) ? 0xFFFF
+                        : offsetof(struct IOHubInfo, devices);
+
+    for (int i=0; i<nr; i++) {
+        ioInfo.devices[i] = deviceInfo[first + i];
+        ioInfo.devices[i].next_ptr = (i == nr-1) ? 0xFFFF
+            : offsetof(struct IOHubInfo, devices) +
+              (i+1) * sizeof(struct IOHubDevice);
+    }
+}
+
+bool
+PARDg5VIOHubCP::isAssigned(uint16_t DSid, int id)
+{
+    int row = findRow(DSid);
+    if (row < 0 || id < 0 || id / 64 >= deviceSets[row].size())
+        return false;
+    return deviceSets[row][id / 64] & ((uint64_t)1 << (id % 64));
+}
+
+std::vector<int>
+PARDg5VIOHubCP::getDeviceIDs(uint16_t DSid)
+{
+    std::vector<int> ids;
+    int row = findRow(DSid);
+    if (row < 0)
+        return ids;
+
+    const std::vector<uint64_t> &set = deviceSets[row];
+    for (int word = 0; word < set.size(); word++) {
+        for (int i = 0; i < 64; i++) {
+            if (set[word] & ((uint64_t)1 << i))
+                ids.push_back(word * 64 + i);
+        }
+    }
+    return ids;
+}
+
+int
+PARDg5VIOHubCP::findRow(uint16_t DSid)
 {
-    uint32_t device_mask = 0;
+    auto it = rowCache.find(DSid);
+    if (it != rowCache.end())
+        return it->second;
 
+    int row = -1;
     for (int i=0; i<param_table_entries; i++) {
         if ((paramTable[i].flags & FLAG_VALID) &&
             (paramTable[i].DSid == DSid)) {
-            device_mask = paramTable[i].device_mask;
+            row = i;
             break;
         }
     }
+    rowCache[DSid] = row;
+    return row;
+}
+
+uint32_t
+PARDg5VIOHubCP::getIOWeight(uint16_t DSid)
+{
+    int row = findRow(DSid);
+    return (row < 0 || !paramTable[row].io_weight) ? 1
+           : paramTable[row].io_weight;
+}
+
+uint64_t
+PARDg5VIOHubCP::getIOByteRate(uint16_t DSid)
+{
+    int row = findRow(DSid);
+    return row < 0 ? 0 : paramTable[row].io_bps;
+}
 
-    return device_mask;
+uint32_t
+PARDg5VIOHubCP::getIORate(uint16_t DSid)
+{
+    int row = findRow(DSid);
+    return row < 0 ? 0 : paramTable[row].io_iops;
+}
+
+void
+PARDg5VIOHubCP::recordIO(uint16_t DSid, unsigned bytes, Tick latency,
+                         bool throttled)
+{
+    int row = findRow(DSid);
+    if (row >= 0 && row < stat_table_entries) {
+        struct StatEntry &stat = statTable[row];
+        stat.flags = FLAG_VALID;
+        stat.DSid = DSid;
+        stat.io_requests++;
+        stat.io_bytes += bytes;
+        stat.io_latency += latency;
+        if (throttled)
+            stat.io_throttled++;
+    }
+    incrCounter(DSid, ioRequestsCounter, 1);
+    incrCounter(DSid, ioBytesCounter, bytes);
 }
 
 
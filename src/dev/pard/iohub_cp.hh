@@ -40,7 +40,9 @@
 #ifndef __DEV_PARDG5V_IOHUB_CP_HH__
 #define __DEV_PARDG5V_IOHUB_CP_HH__
 
+#include <map>
 #include <set>
+#include <vector>
 
 #include "base/addr_range.hh"
 #include "params/PARDg5VIOHubCP.hh"
@@ -48,42 +50,64 @@
 
 /**
  * Config Table
+ *
+ * device_mask assigns devices 0-31. The device set of the row follows
+ * at IOH_DEVSET_OFFSET, one bit per device id in 64-bit words, and
+ * covers every device of the IOHub. Its low 32 bits are device_mask.
  */
 struct ParamEntry {
     uint16_t flags;
     uint16_t DSid;
-    uint32_t device_mask;
+    uint32_t device_mask;   // devices with VFs may be in several sets
+    uint32_t io_weight;     // share of the shared disk, 0 counts as 1
+    uint32_t io_iops;       // disk requests per second, 0 for no limit
+    uint64_t io_bps;        // disk bytes per second, 0 for no limit
 };
 #define FLAG_VALID	0x0001
+#define IOH_DEVSET_OFFSET	0x40
+#define IOH_MAX_DEVICES		((0x400 - IOH_DEVSET_OFFSET) * 8)
 
 /**
- * State Table
+ * State Table, same row as param table
  */
-struct StatEntry {	// Indexed by Port
+struct StatEntry {
     uint16_t flags;
     uint16_t DSid;
+    uint32_t __padding;
+    uint64_t io_requests;   // requests served by the shared disk
+    uint64_t io_bytes;
+    uint64_t io_latency;    // total ticks from queueing to completion
+    uint64_t io_throttled;  // requests held back by io_bps or io_iops
 };
 
 
 /**
  * SystemInfo Table
+ *
+ * Only a page of IOH_PAGE_DEVICES devices fits the SystemInfo window.
+ * Writing device_page to the first qword moves to another page, the
+ * device_ptr list then links the devices of that page.
  */
 struct IOHubDevice {
     uint16_t next_ptr;
-    uint8_t id;
-    uint8_t flags;
+    uint16_t id;
     uint16_t pciid;
-    uint8_t interrupt;
-    uint8_t reserved;
+    uint8_t  flags;
+    uint8_t  interrupt;
+    uint8_t  num_vfs;       // 0 if only assigned whole
+    uint8_t  __res[7];
     char ident[32];
 };
 
+#define IOH_PAGE_DEVICES	5
 struct IOHubInfo
 {
     uint16_t device_ptr;
-    uint8_t  device_nr;
-    uint8_t  __res[5];
-    struct IOHubDevice devices[32];
+    uint8_t  device_nr;     // devices in this page
+    uint8_t  page_devices;  // IOH_PAGE_DEVICES
+    uint16_t device_page;   // writable, selects the page
+    uint16_t device_total;  // devices of all pages
+    struct IOHubDevice devices[IOH_PAGE_DEVICES];
 };
 
 struct PCI_DEVICE;
@@ -99,8 +123,24 @@ class PARDg5VIOHubCP : public ControlPlane
     struct ParamEntry *paramTable;
     struct IOHubInfo ioInfo;
 
+    /** Device set of each param table row, one bit per device id */
+    std::vector<std::vector<uint64_t> > deviceSets;
+    /** Info of all devices, ioInfo pages through it */
+    std::vector<struct IOHubDevice> deviceInfo;
+
+    /**
+     * Param table row of each DSid looked up so far, -1 for none. The
+     * I/O scheduler asks for every request, PRM writes to the param
+     * table drop it.
+     */
+    std::map<uint16_t, int> rowCache;
+
     PARDg5VIOHub *iohub;
 
+    /** Counter indexes, see ControlPlane::registerCounter() */
+    int ioRequestsCounter;
+    int ioBytesCounter;
+
   public:
     typedef PARDg5VIOHubCPParams Params;
     PARDg5VIOHubCP(const Params *p);
@@ -109,14 +149,38 @@ class PARDg5VIOHubCP : public ControlPlane
     void regPARDg5VIOHub(PARDg5VIOHub *_iohub);
 
   public:
-    uint32_t getDeviceMask(uint16_t DSid);
+    /** Device id is assigned to DSid */
+    bool isAssigned(uint16_t DSid, int id);
+    /** Ids of the devices assigned to DSid, in ascending order */
+    std::vector<int> getDeviceIDs(uint16_t DSid);
+
+    /** I/O shares of DSid, no limits without a valid row */
+    uint32_t getIOWeight(uint16_t DSid);
+    uint64_t getIOByteRate(uint16_t DSid);
+    uint32_t getIORate(uint16_t DSid);
+
+    /** Called by the I/O scheduler for every request it served */
+    void recordIO(uint16_t DSid, unsigned bytes, Tick latency,
+                  bool throttled);
+
     void recvDeviceChange(const std::vector<struct PCI_DEVICE *> &devices);
 
     virtual uint64_t queryTable(uint16_t DSid, uint32_t addr);
     virtual void updateTable(uint16_t DSid, uint32_t addr, uint64_t data);
+    virtual int snapshotStats(uint16_t DSid, uint8_t *buf, int size);
 
   private:
     uint64_t *parseAddr(uint32_t addr);
+    int findRow(uint16_t DSid);
+
+    /**
+     * Assign and release the devices whose bits in a device set word
+     * changed from old_bits, bits of devices that can't be assigned
+     * are cleared.
+     */
+    void applyDeviceSet(int row, int word, uint64_t old_bits);
+    /** Fill ioInfo with the devices of a page */
+    void selectPage(uint16_t page);
 
   protected:
     const Params *param() const
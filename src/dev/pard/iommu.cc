@@ -0,0 +1,687 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+#include <algorithm>
+
+#include "base/bitfield.hh"
+#include "base/intmath.hh"
+#include "debug/PARDg5VIOMMU.hh"
+#include "dev/pard/iommu.hh"
+#include "dev/pard/iommu_cp.hh"
+#include "sim/stats.hh"
+#include "sim/system.hh"
+
+/**
+ * Page table entry bits, PS only counts in the PDPT and PD.
+ */
+#define PTE_P           0x001ULL
+#define PTE_W           0x002ULL
+#define PTE_PS          0x080ULL
+#define PTE_ADDR_MASK   0x000FFFFFFFFFF000ULL
+
+/** DMA addresses are 48 bits wide, as the 4-level page table */
+#define IOVA_BITS       48
+
+PARDg5VIOMMU::PARDg5VIOMMU(Params *p)
+    : XBridge(p),
+      slavePort(p->name + ".slave", *this, masterPort,
+                ticksToCycles(p->delay), p->resp_size, p->ranges),
+      masterPort(p->name + ".master", *this, slavePort,
+                 ticksToCycles(p->delay), p->req_size),
+      cp(p->cp), masterId(p->system->getMasterId(p->name + ".walker")),
+      defaultBypass(p->default_bypass), iotlbLatency(p->iotlb_latency),
+      numWalkers(p->walkers),
+      iotlbSets(p->iotlb_sets), iotlbWays(p->iotlb_ways),
+      iotlb(p->iotlb_sets * p->iotlb_ways), lruClock(0), held(0),
+      numLDoms(p->ldoms)
+{
+    fatal_if(iotlbSets == 0 || !isPowerOf2(iotlbSets),
+             "%s: IOTLB sets %d not a power of 2\n", name(), iotlbSets);
+    fatal_if(iotlbWays == 0, "%s: IOTLB needs at least one way\n", name());
+    fatal_if(numWalkers == 0, "%s: needs at least one walker\n", name());
+
+    for (auto &entry : iotlb)
+        entry.valid = false;
+
+    cp->regIOMMU(this, iotlbSets, iotlbWays);
+}
+
+PARDg5VIOMMU::~PARDg5VIOMMU()
+{
+    for (auto walk : walks)
+        delete walk;
+}
+
+BaseMasterPort&
+PARDg5VIOMMU::getMasterPort(const std::string &if_name, PortID idx)
+{
+    if (if_name == "master")
+        return masterPort;
+    else
+        // pass it along to our super class
+        return XBridge::getMasterPort(if_name, idx);
+}
+
+BaseSlavePort&
+PARDg5VIOMMU::getSlavePort(const std::string &if_name, PortID idx)
+{
+    if (if_name == "slave")
+        return slavePort;
+    else
+        // pass it along to our super class
+        return XBridge::getSlavePort(if_name, idx);
+}
+
+void
+PARDg5VIOMMU::init()
+{
+    // make sure both sides are connected and have the same block size
+    if (!slavePort.isConnected() || !masterPort.isConnected())
+        fatal("Both ports of a bridge must be connected.\n");
+
+    // notify the master side  of our address ranges
+    slavePort.sendRangeChange();
+}
+
+void
+PARDg5VIOMMU::regStats()
+{
+    using namespace Stats;
+
+    XBridge::regStats();
+
+    iotlbHits
+        .name(name() + ".iotlbHits")
+        .desc("Number of DMA packets translated by the IOTLB")
+        ;
+    iotlbMisses
+        .name(name() + ".iotlbMisses")
+        .desc("Number of DMA packets that missed in the IOTLB")
+        ;
+    iotlbHitRate
+        .name(name() + ".iotlbHitRate")
+        .desc("IOTLB hit rate")
+        ;
+    iotlbHitRate = iotlbHits / (iotlbHits + iotlbMisses);
+    ldomHits
+        .init(numLDoms)
+        .name(name() + ".ldomHits")
+        .desc("IOTLB hits by DSid")
+        .flags(total | nozero)
+        ;
+    ldomMisses
+        .init(numLDoms)
+        .name(name() + ".ldomMisses")
+        .desc("IOTLB misses by DSid")
+        .flags(total | nozero)
+        ;
+    iotlbEvictions
+        .name(name() + ".iotlbEvictions")
+        .desc("Valid IOTLB entries replaced by a fill")
+        ;
+    iotlbInvalidations
+        .name(name() + ".iotlbInvalidations")
+        .desc("IOTLB entries dropped by the control plane")
+        ;
+    walksStarted
+        .name(name() + ".walks")
+        .desc("Number of page table walks")
+        ;
+    walkReads
+        .name(name() + ".walkReads")
+        .desc("Page table entries read by walks")
+        ;
+    coalescedMisses
+        .name(name() + ".coalescedMisses")
+        .desc("Misses that joined a walk of the same page")
+        ;
+    walkLatency
+        .name(name() + ".walkLatency")
+        .desc("Total ticks spent walking page tables")
+        ;
+    avgWalkLatency
+        .name(name() + ".avgWalkLatency")
+        .desc("Average ticks of a page table walk")
+        ;
+    avgWalkLatency = walkLatency / walksStarted;
+    faults
+        .name(name() + ".faults")
+        .desc("DMA packets refused for a missing or read-only mapping")
+        ;
+}
+
+bool
+PARDg5VIOMMU::getRoot(uint16_t DSid, Addr &root, bool &bypass) const
+{
+    if (!cp->getRoot(DSid, root, bypass)) {
+        // No page table set up for the DSid
+        root = 0;
+        bypass = defaultBypass;
+        return bypass;
+    }
+    return true;
+}
+
+PARDg5VIOMMU::IOTLBEntry *
+PARDg5VIOMMU::lookup(uint16_t DSid, Addr vpn)
+{
+    IOTLBEntry *entry = const_cast<IOTLBEntry *>(probe(DSid, vpn));
+    if (entry)
+        entry->lastUse = ++lruClock;
+    return entry;
+}
+
+const PARDg5VIOMMU::IOTLBEntry *
+PARDg5VIOMMU::probe(uint16_t DSid, Addr vpn) const
+{
+    // LDomains using the same DMA addresses land in different sets
+    unsigned set = (vpn ^ DSid) & (iotlbSets - 1);
+    const IOTLBEntry *ways = &iotlb[set * iotlbWays];
+    for (int i = 0; i < iotlbWays; i++) {
+        if (ways[i].valid && ways[i].DSid == DSid && ways[i].vpn == vpn)
+            return &ways[i];
+    }
+    return NULL;
+}
+
+void
+PARDg5VIOMMU::insert(uint16_t DSid, Addr vpn, Addr ppn, bool writable)
+{
+    unsigned set = (vpn ^ DSid) & (iotlbSets - 1);
+    IOTLBEntry *ways = &iotlb[set * iotlbWays];
+    IOTLBEntry *victim = const_cast<IOTLBEntry *>(probe(DSid, vpn));
+
+    // Refill a free way first, the least recently used otherwise
+    if (!victim) {
+        victim = &ways[0];
+        for (int i = 0; i < iotlbWays && victim->valid; i++) {
+            if (!ways[i].valid || ways[i].lastUse < victim->lastUse)
+                victim = &ways[i];
+        }
+        if (victim->valid)
+            iotlbEvictions++;
+    }
+
+    victim->valid = true;
+    victim->DSid = DSid;
+    victim->vpn = vpn;
+    victim->ppn = ppn;
+    victim->writable = writable;
+    victim->lastUse = ++lruClock;
+}
+
+void
+PARDg5VIOMMU::invalidate(unsigned scope, uint16_t DSid, Addr iova)
+{
+    if (scope > IOMMU_INV_PAGE) {
+        warn("%s: unknown invalidation scope %d, flushing all\n",
+             name(), scope);
+        scope = IOMMU_INV_GLOBAL;
+    }
+
+    // Large pages are cached as 4kB entries, they are invalidated a
+    // 4kB page at a time or by DSid
+    Addr vpn = iova >> PageShift;
+    DPRINTF(PARDg5VIOMMU, "invalidate scope %d DSid %d vpn %#x\n",
+            scope, DSid, vpn);
+
+    for (auto &entry : iotlb) {
+        if (!entry.valid)
+            continue;
+        if (scope != IOMMU_INV_GLOBAL && entry.DSid != DSid)
+            continue;
+        if (scope == IOMMU_INV_PAGE && entry.vpn != vpn)
+            continue;
+        entry.valid = false;
+        iotlbInvalidations++;
+    }
+
+    // Walks in flight may have read the old entries, let them finish
+    // without caching their result
+    for (auto walk : walks) {
+        if (scope != IOMMU_INV_GLOBAL && walk->DSid != DSid)
+            continue;
+        if (scope == IOMMU_INV_PAGE && (walk->iova >> PageShift) != vpn)
+            continue;
+        walk->fill = false;
+    }
+}
+
+void
+PARDg5VIOMMU::countLookup(uint16_t DSid, bool hit)
+{
+    if (hit) {
+        iotlbHits++;
+        if (DSid < numLDoms)
+            ldomHits[DSid]++;
+    } else {
+        iotlbMisses++;
+        if (DSid < numLDoms)
+            ldomMisses[DSid]++;
+    }
+    cp->recordLookup(DSid, hit);
+}
+
+void
+PARDg5VIOMMU::countFault(uint16_t DSid, Addr iova)
+{
+    DPRINTF(PARDg5VIOMMU, "DMA fault DSid %d addr %#x\n", DSid, iova);
+    faults++;
+    cp->recordFault(DSid, iova);
+}
+
+PARDg5VIOMMU::PageWalk *
+PARDg5VIOMMU::findWalk(uint16_t DSid, Addr vpn) const
+{
+    for (auto walk : walks) {
+        if (walk->DSid == DSid && (walk->iova >> PageShift) == vpn)
+            return walk;
+    }
+    return NULL;
+}
+
+bool
+PARDg5VIOMMU::needsWalk(PacketPtr pkt) const
+{
+    uint16_t DSid = pkt->getDSid();
+    Addr vpn = pkt->getAddr() >> PageShift;
+    Addr root;
+    bool bypass;
+
+    if (!getRoot(DSid, root, bypass) || bypass ||
+        (pkt->getAddr() >> IOVA_BITS))
+        return false;
+    return !probe(DSid, vpn) && !findWalk(DSid, vpn);
+}
+
+void
+PARDg5VIOMMU::startWalk(PageWalk *walk, uint16_t DSid, Addr vpn, Addr root)
+{
+    walk->DSid = DSid;
+    walk->iova = vpn << PageShift;
+    walk->table = root & PTE_ADDR_MASK;
+    walk->level = Levels - 1;
+    walk->writable = true;
+    walk->fault = false;
+    walk->paddr = 0;
+    walk->fill = true;
+    walk->start = curTick();
+}
+
+Addr
+PARDg5VIOMMU::pteAddr(const PageWalk *walk) const
+{
+    unsigned shift = PageShift + LevelBits * walk->level;
+    return walk->table +
+           bits(walk->iova, shift + LevelBits - 1, shift) * sizeof(uint64_t);
+}
+
+bool
+PARDg5VIOMMU::stepWalk(PageWalk *walk, uint64_t pte)
+{
+    if (!(pte & PTE_P)) {
+        walk->fault = true;
+        return true;
+    }
+
+    // Every level has to allow writes for the page to be writable
+    walk->writable = walk->writable && (pte & PTE_W);
+
+    Addr base = pte & PTE_ADDR_MASK;
+    if (walk->level == 0 || ((pte & PTE_PS) && walk->level <= 2)) {
+        // 4kB, 2MB or 1GB page, the IOTLB holds its 4kB part in use
+        unsigned shift = PageShift + LevelBits * walk->level;
+        walk->paddr = (base & ~mask(shift)) | (walk->iova & mask(shift));
+        return true;
+    }
+
+    walk->table = base;
+    walk->level--;
+    return false;
+}
+
+void
+PARDg5VIOMMU::issueWalkRead(PageWalk *walk, Tick when)
+{
+    Request *req = new Request(pteAddr(walk), sizeof(uint64_t), 0, masterId);
+    // The page table lives in the memory of the DSid
+    req->setDSid(walk->DSid);
+
+    PacketPtr pkt = new Packet(req, MemCmd::ReadReq);
+    pkt->allocate();
+    pkt->pushSenderState(new WalkState(walk));
+
+    DPRINTF(PARDg5VIOMMU, "walk DSid %d vpn %#x level %d read %#x\n",
+            walk->DSid, walk->iova >> PageShift, walk->level,
+            pkt->getAddr());
+    walkReads++;
+    masterPort.queueRequest(pkt, when);
+}
+
+void
+PARDg5VIOMMU::recvWalkResp(PacketPtr pkt)
+{
+    WalkState *state = dynamic_cast<WalkState *>(pkt->popSenderState());
+    assert(state);
+    PageWalk *walk = state->walk;
+    delete state;
+
+    // A page table the DSid can't reach faults like a missing entry
+    uint64_t pte = pkt->isError() ? 0 : pkt->get<uint64_t>();
+    delete pkt->req;
+    delete pkt;
+
+    if (stepWalk(walk, pte))
+        finishWalk(walk);
+    else
+        issueWalkRead(walk, clockEdge());
+}
+
+void
+PARDg5VIOMMU::finishWalk(PageWalk *walk)
+{
+    walks.remove(walk);
+    walkLatency += curTick() - walk->start;
+
+    DPRINTF(PARDg5VIOMMU, "walk DSid %d vpn %#x done: %s %#x, %d waiting\n",
+            walk->DSid, walk->iova >> PageShift,
+            walk->fault ? "fault" : "page", walk->paddr,
+            walk->waiting.size());
+
+    if (!walk->fault && walk->fill)
+        insert(walk->DSid, walk->iova >> PageShift,
+               walk->paddr >> PageShift, walk->writable);
+
+    Tick when = clockEdge();
+    for (auto pkt : walk->waiting) {
+        held--;
+        bool denied = walk->fault || (pkt->isWrite() && !walk->writable);
+        forward(pkt, denied, walk->paddr | (pkt->getAddr() & mask(PageShift)),
+                when);
+    }
+    delete walk;
+
+    // The walker and the places of the waiting requests are free
+    slavePort.retryStalledReq();
+}
+
+void
+PARDg5VIOMMU::forward(PacketPtr pkt, bool fault, Addr paddr, Tick when)
+{
+    if (fault) {
+        countFault(pkt->getDSid(), pkt->getAddr());
+        faultRequest(pkt, when);
+        return;
+    }
+
+    // The response has to carry the address the device used
+    if (!pkt->memInhibitAsserted() && pkt->needsResponse())
+        pkt->pushSenderState(new TranslationState(pkt->getAddr()));
+    pkt->setAddr(paddr);
+    masterPort.queueRequest(pkt, when);
+}
+
+void
+PARDg5VIOMMU::faultRequest(PacketPtr pkt, Tick when)
+{
+    if (!pkt->memInhibitAsserted() && pkt->needsResponse()) {
+        // The slave port reserved room for the response when it took
+        // the request
+        pkt->makeResponse();
+        pkt->setBadAddress();
+        slavePort.schedTimingResp(pkt, when);
+    } else {
+        delete pkt;
+    }
+}
+
+void
+PARDg5VIOMMU::translateTiming(PacketPtr pkt, Tick when)
+{
+    uint16_t DSid = pkt->getDSid();
+    Addr iova = pkt->getAddr();
+    Addr root;
+    bool bypass;
+
+    if (!getRoot(DSid, root, bypass)) {
+        countFault(DSid, iova);
+        faultRequest(pkt, when);
+        return;
+    }
+    if (bypass) {
+        masterPort.queueRequest(pkt, when);
+        return;
+    }
+
+    // DMA engines split transfers at burst boundaries, a packet never
+    // spans two pages
+    panic_if((iova >> PageShift) != ((iova + pkt->getSize() - 1) >> PageShift),
+             "%s: DMA packet %#x size %d crosses a page\n",
+             name(), iova, pkt->getSize());
+
+    when += iotlbLatency * clockPeriod();
+    if (iova >> IOVA_BITS) {
+        countFault(DSid, iova);
+        faultRequest(pkt, when);
+        return;
+    }
+
+    Addr vpn = iova >> PageShift;
+    IOTLBEntry *entry = lookup(DSid, vpn);
+    countLookup(DSid, entry != NULL);
+    if (entry) {
+        forward(pkt, pkt->isWrite() && !entry->writable,
+                (entry->ppn << PageShift) | (iova & mask(PageShift)), when);
+        return;
+    }
+
+    // Misses to a page under walk wait for that walk
+    PageWalk *walk = findWalk(DSid, vpn);
+    if (walk) {
+        coalescedMisses++;
+    } else {
+        assert(walks.size() < numWalkers);
+        walk = new PageWalk;
+        startWalk(walk, DSid, vpn, root);
+        walks.push_back(walk);
+        walksStarted++;
+        issueWalkRead(walk, when);
+    }
+    walk->waiting.push_back(pkt);
+    held++;
+}
+
+bool
+PARDg5VIOMMU::translateNow(uint16_t DSid, Addr iova, bool write,
+                           bool functional, Addr &paddr, Tick &lat)
+{
+    Addr root;
+    bool bypass;
+
+    if (!getRoot(DSid, root, bypass))
+        return false;
+    if (bypass) {
+        paddr = iova;
+        return true;
+    }
+    if (iova >> IOVA_BITS)
+        return false;
+
+    // Functional accesses leave IOTLB and stats as they are
+    Addr vpn = iova >> PageShift;
+    const IOTLBEntry *entry = functional ? probe(DSid, vpn) :
+                                           lookup(DSid, vpn);
+    if (!functional) {
+        countLookup(DSid, entry != NULL);
+        lat += iotlbLatency * clockPeriod();
+    }
+    if (entry) {
+        paddr = (entry->ppn << PageShift) | (iova & mask(PageShift));
+        return !(write && !entry->writable);
+    }
+
+    PageWalk walk;
+    startWalk(&walk, DSid, vpn, root);
+    uint64_t pte;
+    do {
+        Request req(pteAddr(&walk), sizeof(uint64_t), 0, masterId);
+        req.setDSid(DSid);
+        Packet pkt(&req, MemCmd::ReadReq);
+        uint64_t data = 0;
+        pkt.dataStatic(&data);
+
+        if (functional) {
+            masterPort.sendFunctional(&pkt);
+        } else {
+            lat += masterPort.sendAtomic(&pkt);
+            walkReads++;
+        }
+        pte = pkt.isError() ? 0 : pkt.get<uint64_t>();
+    } while (!stepWalk(&walk, pte));
+
+    if (!functional) {
+        walksStarted++;
+        if (!walk.fault)
+            insert(DSid, vpn, walk.paddr >> PageShift, walk.writable);
+    }
+    if (walk.fault)
+        return false;
+
+    paddr = walk.paddr | (iova & mask(PageShift));
+    return !(write && !walk.writable);
+}
+
+Tick
+PARDg5VIOMMU::IOMMUSlavePort::recvAtomic(PacketPtr pkt)
+{
+    Addr iova = pkt->getAddr();
+    Addr paddr;
+    Tick lat = 0;
+
+    if (!iommu.translateNow(pkt->getDSid(), iova, pkt->isWrite(), false,
+                            paddr, lat)) {
+        iommu.countFault(pkt->getDSid(), iova);
+        if (pkt->needsResponse()) {
+            pkt->makeAtomicResponse();
+            pkt->setBadAddress();
+        }
+        return lat;
+    }
+
+    pkt->setAddr(paddr);
+    lat += BridgeSlavePort::recvAtomic(pkt);
+    pkt->setAddr(iova);
+    return lat;
+}
+
+void
+PARDg5VIOMMU::IOMMUSlavePort::recvFunctional(PacketPtr pkt)
+{
+    Addr iova = pkt->getAddr();
+    Addr paddr;
+    Tick lat = 0;
+
+    if (!iommu.translateNow(pkt->getDSid(), iova, pkt->isWrite(), true,
+                            paddr, lat)) {
+        DPRINTF(PARDg5VIOMMU, "functional %s DSid %d addr %#x faults\n",
+                pkt->cmdString(), pkt->getDSid(), iova);
+        return;
+    }
+
+    pkt->setAddr(paddr);
+    BridgeSlavePort::recvFunctional(pkt);
+    pkt->setAddr(iova);
+}
+
+bool
+PARDg5VIOMMU::IOMMUMasterPort::reqQueueFull() const
+{
+    return transmitList.size() + iommu.held >= reqQueueLimit;
+}
+
+bool
+PARDg5VIOMMU::IOMMUMasterPort::reqQueueFull(PacketPtr pkt) const
+{
+    if (reqQueueFull())
+        return true;
+    return iommu.needsWalk(pkt) && iommu.walks.size() >= iommu.numWalkers;
+}
+
+void
+PARDg5VIOMMU::IOMMUMasterPort::schedTimingReq(PacketPtr pkt, Tick when)
+{
+    // If we expect to see a response, we need to restore the source
+    // and destination field that is potentially changed by a second
+    // crossbar
+    if (!pkt->memInhibitAsserted() && pkt->needsResponse()) {
+        // Update the sender state so we can deal with the response
+        // appropriately
+        pkt->pushSenderState(new RequestState(pkt->getSrc()));
+    }
+
+    iommu.translateTiming(pkt, when);
+}
+
+void
+PARDg5VIOMMU::IOMMUMasterPort::queueRequest(PacketPtr pkt, Tick when)
+{
+    // Requests leave in the order they were translated
+    if (transmitList.empty())
+        iommu.schedule(sendEvent, when);
+    else
+        when = std::max(when, transmitList.back().tick);
+
+    transmitList.push_back(DeferredPacket(pkt, when));
+}
+
+bool
+PARDg5VIOMMU::IOMMUMasterPort::recvTimingResp(PacketPtr pkt)
+{
+    if (dynamic_cast<WalkState *>(pkt->senderState)) {
+        iommu.recvWalkResp(pkt);
+        return true;
+    }
+
+    TranslationState *state =
+        dynamic_cast<TranslationState *>(pkt->senderState);
+    if (state) {
+        pkt->popSenderState();
+        pkt->setAddr(state->iova);
+        delete state;
+    }
+
+    return BridgeMasterPort::recvTimingResp(pkt);
+}
+
+PARDg5VIOMMU *
+PARDg5VIOMMUParams::create()
+{
+    return new PARDg5VIOMMU(this);
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/**
+ * @file
+ * Declaration of a DSid-aware IOMMU for PARDg5-V device DMA.
+ */
+
+#ifndef __DEV_PARDG5V_IOMMU_HH__
+#define __DEV_PARDG5V_IOMMU_HH__
+
+#include <list>
+#include <vector>
+
+#include "base/statistics.hh"
+#include "ext/xbridge.hh"
+#include "params/PARDg5VIOMMU.hh"
+
+class PARDg5VIOMMUCP;
+
+/**
+ * IOMMU between the IOHub and memory. Every DSid has its own I/O page
+ * table in its own memory, x86-64 long mode layout with 4kB, 2MB and
+ * 1GB pages, set up through the control plane. Translations of 4kB
+ * pages are cached in a set-associative IOTLB tagged by DSid. A miss
+ * walks the page table with reads carrying the DSid, so they go
+ * through the memory partition of that DSid like any other access.
+ *
+ * DMA of a DSid without a page table is passed through untranslated
+ * or faults, depending on default_bypass. Faulting reads and writes
+ * get an error response and are not forwarded.
+ */
+class PARDg5VIOMMU : public XBridge
+{
+  protected:
+
+    static const unsigned PageShift = 12;
+    static const unsigned LevelBits = 9;
+    static const unsigned Levels = 4;
+
+    class IOMMUSlavePort : public BridgeSlavePort
+    {
+      private:
+        PARDg5VIOMMU &iommu;
+
+      public:
+        IOMMUSlavePort(const std::string &_name, PARDg5VIOMMU &_iommu,
+                       BridgeMasterPort& _masterPort, Cycles _delay,
+                       int _resp_limit, std::vector<AddrRange> _ranges)
+            : BridgeSlavePort(_name, _iommu, _masterPort, _delay,
+                              _resp_limit, _ranges),
+              iommu(_iommu)
+        { }
+
+      protected:
+        virtual Tick recvAtomic(PacketPtr pkt);
+        virtual void recvFunctional(PacketPtr pkt);
+    };
+
+    class IOMMUMasterPort : public BridgeMasterPort
+    {
+      private:
+        PARDg5VIOMMU &iommu;
+
+      public:
+        IOMMUMasterPort(const std::string &_name, PARDg5VIOMMU &_iommu,
+                        BridgeSlavePort& _slavePort, Cycles _delay,
+                        int _req_limit)
+            : BridgeMasterPort(_name, _iommu, _slavePort, _delay,
+                               _req_limit),
+              iommu(_iommu)
+        { }
+
+        /**
+         * Requests waiting for a walk hold a place in the queue, and a
+         * miss needs a free walker unless its page is walked already.
+         * @{
+         */
+        virtual bool reqQueueFull() const;
+        virtual bool reqQueueFull(PacketPtr pkt) const;
+        /** @} */
+
+        /** Translate pkt, it goes out once the translation is known */
+        virtual void schedTimingReq(PacketPtr pkt, Tick when);
+
+        /** Queue a translated request or a page table read */
+        void queueRequest(PacketPtr pkt, Tick when);
+
+      protected:
+        virtual bool recvTimingResp(PacketPtr pkt);
+    };
+
+    /** Original DMA address of a translated request */
+    class TranslationState : public Packet::SenderState
+    {
+      public:
+        const Addr iova;
+        TranslationState(Addr _iova) : iova(_iova) { }
+    };
+
+    struct IOTLBEntry
+    {
+        bool valid;
+        uint16_t DSid;
+        Addr vpn;
+        Addr ppn;
+        bool writable;
+        uint64_t lastUse;
+    };
+
+    struct PageWalk
+    {
+        uint16_t DSid;
+        Addr iova;
+        Addr table;
+        int level;
+        bool writable;
+        bool fault;
+        Addr paddr;
+        /** Cleared by an invalidation while the walk is in flight */
+        bool fill;
+        Tick start;
+        /** Requests to the page, in arrival order */
+        std::vector<PacketPtr> waiting;
+    };
+
+    /** Page table read of a walk */
+    class WalkState : public Packet::SenderState
+    {
+      public:
+        PageWalk *walk;
+        WalkState(PageWalk *_walk) : walk(_walk) { }
+    };
+
+    IOMMUSlavePort slavePort;
+    IOMMUMasterPort masterPort;
+
+    /** Control plane, holds the page table root of each DSid */
+    PARDg5VIOMMUCP *cp;
+
+    /** Master ID of page table reads */
+    const MasterID masterId;
+
+    const bool defaultBypass;
+    const Cycles iotlbLatency;
+    const unsigned numWalkers;
+
+    const unsigned iotlbSets;
+    const unsigned iotlbWays;
+    std::vector<IOTLBEntry> iotlb;
+    uint64_t lruClock;
+
+    std::list<PageWalk *> walks;
+    /** Requests parked on walks */
+    unsigned held;
+
+    /** LDomains tracked by the per-DSid statistics */
+    const unsigned numLDoms;
+
+    Stats::Scalar iotlbHits;
+    Stats::Scalar iotlbMisses;
+    Stats::Formula iotlbHitRate;
+    Stats::Vector ldomHits;
+    Stats::Vector ldomMisses;
+    Stats::Scalar iotlbEvictions;
+    Stats::Scalar iotlbInvalidations;
+    Stats::Scalar walksStarted;
+    Stats::Scalar walkReads;
+    Stats::Scalar coalescedMisses;
+    Stats::Scalar walkLatency;
+    Stats::Formula avgWalkLatency;
+    Stats::Scalar faults;
+
+  protected:
+
+    IOTLBEntry *lookup(uint16_t DSid, Addr vpn);
+    const IOTLBEntry *probe(uint16_t DSid, Addr vpn) const;
+    void insert(uint16_t DSid, Addr vpn, Addr ppn, bool writable);
+
+    /**
+     * Page table root of DSid, bypass if its DMA is not translated.
+     * @return false if DMA of DSid is not allowed
+     */
+    bool getRoot(uint16_t DSid, Addr &root, bool &bypass) const;
+
+    PageWalk *findWalk(uint16_t DSid, Addr vpn) const;
+
+    /** pkt misses in the IOTLB and no walk of its page is running */
+    bool needsWalk(PacketPtr pkt) const;
+
+    void startWalk(PageWalk *walk, uint16_t DSid, Addr vpn, Addr root);
+
+    /** Address of the page table entry the walk reads next */
+    Addr pteAddr(const PageWalk *walk) const;
+
+    /**
+     * Apply a page table entry read by walk.
+     * @return true once the walk reached a page or faulted
+     */
+    bool stepWalk(PageWalk *walk, uint64_t pte);
+
+    /** Timing walks */
+    void issueWalkRead(PageWalk *walk, Tick when);
+    void recvWalkResp(PacketPtr pkt);
+    void finishWalk(PageWalk *walk);
+
+    /** Record lookups and faults in stats and control plane */
+    void countLookup(uint16_t DSid, bool hit);
+    void countFault(uint16_t DSid, Addr iova);
+
+    /** Send pkt to its translated address, or fault it */
+    void forward(PacketPtr pkt, bool fault, Addr paddr, Tick when);
+    void faultRequest(PacketPtr pkt, Tick when);
+
+    /**
+     * Translate without timing, page table reads are atomic or
+     * functional accesses.
+     * @return false on a fault
+     */
+    bool translateNow(uint16_t DSid, Addr iova, bool write, bool functional,
+                      Addr &paddr, Tick &lat);
+
+    /** Timing translation of a request accepted by the slave port */
+    void translateTiming(PacketPtr pkt, Tick when);
+
+  public:
+
+    /**
+     * Drop IOTLB entries, called by the control plane.
+     * @param scope IOMMU_INV_GLOBAL, IOMMU_INV_DSID or IOMMU_INV_PAGE
+     */
+    void invalidate(unsigned scope, uint16_t DSid, Addr iova);
+
+    virtual BaseMasterPort& getMasterPort(const std::string& if_name,
+                                          PortID idx = InvalidPortID);
+    virtual BaseSlavePort& getSlavePort(const std::string& if_name,
+                                        PortID idx = InvalidPortID);
+
+    virtual void init();
+    virtual void regStats();
+
+    typedef PARDg5VIOMMUParams Params;
+
+    PARDg5VIOMMU(Params *p);
+    virtual ~PARDg5VIOMMU();
+};
+
+#endif  // __DEV_PARDG5V_IOMMU_HH__
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+#include "debug/ControlPlane.hh"
+#include "dev/pard/iommu.hh"
+#include "dev/pard/iommu_cp.hh"
+#include "sim/serialize.hh"
+
+PARDg5VIOMMUCP::PARDg5VIOMMUCP(const Params *p)
+    : ControlPlane(p),
+      param_table_entries(p->param_table_entries),
+      stat_table_entries(p->param_table_entries),
+      iommu(NULL)
+{
+    memset(&iommuInfo, 0, sizeof(iommuInfo));
+
+    // Allocate ConfigTable
+    paramTable = new struct IOMMUParamEntry[param_table_entries];
+    statTable  = new struct IOMMUStatEntry[stat_table_entries];
+    memset(paramTable, 0,
+           sizeof(struct IOMMUParamEntry) * param_table_entries);
+    memset(statTable, 0,
+           sizeof(struct IOMMUStatEntry) * stat_table_entries);
+
+    // Per-DSid counters, updated for every DMA packet
+    missesCounter = registerCounter("iotlb_misses");
+    faultsCounter = registerCounter("iommu_faults");
+}
+
+PARDg5VIOMMUCP::~PARDg5VIOMMUCP()
+{
+    delete[] statTable;
+    delete[] paramTable;
+}
+
+void
+PARDg5VIOMMUCP::regIOMMU(PARDg5VIOMMU *_iommu, unsigned sets, unsigned ways)
+{
+    panic_if(iommu, "%s already reg to %s\n", name(), iommu->name());
+    iommu = _iommu;
+    iommuInfo.iotlb_sets = sets;
+    iommuInfo.iotlb_ways = ways;
+}
+
+int
+PARDg5VIOMMUCP::findRow(uint16_t DSid) const
+{
+    for (int i = 0; i < param_table_entries; i++) {
+        if ((paramTable[i].flags & IOMMU_FLAG_VALID) &&
+            paramTable[i].DSid == DSid)
+            return i;
+    }
+    return -1;
+}
+
+bool
+PARDg5VIOMMUCP::getRoot(uint16_t DSid, Addr &root, bool &bypass) const
+{
+    int row = findRow(DSid);
+    if (row < 0)
+        return false;
+    root = paramTable[row].root & ~ULL(0xFFF);
+    bypass = paramTable[row].flags & IOMMU_FLAG_BYPASS;
+    return true;
+}
+
+void
+PARDg5VIOMMUCP::recordLookup(uint16_t DSid, bool hit)
+{
+    int row = findRow(DSid);
+    if (row >= 0) {
+        IOMMUStatEntry &stat = statTable[row];
+        stat.flags = IOMMU_FLAG_VALID;
+        stat.DSid = DSid;
+        if (hit)
+            stat.hits++;
+        else
+            stat.misses++;
+    }
+    if (!hit)
+        incrCounter(DSid, missesCounter, 1);
+}
+
+void
+PARDg5VIOMMUCP::recordFault(uint16_t DSid, Addr addr)
+{
+    int row = findRow(DSid);
+    if (row >= 0) {
+        IOMMUStatEntry &stat = statTable[row];
+        stat.flags = IOMMU_FLAG_VALID;
+        stat.DSid = DSid;
+        stat.faults++;
+        stat.fault_addr = addr;
+    }
+    incrCounter(DSid, faultsCounter, 1);
+}
+
+uint64_t
+PARDg5VIOMMUCP::queryTable(uint16_t DSid, uint32_t addr)
+{
+    uint64_t *pdata;
+    DPRINTF(ControlPlane, "queryTable(DSid=%d, addr=0x%x)\n",
+            DSid, addr);
+
+    pdata = parseAddr(addr);
+    if (!pdata) {
+        warn("PARDg5VIOMMUCP: unknown addr 0x%x", addr);
+        return 0xFFFFFFFFFFFFFFFF;
+    }
+    return *pdata;
+}
+
+void
+PARDg5VIOMMUCP::updateTable(uint16_t DSid, uint32_t addr, uint64_t data)
+{
+    uint64_t *pdata;
+
+    DPRINTF(ControlPlane, "updateTable(DSid=%d, addr=0x%x, data=0x%x)\n",
+            DSid, addr, data);
+
+    pdata = parseAddr(addr);
+    if (!pdata) {
+        warn("PARDg5VIOMMUCP: unknown addr 0x%x", addr);
+        return;
+    }
+
+    bool param = (char *)pdata >= (char *)paramTable &&
+                 (char *)pdata < (char *)&paramTable[param_table_entries];
+    bool command = (char *)pdata >= (char *)&iommuInfo.inv_addr &&
+                   (char *)pdata < (char *)&iommuInfo + sizeof(iommuInfo);
+    if (!param && !command) {
+        // stat table and IOTLB geometry are read-only
+        warn("PARDg5VIOMMUCP: write to read-only addr 0x%x", addr);
+        return;
+    }
+
+    if (param) {
+        int row = ((char *)pdata - (char *)paramTable) /
+                  sizeof(struct IOMMUParamEntry);
+        uint16_t old_DSid = paramTable[row].DSid;
+        *pdata = data;
+
+        // Translations of the old and the new owner of the row may both
+        // be stale now
+        iommu->invalidate(IOMMU_INV_DSID, old_DSid, 0);
+        iommu->invalidate(IOMMU_INV_DSID, paramTable[row].DSid, 0);
+
+        // A new owner of the row starts with fresh statistics
+        if (statTable[row].DSid != paramTable[row].DSid ||
+            !(paramTable[row].flags & IOMMU_FLAG_VALID))
+            memset(&statTable[row], 0, sizeof(struct IOMMUStatEntry));
+        return;
+    }
+
+    *pdata = data;
+    if (pdata == &iommuInfo.inv_cmd) {
+        iommu->invalidate(bits(data, 17, 16), bits(data, 15, 0),
+                          iommuInfo.inv_addr);
+    }
+}
+
+int
+PARDg5VIOMMUCP::snapshotStats(uint16_t DSid, uint8_t *buf, int size)
+{
+    int row = findRow(DSid);
+    if (row < 0)
+        return 0;
+    return copyStatRow(&statTable[row], sizeof(struct IOMMUStatEntry),
+                       buf, size);
+}
+
+uint64_t *
+PARDg5VIOMMUCP::parseAddr(uint32_t addr)
+{
+    char *ptr = NULL;
+    int offset;
+
+    switch (addr & ADDRTYPE_MASK) {
+    // Access ConfigTable
+    case ADDRTYPE_CFGTBL:
+        {
+            int row = cfgtbl_addr2row(addr);
+            offset = cfgtbl_addr2offset(addr);
+
+            switch (cfgtbl_addr2type(addr)) {
+              case CFGTBL_TYPE_PARAM:
+                if ((row < param_table_entries) &&
+                    (offset <= sizeof(struct IOMMUParamEntry) -
+                               sizeof(uint64_t)))
+                    ptr = (char *)&paramTable[row];
+                break;
+              case CFGTBL_TYPE_STAT:
+                if ((row < stat_table_entries) &&
+                    (offset <= sizeof(struct IOMMUStatEntry) -
+                               sizeof(uint64_t)))
+                    ptr = (char *)&statTable[row];
+                break;
+            }
+        }
+        break;
+    // Access IOTLB info and invalidation registers
+    case ADDRTYPE_SYSINFO:
+        offset = sysinfo_addr2offset(addr);
+        if (offset <= sizeof(iommuInfo) - sizeof(uint64_t))
+            ptr = (char *)&iommuInfo;
+        break;
+    }
+
+    return (ptr ? ((uint64_t *)(ptr + offset)) : NULL);
+}
+
+void
+PARDg5VIOMMUCP::serialize(std::ostream &os)
+{
+    arrayParamOut(os, "paramTable", (uint8_t *)paramTable,
+                  sizeof(struct IOMMUParamEntry) * param_table_entries);
+    arrayParamOut(os, "statTable", (uint8_t *)statTable,
+                  sizeof(struct IOMMUStatEntry) * stat_table_entries);
+    arrayParamOut(os, "iommuInfo", (uint8_t *)&iommuInfo,
+                  sizeof(iommuInfo));
+}
+
+void
+PARDg5VIOMMUCP::unserialize(Checkpoint *cp, const std::string &section)
+{
+    arrayParamIn(cp, section, "paramTable", (uint8_t *)paramTable,
+                 sizeof(struct IOMMUParamEntry) * param_table_entries);
+    arrayParamIn(cp, section, "statTable", (uint8_t *)statTable,
+                 sizeof(struct IOMMUStatEntry) * stat_table_entries);
+    arrayParamIn(cp, section, "iommuInfo", (uint8_t *)&iommuInfo,
+                 sizeof(iommuInfo));
+}
+
+PARDg5VIOMMUCP *
+PARDg5VIOMMUCPParams::create()
+{
+    return new PARDg5VIOMMUCP(this);
+}
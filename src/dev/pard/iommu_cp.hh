@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/**
+ * @file
+ * Declaration of PARDg5-V IOMMU control plane.
+ *
+ * Each param table row points the DMA of one DSid to the root of its
+ * I/O page table, an address in that DSid's own memory. The stat table
+ * row with the same index reports its IOTLB behaviour and faults.
+ * Writing inv_cmd in the system info invalidates IOTLB entries.
+ */
+
+#ifndef __DEV_PARDG5V_IOMMU_CP_HH__
+#define __DEV_PARDG5V_IOMMU_CP_HH__
+
+#include "params/PARDg5VIOMMUCP.hh"
+#include "prm/ControlPlane.hh"
+
+class PARDg5VIOMMU;
+
+/**
+ * Param Table
+ */
+struct IOMMUParamEntry {
+    uint16_t flags;
+    uint16_t DSid;
+    uint32_t __padding;
+    uint64_t root;          // I/O page table root, 4kB aligned
+};
+#define IOMMU_FLAG_VALID	0x0001
+#define IOMMU_FLAG_BYPASS	0x0002  // DMA addresses are not translated
+
+/**
+ * Stat Table, same row as param table
+ */
+struct IOMMUStatEntry {
+    uint16_t flags;
+    uint16_t DSid;
+    uint32_t __padding;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t faults;
+    uint64_t fault_addr;    // DMA address of the last fault
+};
+
+/**
+ * SystemInfo Table, inv_addr and inv_cmd are writable
+ */
+struct IOMMUInfo {
+    uint32_t iotlb_sets;
+    uint32_t iotlb_ways;
+    uint64_t inv_addr;      // DMA address of a page invalidation
+    uint64_t inv_cmd;       // [15:0] DSid, [17:16] scope
+};
+#define IOMMU_INV_GLOBAL	0
+#define IOMMU_INV_DSID		1
+#define IOMMU_INV_PAGE		2
+
+class PARDg5VIOMMUCP : public ControlPlane
+{
+  protected:
+    int param_table_entries;
+    int stat_table_entries;
+
+    struct IOMMUParamEntry *paramTable;
+    struct IOMMUStatEntry *statTable;
+    struct IOMMUInfo iommuInfo;
+
+    PARDg5VIOMMU *iommu;
+
+    /** Counter indexes, see ControlPlane::registerCounter() */
+    int missesCounter;
+    int faultsCounter;
+
+  public:
+    typedef PARDg5VIOMMUCPParams Params;
+    PARDg5VIOMMUCP(const Params *p);
+    ~PARDg5VIOMMUCP();
+
+    void regIOMMU(PARDg5VIOMMU *_iommu, unsigned sets, unsigned ways);
+
+  public:
+    /**
+     * Page table root of DSid.
+     * @return false without a valid row
+     */
+    bool getRoot(uint16_t DSid, Addr &root, bool &bypass) const;
+
+    /** Called by the IOMMU for every translated DMA packet */
+    void recordLookup(uint16_t DSid, bool hit);
+    void recordFault(uint16_t DSid, Addr addr);
+
+    virtual uint64_t queryTable(uint16_t DSid, uint32_t addr);
+    virtual void updateTable(uint16_t DSid, uint32_t addr, uint64_t data);
+    virtual int snapshotStats(uint16_t DSid, uint8_t *buf, int size);
+
+    virtual void serialize(std::ostream &os);
+    virtual void unserialize(Checkpoint *cp, const std::string &section);
+
+  private:
+    uint64_t *parseAddr(uint32_t addr);
+    int findRow(uint16_t DSid) const;
+};
+
+#endif	// __DEV_PARDG5V_IOMMU_CP_HH__
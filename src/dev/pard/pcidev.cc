@@ -56,8 +56,10 @@
 #include "base/intmath.hh"
 #include "base/misc.hh"
 #include "base/str.hh"
+#include "arch/x86/intmessage.hh"
 #include "base/trace.hh"
 #include "debug/PCIDEV.hh"
+#include "dev/cellx/cellx.hh"
 #include "dev/alpha/tsunamireg.h"
 #include "dev/pard/pcidev.hh"
 #include "dev/pciconfigall.hh"
@@ -97,7 +99,7 @@ PARDg5VPciDevice::PciConfigPort::getAddrRanges() const
 
 
 PARDg5VPciDevice::PARDg5VPciDevice(const Params *p)
-    : PARDg5VDmaDevice(p),
+    : PARDg5VDmaDevice(p), IntDevice(this, p->msi_latency),
       PMCAP_BASE(p->PMCAPBaseOffset),
       PMCAP_ID_OFFSET(p->PMCAPBaseOffset+PMCAP_ID),
       PMCAP_PC_OFFSET(p->PMCAPBaseOffset+PMCAP_PC),
@@ -109,6 +111,9 @@ PARDg5VPciDevice::PARDg5VPciDevice(const Params *p)
       MSIXCAP_MTAB_OFFSET(p->MSIXCAPBaseOffset+MSIXCAP_MTAB),
       MSIXCAP_MPBA_OFFSET(p->MSIXCAPBaseOffset+MSIXCAP_MPBA),
       PXCAP_BASE(p->PXCAPBaseOffset),
+      vfs(p->num_vfs),
+      msiRouter(p->system),
+      msiLatency(p->msi_latency),
       platform(p->platform),
       pioDelay(p->pio_latency),
       configDelay(p->config_latency),
@@ -246,6 +251,9 @@ PARDg5VPciDevice::PARDg5VPciDevice(const Params *p)
 
     platform->registerPciDevice(p->pci_bus, p->pci_dev, p->pci_func,
             letoh(config.interruptLine));
+
+    for (auto &vf : vfs)
+        vf.valid = false;
 }
 
 void
@@ -257,11 +265,94 @@ PARDg5VPciDevice::init()
    PARDg5VDmaDevice::init();
 }
 
+void
+PARDg5VPciDevice::regStats()
+{
+    PARDg5VDmaDevice::regStats();
+
+    if (vfs.empty())
+        return;
+
+    vfConfigAccesses
+        .init(vfs.size())
+        .name(name() + ".vfConfigAccesses")
+        .desc("Config space accesses of each VF")
+        .flags(Stats::total)
+        ;
+    vfMsixAccesses
+        .init(vfs.size())
+        .name(name() + ".vfMsixAccesses")
+        .desc("MSI-X table and PBA accesses of each VF")
+        .flags(Stats::total)
+        ;
+    vfInterrupts
+        .init(vfs.size())
+        .name(name() + ".vfInterrupts")
+        .desc("Interrupts posted by each VF")
+        .flags(Stats::total)
+        ;
+}
+
+int
+PARDg5VPciDevice::findVF(uint16_t DSid) const
+{
+    for (int i = 0; i < vfs.size(); i++) {
+        if (vfs[i].valid && vfs[i].DSid == DSid)
+            return i;
+    }
+    return -1;
+}
+
+bool
+PARDg5VPciDevice::attachVF(uint16_t DSid)
+{
+    if (findVF(DSid) >= 0)
+        return true;
+
+    for (int i = 0; i < vfs.size(); i++) {
+        VirtualFunction &vf = vfs[i];
+        if (vf.valid)
+            continue;
+
+        // A fresh function, decoding nothing until the guest enables it
+        vf.valid = true;
+        vf.DSid = DSid;
+        vf.config = config;
+        vf.config.command = 0;
+        vf.msicap = msicap;
+        vf.msixcap = msixcap;
+        dsidCaps.erase(DSid);
+        msixTables.erase(DSid);
+        msixPbas.erase(DSid);
+
+        DPRINTF(PCIDEV, "Attach VF%d to DSid %d\n", i, DSid);
+        vfEnable(i);
+        return true;
+    }
+    return false;
+}
+
+void
+PARDg5VPciDevice::detachVF(uint16_t DSid)
+{
+    int vf = findVF(DSid);
+    if (vf < 0)
+        return;
+
+    DPRINTF(PCIDEV, "Detach VF%d from DSid %d\n", vf, DSid);
+    vfDisable(vf);
+    vfs[vf].valid = false;
+    dsidCaps.erase(DSid);
+    msixTables.erase(DSid);
+    msixPbas.erase(DSid);
+}
+
 unsigned int
 PARDg5VPciDevice::drain(DrainManager *dm)
 {
     unsigned int count;
-    count = pioPort.drain(dm) + dmaPort.drain(dm) + configPort.drain(dm);
+    count = pioPort.drain(dm) + dmaPort.drain(dm) + configPort.drain(dm)
+          + intMasterPort.drain(dm);
     if (count)
         setDrainState(Drainable::Draining);
     else
@@ -273,6 +364,17 @@ Tick
 PARDg5VPciDevice::readConfig(PacketPtr pkt)
 {
     int offset = pkt->getAddr() & PCI_CONFIG_SIZE;
+    PCIConfig &config = getConfig(pkt->getDSid());
+
+    int vf = findVF(pkt->getDSid());
+    if (vf >= 0)
+        vfConfigAccesses[vf]++;
+
+    /* Access to MSI/MSI-X CAP */
+    if (readCapability(pkt, offset)) {
+        pkt->makeAtomicResponse();
+        return configDelay;
+    }
 
     /* Return 0 for accesses to unimplemented PCI configspace areas */
     if (offset >= PCI_DEVICE_SPECIFIC &&
@@ -341,6 +443,17 @@ Tick
 PARDg5VPciDevice::writeConfig(PacketPtr pkt)
 {
     int offset = pkt->getAddr() & PCI_CONFIG_SIZE;
+    PCIConfig &config = getConfig(pkt->getDSid());
+
+    int vf = findVF(pkt->getDSid());
+    if (vf >= 0)
+        vfConfigAccesses[vf]++;
+
+    /* Access to MSI/MSI-X CAP */
+    if (writeCapability(pkt, offset)) {
+        pkt->makeAtomicResponse();
+        return configDelay;
+    }
 
     /* No effect if we write to config space that is not implemented*/
     if (offset >= PCI_DEVICE_SPECIFIC &&
@@ -431,6 +544,8 @@ PARDg5VPciDevice::writeConfig(PacketPtr pkt)
                         he_new_bar = ~(BARSize[barnum] - 1);
                     } else {
                         // does it mean something special to write 0 to a BAR?
+                        // VFs share the BARs, IOHub gives them all the
+                        // same address
                         he_new_bar &= ~bar_mask;
                         if (he_new_bar) {
                             BARAddrs[barnum] = BAR_IO_SPACE(he_old_bar) ?
@@ -474,6 +589,392 @@ PARDg5VPciDevice::writeConfig(PacketPtr pkt)
     return configDelay;
 }
 
+bool
+PARDg5VPciDevice::readCapability(PacketPtr pkt, int offset)
+{
+    uint8_t *cap_data;
+    MSICAP &msicap = getMsiCap(pkt->getDSid());
+    MSIXCAP &msixcap = getMsixCap(pkt->getDSid());
+
+    if (MSICAP_BASE && offset >= MSICAP_BASE &&
+        offset + pkt->getSize() <= MSICAP_BASE + MSICAP_MPEND + 4) {
+        cap_data = &msicap.data[offset - MSICAP_BASE];
+    } else if (MSIXCAP_BASE && offset >= MSIXCAP_BASE &&
+        offset + pkt->getSize() <= MSIXCAP_BASE + MSIXCAP_MPBA + 4) {
+        cap_data = &msixcap.data[offset - MSIXCAP_BASE];
+    } else {
+        return false;
+    }
+
+    switch (pkt->getSize()) {
+      case sizeof(uint8_t):
+        pkt->set<uint8_t>(*cap_data);
+        break;
+      case sizeof(uint16_t):
+        pkt->set<uint16_t>(*(uint16_t *)cap_data);
+        break;
+      case sizeof(uint32_t):
+        pkt->set<uint32_t>(*(uint32_t *)cap_data);
+        break;
+      default:
+        panic("invalid access size(?) for PCI capability!\n");
+    }
+    DPRINTF(PCIDEV, "readCapability: dev %#x func %#x reg %#x %d bytes\n",
+            params()->pci_dev, params()->pci_func, offset, pkt->getSize());
+    return true;
+}
+
+bool
+PARDg5VPciDevice::writeCapability(PacketPtr pkt, int offset)
+{
+    uint8_t *cap_data;
+    MSICAP &msicap = getMsiCap(pkt->getDSid());
+    MSIXCAP &msixcap = getMsixCap(pkt->getDSid());
+
+    // Capability ID and next pointer are read only, so are MSI-X Table
+    // and PBA offsets. Only enable/mask bits of message control and the
+    // message address/data/mask registers are writable.
+    uint16_t old_mid = msicap.mid;
+    uint16_t old_mc = msicap.mc;
+    uint16_t old_mxid = msixcap.mxid;
+    uint16_t old_mxc = msixcap.mxc;
+    uint32_t old_mtab = msixcap.mtab;
+    uint32_t old_mpba = msixcap.mpba;
+
+    if (MSICAP_BASE && offset >= MSICAP_BASE &&
+        offset + pkt->getSize() <= MSICAP_BASE + MSICAP_MPEND + 4) {
+        cap_data = &msicap.data[offset - MSICAP_BASE];
+    } else if (MSIXCAP_BASE && offset >= MSIXCAP_BASE &&
+        offset + pkt->getSize() <= MSIXCAP_BASE + MSIXCAP_MPBA + 4) {
+        cap_data = &msixcap.data[offset - MSIXCAP_BASE];
+    } else {
+        return false;
+    }
+
+    switch (pkt->getSize()) {
+      case sizeof(uint8_t):
+        *cap_data = pkt->get<uint8_t>();
+        break;
+      case sizeof(uint16_t):
+        *(uint16_t *)cap_data = pkt->get<uint16_t>();
+        break;
+      case sizeof(uint32_t):
+        *(uint32_t *)cap_data = pkt->get<uint32_t>();
+        break;
+      default:
+        panic("invalid access size(?) for PCI capability!\n");
+    }
+
+    msicap.mid = old_mid;
+    msicap.mc = (old_mc & ~0x0071) | (msicap.mc & 0x0071);
+    msixcap.mxid = old_mxid;
+    msixcap.mxc = (old_mxc & ~0xC000) | (msixcap.mxc & 0xC000);
+    msixcap.mtab = old_mtab;
+    msixcap.mpba = old_mpba;
+
+    DPRINTF(PCIDEV, "writeCapability: dev %#x func %#x reg %#x %d bytes\n",
+            params()->pci_dev, params()->pci_func, offset, pkt->getSize());
+
+    // Deliver messages pending while MSI-X function was masked, a VF
+    // only has its own
+    if ((old_mxc & 0x4000) && !(msixcap.mxc & 0x4000) &&
+        (msixcap.mxc & 0x8000)) {
+        for (auto &pba : msixPbas) {
+            if (&getMsixCap(pba.first) != &msixcap)
+                continue;
+            for (int i = 0; i < msix_table.size(); i++) {
+                MSIXPbaEntry &entry = pba.second[i / MSIXVECS_PER_PBA];
+                if (entry.bits & (ULL(1) << (i % MSIXVECS_PER_PBA)))
+                    msixPost(pba.first, i);
+            }
+        }
+    }
+
+    return true;
+}
+
+PARDg5VPciDevice::DSidCaps &
+PARDg5VPciDevice::getDSidCaps(uint16_t DSid)
+{
+    auto it = dsidCaps.find(DSid);
+    if (it == dsidCaps.end()) {
+        DSidCaps caps = { msicap, msixcap };
+        it = dsidCaps.insert(std::make_pair(DSid, caps)).first;
+    }
+    return it->second;
+}
+
+bool
+PARDg5VPciDevice::msiEnabled(uint16_t DSid) const
+{
+    if (!MSICAP_BASE)
+        return false;
+    int vf = findVF(DSid);
+    if (vf >= 0)
+        return vfs[vf].msicap.mc & 0x0001;
+    auto it = dsidCaps.find(DSid);
+    return (it == dsidCaps.end() ? msicap : it->second.msicap).mc & 0x0001;
+}
+
+bool
+PARDg5VPciDevice::msixEnabled(uint16_t DSid) const
+{
+    if (!MSIXCAP_BASE)
+        return false;
+    int vf = findVF(DSid);
+    if (vf >= 0)
+        return vfs[vf].msixcap.mxc & 0x8000;
+    auto it = dsidCaps.find(DSid);
+    return (it == dsidCaps.end() ? msixcap : it->second.msixcap).mxc &
+           0x8000;
+}
+
+std::vector<MSIXTable> &
+PARDg5VPciDevice::getMsixTable(uint16_t DSid)
+{
+    auto it = msixTables.find(DSid);
+    if (it == msixTables.end())
+        it = msixTables.insert(std::make_pair(DSid, msix_table)).first;
+    return it->second;
+}
+
+std::vector<MSIXPbaEntry> &
+PARDg5VPciDevice::getMsixPba(uint16_t DSid)
+{
+    auto it = msixPbas.find(DSid);
+    if (it == msixPbas.end())
+        it = msixPbas.insert(std::make_pair(DSid, msix_pba)).first;
+    return it->second;
+}
+
+bool
+PARDg5VPciDevice::isMsixAccess(int bar, Addr offs) const
+{
+    if (!MSIXCAP_BASE)
+        return false;
+    if (bar == (msixcap.mtab & 0x7) &&
+        offs >= MSIX_TABLE_OFFSET && offs < MSIX_TABLE_END)
+        return true;
+    if (bar == (msixcap.mpba & 0x7) &&
+        offs >= MSIX_PBA_OFFSET && offs < MSIX_PBA_END)
+        return true;
+    return false;
+}
+
+Tick
+PARDg5VPciDevice::readMsix(PacketPtr pkt, int bar, Addr offs)
+{
+    uint8_t *data;
+
+    assert(isMsixAccess(bar, offs));
+    int vf = findVF(pkt->getDSid());
+    if (vf >= 0)
+        vfMsixAccesses[vf]++;
+    if (bar == (msixcap.mtab & 0x7) &&
+        offs >= MSIX_TABLE_OFFSET && offs < MSIX_TABLE_END) {
+        data = (uint8_t *)&getMsixTable(pkt->getDSid())[0]
+            + (offs - MSIX_TABLE_OFFSET);
+    } else {
+        data = (uint8_t *)&getMsixPba(pkt->getDSid())[0]
+            + (offs - MSIX_PBA_OFFSET);
+    }
+
+    switch (pkt->getSize()) {
+      case sizeof(uint32_t):
+        pkt->set<uint32_t>(*(uint32_t *)data);
+        break;
+      case sizeof(uint64_t):
+        pkt->set<uint64_t>(*(uint64_t *)data);
+        break;
+      default:
+        panic("invalid access size %d for MSI-X table!\n", pkt->getSize());
+    }
+    pkt->makeAtomicResponse();
+    return pioDelay;
+}
+
+Tick
+PARDg5VPciDevice::writeMsix(PacketPtr pkt, int bar, Addr offs)
+{
+    assert(isMsixAccess(bar, offs));
+    int vf = findVF(pkt->getDSid());
+    if (vf >= 0)
+        vfMsixAccesses[vf]++;
+    if (bar == (msixcap.mtab & 0x7) &&
+        offs >= MSIX_TABLE_OFFSET && offs < MSIX_TABLE_END) {
+        std::vector<MSIXTable> &table = getMsixTable(pkt->getDSid());
+        int vector = (offs - MSIX_TABLE_OFFSET) / sizeof(MSIXTable);
+        bool was_masked = letoh(table[vector].fields.vec_ctrl) & 0x1;
+        uint8_t *data = (uint8_t *)&table[0] + (offs - MSIX_TABLE_OFFSET);
+
+        switch (pkt->getSize()) {
+          case sizeof(uint32_t):
+            *(uint32_t *)data = pkt->get<uint32_t>();
+            break;
+          case sizeof(uint64_t):
+            *(uint64_t *)data = pkt->get<uint64_t>();
+            break;
+          default:
+            panic("invalid access size %d for MSI-X table!\n",
+                  pkt->getSize());
+        }
+
+        // Deliver the pending message once the vector is unmasked
+        MSIXPbaEntry &pba =
+            getMsixPba(pkt->getDSid())[vector / MSIXVECS_PER_PBA];
+        uint64_t pending = ULL(1) << (vector % MSIXVECS_PER_PBA);
+        if (was_masked && !(letoh(table[vector].fields.vec_ctrl) & 0x1) &&
+            (pba.bits & pending))
+            msixPost(pkt->getDSid(), vector);
+    } else {
+        // The PBA is read only
+        DPRINTF(PCIDEV, "Ignore write to MSI-X PBA offset %#x\n", offs);
+    }
+
+    pkt->makeAtomicResponse();
+    return pioDelay;
+}
+
+void
+PARDg5VPciDevice::intrPost(uint16_t DSid, int vector)
+{
+    int vf = findVF(DSid);
+    if (vf >= 0)
+        vfInterrupts[vf]++;
+
+    if (msixEnabled(DSid) || msiEnabled(DSid)) {
+        if (intMasterPort.isConnected()) {
+            if (!msixEnabled(DSid)) {
+                msiPost(DSid);
+                return;
+            }
+            if (vector < 0 || vector >= (int)getMsixTable(DSid).size()) {
+                warn_once("%s: MSI-X vector %d not in table, use vector "
+                          "0.\n", name(), vector);
+                vector = 0;
+            }
+            msixPost(DSid, vector);
+            return;
+        }
+        warn_once("%s: MSI enabled but int_master not connected, "
+                  "fall back to INTx.\n", name());
+    }
+
+    // The PF and its VFs share one INTx line, it must only reach the
+    // LDomain of the function that raised it
+    int line = letoh(getConfig(DSid).interruptLine);
+    if (!numVFs()) {
+        platform->postPciInt(line);
+        return;
+    }
+    CellX *cellx = dynamic_cast<CellX *>(platform);
+    panic_if(!cellx, "%s: INTx of an SR-IOV device needs CellX.\n", name());
+    cellx->postPciInt(DSid, line);
+}
+
+void
+PARDg5VPciDevice::msiPost(uint16_t DSid)
+{
+    MSICAP &msicap = getMsiCap(DSid);
+
+    // 64-bit capable MSI moves data/mask/pending up by 4 bytes
+    bool addr64 = msicap.mc & 0x0080;
+    bool maskable = msicap.mc & 0x0100;
+    int data_offset = addr64 ? MSICAP_MD : MSICAP_MUA;
+    int mask_offset = addr64 ? MSICAP_MMASK : MSICAP_MD;
+    int pend_offset = mask_offset + 4;
+
+    uint64_t addr = letoh(*(uint32_t *)&msicap.data[MSICAP_MA]);
+    if (addr64)
+        addr |= (uint64_t)letoh(*(uint32_t *)&msicap.data[MSICAP_MUA]) << 32;
+    uint16_t data = letoh(*(uint16_t *)&msicap.data[data_offset]);
+
+    if (maskable) {
+        uint32_t *mask = (uint32_t *)&msicap.data[mask_offset];
+        uint32_t *pend = (uint32_t *)&msicap.data[pend_offset];
+        if (letoh(*mask) & 0x1) {
+            *pend = htole(letoh(*pend) | 0x1);
+            return;
+        }
+        *pend = htole(letoh(*pend) & ~0x1);
+    }
+
+    sendMsi(DSid, addr, data);
+}
+
+void
+PARDg5VPciDevice::msixPost(uint16_t DSid, int vector)
+{
+    std::vector<MSIXTable> &table = getMsixTable(DSid);
+    MSIXPbaEntry &pba = getMsixPba(DSid)[vector / MSIXVECS_PER_PBA];
+    uint64_t pending = ULL(1) << (vector % MSIXVECS_PER_PBA);
+
+    assert(vector < table.size());
+
+    // Function mask or vector mask, leave it pending
+    if ((getMsixCap(DSid).mxc & 0x4000) ||
+        (letoh(table[vector].fields.vec_ctrl) & 0x1)) {
+        pba.bits |= pending;
+        return;
+    }
+    pba.bits &= ~pending;
+
+    uint64_t addr = letoh(table[vector].fields.addr_lo) |
+                    ((uint64_t)letoh(table[vector].fields.addr_hi) << 32);
+    sendMsi(DSid, addr, letoh(table[vector].fields.msg_data));
+}
+
+void
+PARDg5VPciDevice::sendMsi(uint16_t DSid, uint64_t addr, uint32_t data)
+{
+    using namespace X86ISA;
+
+    if ((addr & 0xFFF00000) != 0xFEE00000) {
+        warn("%s: MSI to invalid address %#x ignored.\n", name(), addr);
+        return;
+    }
+
+    TriggerIntMessage message = 0;
+    message.destination = bits(addr, 19, 12);
+    message.destMode = bits(addr, 2);
+    message.vector = bits(data, 7, 0);
+    message.deliveryMode = bits(data, 10, 8);
+    message.level = bits(data, 14);
+    message.trigger = bits(data, 15);
+
+    // Only local APICs owned by DSid can be targeted
+    ApicList apics;
+    if (message.destMode == 0) {
+        if (message.destination == 0xFF) {
+            // APIC ids need not be dense, match the real ones
+            apics = msiRouter.getOwnedApics(DSid);
+        } else if (msiRouter.isOwner(DSid, message.destination)) {
+            apics.push_back(message.destination);
+        }
+    } else {
+        apics = msiRouter.getLogicalRoute(DSid, message.destination);
+        if (message.deliveryMode == DeliveryMode::LowestPriority &&
+                apics.size() > 1)
+            apics.resize(1);
+    }
+
+    DPRINTF(PCIDEV, "MSI DSid=%d addr=%#x data=%#x to %d apics\n",
+            DSid, addr, data, apics.size());
+
+    for (auto apic : apics) {
+        PacketPtr pkt = buildIntRequest(apic, message);
+        pkt->req->setDSid(DSid);
+        if (sys->isTimingMode()) {
+            // The target handles cleaning up the packet in timing mode.
+            intMasterPort.schedTimingReq(pkt, curTick() + msiLatency);
+        } else {
+            intMasterPort.sendAtomic(pkt);
+            delete pkt->req;
+            delete pkt;
+        }
+    }
+}
+
 void
 PARDg5VPciDevice::serialize(std::ostream &os)
 {
@@ -525,6 +1026,31 @@ PARDg5VPciDevice::serialize(std::ostream &os)
             paramOut(os, csprintf("msix_pba[%d].bits", i),
                      msix_pba[i].bits);
         }
+
+        std::vector<uint16_t> msix_dsids;
+        for (auto &t : msixTables)
+            msix_dsids.push_back(t.first);
+        unsigned msix_dsid_count = msix_dsids.size();
+        SERIALIZE_SCALAR(msix_dsid_count);
+        arrayParamOut(os, "msix_dsids", msix_dsids);
+        for (auto DSid : msix_dsids) {
+            std::vector<MSIXTable> &table = getMsixTable(DSid);
+            std::vector<MSIXPbaEntry> &pba = getMsixPba(DSid);
+            for (int i = 0; i < msix_array_size; i++) {
+                paramOut(os, csprintf("msix_table.%d[%d].addr_lo", DSid, i),
+                         table[i].fields.addr_lo);
+                paramOut(os, csprintf("msix_table.%d[%d].addr_hi", DSid, i),
+                         table[i].fields.addr_hi);
+                paramOut(os, csprintf("msix_table.%d[%d].msg_data", DSid, i),
+                         table[i].fields.msg_data);
+                paramOut(os, csprintf("msix_table.%d[%d].vec_ctrl", DSid, i),
+                         table[i].fields.vec_ctrl);
+            }
+            for (int i = 0; i < pba_array_size; i++) {
+                paramOut(os, csprintf("msix_pba.%d[%d].bits", DSid, i),
+                         pba[i].bits);
+            }
+        }
     }
 
     paramOut(os, csprintf("pxcap.pxid"), uint16_t(pxcap.pxid));
@@ -537,6 +1063,34 @@ PARDg5VPciDevice::serialize(std::ostream &os)
     paramOut(os, csprintf("pxcap.pxls"), uint16_t(pxcap.pxls));
     paramOut(os, csprintf("pxcap.pxdcap2"), uint32_t(pxcap.pxdcap2));
     paramOut(os, csprintf("pxcap.pxdc2"), uint32_t(pxcap.pxdc2));
+
+    std::vector<uint16_t> cap_dsids;
+    for (auto &caps : dsidCaps)
+        cap_dsids.push_back(caps.first);
+    unsigned cap_dsid_count = cap_dsids.size();
+    SERIALIZE_SCALAR(cap_dsid_count);
+    arrayParamOut(os, "cap_dsids", cap_dsids);
+    for (auto DSid : cap_dsids) {
+        DSidCaps &caps = dsidCaps[DSid];
+        arrayParamOut(os, csprintf("msicap.%d", DSid),
+                      caps.msicap.data, sizeof(caps.msicap.data));
+        arrayParamOut(os, csprintf("msixcap.%d", DSid),
+                      caps.msixcap.data, sizeof(caps.msixcap.data));
+    }
+
+    for (int i = 0; i < vfs.size(); i++) {
+        VirtualFunction &vf = vfs[i];
+        paramOut(os, csprintf("vf%d.valid", i), vf.valid);
+        if (!vf.valid)
+            continue;
+        paramOut(os, csprintf("vf%d.DSid", i), vf.DSid);
+        arrayParamOut(os, csprintf("vf%d.config", i),
+                      vf.config.data, sizeof(vf.config.data));
+        arrayParamOut(os, csprintf("vf%d.msicap", i),
+                      vf.msicap.data, sizeof(vf.msicap.data));
+        arrayParamOut(os, csprintf("vf%d.msixcap", i),
+                      vf.msixcap.data, sizeof(vf.msixcap.data));
+    }
 }
 
 void
@@ -606,6 +1160,38 @@ PARDg5VPciDevice::unserialize(Checkpoint *cp, const std::string &section)
             paramIn(cp, section, csprintf("msix_pba[%d].bits", i),
                     msix_pba[i].bits);
         }
+
+        // Checkpoints without per-DSid tables start every DSid over
+        // from msix_table
+        std::vector<uint16_t> msix_dsids;
+        unsigned msix_dsid_count = 0;
+        optParamIn(cp, section, "msix_dsid_count", msix_dsid_count);
+        if (msix_dsid_count)
+            arrayParamIn(cp, section, "msix_dsids", msix_dsids);
+        msixTables.clear();
+        msixPbas.clear();
+        for (auto DSid : msix_dsids) {
+            std::vector<MSIXTable> &table = getMsixTable(DSid);
+            std::vector<MSIXPbaEntry> &pba = getMsixPba(DSid);
+            for (int i = 0; i < msix_array_size; i++) {
+                paramIn(cp, section,
+                        csprintf("msix_table.%d[%d].addr_lo", DSid, i),
+                        table[i].fields.addr_lo);
+                paramIn(cp, section,
+                        csprintf("msix_table.%d[%d].addr_hi", DSid, i),
+                        table[i].fields.addr_hi);
+                paramIn(cp, section,
+                        csprintf("msix_table.%d[%d].msg_data", DSid, i),
+                        table[i].fields.msg_data);
+                paramIn(cp, section,
+                        csprintf("msix_table.%d[%d].vec_ctrl", DSid, i),
+                        table[i].fields.vec_ctrl);
+            }
+            for (int i = 0; i < pba_array_size; i++) {
+                paramIn(cp, section, csprintf("msix_pba.%d[%d].bits", DSid, i),
+                        pba[i].bits);
+            }
+        }
     }
 
     paramIn(cp, section, csprintf("pxcap.pxid"), tmp16);
@@ -628,6 +1214,34 @@ PARDg5VPciDevice::unserialize(Checkpoint *cp, const std::string &section)
     pxcap.pxdcap2 = tmp32;
     paramIn(cp, section, csprintf("pxcap.pxdc2"), tmp32);
     pxcap.pxdc2 = tmp32;
+
+    std::vector<uint16_t> cap_dsids;
+    unsigned cap_dsid_count = 0;
+    optParamIn(cp, section, "cap_dsid_count", cap_dsid_count);
+    if (cap_dsid_count)
+        arrayParamIn(cp, section, "cap_dsids", cap_dsids);
+    dsidCaps.clear();
+    for (auto DSid : cap_dsids) {
+        DSidCaps &caps = getDSidCaps(DSid);
+        arrayParamIn(cp, section, csprintf("msicap.%d", DSid),
+                     caps.msicap.data, sizeof(caps.msicap.data));
+        arrayParamIn(cp, section, csprintf("msixcap.%d", DSid),
+                     caps.msixcap.data, sizeof(caps.msixcap.data));
+    }
+
+    for (int i = 0; i < vfs.size(); i++) {
+        VirtualFunction &vf = vfs[i];
+        paramIn(cp, section, csprintf("vf%d.valid", i), vf.valid);
+        if (!vf.valid)
+            continue;
+        paramIn(cp, section, csprintf("vf%d.DSid", i), vf.DSid);
+        arrayParamIn(cp, section, csprintf("vf%d.config", i),
+                     vf.config.data, sizeof(vf.config.data));
+        arrayParamIn(cp, section, csprintf("vf%d.msicap", i),
+                     vf.msicap.data, sizeof(vf.msicap.data));
+        arrayParamIn(cp, section, csprintf("vf%d.msixcap", i),
+                     vf.msixcap.data, sizeof(vf.msixcap.data));
+    }
     pioPort.sendRangeChange();
 }
 
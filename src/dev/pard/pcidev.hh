@@ -52,9 +52,13 @@
 #define __DEV_PARD_PCIDEV_HH__
 
 #include <cstring>
+#include <map>
 #include <vector>
 
+#include "arch/x86/pard_interrupts.hh"
+#include "base/statistics.hh"
 #include "dev/pard/dma_device.hh"
+#include "dev/x86/intdev.hh"
 #include "dev/pcireg.h"
 #include "dev/platform.hh"
 #include "params/PARDg5VPciDevice.hh"
@@ -69,9 +73,16 @@
 
 
 /**
- * PCI device, base implementation is only config space.
+ * PCI device, base implementation is only config space. MSI and MSI-X
+ * messages are tagged with the DSid and sent straight to the local APICs
+ * owned by that DSid through int_master, bypassing the I/O APIC.
+ *
+ * A device with num_vfs > 0 can be shared by several DSids, SR-IOV
+ * style. Each DSid it is assigned to gets a virtual function with its
+ * own config space, MSI/MSI-X state and interrupt vector, all VFs decode
+ * the same BARs and are told apart by the DSid of the access.
  */
-class PARDg5VPciDevice : public PARDg5VDmaDevice
+class PARDg5VPciDevice : public PARDg5VDmaDevice, public X86ISA::IntDevice
 {
     class PciConfigPort : public SimpleTimingPort
     {
@@ -137,6 +148,80 @@ class PARDg5VPciDevice : public PARDg5VDmaDevice
     std::vector<MSIXTable> msix_table;
     std::vector<MSIXPbaEntry> msix_pba;
 
+    /**
+     * MSIX Table and PBA of each DSid, copied from msix_table/msix_pba
+     * the first time a DSid touches them.
+     * @{
+     */
+    std::map<uint16_t, std::vector<MSIXTable> > msixTables;
+    std::map<uint16_t, std::vector<MSIXPbaEntry> > msixPbas;
+    std::vector<MSIXTable> &getMsixTable(uint16_t DSid);
+    std::vector<MSIXPbaEntry> &getMsixPba(uint16_t DSid);
+    /** @} */
+
+    /**
+     * MSI/MSI-X capabilities of each DSid without a VF, copied from
+     * msicap/msixcap the first time a DSid touches them.
+     */
+    struct DSidCaps
+    {
+        MSICAP msicap;
+        MSIXCAP msixcap;
+    };
+    std::map<uint16_t, DSidCaps> dsidCaps;
+    DSidCaps &getDSidCaps(uint16_t DSid);
+
+    /**
+     * Virtual function of one DSid, starts as a copy of the physical
+     * function. DSids without a VF see the physical function, with MSI
+     * and MSI-X state of their own.
+     */
+    struct VirtualFunction
+    {
+        bool valid;
+        uint16_t DSid;
+        PCIConfig config;
+        MSICAP msicap;
+        MSIXCAP msixcap;
+    };
+    std::vector<VirtualFunction> vfs;
+
+    /** VF of DSid, -1 if it has none */
+    int findVF(uint16_t DSid) const;
+
+    PCIConfig &
+    getConfig(uint16_t DSid)
+    { int vf = findVF(DSid); return vf < 0 ? config : vfs[vf].config; }
+    MSICAP &
+    getMsiCap(uint16_t DSid)
+    {
+        int vf = findVF(DSid);
+        return vf < 0 ? getDSidCaps(DSid).msicap : vfs[vf].msicap;
+    }
+    MSIXCAP &
+    getMsixCap(uint16_t DSid)
+    {
+        int vf = findVF(DSid);
+        return vf < 0 ? getDSidCaps(DSid).msixcap : vfs[vf].msixcap;
+    }
+
+    /**
+     * Device models set up and tear down the queue state of a VF here,
+     * the VF is already valid when vfEnable() is called.
+     * @{
+     */
+    virtual void vfEnable(int vf) { }
+    virtual void vfDisable(int vf) { }
+    /** @} */
+
+    Stats::Vector vfConfigAccesses;
+    Stats::Vector vfMsixAccesses;
+    Stats::Vector vfInterrupts;
+
+    /** Resolve MSI destinations into local APICs of a DSid */
+    X86ISA::PardApicRouter msiRouter;
+    Tick msiLatency;
+
     /** The size of the BARs */
     uint32_t BARSize[6];
 
@@ -215,17 +300,65 @@ class PARDg5VPciDevice : public PARDg5VDmaDevice
      */
     virtual Tick readConfig(PacketPtr pkt);
 
+    /**
+     * Access MSICAP/MSIXCAP in config space.
+     * @return true if offset is inside one of the capabilities
+     */
+    bool readCapability(PacketPtr pkt, int offset);
+    bool writeCapability(PacketPtr pkt, int offset);
+
+    bool msiEnabled(uint16_t DSid) const;
+    bool msixEnabled(uint16_t DSid) const;
+
+    bool msiEnabled() const { return msiEnabled(_DSid); }
+    bool msixEnabled() const { return msixEnabled(_DSid); }
+
+    /** Post MSI or MSI-X vector on behalf of DSid */
+    void msiPost(uint16_t DSid);
+    void msixPost(uint16_t DSid, int vector);
+
+    /** Send one x86 MSI message (address/data pair) to DSid's APICs */
+    void sendMsi(uint16_t DSid, uint64_t addr, uint32_t data);
+
+    /**
+     * Access MSI-X Table and PBA mapped by BARs, devices with MSI-X
+     * support call these from their read()/write().
+     * @{
+     */
+    bool isMsixAccess(int bar, Addr offs) const;
+    Tick readMsix(PacketPtr pkt, int bar, Addr offs);
+    Tick writeMsix(PacketPtr pkt, int bar, Addr offs);
+    /** @} */
+
   public:
     Addr pciToDma(Addr pciAddr) const
     { return platform->pciToDma(pciAddr); }
 
-    void
-    intrPost()
-    { platform->postPciInt(letoh(config.interruptLine)); }
+    void intrPost() { intrPost(_DSid); }
+    void intrClear() { intrClear(_DSid); }
+
+    /**
+     * Interrupt of the function DSid sees. vector is the MSI-X table
+     * entry of the interrupt source, MSI and INTx carry a single message.
+     */
+    void intrPost(uint16_t DSid, int vector = 0);
 
     void
-    intrClear()
-    { platform->clearPciInt(letoh(config.interruptLine)); }
+    intrClear(uint16_t DSid)
+    {
+        // MSI/MSI-X are edge triggered, nothing to clear
+        if (!msiEnabled(DSid) && !msixEnabled(DSid))
+            platform->clearPciInt(letoh(getConfig(DSid).interruptLine));
+    }
+
+    /**
+     * Give DSid a virtual function, used by IOHub when the device is
+     * assigned to it.
+     * @return false if all VFs are taken
+     */
+    bool attachVF(uint16_t DSid);
+    void detachVF(uint16_t DSid);
+    unsigned numVFs() const { return vfs.size(); }
 
     uint8_t
     interruptLine()
@@ -246,6 +379,7 @@ class PARDg5VPciDevice : public PARDg5VDmaDevice
     PARDg5VPciDevice(const Params *params);
 
     virtual void init();
+    virtual void regStats();
 
     /**
      * Serialize this object to the given output stream.
@@ -272,5 +406,14 @@ class PARDg5VPciDevice : public PARDg5VDmaDevice
         return PARDg5VDmaDevice::getSlavePort(if_name, idx);
     }
 
+    virtual BaseMasterPort &getMasterPort(const std::string &if_name,
+                                          PortID idx = InvalidPortID)
+    {
+        if (if_name == "int_master") {
+            return intMasterPort;
+        }
+        return PARDg5VDmaDevice::getMasterPort(if_name, idx);
+    }
+
 };
 #endif // __DEV_PARD_PCIDEV_HH__
@@ -0,0 +1,566 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/** @file
+ * Paravirtual block device with descriptor rings in guest memory
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/bitfield.hh"
+#include "base/intmath.hh"
+#include "base/trace.hh"
+#include "debug/Drain.hh"
+#include "debug/PARDg5VBlock.hh"
+#include "dev/pard/pv_blk.hh"
+#include "sim/byteswap.hh"
+#include "sim/serialize.hh"
+
+/** Largest request the device buffers, header and status included */
+#define PVBLK_MAX_REQ_BYTES     (4 << 20)
+
+PARDg5VBlockDevice::PARDg5VBlockDevice(Params *p)
+    : PARDg5VPciDevice(p), queues(p->num_vfs + 1),
+      latency(p->latency), bandwidth(p->bandwidth),
+      queueMax(p->queue_max), drainManager(NULL)
+{
+    fatal_if(!isPowerOf2(queueMax) || queueMax > 32768,
+             "%s: queue_max %d not a power of 2 up to 32768\n",
+             name(), queueMax);
+    fatal_if(p->vf_images.size() != p->num_vfs,
+             "%s: %d VFs need as many vf_images, got %d\n",
+             name(), p->num_vfs, p->vf_images.size());
+
+    for (int i = 0; i < queues.size(); i++) {
+        Queue &queue = queues[i];
+        queue.dev = this;
+        queue.q = i;
+        queue.image = i ? p->vf_images[i - 1] : p->image;
+        resetQueue(queue);
+    }
+}
+
+void
+PARDg5VBlockDevice::regStats()
+{
+    using namespace Stats;
+
+    PARDg5VPciDevice::regStats();
+
+    notifies
+        .name(name() + ".notifies")
+        .desc("Doorbell writes")
+        ;
+    batches
+        .name(name() + ".batches")
+        .desc("Batches of requests served")
+        ;
+    requests
+        .init(5)
+        .name(name() + ".requests")
+        .desc("Requests served by type")
+        .flags(total | nozero)
+        ;
+    requests.subname(0, "in");
+    requests.subname(1, "out");
+    requests.subname(2, "flush");
+    requests.subname(3, "get_id");
+    requests.subname(4, "unsupported");
+    errors
+        .name(name() + ".errors")
+        .desc("Malformed or failed requests")
+        ;
+    bytesRead
+        .name(name() + ".bytesRead")
+        .desc("Bytes read from the disk images")
+        ;
+    bytesWritten
+        .name(name() + ".bytesWritten")
+        .desc("Bytes written to the disk images")
+        ;
+    interrupts
+        .name(name() + ".interrupts")
+        .desc("Interrupts posted for finished batches")
+        ;
+    avgBatch
+        .name(name() + ".avgBatch")
+        .desc("Average requests per batch")
+        ;
+    avgBatch = sum(requests) / batches;
+}
+
+void
+PARDg5VBlockDevice::resetQueue(Queue &queue)
+{
+    queue.reset();
+    queue.status = 0;
+    queue.isr = 0;
+}
+
+bool
+PARDg5VBlockDevice::busy() const
+{
+    for (auto &queue : queues) {
+        if (queue.stage != PVRingQueue::Idle)
+            return true;
+    }
+    return false;
+}
+
+void
+PARDg5VBlockDevice::vfEnable(int vf)
+{
+    Queue &queue = queues[vf + 1];
+    resetQueue(queue);
+    queue.DSid = vfs[vf].DSid;
+}
+
+void
+PARDg5VBlockDevice::vfDisable(int vf)
+{
+    resetQueue(queues[vf + 1]);
+}
+
+Tick
+PARDg5VBlockDevice::read(PacketPtr pkt)
+{
+    int bar;
+    Addr offs;
+    if (!getBAR(pkt->getAddr(), bar, offs))
+        panic("Invalid PCI memory access to unmapped memory.\n");
+    if (isMsixAccess(bar, offs))
+        return readMsix(pkt, bar, offs);
+    if (bar != 0 || pkt->getSize() != sizeof(uint32_t))
+        panic("%s: bad read of BAR%d offset %#x size %d\n",
+              name(), bar, offs, pkt->getSize());
+
+    Queue &queue = getQueue(pkt->getDSid());
+    uint64_t capacity = queue.image->size();
+    uint32_t value = 0;
+
+    switch (offs) {
+      case PVBLK_FEATURES:
+        value = PVBLK_F_FLUSH;
+        break;
+      case PVBLK_CAPACITY:
+        value = bits(capacity, 31, 0);
+        break;
+      case PVBLK_CAPACITY + 4:
+        value = bits(capacity, 63, 32);
+        break;
+      case PVBLK_QUEUE_MAX:
+        value = queueMax;
+        break;
+      case PVBLK_QUEUE_SIZE:
+        value = queue.ring.size;
+        break;
+      case PVBLK_QUEUE_DESC:
+        value = bits(queue.ring.desc, 31, 0);
+        break;
+      case PVBLK_QUEUE_DESC + 4:
+        value = bits(queue.ring.desc, 63, 32);
+        break;
+      case PVBLK_QUEUE_AVAIL:
+        value = bits(queue.ring.avail, 31, 0);
+        break;
+      case PVBLK_QUEUE_AVAIL + 4:
+        value = bits(queue.ring.avail, 63, 32);
+        break;
+      case PVBLK_QUEUE_USED:
+        value = bits(queue.ring.used, 31, 0);
+        break;
+      case PVBLK_QUEUE_USED + 4:
+        value = bits(queue.ring.used, 63, 32);
+        break;
+      case PVBLK_STATUS:
+        value = queue.status;
+        break;
+      case PVBLK_ISR:
+        // Reading acknowledges a level triggered interrupt
+        value = queue.isr;
+        queue.isr = 0;
+        intrClear(pkt->getDSid());
+        break;
+      default:
+        break;
+    }
+
+    DPRINTF(PARDg5VBlock, "DSid %d read offset %#x: %#x\n",
+            pkt->getDSid(), offs, value);
+    pkt->set<uint32_t>(value);
+    pkt->makeAtomicResponse();
+    return pioDelay;
+}
+
+Tick
+PARDg5VBlockDevice::write(PacketPtr pkt)
+{
+    int bar;
+    Addr offs;
+    if (!getBAR(pkt->getAddr(), bar, offs))
+        panic("Invalid PCI memory access to unmapped memory.\n");
+    if (isMsixAccess(bar, offs))
+        return writeMsix(pkt, bar, offs);
+    if (bar != 0 || pkt->getSize() != sizeof(uint32_t))
+        panic("%s: bad write of BAR%d offset %#x size %d\n",
+              name(), bar, offs, pkt->getSize());
+
+    Queue &queue = getQueue(pkt->getDSid());
+    uint32_t value = pkt->get<uint32_t>();
+    bool running = queue.status & PVBLK_STATUS_DRIVER_OK;
+
+    DPRINTF(PARDg5VBlock, "DSid %d write offset %#x: %#x\n",
+            pkt->getDSid(), offs, value);
+
+    // The ring can't move while the device uses it
+    if (running && offs >= PVBLK_QUEUE_SIZE && offs < PVBLK_STATUS) {
+        warn("%s: ring of DSid %d changed while running, ignored\n",
+             name(), pkt->getDSid());
+        pkt->makeAtomicResponse();
+        return pioDelay;
+    }
+
+    switch (offs) {
+      case PVBLK_QUEUE_SIZE:
+        if (value && isPowerOf2(value) && value <= queueMax)
+            queue.ring.size = value;
+        else
+            warn("%s: bad queue size %d\n", name(), value);
+        break;
+      case PVBLK_QUEUE_DESC:
+        queue.ring.desc = insertBits(queue.ring.desc, 31, 0, value);
+        break;
+      case PVBLK_QUEUE_DESC + 4:
+        queue.ring.desc = insertBits(queue.ring.desc, 63, 32, value);
+        break;
+      case PVBLK_QUEUE_AVAIL:
+        queue.ring.avail = insertBits(queue.ring.avail, 31, 0, value);
+        break;
+      case PVBLK_QUEUE_AVAIL + 4:
+        queue.ring.avail = insertBits(queue.ring.avail, 63, 32, value);
+        break;
+      case PVBLK_QUEUE_USED:
+        queue.ring.used = insertBits(queue.ring.used, 31, 0, value);
+        break;
+      case PVBLK_QUEUE_USED + 4:
+        queue.ring.used = insertBits(queue.ring.used, 63, 32, value);
+        break;
+      case PVBLK_STATUS:
+        if (value == 0) {
+            resetQueue(queue);
+        } else if ((value & PVBLK_STATUS_DRIVER_OK) && !queue.ring.size) {
+            queue.status = value | PVBLK_STATUS_FAILED;
+        } else {
+            queue.status = value;
+        }
+        break;
+      case PVBLK_NOTIFY:
+        notifies++;
+        if (running)
+            queue.notify();
+        break;
+      default:
+        warn("%s: write to read-only offset %#x\n", name(), offs);
+        break;
+    }
+
+    pkt->makeAtomicResponse();
+    return pioDelay;
+}
+
+void
+PARDg5VBlockDevice::Queue::dmaRead(Addr addr, int size, void *data)
+{
+    dev->dmaRead(dmaDSid(), dev->pciToDma(addr), size, new StepEvent(this),
+                 (uint8_t *)data);
+}
+
+void
+PARDg5VBlockDevice::Queue::dmaWrite(Addr addr, int size, void *data)
+{
+    dev->dmaWrite(dmaDSid(), dev->pciToDma(addr), size, new StepEvent(this),
+                  (uint8_t *)data);
+}
+
+bool
+PARDg5VBlockDevice::Queue::running() const
+{
+    return (status & PVBLK_STATUS_DRIVER_OK) &&
+           !(status & PVBLK_STATUS_FAILED);
+}
+
+void
+PARDg5VBlockDevice::Queue::failed()
+{
+    warn("%s: available index of queue %d out of range\n", dev->name(), q);
+    status |= PVBLK_STATUS_FAILED;
+}
+
+bool
+PARDg5VBlockDevice::Queue::checkChain(const Chain &chain, uint64_t total)
+{
+    // Header, data and a status byte written by the device
+    if (chain.segs.size() < 2 || chain.segs[0].write ||
+        chain.segs[0].len < sizeof(PVBlkReqHdr) ||
+        !chain.segs.back().write || chain.segs.back().len == 0 ||
+        total > PVBLK_MAX_REQ_BYTES) {
+        warn("%s: malformed request at descriptor %d\n",
+             dev->name(), chain.head);
+        dev->errors++;
+        return false;
+    }
+    return true;
+}
+
+bool
+PARDg5VBlockDevice::Queue::transfer(unsigned step)
+{
+    switch (step) {
+      case 0:
+        // Buffers of all requests, then the disk serves the batch as
+        // one transfer, then results go back to the guest
+        for (auto &req : chains) {
+            unsigned off = 0;
+            for (auto &seg : req.segs) {
+                if (!seg.write && seg.len)
+                    read(seg.addr, seg.len, &req.buf[off]);
+                off += seg.len;
+            }
+        }
+        return true;
+      case 1:
+        {
+            unsigned bytes = 0;
+            for (auto &req : chains)
+                bytes += dev->serveRequest(*this, req);
+            addPending();
+            dev->schedule(new StepEvent(this), curTick() + dev->latency +
+                          (Tick)(bytes * dev->bandwidth));
+        }
+        return true;
+      case 2:
+        for (auto &req : chains) {
+            unsigned off = 0;
+            for (auto &seg : req.segs) {
+                if (seg.write && seg.len)
+                    write(seg.addr, seg.len, &req.buf[off]);
+                off += seg.len;
+            }
+        }
+        return true;
+      default:
+        return false;
+    }
+}
+
+void
+PARDg5VBlockDevice::Queue::batchDone(bool intr)
+{
+    dev->batches++;
+    if (intr) {
+        isr |= PVBLK_ISR_USED;
+        dev->interrupts++;
+        dev->intrPost(dmaDSid());
+    }
+}
+
+unsigned
+PARDg5VBlockDevice::serveRequest(Queue &queue, Chain &req)
+{
+    if (req.segs.empty())
+        return 0;
+
+    PVBlkReqHdr hdr;
+    memcpy(&hdr, &req.buf[0], sizeof(hdr));
+    uint32_t type = letoh(hdr.type);
+    uint64_t sector = letoh(hdr.sector);
+
+    // Data sits between the header and the status segment, and has
+    // to go in the direction of the request
+    unsigned data_off = req.segs[0].len;
+    unsigned data_len = req.buf.size() - data_off - req.segs.back().len;
+    uint8_t *data = &req.buf[data_off];
+    bool to_guest = true, to_disk = true;
+    for (int i = 1; i < req.segs.size() - 1; i++) {
+        to_guest = to_guest && req.segs[i].write;
+        to_disk = to_disk && !req.segs[i].write;
+    }
+
+    unsigned sectors = data_len / SectorSize;
+    bool in_range = data_len % SectorSize == 0 &&
+                    sector + sectors <= (uint64_t)queue.image->size();
+    uint8_t status = PVBLK_S_OK;
+    unsigned moved = 0;
+
+    switch (type) {
+      case PVBLK_T_IN:
+        requests[0]++;
+        if (!to_guest || !in_range) {
+            status = PVBLK_S_IOERR;
+            break;
+        }
+        for (unsigned i = 0; i < sectors; i++) {
+            if (queue.image->read(data + i * SectorSize, sector + i) !=
+                SectorSize) {
+                status = PVBLK_S_IOERR;
+                break;
+            }
+        }
+        req.usedLen = data_len;
+        moved = data_len;
+        bytesRead += data_len;
+        break;
+      case PVBLK_T_OUT:
+        requests[1]++;
+        if (!to_disk || !in_range) {
+            status = PVBLK_S_IOERR;
+            break;
+        }
+        for (unsigned i = 0; i < sectors; i++) {
+            if (queue.image->write(data + i * SectorSize, sector + i) !=
+                SectorSize) {
+                status = PVBLK_S_IOERR;
+                break;
+            }
+        }
+        moved = data_len;
+        bytesWritten += data_len;
+        break;
+      case PVBLK_T_FLUSH:
+        // Images are written through, nothing is cached here
+        requests[2]++;
+        break;
+      case PVBLK_T_GET_ID:
+        {
+            requests[3]++;
+            if (!to_guest) {
+                status = PVBLK_S_IOERR;
+                break;
+            }
+            std::string id = csprintf("PARDg5V-blk%d", queue.q);
+            req.usedLen = std::min<unsigned>(data_len, PVBLK_ID_BYTES);
+            memset(data, 0, req.usedLen);
+            memcpy(data, id.c_str(),
+                   std::min<unsigned>(id.size(), req.usedLen));
+        }
+        break;
+      default:
+        requests[4]++;
+        status = PVBLK_S_UNSUPP;
+        break;
+    }
+
+    DPRINTF(PARDg5VBlock, "queue %d request %d type %d sector %d len %d: "
+            "status %d\n", queue.q, req.head, type, sector, data_len, status);
+    if (status != PVBLK_S_OK)
+        errors++;
+
+    // The status byte is the last one of the chain
+    req.buf.back() = status;
+    req.usedLen += 1;
+    return moved;
+}
+
+void
+PARDg5VBlockDevice::checkDrain()
+{
+    if (!drainManager || busy())
+        return;
+
+    DPRINTF(Drain, "%s done draining queues\n", name());
+    drainManager->signalDrainDone();
+    drainManager = NULL;
+}
+
+unsigned int
+PARDg5VBlockDevice::drain(DrainManager *dm)
+{
+    unsigned int count = PARDg5VPciDevice::drain(dm);
+
+    // Batches in flight finish first, only idle queues are saved
+    if (busy()) {
+        drainManager = dm;
+        count++;
+    }
+
+    if (count)
+        setDrainState(Drainable::Draining);
+    else
+        setDrainState(Drainable::Drained);
+    return count;
+}
+
+void
+PARDg5VBlockDevice::serialize(std::ostream &os)
+{
+    PARDg5VPciDevice::serialize(os);
+
+    for (int i = 0; i < queues.size(); i++) {
+        Queue &queue = queues[i];
+        assert(queue.stage == PVRingQueue::Idle);
+        std::string base = csprintf("queue%d", i);
+        paramOut(os, base + ".DSid", queue.DSid);
+        paramOut(os, base + ".size", queue.ring.size);
+        paramOut(os, base + ".desc", queue.ring.desc);
+        paramOut(os, base + ".avail", queue.ring.avail);
+        paramOut(os, base + ".used", queue.ring.used);
+        paramOut(os, base + ".status", queue.status);
+        paramOut(os, base + ".isr", queue.isr);
+        paramOut(os, base + ".lastAvail", queue.ring.lastAvail);
+        paramOut(os, base + ".usedIdx", queue.ring.usedIdx);
+    }
+}
+
+void
+PARDg5VBlockDevice::unserialize(Checkpoint *cp, const std::string &section)
+{
+    PARDg5VPciDevice::unserialize(cp, section);
+
+    for (int i = 0; i < queues.size(); i++) {
+        Queue &queue = queues[i];
+        std::string base = csprintf("queue%d", i);
+        paramIn(cp, section, base + ".DSid", queue.DSid);
+        paramIn(cp, section, base + ".size", queue.ring.size);
+        paramIn(cp, section, base + ".desc", queue.ring.desc);
+        paramIn(cp, section, base + ".avail", queue.ring.avail);
+        paramIn(cp, section, base + ".used", queue.ring.used);
+        paramIn(cp, section, base + ".status", queue.status);
+        paramIn(cp, section, base + ".isr", queue.isr);
+        paramIn(cp, section, base + ".lastAvail", queue.ring.lastAvail);
+        paramIn(cp, section, base + ".usedIdx", queue.ring.usedIdx);
+    }
+}
+
+PARDg5VBlockDevice *
+PARDg5VBlockDeviceParams::create()
+{
+    return new PARDg5VBlockDevice(this);
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/** @file
+ * Paravirtual block device with descriptor rings in guest memory
+ */
+
+#ifndef __DEV_PARD_PV_BLK_HH__
+#define __DEV_PARD_PV_BLK_HH__
+
+#include <vector>
+
+#include "base/statistics.hh"
+#include "dev/disk_image.hh"
+#include "dev/pard/pcidev.hh"
+#include "dev/pard/pv_ring.hh"
+#include "params/PARDg5VBlockDevice.hh"
+
+/**
+ * BAR0 registers, 32-bit accesses only. 64-bit values are split into
+ * a low and a high word.
+ */
+#define PVBLK_FEATURES          0x00    // RO
+#define PVBLK_CAPACITY          0x04    // RO, in sectors, 64-bit
+#define PVBLK_QUEUE_MAX         0x0C    // RO, largest ring accepted
+#define PVBLK_QUEUE_SIZE        0x10    // entries, a power of 2
+#define PVBLK_QUEUE_DESC        0x14    // descriptor table, 64-bit
+#define PVBLK_QUEUE_AVAIL       0x1C    // available ring, 64-bit
+#define PVBLK_QUEUE_USED        0x24    // used ring, 64-bit
+#define PVBLK_STATUS            0x2C
+#define PVBLK_ISR               0x30    // RO, cleared by reading
+#define PVBLK_NOTIFY            0x34    // WO, doorbell
+#define PVBLK_REG_SIZE          0x38
+
+#define PVBLK_F_FLUSH           0x0001
+
+#define PVBLK_STATUS_DRIVER_OK  0x0004
+#define PVBLK_STATUS_FAILED     0x0080  // set by the device
+
+#define PVBLK_ISR_USED          0x0001
+
+/**
+ * Request header, the first descriptor of a chain. Data descriptors
+ * follow, the last byte of the last descriptor receives the status.
+ */
+struct PVBlkReqHdr {
+    uint32_t type;
+    uint32_t __reserved;
+    uint64_t sector;
+};
+#define PVBLK_T_IN              0
+#define PVBLK_T_OUT             1
+#define PVBLK_T_FLUSH           4
+#define PVBLK_T_GET_ID          8
+
+#define PVBLK_S_OK              0
+#define PVBLK_S_IOERR           1
+#define PVBLK_S_UNSUPP          2
+
+#define PVBLK_ID_BYTES          20
+
+/**
+ * Block device a guest drives through a descriptor ring instead of
+ * emulated ATA registers. The guest queues any number of requests and
+ * rings the doorbell once. The device then fetches the new ring
+ * entries, the descriptor table and all request buffers in a few large
+ * DMAs, serves the batch from the disk image and posts one interrupt
+ * when the used ring is updated.
+ *
+ * Every virtual function has its own ring and disk image, so LDomains
+ * sharing the device don't see each other's requests or data. DSids
+ * without a VF use the physical function.
+ */
+class PARDg5VBlockDevice : public PARDg5VPciDevice
+{
+  protected:
+    typedef PVRingQueue::Chain Chain;
+
+    /** Ring of one function, with the registers its driver sees */
+    class Queue : public PVRingQueue
+    {
+      public:
+        PARDg5VBlockDevice *dev;
+        unsigned q;
+        uint16_t DSid;
+        DiskImage *image;
+
+        /** Registers */
+        uint32_t status;
+        uint32_t isr;
+
+        Queue() : dev(NULL), q(0), DSid(0), image(NULL), status(0), isr(0)
+        { }
+
+        /** DSid the DMAs and interrupts of the queue are tagged with */
+        uint16_t dmaDSid() const { return q ? DSid : dev->_DSid; }
+
+      protected:
+        virtual void dmaRead(Addr addr, int size, void *data);
+        virtual void dmaWrite(Addr addr, int size, void *data);
+        virtual bool running() const;
+        virtual void failed();
+        virtual bool checkChain(const Chain &chain, uint64_t total);
+        virtual bool transfer(unsigned step);
+        virtual void batchDone(bool intr);
+        virtual void idle() { dev->checkDrain(); }
+    };
+
+    /** Queue 0 belongs to the physical function, queue i + 1 to VF i */
+    std::vector<Queue> queues;
+
+    const Tick latency;
+    /** Disk bandwidth in ticks per byte */
+    const double bandwidth;
+    const unsigned queueMax;
+
+    DrainManager *drainManager;
+
+    Stats::Scalar notifies;
+    Stats::Scalar batches;
+    Stats::Vector requests;
+    Stats::Scalar errors;
+    Stats::Scalar bytesRead;
+    Stats::Scalar bytesWritten;
+    Stats::Scalar interrupts;
+    Stats::Formula avgBatch;
+
+  protected:
+    /** Queue the function DSid sees is backed by */
+    Queue &getQueue(uint16_t DSid)
+    { return queues[findVF(DSid) + 1]; }
+
+    void resetQueue(Queue &queue);
+    bool busy() const;
+
+    /** @return bytes moved from or to the disk image */
+    unsigned serveRequest(Queue &queue, Chain &req);
+
+    /** Queue went idle, finish a pending drain */
+    void checkDrain();
+
+    virtual void vfEnable(int vf);
+    virtual void vfDisable(int vf);
+
+  public:
+    typedef PARDg5VBlockDeviceParams Params;
+    const Params *params() const { return (const Params *)_params; }
+    PARDg5VBlockDevice(Params *p);
+
+    virtual Tick read(PacketPtr pkt);
+    virtual Tick write(PacketPtr pkt);
+
+    virtual void regStats();
+    virtual unsigned int drain(DrainManager *dm);
+
+    virtual void serialize(std::ostream &os);
+    virtual void unserialize(Checkpoint *cp, const std::string &section);
+};
+
+#endif // __DEV_PARD_PV_BLK_HH__
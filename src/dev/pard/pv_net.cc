@@ -0,0 +1,741 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/** @file
+ * Paravirtual network device with descriptor rings in guest memory
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "base/bitfield.hh"
+#include "base/intmath.hh"
+#include "base/trace.hh"
+#include "debug/Drain.hh"
+#include "debug/PARDg5VNet.hh"
+#include "dev/pard/pv_net.hh"
+#include "sim/byteswap.hh"
+#include "sim/core.hh"
+#include "sim/serialize.hh"
+
+PARDg5VNetDevice::PARDg5VNetDevice(Params *p)
+    : PARDg5VPciDevice(p), fns(p->num_vfs + 1), interface(NULL),
+      tap(p->tap), intrDelay(p->intr_delay),
+      rxFifoSize(p->rx_fifo_size), queueMax(p->queue_max),
+      drainManager(NULL)
+{
+    fatal_if(!isPowerOf2(queueMax) || queueMax > 32768,
+             "%s: queue_max %d not a power of 2 up to 32768\n",
+             name(), queueMax);
+
+    interface = new PVNetInt(name() + ".int0", this);
+
+    // VF i gets the address i + 1 after the one of the physical function
+    uint64_t base = 0;
+    const uint8_t *hwaddr = p->hardware_address.bytes();
+    for (int b = 0; b < ETH_ADDR_LEN; b++)
+        base = (base << 8) | hwaddr[b];
+
+    for (int i = 0; i < fns.size(); i++) {
+        Function &f = fns[i];
+        f.DSid = 0;
+        for (int b = 0; b < ETH_ADDR_LEN; b++)
+            f.mac[b] = (base + i) >> (8 * (ETH_ADDR_LEN - 1 - b));
+        f.lastIntr = 0;
+        f.intrScheduled = false;
+        for (int dir = RX; dir <= TX; dir++) {
+            f.queues[dir].dev = this;
+            f.queues[dir].fn = i;
+            f.queues[dir].dir = (Direction)dir;
+        }
+        resetFunction(f);
+    }
+}
+
+PARDg5VNetDevice::~PARDg5VNetDevice()
+{
+    delete interface;
+}
+
+void
+PARDg5VNetDevice::init()
+{
+    PARDg5VPciDevice::init();
+
+    // The tap is our only link partner, no EtherLink in between
+    if (tap) {
+        EtherInt *peer = tap->getEthPort("tap", 0);
+        fatal_if(!peer, "%s: %s has no tap interface\n",
+                 name(), tap->name());
+        interface->setPeer(peer);
+        peer->setPeer(interface);
+    } else {
+        warn("%s: not attached to a tap, frames only go between "
+             "functions\n", name());
+    }
+}
+
+void
+PARDg5VNetDevice::regStats()
+{
+    using namespace Stats;
+
+    PARDg5VPciDevice::regStats();
+
+    notifies
+        .init(2)
+        .name(name() + ".notifies")
+        .desc("Doorbell writes")
+        .flags(total)
+        ;
+    notifies.subname(RX, "rx");
+    notifies.subname(TX, "tx");
+    batches
+        .init(2)
+        .name(name() + ".batches")
+        .desc("Batches of ring entries served")
+        .flags(total)
+        ;
+    batches.subname(RX, "rx");
+    batches.subname(TX, "tx");
+    txPackets
+        .name(name() + ".txPackets")
+        .desc("Frames transmitted by the guests")
+        ;
+    txBytes
+        .name(name() + ".txBytes")
+        .desc("Bytes transmitted by the guests")
+        ;
+    txDrops
+        .name(name() + ".txDrops")
+        .desc("Frames the tap did not take")
+        ;
+    rxPackets
+        .name(name() + ".rxPackets")
+        .desc("Frames received by the guests")
+        ;
+    rxBytes
+        .name(name() + ".rxBytes")
+        .desc("Bytes received by the guests")
+        ;
+    rxDrops
+        .name(name() + ".rxDrops")
+        .desc("Frames dropped on a full FIFO or a too small buffer")
+        ;
+    localPackets
+        .name(name() + ".localPackets")
+        .desc("Frames passed from one function to another")
+        ;
+    errors
+        .name(name() + ".errors")
+        .desc("Malformed descriptor chains")
+        ;
+    interrupts
+        .name(name() + ".interrupts")
+        .desc("Interrupts posted")
+        ;
+    moderated
+        .name(name() + ".moderated")
+        .desc("Events delayed or folded by interrupt moderation")
+        ;
+    avgTxBatch
+        .name(name() + ".avgTxBatch")
+        .desc("Average frames per TX batch")
+        ;
+    avgTxBatch = txPackets / batches[TX];
+    avgRxBatch
+        .name(name() + ".avgRxBatch")
+        .desc("Average frames per RX batch")
+        ;
+    avgRxBatch = rxPackets / batches[RX];
+}
+
+void
+PARDg5VNetDevice::resetFunction(Function &f)
+{
+    // A batch in flight is dropped when its DMAs come back, a pending
+    // interrupt when its timer fires
+    for (auto &queue : f.queues)
+        queue.reset();
+    f.status = 0;
+    f.isr = 0;
+    f.itr = intrDelay;
+    f.rxFifo.clear();
+}
+
+bool
+PARDg5VNetDevice::busy() const
+{
+    for (auto &f : fns) {
+        if (f.intrScheduled)
+            return true;
+        for (auto &queue : f.queues) {
+            if (queue.stage != PVRingQueue::Idle)
+                return true;
+        }
+    }
+    return false;
+}
+
+void
+PARDg5VNetDevice::vfEnable(int vf)
+{
+    Function &f = fns[vf + 1];
+    resetFunction(f);
+    f.DSid = vfs[vf].DSid;
+}
+
+void
+PARDg5VNetDevice::vfDisable(int vf)
+{
+    resetFunction(fns[vf + 1]);
+}
+
+Tick
+PARDg5VNetDevice::read(PacketPtr pkt)
+{
+    int bar;
+    Addr offs;
+    if (!getBAR(pkt->getAddr(), bar, offs))
+        panic("Invalid PCI memory access to unmapped memory.\n");
+    if (isMsixAccess(bar, offs))
+        return readMsix(pkt, bar, offs);
+    if (bar != 0 || pkt->getSize() != sizeof(uint32_t))
+        panic("%s: bad read of BAR%d offset %#x size %d\n",
+              name(), bar, offs, pkt->getSize());
+
+    Function &f = fns[findVF(pkt->getDSid()) + 1];
+    uint32_t value = 0;
+
+    if (offs >= PVNET_RXQ && offs < PVNET_REG_SIZE) {
+        PVRing &ring = f.queues[offs < PVNET_TXQ ? RX : TX].ring;
+        switch ((offs - PVNET_RXQ) % PVNET_Q_REG_SIZE) {
+          case PVNET_Q_SIZE:
+            value = ring.size;
+            break;
+          case PVNET_Q_DESC:
+            value = bits(ring.desc, 31, 0);
+            break;
+          case PVNET_Q_DESC + 4:
+            value = bits(ring.desc, 63, 32);
+            break;
+          case PVNET_Q_AVAIL:
+            value = bits(ring.avail, 31, 0);
+            break;
+          case PVNET_Q_AVAIL + 4:
+            value = bits(ring.avail, 63, 32);
+            break;
+          case PVNET_Q_USED:
+            value = bits(ring.used, 31, 0);
+            break;
+          case PVNET_Q_USED + 4:
+            value = bits(ring.used, 63, 32);
+            break;
+          default:
+            break;
+        }
+    } else {
+        switch (offs) {
+          case PVNET_FEATURES:
+            value = PVNET_F_MAC;
+            break;
+          case PVNET_MAC:
+            value = f.mac[0] | f.mac[1] << 8 | f.mac[2] << 16 |
+                    f.mac[3] << 24;
+            break;
+          case PVNET_MAC + 4:
+            value = f.mac[4] | f.mac[5] << 8;
+            break;
+          case PVNET_STATUS:
+            value = f.status;
+            break;
+          case PVNET_ISR:
+            // Reading acknowledges a level triggered interrupt
+            value = f.isr;
+            f.isr = 0;
+            intrClear(pkt->getDSid());
+            break;
+          case PVNET_ITR:
+            value = f.itr / SimClock::Int::ns;
+            break;
+          case PVNET_QUEUE_MAX:
+            value = queueMax;
+            break;
+          default:
+            break;
+        }
+    }
+
+    DPRINTF(PARDg5VNet, "DSid %d read offset %#x: %#x\n",
+            pkt->getDSid(), offs, value);
+    pkt->set<uint32_t>(value);
+    pkt->makeAtomicResponse();
+    return pioDelay;
+}
+
+Tick
+PARDg5VNetDevice::write(PacketPtr pkt)
+{
+    int bar;
+    Addr offs;
+    if (!getBAR(pkt->getAddr(), bar, offs))
+        panic("Invalid PCI memory access to unmapped memory.\n");
+    if (isMsixAccess(bar, offs))
+        return writeMsix(pkt, bar, offs);
+    if (bar != 0 || pkt->getSize() != sizeof(uint32_t))
+        panic("%s: bad write of BAR%d offset %#x size %d\n",
+              name(), bar, offs, pkt->getSize());
+
+    Function &f = fns[findVF(pkt->getDSid()) + 1];
+    uint32_t value = pkt->get<uint32_t>();
+    bool on = f.status & PVNET_STATUS_DRIVER_OK;
+
+    DPRINTF(PARDg5VNet, "DSid %d write offset %#x: %#x\n",
+            pkt->getDSid(), offs, value);
+
+    if (offs >= PVNET_RXQ && offs < PVNET_REG_SIZE) {
+        Direction dir = offs < PVNET_TXQ ? RX : TX;
+        Queue &queue = f.queues[dir];
+        PVRing &ring = queue.ring;
+        Addr reg = (offs - PVNET_RXQ) % PVNET_Q_REG_SIZE;
+
+        // The rings can't move while the device uses them
+        if (on && reg != PVNET_Q_NOTIFY) {
+            warn("%s: ring of DSid %d changed while running, ignored\n",
+                 name(), pkt->getDSid());
+            pkt->makeAtomicResponse();
+            return pioDelay;
+        }
+
+        switch (reg) {
+          case PVNET_Q_SIZE:
+            if (value && isPowerOf2(value) && value <= queueMax)
+                ring.size = value;
+            else
+                warn("%s: bad queue size %d\n", name(), value);
+            break;
+          case PVNET_Q_DESC:
+            ring.desc = insertBits(ring.desc, 31, 0, value);
+            break;
+          case PVNET_Q_DESC + 4:
+            ring.desc = insertBits(ring.desc, 63, 32, value);
+            break;
+          case PVNET_Q_AVAIL:
+            ring.avail = insertBits(ring.avail, 31, 0, value);
+            break;
+          case PVNET_Q_AVAIL + 4:
+            ring.avail = insertBits(ring.avail, 63, 32, value);
+            break;
+          case PVNET_Q_USED:
+            ring.used = insertBits(ring.used, 31, 0, value);
+            break;
+          case PVNET_Q_USED + 4:
+            ring.used = insertBits(ring.used, 63, 32, value);
+            break;
+          case PVNET_Q_NOTIFY:
+            notifies[dir]++;
+            if (on)
+                queue.notify();
+            break;
+          default:
+            warn("%s: write to read-only offset %#x\n", name(), offs);
+            break;
+        }
+    } else {
+        switch (offs) {
+          case PVNET_STATUS:
+            if (value == 0) {
+                resetFunction(f);
+            } else if ((value & PVNET_STATUS_DRIVER_OK) &&
+                       (!f.queues[RX].ring.size ||
+                        !f.queues[TX].ring.size)) {
+                f.status = value | PVNET_STATUS_FAILED;
+            } else {
+                f.status = value;
+            }
+            break;
+          case PVNET_ITR:
+            f.itr = (Tick)value * SimClock::Int::ns;
+            break;
+          default:
+            warn("%s: write to read-only offset %#x\n", name(), offs);
+            break;
+        }
+    }
+
+    pkt->makeAtomicResponse();
+    return pioDelay;
+}
+
+void
+PARDg5VNetDevice::Queue::dmaRead(Addr addr, int size, void *data)
+{
+    dev->dmaRead(dev->fnDSid(fn), dev->pciToDma(addr), size,
+                 new StepEvent(this), (uint8_t *)data);
+}
+
+void
+PARDg5VNetDevice::Queue::dmaWrite(Addr addr, int size, void *data)
+{
+    dev->dmaWrite(dev->fnDSid(fn), dev->pciToDma(addr), size,
+                  new StepEvent(this), (uint8_t *)data);
+}
+
+void
+PARDg5VNetDevice::Queue::failed()
+{
+    warn("%s: available index of function %d out of range\n",
+         dev->name(), fn);
+    dev->fns[fn].status |= PVNET_STATUS_FAILED;
+}
+
+unsigned
+PARDg5VNetDevice::Queue::accept(unsigned count)
+{
+    // Every RX buffer takes one waiting frame
+    if (dir == RX)
+        count = std::min<unsigned>(count, dev->fns[fn].rxFifo.size());
+    return count;
+}
+
+bool
+PARDg5VNetDevice::Queue::wantMore() const
+{
+    // New RX buffers only matter to frames already waiting
+    return dir == TX || !dev->fns[fn].rxFifo.empty();
+}
+
+bool
+PARDg5VNetDevice::Queue::checkChain(const Chain &chain, uint64_t total)
+{
+    // The device reads TX chains and writes RX chains, nothing else
+    bool write = dir == RX;
+    bool wrong_dir = false;
+    for (auto &seg : chain.segs)
+        wrong_dir = wrong_dir || seg.write != write;
+
+    // RX buffers may be larger than a frame, TX chains are one
+    if (wrong_dir ||
+        (!write && (total < ETH_HDR_LEN || total > PVNET_MAX_FRAME))) {
+        warn("%s: malformed %s chain at descriptor %d\n",
+             dev->name(), write ? "RX" : "TX", chain.head);
+        dev->errors++;
+        return false;
+    }
+    return true;
+}
+
+bool
+PARDg5VNetDevice::Queue::transfer(unsigned step)
+{
+    if (step == 0) {
+        if (dir == TX) {
+            for (auto &chain : chains) {
+                unsigned off = 0;
+                for (auto &seg : chain.segs) {
+                    if (seg.len)
+                        read(seg.addr, seg.len, &chain.buf[off]);
+                    off += seg.len;
+                }
+            }
+        } else {
+            dev->fillRxChains(fn);
+            for (auto &chain : chains) {
+                unsigned off = 0;
+                for (auto &seg : chain.segs) {
+                    unsigned len = std::min(seg.len, chain.usedLen - off);
+                    if (len == 0)
+                        break;
+                    write(seg.addr, len, &chain.buf[off]);
+                    off += len;
+                }
+            }
+        }
+        return true;
+    }
+
+    // TX frames leave once they are completely fetched
+    if (dir == TX)
+        dev->sendTxChains(fn);
+    return false;
+}
+
+void
+PARDg5VNetDevice::Queue::batchDone(bool intr)
+{
+    dev->batches[dir]++;
+    if (intr)
+        dev->postIntr(fn, dir == RX ? PVNET_ISR_RX : PVNET_ISR_TX);
+}
+
+void
+PARDg5VNetDevice::fillRxChains(unsigned fn)
+{
+    Function &f = fns[fn];
+    for (auto &chain : f.queues[RX].chains) {
+        // A reset may have emptied the FIFO since the ring was fetched
+        if (chain.segs.empty() || f.rxFifo.empty())
+            continue;
+
+        EthPacketPtr pkt = f.rxFifo.front();
+        f.rxFifo.pop_front();
+
+        uint64_t room = 0;
+        for (auto &seg : chain.segs)
+            room += seg.len;
+        if (pkt->length > room) {
+            DPRINTF(PARDg5VNet, "fn %d: %d bytes frame doesn't fit into "
+                    "buffer %d\n", fn, pkt->length, chain.head);
+            rxDrops++;
+            continue;
+        }
+
+        chain.buf.assign(pkt->data, pkt->data + pkt->length);
+        chain.usedLen = pkt->length;
+        rxPackets++;
+        rxBytes += pkt->length;
+    }
+}
+
+void
+PARDg5VNetDevice::sendTxChains(unsigned fn)
+{
+    for (auto &chain : fns[fn].queues[TX].chains) {
+        if (chain.segs.empty())
+            continue;
+
+        EthPacketPtr pkt = std::make_shared<EthPacketData>(chain.buf.size());
+        pkt->length = chain.buf.size();
+        memcpy(pkt->data, &chain.buf[0], pkt->length);
+        txPackets++;
+        txBytes += pkt->length;
+        sendFrame(fn, pkt);
+    }
+}
+
+void
+PARDg5VNetDevice::sendFrame(unsigned from, EthPacketPtr pkt)
+{
+    const uint8_t *dst = pkt->data;
+    bool group = dst[0] & 0x01;
+
+    // Unicast to another function stays in the device, group frames
+    // go everywhere
+    for (unsigned fn = 0; fn < fns.size(); fn++) {
+        if (fn == from || !running(fns[fn]))
+            continue;
+        if (group || memcmp(dst, fns[fn].mac, ETH_ADDR_LEN) == 0) {
+            localPackets++;
+            deliver(fn, pkt);
+            if (!group)
+                return;
+        }
+    }
+
+    if (!interface->getPeer() || !interface->sendPacket(pkt)) {
+        DPRINTF(PARDg5VNet, "fn %d: tap dropped %d bytes frame\n",
+                from, pkt->length);
+        txDrops++;
+    }
+}
+
+bool
+PARDg5VNetDevice::recvPacket(EthPacketPtr pkt)
+{
+    if (pkt->length < ETH_HDR_LEN || pkt->length > PVNET_MAX_FRAME) {
+        rxDrops++;
+        return true;
+    }
+
+    const uint8_t *dst = pkt->data;
+    bool group = dst[0] & 0x01;
+    for (unsigned fn = 0; fn < fns.size(); fn++) {
+        if (!running(fns[fn]))
+            continue;
+        if (group || memcmp(dst, fns[fn].mac, ETH_ADDR_LEN) == 0) {
+            deliver(fn, pkt);
+            if (!group)
+                break;
+        }
+    }
+
+    // Frames for nobody are filtered like on a real NIC, the tap never
+    // has to retry
+    return true;
+}
+
+void
+PARDg5VNetDevice::deliver(unsigned fn, EthPacketPtr pkt)
+{
+    Function &f = fns[fn];
+    if (f.rxFifo.size() >= rxFifoSize) {
+        DPRINTF(PARDg5VNet, "fn %d: RX FIFO full, frame dropped\n", fn);
+        rxDrops++;
+        return;
+    }
+
+    // Frames behind the first wait for the guest to post buffers
+    f.rxFifo.push_back(pkt);
+    if (f.rxFifo.size() == 1 && f.queues[RX].stage == PVRingQueue::Idle)
+        f.queues[RX].notify();
+}
+
+void
+PARDg5VNetDevice::postIntr(unsigned fn, uint32_t bits)
+{
+    Function &f = fns[fn];
+    f.isr |= bits;
+
+    if (f.intrScheduled) {
+        moderated++;
+        return;
+    }
+
+    Tick when = f.lastIntr + f.itr;
+    if (f.itr == 0 || when <= curTick()) {
+        raiseIntr(fn);
+        return;
+    }
+
+    moderated++;
+    f.intrScheduled = true;
+    schedule(new IntrEvent(this, fn), when);
+}
+
+void
+PARDg5VNetDevice::raiseIntr(unsigned fn)
+{
+    fns[fn].lastIntr = curTick();
+    interrupts++;
+    intrPost(fnDSid(fn));
+}
+
+void
+PARDg5VNetDevice::intrTimer(unsigned fn)
+{
+    Function &f = fns[fn];
+    f.intrScheduled = false;
+
+    // Nothing to do if the guest polled the ISR meanwhile
+    if (running(f) && f.isr)
+        raiseIntr(fn);
+    checkDrain();
+}
+
+void
+PARDg5VNetDevice::checkDrain()
+{
+    if (!drainManager || busy())
+        return;
+
+    DPRINTF(Drain, "%s done draining rings\n", name());
+    drainManager->signalDrainDone();
+    drainManager = NULL;
+}
+
+unsigned int
+PARDg5VNetDevice::drain(DrainManager *dm)
+{
+    unsigned int count = PARDg5VPciDevice::drain(dm);
+
+    // Batches and held back interrupts finish first. Frames waiting in
+    // the FIFOs are not saved, like frames on the wire.
+    if (busy()) {
+        drainManager = dm;
+        count++;
+    }
+
+    if (count)
+        setDrainState(Drainable::Draining);
+    else
+        setDrainState(Drainable::Drained);
+    return count;
+}
+
+void
+PARDg5VNetDevice::serialize(std::ostream &os)
+{
+    PARDg5VPciDevice::serialize(os);
+
+    for (int i = 0; i < fns.size(); i++) {
+        Function &f = fns[i];
+        assert(!f.intrScheduled);
+        std::string base = csprintf("fn%d", i);
+        paramOut(os, base + ".DSid", f.DSid);
+        paramOut(os, base + ".status", f.status);
+        paramOut(os, base + ".isr", f.isr);
+        paramOut(os, base + ".itr", f.itr);
+        paramOut(os, base + ".lastIntr", f.lastIntr);
+        for (int dir = RX; dir <= TX; dir++) {
+            PVRing &ring = f.queues[dir].ring;
+            assert(f.queues[dir].stage == PVRingQueue::Idle);
+            std::string q = base + (dir == RX ? ".rx" : ".tx");
+            paramOut(os, q + ".size", ring.size);
+            paramOut(os, q + ".desc", ring.desc);
+            paramOut(os, q + ".avail", ring.avail);
+            paramOut(os, q + ".used", ring.used);
+            paramOut(os, q + ".lastAvail", ring.lastAvail);
+            paramOut(os, q + ".usedIdx", ring.usedIdx);
+        }
+    }
+}
+
+void
+PARDg5VNetDevice::unserialize(Checkpoint *cp, const std::string &section)
+{
+    PARDg5VPciDevice::unserialize(cp, section);
+
+    for (int i = 0; i < fns.size(); i++) {
+        Function &f = fns[i];
+        std::string base = csprintf("fn%d", i);
+        paramIn(cp, section, base + ".DSid", f.DSid);
+        paramIn(cp, section, base + ".status", f.status);
+        paramIn(cp, section, base + ".isr", f.isr);
+        paramIn(cp, section, base + ".itr", f.itr);
+        paramIn(cp, section, base + ".lastIntr", f.lastIntr);
+        for (int dir = RX; dir <= TX; dir++) {
+            PVRing &ring = f.queues[dir].ring;
+            std::string q = base + (dir == RX ? ".rx" : ".tx");
+            paramIn(cp, section, q + ".size", ring.size);
+            paramIn(cp, section, q + ".desc", ring.desc);
+            paramIn(cp, section, q + ".avail", ring.avail);
+            paramIn(cp, section, q + ".used", ring.used);
+            paramIn(cp, section, q + ".lastAvail", ring.lastAvail);
+            paramIn(cp, section, q + ".usedIdx", ring.usedIdx);
+        }
+    }
+}
+
+PARDg5VNetDevice *
+PARDg5VNetDeviceParams::create()
+{
+    return new PARDg5VNetDevice(this);
+}
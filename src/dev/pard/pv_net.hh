@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/** @file
+ * Paravirtual network device with descriptor rings in guest memory
+ */
+
+#ifndef __DEV_PARD_PV_NET_HH__
+#define __DEV_PARD_PV_NET_HH__
+
+#include <deque>
+#include <vector>
+
+#include "base/inet.hh"
+#include "base/statistics.hh"
+#include "dev/etherint.hh"
+#include "dev/etherpkt.hh"
+#include "dev/pard/ethertap.hh"
+#include "dev/pard/pcidev.hh"
+#include "dev/pard/pv_ring.hh"
+#include "params/PARDg5VNetDevice.hh"
+
+/**
+ * BAR0 registers, 32-bit accesses only. 64-bit values are split into
+ * a low and a high word.
+ */
+#define PVNET_FEATURES          0x00    // RO
+#define PVNET_MAC               0x04    // RO, 48-bit
+#define PVNET_STATUS            0x0C
+#define PVNET_ISR               0x10    // RO, cleared by reading
+#define PVNET_ITR               0x14    // min ns between two interrupts
+#define PVNET_QUEUE_MAX         0x18    // RO, largest ring accepted
+#define PVNET_RXQ               0x20    // RX ring registers
+#define PVNET_TXQ               0x40    // TX ring registers
+#define PVNET_REG_SIZE          0x60
+
+// Ring registers, relative to PVNET_RXQ or PVNET_TXQ
+#define PVNET_Q_SIZE            0x00    // entries, a power of 2
+#define PVNET_Q_DESC            0x04    // descriptor table, 64-bit
+#define PVNET_Q_AVAIL           0x0C    // available ring, 64-bit
+#define PVNET_Q_USED            0x14    // used ring, 64-bit
+#define PVNET_Q_NOTIFY          0x1C    // WO, doorbell
+#define PVNET_Q_REG_SIZE        0x20
+
+#define PVNET_F_MAC             0x0001
+
+#define PVNET_STATUS_DRIVER_OK  0x0004
+#define PVNET_STATUS_FAILED     0x0080  // set by the device
+
+#define PVNET_ISR_RX            0x0001
+#define PVNET_ISR_TX            0x0002
+
+/** Largest frame sent or received, without FCS */
+#define PVNET_MAX_FRAME         9018
+
+/**
+ * Network device a guest drives through an RX and a TX descriptor ring
+ * instead of per-packet register accesses. A TX doorbell makes the
+ * device fetch every new chain, send the frames to the tap and post a
+ * single interrupt. Received frames wait in a small FIFO until the
+ * device moves as many as the guest has buffers for in one batch.
+ * Interrupts of a function are at least ITR apart, events in between
+ * are folded into the next one.
+ *
+ * Every virtual function has its own ring pair and MAC address, frames
+ * from the tap are handed to the function their destination belongs
+ * to, broadcasts to all of them. Frames between two functions don't
+ * leave the device. DSids without a VF use the physical function.
+ */
+class PARDg5VNetDevice : public PARDg5VPciDevice
+{
+  protected:
+    enum Direction {
+        RX = 0,
+        TX = 1,
+    };
+
+    typedef PVRingQueue::Chain Chain;
+
+    /** RX or TX ring of one function */
+    class Queue : public PVRingQueue
+    {
+      public:
+        PARDg5VNetDevice *dev;
+        unsigned fn;
+        Direction dir;
+
+        Queue() : dev(NULL), fn(0), dir(RX) { }
+
+      protected:
+        virtual void dmaRead(Addr addr, int size, void *data);
+        virtual void dmaWrite(Addr addr, int size, void *data);
+        virtual bool running() const { return dev->running(dev->fns[fn]); }
+        virtual void failed();
+        virtual unsigned accept(unsigned count);
+        virtual bool wantMore() const;
+        virtual bool checkChain(const Chain &chain, uint64_t total);
+        virtual bool transfer(unsigned step);
+        virtual void batchDone(bool intr);
+        virtual void idle() { dev->checkDrain(); }
+    };
+
+    struct Function
+    {
+        uint16_t DSid;
+        uint8_t mac[ETH_ADDR_LEN];
+
+        /** Registers */
+        uint32_t status;
+        uint32_t isr;
+        Tick itr;
+
+        Queue queues[2];
+
+        /** Frames from the wire waiting for RX buffers */
+        std::deque<EthPacketPtr> rxFifo;
+
+        /** Interrupt moderation */
+        Tick lastIntr;
+        bool intrScheduled;
+    };
+
+    /** Function 0 is the physical function, function i + 1 is VF i */
+    std::vector<Function> fns;
+
+    /** Raises an interrupt held back by moderation */
+    class IntrEvent : public Event
+    {
+      private:
+        PARDg5VNetDevice *dev;
+        unsigned fn;
+
+      public:
+        IntrEvent(PARDg5VNetDevice *_dev, unsigned _fn)
+            : Event(Default_Pri, AutoDelete), dev(_dev), fn(_fn)
+        { }
+        void process() { dev->intrTimer(fn); }
+        const char *description() const
+        { return "PARDg5VNetDevice interrupt event"; }
+    };
+
+    class PVNetInt : public EtherInt
+    {
+      private:
+        PARDg5VNetDevice *dev;
+
+      public:
+        PVNetInt(const std::string &name, PARDg5VNetDevice *_dev)
+            : EtherInt(name), dev(_dev)
+        { }
+
+        virtual bool recvPacket(EthPacketPtr pkt)
+        { return dev->recvPacket(pkt); }
+        virtual void sendDone() { }
+    };
+
+    PVNetInt *interface;
+    PARDg5VISA::EtherTap *tap;
+
+    const Tick intrDelay;
+    const unsigned rxFifoSize;
+    const unsigned queueMax;
+
+    DrainManager *drainManager;
+
+    Stats::Vector notifies;
+    Stats::Vector batches;
+    Stats::Scalar txPackets;
+    Stats::Scalar txBytes;
+    Stats::Scalar txDrops;
+    Stats::Scalar rxPackets;
+    Stats::Scalar rxBytes;
+    Stats::Scalar rxDrops;
+    Stats::Scalar localPackets;
+    Stats::Scalar errors;
+    Stats::Scalar interrupts;
+    Stats::Scalar moderated;
+    Stats::Formula avgTxBatch;
+    Stats::Formula avgRxBatch;
+
+  protected:
+    void resetFunction(Function &f);
+    bool running(const Function &f) const
+    {
+        return (f.status & PVNET_STATUS_DRIVER_OK) &&
+               !(f.status & PVNET_STATUS_FAILED);
+    }
+    bool busy() const;
+
+    /** DSid the DMAs and interrupts of function fn are tagged with */
+    uint16_t fnDSid(unsigned fn) const
+    { return fn ? fns[fn].DSid : _DSid; }
+
+    /** Move waiting frames into the fetched RX chains */
+    void fillRxChains(unsigned fn);
+    void sendTxChains(unsigned fn);
+
+    /** Hand a frame to the tap and the functions it is addressed to */
+    void sendFrame(unsigned from, EthPacketPtr pkt);
+    /** Queue a frame for function fn, dropped if its FIFO is full */
+    void deliver(unsigned fn, EthPacketPtr pkt);
+
+    /** Set ISR bits and raise the interrupt when moderation allows */
+    void postIntr(unsigned fn, uint32_t bits);
+    void raiseIntr(unsigned fn);
+    void intrTimer(unsigned fn);
+
+    /** Queue went idle or a timer expired, finish a pending drain */
+    void checkDrain();
+
+    virtual void vfEnable(int vf);
+    virtual void vfDisable(int vf);
+
+  public:
+    typedef PARDg5VNetDeviceParams Params;
+    const Params *params() const { return (const Params *)_params; }
+    PARDg5VNetDevice(Params *p);
+    ~PARDg5VNetDevice();
+
+    /** Frame from the tap */
+    bool recvPacket(EthPacketPtr pkt);
+
+    virtual void init();
+
+    virtual Tick read(PacketPtr pkt);
+    virtual Tick write(PacketPtr pkt);
+
+    virtual void regStats();
+    virtual unsigned int drain(DrainManager *dm);
+
+    virtual void serialize(std::ostream &os);
+    virtual void unserialize(Checkpoint *cp, const std::string &section);
+};
+
+#endif // __DEV_PARD_PV_NET_HH__
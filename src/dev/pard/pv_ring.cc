@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/** @file
+ * Descriptor ring shared by the PARD paravirtual devices
+ */
+
+#include <algorithm>
+#include <cassert>
+
+#include "base/misc.hh"
+#include "dev/pard/pv_ring.hh"
+#include "sim/byteswap.hh"
+
+PVRingQueue::PVRingQueue()
+    : stage(Idle), pending(0), kicked(false), transferStep(0)
+{
+    ring.reset();
+}
+
+void
+PVRingQueue::reset()
+{
+    // A batch in flight is dropped when its DMAs come back
+    ring.reset();
+    kicked = false;
+}
+
+void
+PVRingQueue::notify()
+{
+    if (stage != Idle)
+        kicked = true;
+    else if (wantMore())
+        fetchAvail();
+}
+
+void
+PVRingQueue::read(Addr addr, int size, void *data)
+{
+    pending++;
+    dmaRead(addr, size, data);
+}
+
+void
+PVRingQueue::write(Addr addr, int size, void *data)
+{
+    pending++;
+    dmaWrite(addr, size, data);
+}
+
+void
+PVRingQueue::stepDone()
+{
+    assert(pending);
+    if (--pending == 0)
+        advance();
+}
+
+void
+PVRingQueue::fetchAvail()
+{
+    stage = FetchAvail;
+    kicked = false;
+    read(ring.availHdr(), sizeof(availHdr), availHdr);
+}
+
+void
+PVRingQueue::goIdle()
+{
+    stage = Idle;
+    idle();
+}
+
+void
+PVRingQueue::parseChains()
+{
+    chains.resize(entries.size());
+    for (unsigned i = 0; i < entries.size(); i++) {
+        Chain &chain = chains[i];
+        chain.head = letoh(entries[i]);
+        chain.segs.clear();
+        chain.usedLen = 0;
+
+        // Follow the chain, at most one visit per descriptor
+        uint16_t idx = chain.head;
+        uint64_t total = 0;
+        bool ended = false;
+        for (unsigned n = 0; n < ring.size && idx < ring.size; n++) {
+            const PVRingDesc &desc = descs[idx];
+            uint16_t flags = letoh(desc.flags);
+            Segment seg = { letoh(desc.addr), letoh(desc.len),
+                            (flags & PVRING_DESC_F_WRITE) != 0 };
+            chain.segs.push_back(seg);
+            total += seg.len;
+            if (!(flags & PVRING_DESC_F_NEXT)) {
+                ended = true;
+                break;
+            }
+            idx = letoh(desc.next);
+        }
+
+        if (!ended || !checkChain(chain, total)) {
+            chain.segs.clear();
+            continue;
+        }
+        chain.buf.resize(total);
+    }
+}
+
+void
+PVRingQueue::doTransfer()
+{
+    while (transfer(transferStep++)) {
+        if (pending)
+            return;
+    }
+
+    unsigned count = chains.size();
+    usedElems.resize(count);
+    for (unsigned i = 0; i < count; i++) {
+        usedElems[i].id = htole((uint32_t)chains[i].head);
+        usedElems[i].len = htole(chains[i].usedLen);
+    }
+
+    // The used ring may wrap within the batch
+    stage = WriteUsed;
+    uint16_t idx = ring.usedIdx;
+    unsigned part = std::min(count, ring.untilWrap(idx));
+    write(ring.usedEntry(idx), part * sizeof(PVRingUsedElem),
+          &usedElems[0]);
+    if (part < count)
+        write(ring.usedEntry(idx + part),
+              (count - part) * sizeof(PVRingUsedElem), &usedElems[part]);
+}
+
+void
+PVRingQueue::advance()
+{
+    // A reset or detached function drops the batch here
+    if (!running()) {
+        goIdle();
+        return;
+    }
+
+    switch (stage) {
+      case FetchAvail:
+        {
+            uint16_t count = letoh(availHdr[1]) - ring.lastAvail;
+            if (count > ring.size) {
+                failed();
+                goIdle();
+                return;
+            }
+
+            count = accept(count);
+            if (count == 0) {
+                if (kicked && wantMore())
+                    fetchAvail();
+                else
+                    goIdle();
+                return;
+            }
+
+            // Entries up to the end of the ring, the rest comes with
+            // the next batch
+            count = std::min<unsigned>(count, ring.untilWrap(ring.lastAvail));
+            entries.resize(count);
+            stage = FetchRing;
+            read(ring.availEntry(ring.lastAvail), count * sizeof(uint16_t),
+                 &entries[0]);
+        }
+        break;
+
+      case FetchRing:
+        // One read for the whole table beats following chains
+        descs.resize(ring.size);
+        stage = FetchDesc;
+        read(ring.desc, ring.size * sizeof(PVRingDesc), &descs[0]);
+        break;
+
+      case FetchDesc:
+        parseChains();
+        stage = Transfer;
+        transferStep = 0;
+        doTransfer();
+        break;
+
+      case Transfer:
+        doTransfer();
+        break;
+
+      case WriteUsed:
+        // Publish the entries only once they are in memory
+        ring.usedIdx += chains.size();
+        newUsedIdx = htole(ring.usedIdx);
+        stage = UpdateUsed;
+        write(ring.usedIdxAddr(), sizeof(uint16_t), &newUsedIdx);
+        break;
+
+      case UpdateUsed:
+        ring.lastAvail += chains.size();
+        batchDone(!(letoh(availHdr[0]) & PVRING_AVAIL_F_NO_INTERRUPT));
+
+        // More entries may have been queued meanwhile
+        if (wantMore())
+            fetchAvail();
+        else
+            goIdle();
+        break;
+
+      default:
+        panic("PV ring queue advanced while idle\n");
+    }
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/** @file
+ * Descriptor ring shared by the PARD paravirtual devices
+ */
+
+#ifndef __DEV_PARD_PV_RING_HH__
+#define __DEV_PARD_PV_RING_HH__
+
+#include <vector>
+
+#include "base/types.hh"
+#include "sim/eventq.hh"
+
+/**
+ * Ring layout, the same as a virtio split ring. All fields are little
+ * endian.
+ */
+struct PVRingDesc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+};
+#define PVRING_DESC_F_NEXT      0x0001
+#define PVRING_DESC_F_WRITE     0x0002  // written by the device
+
+// avail ring: uint16 flags, uint16 idx, uint16 ring[size]
+#define PVRING_AVAIL_F_NO_INTERRUPT 0x0001
+
+// used ring: uint16 flags, uint16 idx, PVRingUsedElem ring[size]
+struct PVRingUsedElem {
+    uint32_t id;
+    uint32_t len;
+};
+
+/**
+ * Where a ring lives in guest memory, set up through the registers of
+ * a device, and how far the device got.
+ */
+struct PVRing
+{
+    /** Entries, a power of 2 */
+    uint32_t size;
+    Addr desc;
+    Addr avail;
+    Addr used;
+
+    /** Next available entry to fetch, and the device's used index */
+    uint16_t lastAvail;
+    uint16_t usedIdx;
+
+    void
+    reset()
+    {
+        size = 0;
+        desc = avail = used = 0;
+        lastAvail = usedIdx = 0;
+    }
+
+    Addr availHdr() const { return avail; }
+    Addr
+    availEntry(uint16_t idx) const
+    {
+        return avail + 2 * sizeof(uint16_t) +
+               (idx & (size - 1)) * sizeof(uint16_t);
+    }
+
+    Addr usedIdxAddr() const { return used + sizeof(uint16_t); }
+    Addr
+    usedEntry(uint16_t idx) const
+    {
+        return used + 2 * sizeof(uint16_t) +
+               (idx & (size - 1)) * sizeof(PVRingUsedElem);
+    }
+
+    /** Entries from idx up to the end of the ring */
+    unsigned
+    untilWrap(uint16_t idx) const
+    { return size - (idx & (size - 1)); }
+};
+
+/**
+ * Device side of one ring. A batch fetches the new available entries
+ * and the descriptor table, walks the chains, lets the device move
+ * their data and returns them through the used ring. Each step waits
+ * for the DMAs of the previous one.
+ *
+ * Devices derive their queues from this class and supply the DMAs,
+ * the checks of a chain and the data transfer.
+ */
+class PVRingQueue
+{
+  public:
+    /** Steps of a batch */
+    enum Stage {
+        Idle = 0,
+        FetchAvail,
+        FetchRing,
+        FetchDesc,
+        Transfer,
+        WriteUsed,
+        UpdateUsed,
+    };
+
+    struct Segment
+    {
+        Addr addr;
+        uint32_t len;
+        /** Written by the device */
+        bool write;
+    };
+
+    struct Chain
+    {
+        uint16_t head;
+        /** Empty for a malformed chain */
+        std::vector<Segment> segs;
+        /** All segments back to back */
+        std::vector<uint8_t> buf;
+        /** Bytes written to the chain, reported in the used ring */
+        uint32_t usedLen;
+    };
+
+    /** Completes one DMA or other event of the current step */
+    class StepEvent : public Event
+    {
+      private:
+        PVRingQueue *queue;
+
+      public:
+        StepEvent(PVRingQueue *_queue)
+            : Event(Default_Pri, AutoDelete), queue(_queue)
+        { }
+        void process() { queue->stepDone(); }
+        const char *description() const { return "PV ring step event"; }
+    };
+
+    /** Where the driver put the ring, set through device registers */
+    PVRing ring;
+    Stage stage;
+    /** Chains of the batch in progress */
+    std::vector<Chain> chains;
+
+  protected:
+    /** DMAs and events the current step waits for */
+    unsigned pending;
+    /** Doorbell rang after the available index was fetched */
+    bool kicked;
+    /** Calls of transfer() in this batch */
+    unsigned transferStep;
+
+    uint16_t availHdr[2];
+    std::vector<uint16_t> entries;
+    std::vector<PVRingDesc> descs;
+    std::vector<PVRingUsedElem> usedElems;
+    uint16_t newUsedIdx;
+
+  public:
+    PVRingQueue();
+    virtual ~PVRingQueue() { }
+
+    /** Forget the ring, a batch in flight is dropped at its next step */
+    void reset();
+
+    /** Doorbell, starts a batch if the queue is idle */
+    void notify();
+
+    /** One DMA or event of the current step finished */
+    void stepDone();
+
+    /** The device started an event that ends with stepDone() */
+    void addPending() { pending++; }
+
+  protected:
+    /** DMA for the current step */
+    void read(Addr addr, int size, void *data);
+    void write(Addr addr, int size, void *data);
+
+    void fetchAvail();
+    void advance();
+    void parseChains();
+    void doTransfer();
+    void goIdle();
+
+    /**
+     * Supplied by the device
+     * @{
+     */
+    /** Start a DMA that completes with a StepEvent of this queue */
+    virtual void dmaRead(Addr addr, int size, void *data) = 0;
+    virtual void dmaWrite(Addr addr, int size, void *data) = 0;
+    /** Driver set the ring up and it did not fail */
+    virtual bool running() const = 0;
+    /** Available index beyond the ring, the device stops the ring */
+    virtual void failed() = 0;
+    /** Entries the device takes of count available ones */
+    virtual unsigned accept(unsigned count) { return count; }
+    /** Go on with another batch when entries are available */
+    virtual bool wantMore() const { return true; }
+    /** Validate a walked chain, false drops it as malformed */
+    virtual bool checkChain(const Chain &chain, uint64_t total) = 0;
+    /**
+     * Move the data of the chains. Called again once the DMAs and
+     * events started by the previous call completed.
+     * @param step 0 for the first call of a batch
+     * @return false when the transfer is done
+     */
+    virtual bool transfer(unsigned step) = 0;
+    /** Batch is in the used ring, intr unless the driver suppressed it */
+    virtual void batchDone(bool intr) = 0;
+    /** Queue went idle */
+    virtual void idle() { }
+    /** @} */
+};
+
+#endif // __DEV_PARD_PV_RING_HH__
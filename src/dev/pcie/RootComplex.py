@@ -1,7 +1,54 @@
 from m5.params import *
+from ControlPlane import ControlPlane
 from XBridge import XBridge
 
+class RootComplexCP(ControlPlane):
+    type = 'RootComplexCP'
+    cxx_header = 'dev/pcie/root_complex_cp.hh'
+
+    # CPN address 4:0
+    cp_dev = 4
+    cp_fun = 0
+    # Type 'P' PCI-Express, IDENT: PARDg5VPCIe
+    Type = 0x50
+    IDENT = "PARDg5VPCIe"
+
+    param_table_entries = Param.Int(32, "Number of parameter table entries")
+
 class RootComplex(XBridge):
     type = 'RootComplex'
     cxx_header = "dev/pcie/root_complex.hh"
 
+    # Root Complex Control Plane, maps DSids to traffic classes
+    cp = Param.RootComplexCP(RootComplexCP(),
+                             "Control plane for PCI-Express root complex")
+
+    # Each VC has its own queue and credits, they share the link by
+    # weighted round-robin
+    num_vcs = Param.Unsigned(2, "Number of virtual channels, 1-8")
+
+    # Completions are routed back by requester ID, MAKE_PCI_ID layout
+    requester_id = Param.UInt32(0, "PCI ID of the root port")
+
+    # Device DMA goes upstream through these ports, optional
+    dma_slave = SlavePort("Slave port for DMA of the devices below")
+    dma_master = MasterPort("Master port for DMA towards host memory")
+    dma_ranges = VectorParam.AddrRange([AllMemory],
+                                       "Address ranges device DMA can reach")
+
+    link_width = Param.Unsigned(4, "Number of lanes of the link")
+    link_gen = Param.Unsigned(2, "PCI-Express generation of the link, 1-3")
+    tags = Param.Unsigned(32, "Tags for outstanding non-posted requests")
+
+    # Flow control credits of each VC, a header credit per TLP and a
+    # data credit per 16 bytes of payload. 0 advertises infinite credits.
+    posted_hdr_credits = Param.Unsigned(32, "Posted header credits")
+    posted_data_credits = Param.Unsigned(128, "Posted data credits")
+    nonposted_hdr_credits = Param.Unsigned(16, "Non-posted header credits")
+    nonposted_data_credits = Param.Unsigned(16, "Non-posted data credits")
+    cpl_hdr_credits = Param.Unsigned(0, "Completion header credits")
+    cpl_data_credits = Param.Unsigned(0, "Completion data credits")
+    fc_update_latency = Param.Latency('64ns',
+        "Delay before consumed credits are returned by an UpdateFC")
+
+    ldoms = Param.Unsigned(64, "DSids with their own link statistics")
@@ -1,15 +1,93 @@
+#include <algorithm>
+
 #include "arch/x86/x86_traits.hh"
+#include "base/bitfield.hh"
 #include "dev/pcie/root_complex.hh"
+#include "dev/pcie/root_complex_cp.hh"
 #include "debug/RootComplex.hh"
 #include "params/RootComplex.hh"
+#include "sim/core.hh"
+#include "sim/stats.hh"
+
+const char *
+PciExpressTLP::typeName(TLPType type)
+{
+    static const char *names[NUM_TLPTYPES] = {
+        "MRd", "MRdLk", "MWr",
+        "IORd", "IOWr",
+        "CfgRd0", "CfgWr0", "CfgRd1", "CfgWr1",
+        "Msg", "MsgD",
+        "Cpl", "CplD",
+    };
+    return names[type];
+}
+
+/**
+ * Bytes per second over all lanes, after line encoding: Gen1 and Gen2
+ * use 8b/10b, Gen3 128b/130b.
+ */
+static double
+linkBandwidth(unsigned gen, unsigned width)
+{
+    switch (gen) {
+      case 1:
+        return 2.5e9 * 8 / 10 / 8 * width;
+      case 2:
+        return 5.0e9 * 8 / 10 / 8 * width;
+      case 3:
+        return 8.0e9 * 128 / 130 / 8 * width;
+      default:
+        fatal("Unsupported PCI-Express generation %d\n", gen);
+    }
+}
 
 RootComplex::RootComplex(Params *p)
     : XBridge(p),
       slavePort(p->name + ".slave", *this, masterPort,
-                ticksToCycles(p->delay), p->resp_size, p->ranges),
+                ticksToCycles(p->delay), p->resp_size, p->ranges, Down),
       masterPort(p->name + ".master", *this, slavePort,
-                 ticksToCycles(p->delay), p->req_size)
+                 ticksToCycles(p->delay), p->req_size, Down, p->num_vcs),
+      dmaSlavePort(p->name + ".dma_slave", *this, dmaMasterPort,
+                   ticksToCycles(p->delay), p->resp_size, p->dma_ranges,
+                   Up),
+      dmaMasterPort(p->name + ".dma_master", *this, dmaSlavePort,
+                    ticksToCycles(p->delay), p->req_size, Up, p->num_vcs),
+      cp(p->cp), numVCs(p->num_vcs),
+      requesterID(p->requester_id),
+      ticksPerByte(SimClock::Float::s /
+                   linkBandwidth(p->link_gen, p->link_width)),
+      fcUpdateLatency(p->fc_update_latency),
+      creditEvent(this), numLDoms(p->ldoms)
 {
+    fatal_if(p->link_width == 0 || p->link_width > 32,
+             "%s: invalid link width x%d\n", name(), p->link_width);
+    fatal_if(p->tags == 0 || p->tags > 256,
+             "%s: %d tags don't fit the 8-bit tag field\n", name(), p->tags);
+    fatal_if(numVCs == 0 || numVCs > MaxVCs,
+             "%s: %d VCs, between 1 and %d supported\n",
+             name(), numVCs, MaxVCs);
+    cp->regRootComplex(this, numVCs);
+
+    hdrLimit[PciExpressTLP::Posted] = p->posted_hdr_credits;
+    dataLimit[PciExpressTLP::Posted] = p->posted_data_credits;
+    hdrLimit[PciExpressTLP::NonPosted] = p->nonposted_hdr_credits;
+    dataLimit[PciExpressTLP::NonPosted] = p->nonposted_data_credits;
+    hdrLimit[PciExpressTLP::Completion] = p->cpl_hdr_credits;
+    dataLimit[PciExpressTLP::Completion] = p->cpl_data_credits;
+    for (int dir = 0; dir < NumDirs; dir++) {
+        for (int vc = 0; vc < MaxVCs; vc++) {
+            for (int fc = 0; fc < PciExpressTLP::NUM_FCCLASSES; fc++) {
+                hdrCredits[dir][vc][fc] = hdrLimit[fc];
+                dataCredits[dir][vc][fc] = dataLimit[fc];
+            }
+        }
+
+        // Lowest tags are handed out first
+        outstanding[dir].assign(p->tags, NULL);
+        for (int tag = p->tags - 1; tag >= 0; tag--)
+            freeTags[dir].push_back(tag);
+        linkFree[dir] = 0;
+    }
 }
 
 BaseMasterPort&
@@ -17,6 +95,8 @@ RootComplex::getMasterPort(const std::string &if_name, PortID idx)
 {
     if (if_name == "master")
         return masterPort;
+    else if (if_name == "dma_master")
+        return dmaMasterPort;
     else
         // pass it along to our super class
         return XBridge::getMasterPort(if_name, idx);
@@ -27,6 +107,8 @@ RootComplex::getSlavePort(const std::string &if_name, PortID idx)
 {
     if (if_name == "slave")
         return slavePort;
+    else if (if_name == "dma_slave")
+        return dmaSlavePort;
     else
         // pass it along to our super class
         return XBridge::getSlavePort(if_name, idx);
@@ -39,39 +121,400 @@ RootComplex::init()
     if (!slavePort.isConnected() || !masterPort.isConnected())
         fatal("Both ports of a bridge must be connected.\n");
 
+    // The DMA path is optional, but needs both of its ports
+    if (dmaSlavePort.isConnected() != dmaMasterPort.isConnected())
+        fatal("%s: dma_slave and dma_master must be connected together.\n",
+              name());
+
     // notify the master side  of our address ranges
     slavePort.sendRangeChange();
+    if (dmaSlavePort.isConnected())
+        dmaSlavePort.sendRangeChange();
+}
+
+void
+RootComplex::regStats()
+{
+    using namespace Stats;
+
+    XBridge::regStats();
+
+    tlps
+        .init(PciExpressTLP::NUM_TLPTYPES)
+        .name(name() + ".tlps")
+        .desc("Number of TLPs by type")
+        .flags(total | nozero)
+        ;
+    tlpBytes
+        .init(PciExpressTLP::NUM_TLPTYPES)
+        .name(name() + ".tlpBytes")
+        .desc("Bytes on the link by TLP type, framing included")
+        .flags(total | nozero)
+        ;
+    for (int type = 0; type < PciExpressTLP::NUM_TLPTYPES; type++) {
+        const char *type_name =
+            PciExpressTLP::typeName((PciExpressTLP::TLPType)type);
+        tlps.subname(type, type_name);
+        tlpBytes.subname(type, type_name);
+    }
+    ldomBytes
+        .init(numLDoms)
+        .name(name() + ".ldomBytes")
+        .desc("Payload bytes on the link by DSid")
+        .flags(total | nozero)
+        ;
+    creditStalls
+        .name(name() + ".creditStalls")
+        .desc("Arbitration rounds a VC was held back for credits")
+        ;
+    tagStalls
+        .name(name() + ".tagStalls")
+        .desc("Arbitration rounds a VC was held back for a free tag")
+        ;
+    for (int dir = 0; dir < NumDirs; dir++) {
+        const char *dir_name = dir == Down ? "down" : "up";
+        linkBusy[dir]
+            .name(csprintf("%s.%sLinkBusy", name(), dir_name))
+            .desc(csprintf("Ticks the %sstream link spent sending TLPs",
+                           dir_name))
+            ;
+        linkUtil[dir]
+            .name(csprintf("%s.%sLinkUtil", name(), dir_name))
+            .desc(csprintf("Utilization of the %sstream link", dir_name))
+            ;
+        linkUtil[dir] = linkBusy[dir] / simTicks;
+    }
+
+    // Host requests and DMA are arbitrated separately, the VC stats
+    // are kept for each direction of the requests
+    vcTLPs
+        .init(NumDirs * numVCs)
+        .name(name() + ".vcTLPs")
+        .desc("Number of request TLPs sent by each VC")
+        .flags(total)
+        ;
+    vcBytes
+        .init(NumDirs * numVCs)
+        .name(name() + ".vcBytes")
+        .desc("Payload bytes on the link by VC, requests and completions")
+        .flags(total)
+        ;
+    vcQueueLat
+        .init(NumDirs * numVCs)
+        .name(name() + ".vcQueueLat")
+        .desc("Total ticks TLPs of each VC waited for the link")
+        ;
+    vcNonPosted
+        .init(NumDirs * numVCs)
+        .name(name() + ".vcNonPosted")
+        .desc("Number of completed non-posted requests by VC")
+        ;
+    vcCplLat
+        .init(NumDirs * numVCs)
+        .name(name() + ".vcCplLat")
+        .desc("Total ticks from request to completion by VC")
+        ;
+    for (int dir = 0; dir < NumDirs; dir++) {
+        for (int vc = 0; vc < numVCs; vc++) {
+            std::string vc_name =
+                csprintf("%s_vc%d", dir == Down ? "down" : "up", vc);
+            unsigned i = vcStat((Dir)dir, vc);
+            vcTLPs.subname(i, vc_name);
+            vcBytes.subname(i, vc_name);
+            vcQueueLat.subname(i, vc_name);
+            vcNonPosted.subname(i, vc_name);
+            vcCplLat.subname(i, vc_name);
+        }
+    }
+    vcAvgQueueLat
+        .name(name() + ".vcAvgQueueLat")
+        .desc("Average ticks a TLP waited for the link by VC")
+        ;
+    vcAvgQueueLat = vcQueueLat / vcTLPs;
+    vcAvgCplLat
+        .name(name() + ".vcAvgCplLat")
+        .desc("Average ticks from request to completion by VC")
+        ;
+    vcAvgCplLat = vcCplLat / vcNonPosted;
+    vcBandwidth
+        .name(name() + ".vcBandwidth")
+        .desc("Payload bandwidth by VC (bytes/s)")
+        ;
+    vcBandwidth = vcBytes / simSeconds;
 }
 
 PciExpressTLP *
 RootComplex::buildTLP(PacketPtr pkt)
 {
-    PciExpressTLP *tlp = NULL;
+    Addr addr = pkt->getAddr();
+    bool write = pkt->isWrite();
+    PciExpressTLP::TLPType type;
+    uint32_t destID = 0;
 
     /* >= 0xC000000000000000 */
-    if (pkt->getAddr() >= X86ISA::PhysAddrPrefixPciConfig) {
-        // PCI Config 
-        tlp = new PciExpressTLP(PciExpressTLP::CfgRd1, 0, pkt);
+    if (addr >= X86ISA::PhysAddrPrefixPciConfig) {
+        // PCI Config, routed by ID. Type 0 is consumed by a device on
+        // the bus right below us, type 1 is forwarded by switches
+        Addr cfg = addr - X86ISA::PhysAddrPrefixPciConfig;
+        uint32_t bus = bits(cfg, 23, 16);
+        destID = MAKE_PCI_ID(bus, bits(cfg, 15, 11), bits(cfg, 10, 8));
+        if (bus == 0)
+            type = write ? PciExpressTLP::CfgWr0 : PciExpressTLP::CfgRd0;
+        else
+            type = write ? PciExpressTLP::CfgWr1 : PciExpressTLP::CfgRd1;
     }
     /* >= 0xA000000000000000 */
-    else if (pkt->getAddr() >= X86ISA::PhysAddrPrefixInterrupts) {
-        // Interrupts? 
+    else if (addr >= X86ISA::PhysAddrPrefixInterrupts) {
+        // Interrupts are carried by messages
+        type = pkt->hasData() ? PciExpressTLP::MsgD : PciExpressTLP::Msg;
     }
     /* >= 0x8000000000000000 */
-    else if (pkt->getAddr() >= X86ISA::PhysAddrPrefixIO) {
+    else if (addr >= X86ISA::PhysAddrPrefixIO) {
         // IO Access
+        type = write ? PciExpressTLP::IOWr : PciExpressTLP::IORd;
     }
     /* >= 0x2000000000000000 */
-    else if (pkt->getAddr() >= X86ISA::PhysAddrPrefixLocalAPIC) {
-        // LocalAPIC?
+    else if (addr >= X86ISA::PhysAddrPrefixLocalAPIC) {
+        // LocalAPIC is never behind a root port
+        return NULL;
     }
     /* Normal Memory */
     else {
-        // Memory Access
+        if (write)
+            type = PciExpressTLP::MWr;
+        else if (pkt->req->isLocked())
+            type = PciExpressTLP::MRdLk;
+        else
+            type = PciExpressTLP::MRd;
     }
+
+    PciExpressTLP *tlp = new PciExpressTLP(type, destID, requesterID, pkt);
+    tlp->tc = cp->getTrafficClass(pkt->getDSid());
+    tlp->vc = cp->getVC(tlp->tc);
     return tlp;
 }
 
+unsigned
+RootComplex::getVC(uint16_t DSid) const
+{
+    return cp->getVC(cp->getTrafficClass(DSid));
+}
+
+bool
+RootComplex::haveCredits(Dir dir, PciExpressTLP *tlp) const
+{
+    // A TLP larger than the whole receive buffer waits for it to drain
+    unsigned vc = tlp->vc;
+    auto fits = [this, dir, vc](int fc, unsigned payload) {
+        unsigned data = std::min(PciExpressTLP::dataCredits(payload),
+                                 dataLimit[fc]);
+        return (!hdrLimit[fc] || hdrCredits[dir][vc][fc] >= 1) &&
+               (!dataLimit[fc] || dataCredits[dir][vc][fc] >= data);
+    };
+
+    if (!fits(tlp->fcClass(), tlp->requestPayload()))
+        return false;
+
+    // Non-posted requests reserve room for their completion up front,
+    // a completion is never stalled once it is on the link
+    return tlp->posted() ||
+           fits(PciExpressTLP::Completion, tlp->completionPayload());
+}
+
+void
+RootComplex::consumeCredits(Dir dir, PciExpressTLP *tlp)
+{
+    unsigned vc = tlp->vc;
+    auto consume = [this, dir, vc](int fc, unsigned payload) {
+        unsigned data = std::min(PciExpressTLP::dataCredits(payload),
+                                 dataLimit[fc]);
+        if (hdrLimit[fc])
+            hdrCredits[dir][vc][fc] -= 1;
+        if (dataLimit[fc])
+            dataCredits[dir][vc][fc] -= data;
+    };
+
+    consume(tlp->fcClass(), tlp->requestPayload());
+    if (!tlp->posted())
+        consume(PciExpressTLP::Completion, tlp->completionPayload());
+}
+
+void
+RootComplex::returnCredits(Dir dir, unsigned vc, PciExpressTLP::FCClass fc,
+                           unsigned hdr, unsigned data, Tick when)
+{
+    CreditReturn ret = { when, dir, vc, fc, hdr,
+                         std::min(data, dataLimit[fc]) };
+    creditReturns.push_back(ret);
+    if (!creditEvent.scheduled())
+        schedule(creditEvent, when);
+}
+
+void
+RootComplex::processCreditReturn()
+{
+    while (!creditReturns.empty() && creditReturns.front().when <= curTick()) {
+        const CreditReturn &ret = creditReturns.front();
+        if (hdrLimit[ret.fc])
+            hdrCredits[ret.dir][ret.vc][ret.fc] += ret.hdr;
+        if (dataLimit[ret.fc])
+            dataCredits[ret.dir][ret.vc][ret.fc] += ret.data;
+        assert(hdrCredits[ret.dir][ret.vc][ret.fc] <= hdrLimit[ret.fc]);
+        assert(dataCredits[ret.dir][ret.vc][ret.fc] <= dataLimit[ret.fc]);
+        creditReturns.pop_front();
+    }
+
+    if (!creditReturns.empty())
+        schedule(creditEvent, creditReturns.front().when);
+
+    masterPort.creditsReturned();
+    dmaMasterPort.creditsReturned();
+}
+
+void
+RootComplex::sentTLP(Dir dir, PciExpressTLP *tlp)
+{
+    consumeCredits(dir, tlp);
+
+    unsigned bytes = tlp->requestWireBytes();
+    linkFree[dir] = curTick() + serializationDelay(bytes);
+    linkBusy[dir] += serializationDelay(bytes);
+
+    if (!tlp->posted()) {
+        assert(freeTags[dir].back() == tlp->tag &&
+               !outstanding[dir][tlp->tag]);
+        freeTags[dir].pop_back();
+        outstanding[dir][tlp->tag] = tlp;
+    }
+
+    // The link partner hands the buffer space back through an UpdateFC
+    // once it has taken the TLP
+    returnCredits(dir, tlp->vc, tlp->fcClass(), 1,
+                  PciExpressTLP::dataCredits(tlp->requestPayload()),
+                  curTick() + fcUpdateLatency);
+
+    tlps[tlp->type]++;
+    tlpBytes[tlp->type] += bytes;
+    if (tlp->getDSid() < numLDoms)
+        ldomBytes[tlp->getDSid()] += tlp->requestPayload();
+    vcTLPs[vcStat(dir, tlp->vc)]++;
+    vcBytes[vcStat(dir, tlp->vc)] += tlp->requestPayload();
+    vcQueueLat[vcStat(dir, tlp->vc)] += curTick() - tlp->enqueued;
+
+    // Posted requests are done once they are on the link
+    if (tlp->posted()) {
+        cp->recordTLP(tlp->getDSid(), tlp->requestPayload(),
+                      curTick() - tlp->enqueued, dir == Up);
+    }
+
+    DPRINTF(RootComplex, "Sent %s %s VC%d tag %d addr %#x, %d bytes\n",
+            dir == Down ? "down" : "up", PciExpressTLP::typeName(tlp->type),
+            tlp->vc, tlp->tag, tlp->getAddr(), bytes);
+}
+
+PacketPtr
+RootComplex::recvCompletion(Dir dir, PciExpressTLP *tlp)
+{
+    // Posted requests have no completion on the link, their response
+    // only closes the transaction in the memory system
+    if (!tlp->posted()) {
+        // Completions are routed by requester ID and matched to their
+        // request by tag
+        if (tlp->requesterID != requesterID)
+            panic("%s: completion for requester %#x routed to %#x\n",
+                  name(), tlp->requesterID, requesterID);
+        assert(outstanding[dir][tlp->tag] == tlp);
+        outstanding[dir][tlp->tag] = NULL;
+        freeTags[dir].push_back(tlp->tag);
+
+        // The requester drains the completion buffer right away
+        unsigned data = std::min(
+            PciExpressTLP::dataCredits(tlp->completionPayload()),
+            dataLimit[PciExpressTLP::Completion]);
+        if (hdrLimit[PciExpressTLP::Completion])
+            hdrCredits[dir][tlp->vc][PciExpressTLP::Completion] += 1;
+        if (dataLimit[PciExpressTLP::Completion])
+            dataCredits[dir][tlp->vc][PciExpressTLP::Completion] += data;
+
+        PciExpressTLP::TLPType cpl = tlp->cplType();
+        tlps[cpl]++;
+        tlpBytes[cpl] += tlp->completionWireBytes();
+        if (tlp->getDSid() < numLDoms)
+            ldomBytes[tlp->getDSid()] += tlp->completionPayload();
+        vcBytes[vcStat(dir, tlp->vc)] += tlp->completionPayload();
+        vcNonPosted[vcStat(dir, tlp->vc)]++;
+        vcCplLat[vcStat(dir, tlp->vc)] += curTick() - tlp->enqueued;
+        cp->recordTLP(tlp->getDSid(),
+                      tlp->requestPayload() + tlp->completionPayload(),
+                      curTick() - tlp->enqueued, dir == Up);
+
+        DPRINTF(RootComplex, "Received %s %s tag %d addr %#x\n",
+                dir == Down ? "up" : "down", PciExpressTLP::typeName(cpl),
+                tlp->tag, tlp->getAddr());
+
+        (dir == Down ? masterPort : dmaMasterPort).creditsReturned();
+    }
+
+    PacketPtr pkt = tlp->pkt;
+    pkt->makeResponse();
+    if (tlp->isError())
+        pkt->copyError(tlp);
+    delete tlp;
+
+    return pkt;
+}
+
+Tick
+RootComplex::atomicLatency(Dir dir, PacketPtr pkt)
+{
+    PciExpressTLP *tlp = buildTLP(pkt);
+    if (!tlp)
+        panic("%s: can't route %s addr %#x to the link\n",
+              name(), pkt->cmdString(), pkt->getAddr());
+
+    // No contention in atomic mode, only the time on the wire
+    Tick lat = serializationDelay(tlp->requestWireBytes());
+    tlps[tlp->type]++;
+    tlpBytes[tlp->type] += tlp->requestWireBytes();
+    if (!tlp->posted()) {
+        lat += serializationDelay(tlp->completionWireBytes());
+        tlps[tlp->cplType()]++;
+        tlpBytes[tlp->cplType()] += tlp->completionWireBytes();
+    }
+    unsigned payload = tlp->requestPayload() + tlp->completionPayload();
+    if (tlp->getDSid() < numLDoms)
+        ldomBytes[tlp->getDSid()] += payload;
+    vcTLPs[vcStat(dir, tlp->vc)]++;
+    vcBytes[vcStat(dir, tlp->vc)] += payload;
+    cp->recordTLP(tlp->getDSid(), payload, lat, dir == Up);
+    delete tlp;
+
+    return lat;
+}
+
+Tick
+RootComplex::RCSlavePort::recvAtomic(PacketPtr pkt)
+{
+    return rc.atomicLatency(dir, pkt) + BridgeSlavePort::recvAtomic(pkt);
+}
+
+bool
+RootComplex::RCMasterPort::reqQueueFull() const
+{
+    for (auto &queue : vcQueues) {
+        if (queue.size() < reqQueueLimit)
+            return false;
+    }
+    return true;
+}
+
+bool
+RootComplex::RCMasterPort::reqQueueFull(PacketPtr pkt) const
+{
+    // Every VC has its own buffer, a busy VC can't block the others
+    return vcQueues[rc.getVC(pkt->getDSid())].size() == reqQueueLimit;
+}
+
 void
 RootComplex::RCMasterPort::schedTimingReq(PacketPtr pkt, Tick when)
 {
@@ -84,19 +527,153 @@ RootComplex::RCMasterPort::schedTimingReq(PacketPtr pkt, Tick when)
         pkt->pushSenderState(new RequestState(pkt->getSrc()));
     }
 
-    // If we're about to put this packet at the head of the queue, we
-    // need to schedule an event to do the transmit.  Otherwise there
-    // should already be an event scheduled for sending the head
-    // packet.
-    if (transmitList.empty()) {
+    // Build PCI-Express TLP packet
+    PciExpressTLP *tlp = rc.buildTLP(pkt);
+    if (!tlp)
+        panic("%s: can't route %s addr %#x to the link\n",
+              name(), pkt->cmdString(), pkt->getAddr());
+    tlp->enqueued = curTick();
+
+    std::deque<DeferredPacket> &queue = vcQueues[tlp->vc];
+    assert(queue.size() != reqQueueLimit);
+
+    // The TLP reaches the other side once it is completely serialized
+    when += rc.serializationDelay(tlp->requestWireBytes());
+    queue.push_back(DeferredPacket(tlp, when));
+    scheduleSend(queue.front().tick);
+}
+
+void
+RootComplex::RCMasterPort::scheduleSend(Tick when)
+{
+    when = std::max(when, curTick());
+    if (!sendEvent.scheduled())
         rc.schedule(sendEvent, when);
+    else if (sendEvent.when() > when)
+        rc.reschedule(sendEvent, when);
+}
+
+bool
+RootComplex::RCMasterPort::eligible(unsigned vc, Tick &next)
+{
+    if (vcQueues[vc].empty())
+        return false;
+
+    const DeferredPacket &head = vcQueues[vc].front();
+    if (head.tick > curTick()) {
+        next = std::min(next, head.tick);
+        return false;
+    }
+
+    // The link partner must have room for the TLP in this VC, and a
+    // non-posted request a tag to match its completion
+    PciExpressTLP *tlp = static_cast<PciExpressTLP *>(head.pkt);
+    if (!tlp->posted() && rc.freeTags[dir].empty()) {
+        rc.tagStalls++;
+        waitingCredits = true;
+        return false;
+    }
+    if (!rc.haveCredits(dir, tlp)) {
+        rc.creditStalls++;
+        waitingCredits = true;
+        return false;
     }
+    return true;
+}
 
-    assert(transmitList.size() != reqQueueLimit);
+int
+RootComplex::RCMasterPort::arbitrate(Tick &next)
+{
+    unsigned nvc = vcQueues.size();
+    next = MaxTick;
+    waitingCredits = false;
 
-    // Build PCI-Express TLP packet and add it to transmitList
-    PciExpressTLP *tlp = rc.buildTLP(pkt);
-    transmitList.push_back(DeferredPacket(tlp, when));
+    // The current VC keeps the link until it used up its weight, VCs
+    // that can't send pass their turn on
+    unsigned start = arbServed < rc.cp->getVCWeight(arbVC) ?
+                     arbVC : (arbVC + 1) % nvc;
+    for (unsigned i = 0; i < nvc; i++) {
+        unsigned vc = (start + i) % nvc;
+        if (!eligible(vc, next))
+            continue;
+        if (vc != arbVC) {
+            arbVC = vc;
+            arbServed = 0;
+        }
+        return vc;
+    }
+    return -1;
+}
+
+void
+RootComplex::RCMasterPort::trySendTiming()
+{
+    if (waitingRetry)
+        return;
+
+    // The link is still busy with the previous TLP
+    if (rc.linkFree[dir] > curTick()) {
+        scheduleSend(rc.linkFree[dir]);
+        return;
+    }
+
+    Tick next;
+    int vc = arbitrate(next);
+    if (vc < 0) {
+        // Nothing ready yet, VCs out of credits resume on their return
+        DPRINTF(RootComplex, "No VC can send%s\n",
+                waitingCredits ? ", waiting for credits" : "");
+        if (next != MaxTick)
+            scheduleSend(next);
+        return;
+    }
+
+    PciExpressTLP *tlp =
+        static_cast<PciExpressTLP *>(vcQueues[vc].front().pkt);
+    if (!tlp->posted())
+        tlp->tag = rc.freeTags[dir].back();
+
+    DPRINTF(RootComplex, "trySend %s VC%d addr 0x%x, queue size %d\n",
+            PciExpressTLP::typeName(tlp->type), vc, tlp->getAddr(),
+            vcQueues[vc].size());
+
+    if (sendTimingReq(tlp)) {
+        // send successful
+        vcQueues[vc].pop_front();
+        arbServed++;
+        rc.sentTLP(dir, tlp);
+
+        // Arbitrate again once the link is free
+        for (auto &queue : vcQueues) {
+            if (!queue.empty()) {
+                scheduleSend(rc.linkFree[dir]);
+                break;
+            }
+        }
+
+        // if we have stalled a request due to a full request queue,
+        // then send a retry at this point
+        slavePort.retryStalledReq();
+    } else {
+        // try again once we receive a retry
+        waitingRetry = true;
+    }
+}
+
+void
+RootComplex::RCMasterPort::recvRetry()
+{
+    waitingRetry = false;
+    trySendTiming();
+}
+
+void
+RootComplex::RCMasterPort::creditsReturned()
+{
+    if (!waitingCredits)
+        return;
+    waitingCredits = false;
+    scheduleSend(curTick());
 }
 
 bool
@@ -105,8 +682,19 @@ RootComplex::RCMasterPort::recvTimingResp(PacketPtr pkt)
     PciExpressTLP *tlp = dynamic_cast<PciExpressTLP *>(pkt);
     if (!tlp)
         panic("RootComplex::RCMasterPort receive non-TLP packet.");
-    pkt = tlp->pkt;
-    delete tlp;
+
+    // Completions cross the link in the other direction, posted
+    // requests have none
+    Tick arrive = curTick();
+    if (!tlp->posted()) {
+        Dir cpl_dir = otherDir(dir);
+        Tick ser = rc.serializationDelay(tlp->completionWireBytes());
+        arrive = std::max(arrive, rc.linkFree[cpl_dir]) + ser;
+        rc.linkFree[cpl_dir] = arrive;
+        rc.linkBusy[cpl_dir] += ser;
+    }
+
+    pkt = rc.recvCompletion(dir, tlp);
 
     // all checks are done when the request is accepted on the slave
     // side, so we are guaranteed to have space for the response
@@ -116,7 +704,7 @@ RootComplex::RCMasterPort::recvTimingResp(PacketPtr pkt)
     // @todo: We need to pay for this and not just zero it out
     pkt->firstWordDelay = pkt->lastWordDelay = 0;
 
-    slavePort.schedTimingResp(pkt, rc.clockEdge(delay));
+    slavePort.schedTimingResp(pkt, rc.clockEdge(delay) + arrive - curTick());
 
     return true;
 }
@@ -124,20 +712,17 @@ RootComplex::RCMasterPort::recvTimingResp(PacketPtr pkt)
 bool
 RootComplex::RCMasterPort::checkFunctional(PacketPtr pkt)
 {
-    bool found = false;
-    auto i = transmitList.begin();
-
-    while(i != transmitList.end() && !found) {
-         PciExpressTLP *tlp = dynamic_cast<PciExpressTLP *>((*i).pkt);
-         assert(tlp);
-         if (pkt->checkFunctional(tlp->pkt)) {
-              pkt->makeResponse();
-              found = true;
-         }
-         ++i;
+    for (auto &queue : vcQueues) {
+        for (auto i = queue.begin(); i != queue.end(); ++i) {
+            PciExpressTLP *tlp = static_cast<PciExpressTLP *>((*i).pkt);
+            if (pkt->checkFunctional(tlp->pkt)) {
+                pkt->makeResponse();
+                return true;
+            }
+        }
     }
 
-    return found;
+    return false;
 }
 
 RootComplex *
@@ -145,4 +730,3 @@ RootComplexParams::create()
 {
     return new RootComplex(this);
 }
-
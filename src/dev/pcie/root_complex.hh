@@ -2,32 +2,63 @@
 #define __DEV_PCIE_ROOTCOMPLEX_HH__
 
 #include <deque>
+#include <vector>
 
+#include "base/statistics.hh"
 #include "base/types.hh"
 #include "dev/pcie/tlp.hh"
 #include "ext/xbridge.hh"
 #include "mem/mem_object.hh"
 #include "params/RootComplex.hh"
 
-
+class RootComplexCP;
+
+/**
+ * Root port of a PCI-Express link. Host requests leave the master port
+ * as TLPs, which only go out when the link partner has advertised
+ * enough flow control credits and a tag is free for non-posted
+ * requests. Both link directions serialize TLPs at the configured
+ * width and speed, completions are matched to their requests by
+ * requester ID and tag.
+ *
+ * TLPs are tagged with the traffic class the control plane assigned to
+ * their DSid. Every VC has its own request queue and credits, and the
+ * VCs share the link by weighted round-robin.
+ *
+ * Device DMA enters through the dma_slave port and goes upstream the
+ * same way, with its own VC queues and credits. Its completions come
+ * back on the downstream link, shared with host requests.
+ */
 class RootComplex : public XBridge
 {
 
   protected:
 
+    static const unsigned MaxVCs = 8;
+
+    /** Link direction a request travels, its completion takes the other */
+    enum Dir { Down, Up, NumDirs };
+
     class RCSlavePort : public BridgeSlavePort
     {
       private:
         RootComplex &rc;
 
+        /** Direction of the requests received by this port */
+        const Dir dir;
+
       public:
         RCSlavePort(const std::string &_name, RootComplex &_rc,
                     BridgeMasterPort& _masterPort, Cycles _delay,
-                    int _resp_limit, std::vector<AddrRange> _ranges)
+                    int _resp_limit, std::vector<AddrRange> _ranges,
+                    Dir _dir)
             : BridgeSlavePort(_name, _rc, _masterPort, _delay, _resp_limit,
                               _ranges),
-              rc(_rc)
+              rc(_rc), dir(_dir)
         { }
+
+      protected:
+        virtual Tick recvAtomic(PacketPtr pkt);
     };
 
     class RCMasterPort : public BridgeMasterPort
@@ -35,31 +66,169 @@ class RootComplex : public XBridge
       private:
         RootComplex &rc;
 
+        /** Direction of the requests sent by this port */
+        const Dir dir;
+
+        /** Request queue of each VC, transmitList is not used */
+        std::vector<std::deque<DeferredPacket> > vcQueues;
+
+        /** VC holding the link, and TLPs it sent in this turn */
+        unsigned arbVC;
+        unsigned arbServed;
+
+        /** Some VC waits for credits or a tag */
+        bool waitingCredits;
+
+        /** Link partner refused a TLP, wait for its retry */
+        bool waitingRetry;
+
+        /**
+         * Pick the VC to send next by weighted round-robin, skipping
+         * VCs without a ready TLP or credits for it.
+         * @param next earliest tick a TLP not ready yet will be
+         * @return VC, -1 if none can send now
+         */
+        int arbitrate(Tick &next);
+        bool eligible(unsigned vc, Tick &next);
+
+        void scheduleSend(Tick when);
+
       public:
         RCMasterPort(const std::string &_name, RootComplex &_rc,
                      BridgeSlavePort& _slavePort, Cycles _delay,
-                     int _req_limit)
-            : BridgeMasterPort(_name, rc, _slavePort, _delay, _req_limit),
-              rc(_rc)
+                     int _req_limit, Dir _dir, unsigned numVCs)
+            : BridgeMasterPort(_name, _rc, _slavePort, _delay, _req_limit),
+              rc(_rc), dir(_dir), vcQueues(numVCs), arbVC(0), arbServed(0),
+              waitingCredits(false), waitingRetry(false)
         { }
 
+        virtual bool reqQueueFull() const;
+        virtual bool reqQueueFull(PacketPtr pkt) const;
         virtual void schedTimingReq(PacketPtr pkt, Tick when);
+        virtual bool checkFunctional(PacketPtr pkt);
+
+        /** Credits came back, retry a TLP that waits for them */
+        void creditsReturned();
 
       protected:
+        virtual void trySendTiming();
         virtual bool recvTimingResp(PacketPtr pkt);
-        virtual bool checkFunctional(PacketPtr pkt);
-
+        virtual void recvRetry();
     };
 
     /** Slave port to receive CPU request */
     RCSlavePort slavePort;
     /** Master port to send PCI-E TLP request */
     RCMasterPort masterPort;
+    /** Slave port to receive device DMA */
+    RCSlavePort dmaSlavePort;
+    /** Master port to send DMA TLPs to the host */
+    RCMasterPort dmaMasterPort;
+
+    /** Control plane, assigns traffic classes and VC weights */
+    RootComplexCP *cp;
+
+    const unsigned numVCs;
+
+    /** Requester ID of the root port, completions must carry it */
+    const uint32_t requesterID;
+
+    /** Link bandwidth, in ticks per byte over all lanes */
+    const double ticksPerByte;
+
+    /** Delay of UpdateFC DLLPs returning credits */
+    const Tick fcUpdateLatency;
+
+    /**
+     * Credits available for each direction, VC and flow control class.
+     * Posted and non-posted credits are advertised by the receiver of
+     * the requests, completion credits by their sender and reserved
+     * when a non-posted request is sent. Both ends advertise the same
+     * limits, a limit of 0 advertises infinite credits.
+     */
+    unsigned hdrLimit[PciExpressTLP::NUM_FCCLASSES];
+    unsigned dataLimit[PciExpressTLP::NUM_FCCLASSES];
+    unsigned hdrCredits[NumDirs][MaxVCs][PciExpressTLP::NUM_FCCLASSES];
+    unsigned dataCredits[NumDirs][MaxVCs][PciExpressTLP::NUM_FCCLASSES];
+
+    /**
+     * Non-posted requests in flight in each direction, indexed by tag.
+     * The devices below the port share one tag space.
+     */
+    std::vector<PciExpressTLP *> outstanding[NumDirs];
+    std::vector<uint8_t> freeTags[NumDirs];
+
+    /** Ticks at which each link direction can take the next TLP */
+    Tick linkFree[NumDirs];
+
+    struct CreditReturn
+    {
+        Tick when;
+        Dir dir;
+        unsigned vc;
+        PciExpressTLP::FCClass fc;
+        unsigned hdr;
+        unsigned data;
+    };
+
+    /** Credits on their way back, in order as the latency is fixed */
+    std::deque<CreditReturn> creditReturns;
+
+    void processCreditReturn();
+    EventWrapper<RootComplex,
+                 &RootComplex::processCreditReturn> creditEvent;
+
+    /** LDomains tracked by the per-DSid statistics */
+    const unsigned numLDoms;
+
+    Stats::Vector tlps;
+    Stats::Vector tlpBytes;
+    Stats::Vector ldomBytes;
+    Stats::Scalar creditStalls;
+    Stats::Scalar tagStalls;
+    Stats::Scalar linkBusy[NumDirs];
+    Stats::Formula linkUtil[NumDirs];
+
+    /** Indexed by vcStat(), downstream VCs first */
+    Stats::Vector vcTLPs;
+    Stats::Vector vcBytes;
+    Stats::Vector vcQueueLat;
+    Stats::Vector vcNonPosted;
+    Stats::Vector vcCplLat;
+    Stats::Formula vcAvgQueueLat;
+    Stats::Formula vcAvgCplLat;
+    Stats::Formula vcBandwidth;
 
   protected:
 
+    /** Wrap pkt into a TLP, NULL if it can't be routed to the link */
     PciExpressTLP * buildTLP(PacketPtr pkt);
 
+    static Dir otherDir(Dir dir)
+    { return dir == Down ? Up : Down; }
+
+    /** VC the TLPs of DSid travel on */
+    unsigned getVC(uint16_t DSid) const;
+
+    unsigned vcStat(Dir dir, unsigned vc) const
+    { return dir * numVCs + vc; }
+
+    Tick serializationDelay(unsigned bytes) const
+    { return (Tick)(bytes * ticksPerByte + 0.5); }
+
+    bool haveCredits(Dir dir, PciExpressTLP *tlp) const;
+    void consumeCredits(Dir dir, PciExpressTLP *tlp);
+    void returnCredits(Dir dir, unsigned vc, PciExpressTLP::FCClass fc,
+                       unsigned hdr, unsigned data, Tick when);
+
+    /** TLP went out on the link */
+    void sentTLP(Dir dir, PciExpressTLP *tlp);
+    /** Completion of tlp came back, returns the original packet */
+    PacketPtr recvCompletion(Dir dir, PciExpressTLP *tlp);
+
+    /** Link time of pkt in atomic mode, request and completion */
+    Tick atomicLatency(Dir dir, PacketPtr pkt);
+
   public:
 
     virtual BaseMasterPort& getMasterPort(const std::string& if_name,
@@ -68,6 +237,7 @@ class RootComplex : public XBridge
                                         PortID idx = InvalidPortID);
 
     virtual void init();
+    virtual void regStats();
 
     typedef RootComplexParams Params;
 
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+#include "debug/ControlPlane.hh"
+#include "dev/pcie/root_complex.hh"
+#include "dev/pcie/root_complex_cp.hh"
+#include "sim/serialize.hh"
+
+RootComplexCP::RootComplexCP(const Params *p)
+    : ControlPlane(p),
+      param_table_entries(p->param_table_entries),
+      stat_table_entries(p->param_table_entries),
+      rc(NULL)
+{
+    memset(&rcInfo, 0, sizeof(rcInfo));
+
+    // Allocate ConfigTable
+    paramTable = new struct RCParamEntry[param_table_entries];
+    statTable  = new struct RCStatEntry[stat_table_entries];
+    memset(paramTable, 0,
+           sizeof(struct RCParamEntry) * param_table_entries);
+    memset(statTable, 0,
+           sizeof(struct RCStatEntry) * stat_table_entries);
+
+    // Per-DSid counters, updated for every TLP
+    tlpsCounter = registerCounter("pcie_tlps");
+    bytesCounter = registerCounter("pcie_bytes");
+    dmaTLPsCounter = registerCounter("pcie_dma_tlps");
+    dmaBytesCounter = registerCounter("pcie_dma_bytes");
+}
+
+RootComplexCP::~RootComplexCP()
+{
+    delete[] statTable;
+    delete[] paramTable;
+}
+
+void
+RootComplexCP::regRootComplex(RootComplex *_rc, unsigned numVCs)
+{
+    panic_if(rc, "%s already reg to %s\n", name(), rc->name());
+    panic_if(numVCs == 0 || numVCs > RC_NUM_TCS,
+             "%s: %d VCs, between 1 and %d supported.\n",
+             name(), numVCs, RC_NUM_TCS);
+    rc = _rc;
+
+    // Spread traffic classes over the VCs, every VC gets the link
+    // for one TLP per turn
+    rcInfo.numVCs = numVCs;
+    for (int tc = 0; tc < RC_NUM_TCS; tc++)
+        rcInfo.tcMap[tc] = tc % numVCs;
+    for (int vc = 0; vc < numVCs; vc++)
+        rcInfo.vcWeight[vc] = 1;
+}
+
+int
+RootComplexCP::findRow(uint16_t DSid) const
+{
+    for (int i = 0; i < param_table_entries; i++) {
+        if ((paramTable[i].flags & RC_FLAG_VALID) &&
+            paramTable[i].DSid == DSid)
+            return i;
+    }
+    return -1;
+}
+
+uint8_t
+RootComplexCP::getTrafficClass(uint16_t DSid) const
+{
+    int row = findRow(DSid);
+    return row < 0 ? 0 : paramTable[row].tc % RC_NUM_TCS;
+}
+
+void
+RootComplexCP::recordTLP(uint16_t DSid, unsigned bytes, Tick latency,
+                         bool dma)
+{
+    int row = findRow(DSid);
+    if (row >= 0) {
+        RCStatEntry &stat = statTable[row];
+        stat.flags = RC_FLAG_VALID;
+        stat.DSid = DSid;
+        stat.tlps++;
+        stat.bytes += bytes;
+        stat.latency += latency;
+    }
+    incrCounter(DSid, tlpsCounter, 1);
+    incrCounter(DSid, bytesCounter, bytes);
+    if (dma) {
+        incrCounter(DSid, dmaTLPsCounter, 1);
+        incrCounter(DSid, dmaBytesCounter, bytes);
+    }
+}
+
+uint64_t
+RootComplexCP::queryTable(uint16_t DSid, uint32_t addr)
+{
+    uint64_t *pdata;
+    DPRINTF(ControlPlane, "queryTable(DSid=%d, addr=0x%x)\n",
+            DSid, addr);
+
+    pdata = parseAddr(addr);
+    if (!pdata) {
+        warn("RootComplexCP: unknown addr 0x%x", addr);
+        return 0xFFFFFFFFFFFFFFFF;
+    }
+    return *pdata;
+}
+
+void
+RootComplexCP::updateTable(uint16_t DSid, uint32_t addr, uint64_t data)
+{
+    uint64_t *pdata;
+
+    DPRINTF(ControlPlane, "updateTable(DSid=%d, addr=0x%x, data=0x%x)\n",
+            DSid, addr, data);
+
+    pdata = parseAddr(addr);
+    if (!pdata) {
+        warn("RootComplexCP: unknown addr 0x%x", addr);
+        return;
+    }
+
+    bool param = (char *)pdata >= (char *)paramTable &&
+                 (char *)pdata < (char *)&paramTable[param_table_entries];
+    bool arbitration = (char *)pdata >= (char *)rcInfo.tcMap &&
+                       (char *)pdata < (char *)&rcInfo + sizeof(rcInfo);
+    if (!param && !arbitration) {
+        // stat table and VC count are read-only
+        warn("RootComplexCP: write to read-only addr 0x%x", addr);
+        return;
+    }
+
+    *pdata = data;
+
+    if (param) {
+        // A new owner of the row starts with fresh statistics
+        int row = ((char *)pdata - (char *)paramTable) /
+                  sizeof(struct RCParamEntry);
+        if (statTable[row].DSid != paramTable[row].DSid ||
+            !(paramTable[row].flags & RC_FLAG_VALID))
+            memset(&statTable[row], 0, sizeof(struct RCStatEntry));
+    } else {
+        // TLPs of a VC the link does not have go to the last one
+        for (int tc = 0; tc < RC_NUM_TCS; tc++) {
+            if (rcInfo.tcMap[tc] >= rcInfo.numVCs)
+                rcInfo.tcMap[tc] = rcInfo.numVCs - 1;
+        }
+    }
+}
+
+int
+RootComplexCP::snapshotStats(uint16_t DSid, uint8_t *buf, int size)
+{
+    int row = findRow(DSid);
+    if (row < 0)
+        return 0;
+    return copyStatRow(&statTable[row], sizeof(struct RCStatEntry),
+                       buf, size);
+}
+
+uint64_t *
+RootComplexCP::parseAddr(uint32_t addr)
+{
+    char *ptr = NULL;
+    int offset;
+
+    switch (addr & ADDRTYPE_MASK) {
+    // Access ConfigTable
+    case ADDRTYPE_CFGTBL:
+        {
+            int row = cfgtbl_addr2row(addr);
+            offset = cfgtbl_addr2offset(addr);
+
+            switch (cfgtbl_addr2type(addr)) {
+              case CFGTBL_TYPE_PARAM:
+                if ((row < param_table_entries) &&
+                    (offset <= sizeof(struct RCParamEntry) -
+                               sizeof(uint64_t)))
+                    ptr = (char *)&paramTable[row];
+                break;
+              case CFGTBL_TYPE_STAT:
+                if ((row < stat_table_entries) &&
+                    (offset <= sizeof(struct RCStatEntry) -
+                               sizeof(uint64_t)))
+                    ptr = (char *)&statTable[row];
+                break;
+            }
+        }
+        break;
+    // Access VC info and arbitration table
+    case ADDRTYPE_SYSINFO:
+        offset = sysinfo_addr2offset(addr);
+        if (offset <= sizeof(rcInfo) - sizeof(uint64_t))
+            ptr = (char *)&rcInfo;
+        break;
+    }
+
+    return (ptr ? ((uint64_t *)(ptr + offset)) : NULL);
+}
+
+void
+RootComplexCP::serialize(std::ostream &os)
+{
+    arrayParamOut(os, "paramTable", (uint8_t *)paramTable,
+                  sizeof(struct RCParamEntry) * param_table_entries);
+    arrayParamOut(os, "statTable", (uint8_t *)statTable,
+                  sizeof(struct RCStatEntry) * stat_table_entries);
+    arrayParamOut(os, "rcInfo", (uint8_t *)&rcInfo, sizeof(rcInfo));
+}
+
+void
+RootComplexCP::unserialize(Checkpoint *cp, const std::string &section)
+{
+    arrayParamIn(cp, section, "paramTable", (uint8_t *)paramTable,
+                 sizeof(struct RCParamEntry) * param_table_entries);
+    arrayParamIn(cp, section, "statTable", (uint8_t *)statTable,
+                 sizeof(struct RCStatEntry) * stat_table_entries);
+    arrayParamIn(cp, section, "rcInfo", (uint8_t *)&rcInfo, sizeof(rcInfo));
+}
+
+RootComplexCP *
+RootComplexCPParams::create()
+{
+    return new RootComplexCP(this);
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2015 Institute of Computing Technology, CAS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/**
+ * @file
+ * Declaration of PCI-Express root complex control plane.
+ *
+ * Each param table row tags the TLPs of one DSid with a traffic class.
+ * The system info holds the TC to VC map and the weighted round-robin
+ * arbitration table of the link, both writable by PRM. They apply to
+ * host requests and device DMA alike, each direction is arbitrated on
+ * its own. The stat table row with the same index reports link traffic
+ * of the DSid.
+ */
+
+#ifndef __DEV_PCIE_ROOTCOMPLEX_CP_HH__
+#define __DEV_PCIE_ROOTCOMPLEX_CP_HH__
+
+#include "params/RootComplexCP.hh"
+#include "prm/ControlPlane.hh"
+
+class RootComplex;
+
+/**
+ * Param Table
+ */
+struct RCParamEntry {
+    uint16_t flags;
+    uint16_t DSid;
+    uint8_t  tc;            // traffic class of the DSid, 0-7
+    uint8_t  __padding[3];
+};
+#define RC_FLAG_VALID	0x0001
+
+/**
+ * Stat Table, same row as param table
+ */
+struct RCStatEntry {
+    uint16_t flags;
+    uint16_t DSid;
+    uint32_t __padding;
+    uint64_t tlps;          // TLPs sent on the link
+    uint64_t bytes;         // payload bytes, both directions
+    uint64_t latency;       // total ticks from request to completion
+};
+
+/**
+ * SystemInfo Table, tcMap and vcWeight are writable
+ */
+#define RC_NUM_TCS	8
+struct RCInfo {
+    uint8_t  numVCs;
+    uint8_t  __padding[7];
+    uint8_t  tcMap[RC_NUM_TCS];     // VC of each traffic class
+    uint32_t vcWeight[RC_NUM_TCS];  // TLPs per arbitration turn
+};
+
+class RootComplexCP : public ControlPlane
+{
+  protected:
+    int param_table_entries;
+    int stat_table_entries;
+
+    struct RCParamEntry *paramTable;
+    struct RCStatEntry *statTable;
+    struct RCInfo rcInfo;
+
+    RootComplex *rc;
+
+    /** Counter indexes, see ControlPlane::registerCounter() */
+    int tlpsCounter;
+    int bytesCounter;
+    int dmaTLPsCounter;
+    int dmaBytesCounter;
+
+  public:
+    typedef RootComplexCPParams Params;
+    RootComplexCP(const Params *p);
+    ~RootComplexCP();
+
+    void regRootComplex(RootComplex *_rc, unsigned numVCs);
+
+  public:
+    /** Traffic class of DSid, TC0 without a valid row */
+    uint8_t getTrafficClass(uint16_t DSid) const;
+    unsigned getVC(uint8_t tc) const
+    { return rcInfo.tcMap[tc % RC_NUM_TCS]; }
+    unsigned getVCWeight(unsigned vc) const
+    { return rcInfo.vcWeight[vc] ? rcInfo.vcWeight[vc] : 1; }
+
+    /** Called by the root complex for every finished TLP */
+    void recordTLP(uint16_t DSid, unsigned bytes, Tick latency, bool dma);
+
+    virtual uint64_t queryTable(uint16_t DSid, uint32_t addr);
+    virtual void updateTable(uint16_t DSid, uint32_t addr, uint64_t data);
+    virtual int snapshotStats(uint16_t DSid, uint8_t *buf, int size);
+
+    virtual void serialize(std::ostream &os);
+    virtual void unserialize(Checkpoint *cp, const std::string &section);
+
+  private:
+    uint64_t *parseAddr(uint32_t addr);
+    int findRow(uint16_t DSid) const;
+};
+
+#endif	// __DEV_PCIE_ROOTCOMPLEX_CP_HH__
@@ -1,10 +1,11 @@
 #ifndef __DEV_PCIE_TLP_HH__
 #define __DEV_PCIE_TLP_HH__
 
+#include "base/intmath.hh"
 #include "mem/packet.hh"
 
 #define MAKE_PCI_ID(bus, dev, fun)  \
-    (((bus&0xFFFF)<<16) | ((dev&&0xFF)<<8) | (fun&&0xFF))
+    (((bus&0xFFFF)<<16) | ((dev&0xFF)<<8) | (fun&0xFF))
 
 class PciExpressTLP : public Packet
 {
@@ -15,21 +16,94 @@ class PciExpressTLP : public Packet
         IORd, IOWr,
         CfgRd0, CfgWr0, CfgRd1, CfgWr1,
         Msg, MsgD,
+        Cpl, CplD,
         NUM_TLPTYPES
     };
 
+    /** Flow control classes, each with its own header/data credits */
+    enum FCClass
+    {
+        Posted, NonPosted, Completion,
+        NUM_FCCLASSES
+    };
+
+    /** One data credit covers 4DW of payload */
+    static const unsigned DataCreditBytes = 16;
+
+    /** Framing, sequence number and LCRC around every TLP */
+    static const unsigned LinkOverheadBytes = 8;
+
+    static const char *typeName(TLPType type);
+
     const TLPType type;
     const uint32_t destID;
+    const uint32_t requesterID;
+    /** Assigned when a non-posted request goes out */
+    uint8_t tag;
+    /** Traffic class of the owner DSid and the VC it maps to */
+    uint8_t tc;
+    uint8_t vc;
+    /** Tick the TLP entered its VC queue */
+    Tick enqueued;
     const PacketPtr pkt;
 
   public:
-    PciExpressTLP(TLPType _type, uint32_t _destID, const PacketPtr _pkt)
+    /**
+     * Wrap pkt into a TLP. The TLP shares the data of pkt, so read
+     * completions land in the original packet. Memory, I/O and message
+     * TLPs are routed by address, config TLPs by destID, which is also
+     * encoded in their address.
+     */
+    PciExpressTLP(TLPType _type, uint32_t _destID, uint32_t _requesterID,
+                  const PacketPtr _pkt)
         : Packet(_pkt->req, _pkt->cmd),
-          type(_type), destID(_destID), pkt(_pkt)
+          type(_type), destID(_destID), requesterID(_requesterID),
+          tag(0), tc(0), vc(0), enqueued(0), pkt(_pkt)
     {
-        setAddr(destID);
+        setAddr(_pkt->getAddr());
+        setDSid(_pkt->getDSid());
+        _pkt->allocate();
+        dataStatic(_pkt->getPtr<uint8_t>());
     }
-    
+
+    /** MWr and messages are posted, everything else waits for a Cpl */
+    bool posted() const
+    { return type == MWr || type == Msg || type == MsgD; }
+
+    FCClass fcClass() const
+    { return posted() ? Posted : NonPosted; }
+
+    /** Completion type returned for this request */
+    TLPType cplType() const
+    { return pkt->isRead() ? CplD : Cpl; }
+
+    /** 4DW header for 64-bit memory addresses and messages */
+    unsigned headerBytes() const
+    {
+        if (type == Msg || type == MsgD)
+            return 16;
+        if ((type == MRd || type == MRdLk || type == MWr) &&
+            (getAddr() >> 32))
+            return 16;
+        return 12;
+    }
+
+    /** Payload carried by the request TLP */
+    unsigned requestPayload() const
+    { return pkt->isWrite() || type == MsgD ? getSize() : 0; }
+
+    /** Payload carried by its completion */
+    unsigned completionPayload() const
+    { return pkt->isRead() ? getSize() : 0; }
+
+    static unsigned dataCredits(unsigned payload)
+    { return divCeil(payload, DataCreditBytes); }
+
+    unsigned requestWireBytes() const
+    { return headerBytes() + requestPayload() + LinkOverheadBytes; }
+
+    unsigned completionWireBytes() const
+    { return 12 + completionPayload() + LinkOverheadBytes; }
 };
 
 #endif // __DEV_PCIE_TLP_HH__
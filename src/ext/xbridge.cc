@@ -117,7 +117,7 @@ XBridge::BridgeSlavePort::recvTimingReq(PacketPtr pkt)
             transmitList.size(), outstandingResponses);
 
     // if the request queue is full then there is no hope
-    if (masterPort.reqQueueFull()) {
+    if (masterPort.reqQueueFull(pkt)) {
         DPRINTF(Bridge, "Request queue full\n");
         retryReq = true;
     } else {
@@ -263,7 +263,7 @@ class XBridge : public MemObject
          * the outbound queue is ready to transmit (for timing
          * accesses only).
          */
-        void trySendTiming();
+        virtual void trySendTiming();
 
         /** Send event for the request queue. */
         EventWrapper<BridgeMasterPort,
@@ -289,7 +289,16 @@ class XBridge : public MemObject
          *
          * @return true if the occupied space has reached the set limit
          */
-        bool reqQueueFull() const;
+        virtual bool reqQueueFull() const;
+
+        /**
+         * Is this side blocked from accepting pkt, for bridges that
+         * buffer requests in more than one queue.
+         *
+         * @return true if the space for pkt has reached the set limit
+         */
+        virtual bool reqQueueFull(PacketPtr pkt) const
+        { return reqQueueFull(); }
 
         /**
          * Queue a request packet to be sent out later and also schedule
@@ -308,7 +317,7 @@ class XBridge : public MemObject
          *
          * @return true if we find a match
          */
-        bool checkFunctional(PacketPtr pkt);
+        virtual bool checkFunctional(PacketPtr pkt);
 
       protected:
 
@@ -2,6 +2,20 @@ from m5.params import *
 from MemObject import MemObject
 from XBar import CoherentXBar, NoncoherentXBar
 from Bridge import Bridge
+from ControlPlane import ControlPlane
+
+class PARDMemoryCtrlCP(ControlPlane):
+    type = 'PARDMemoryCtrlCP'
+    cxx_header = 'mem/pard_mem_ctrl_cp.hh'
+
+    # CPN address 3:0
+    cp_dev = 3
+    cp_fun = 0
+    # Type 'M' Memory, IDENT: PARDg5VMemCP
+    Type = 0x4D
+    IDENT = "PARDg5VMemCP"
+
+    param_table_entries = Param.Int(32, "Number of parameter table entries")
 
 class PARDMemoryCtrl(MemObject):
     type = 'PARDMemoryCtrl'
@@ -9,6 +23,16 @@ class PARDMemoryCtrl(MemObject):
 
     port = SlavePort("Slave port")
 
+    # PARD Memory Control Plane
+    cp = Param.PARDMemoryCtrlCP(PARDMemoryCtrlCP(),
+                                "Control plane for PARD memory controller")
+
+    # Memory partitions are built from granule-sized extents, the first
+    # 'partitions' DSids start with partition_size bytes each
+    granule = Param.MemorySize('128MB', "Partition allocation unit")
+    partitions = Param.Unsigned(4, "Number of initial partitions")
+    partition_size = Param.MemorySize('2GB', "Size of initial partitions")
+
     # Internal DRAM Controller
     #  - TODO: Maybe we should use multiple DRAMCtrl?
     memories = Param.AbstractMemory("Internal memories")
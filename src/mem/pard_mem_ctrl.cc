@@ -1,13 +1,50 @@
+#include <zlib.h>
+
+#include <algorithm>
+#include <fstream>
+
 #include "debug/PARDMemoryCtrl.hh"
 #include "mem/pard_mem_ctrl.hh"
+#include "mem/pard_mem_ctrl_cp.hh"
+#include "sim/serialize.hh"
+
+// "PARDMEM1", leads every LDomain memory image
+static const uint64_t LDomImageMagic = ULL(0x314d454d44524150);
 
 PARDMemoryCtrl::PARDMemoryCtrl(const PARDMemoryCtrlParams* p)
     : MemObject(p),
       port(name() + ".port", *this),
-      internal_port(name() + ".internal_port", *this)
+      internal_port(name() + ".internal_port", *this),
       //memories(p->memories)
+      cp(p->cp), granule(p->granule),
+      lazyCount(0), runCacheFile(-1), runCacheOffset(0),
+      faultRespEvent(this), faultRetry(false), internalRetry(false)
 {
-      memories.push_back(p->memories);
+    memories.push_back(p->memories);
+    memBase = memories[0]->getAddrRange().start();
+
+    fatal_if(granule == 0 || getTotalSize() % granule,
+             "%s: memory size is not a multiple of granule %#x.\n",
+             name(), granule);
+    fatal_if(p->partition_size % granule,
+             "%s: partition size is not a multiple of granule %#x.\n",
+             name(), granule);
+    fatal_if(p->partitions * p->partition_size > getTotalSize(),
+             "%s: %d partitions of %#x bytes exceed memory size.\n",
+             name(), p->partitions, p->partition_size);
+
+    dirtyPages.resize(getTotalSize() / PageSize, false);
+    lazyPending.resize(getTotalSize() / PageSize, false);
+
+    // Every extent starts in the free pool, then the initial
+    // partitions take them in address order, so DSid N is mapped at
+    // N*partition_size
+    for (uint64_t off = 0; off < getTotalSize(); off += granule)
+        freeExtents.insert(memBase + off);
+    for (int i = 0; i < p->partitions; i++)
+        resizePartition(i, p->partition_size);
+
+    cp->regMemoryCtrl(this);
 }
 
 void
@@ -35,16 +72,128 @@ PARDMemoryCtrl::getAddrRanges() const
     return ranges;
 }
 
-Addr
-PARDMemoryCtrl::remapAddr(uint16_t DSid, Addr addr) const
+uint64_t
+PARDMemoryCtrl::getTotalSize() const
+{
+    uint64_t size = 0;
+    for (auto mem : memories)
+        size += mem->size();
+    return size;
+}
+
+uint64_t
+PARDMemoryCtrl::getPartitionSize(uint16_t DSid) const
+{
+    auto it = partitions.find(DSid);
+    return it == partitions.end() ? 0 : it->second.size() * granule;
+}
+
+uint64_t
+PARDMemoryCtrl::requestPartition(uint16_t DSid, uint64_t size)
+{
+    return cp->requestSize(DSid, size);
+}
+
+std::vector<uint16_t>
+PARDMemoryCtrl::getPartitions() const
+{
+    std::vector<uint16_t> dsids;
+    for (auto &part : partitions)
+        dsids.push_back(part.first);
+    return dsids;
+}
+
+uint64_t
+PARDMemoryCtrl::resizePartition(uint16_t DSid, uint64_t size)
 {
-    if (DSid < 4) {
-        DPRINTF(PARDMemoryCtrl, "[%d] 0x%016x ==> 0x%016x\n", DSid, addr, addr + (uint64_t)DSid*0x80000000);
-        return addr + (uint64_t)DSid*0x80000000;
+    std::vector<Addr> &extents = partitions[DSid];
+    uint64_t want = (size + granule - 1) / granule;
+
+    // Shrink: the guest is expected to have offlined the top of its
+    // memory already, hand those extents back to the pool zeroed so no
+    // data leaks to the next owner
+    while (extents.size() > want) {
+        resetExtent(extents.back(), false);
+        freeExtents.insert(extents.back());
+        extents.pop_back();
     }
-    else {
-        panic("PARDMemoryCtrl::remapAddr(): unknown DSid 0x%x\n", DSid);
-        return addr;
+
+    // Grow: lowest free extents first, keeps the pool compact. New
+    // extents are zeroed again, and stay dirty since the previous image
+    // of DSid does not cover them
+    while (extents.size() < want && !freeExtents.empty()) {
+        extents.push_back(*freeExtents.begin());
+        freeExtents.erase(freeExtents.begin());
+        resetExtent(extents.back(), true);
+    }
+
+    uint64_t granted = extents.size() * granule;
+    if (extents.empty())
+        partitions.erase(DSid);
+
+    DPRINTF(PARDMemoryCtrl, "resize DSid#%d: %#x bytes requested, "
+            "%#x granted, %#x free\n", DSid, size, granted, getFreeSize());
+
+    return granted;
+}
+
+bool
+PARDMemoryCtrl::remapAddr(uint16_t DSid, Addr addr, Addr &remapped) const
+{
+    auto it = partitions.find(DSid);
+    uint64_t idx = addr / granule;
+
+    if (it == partitions.end() || idx >= it->second.size()) {
+        DPRINTF(PARDMemoryCtrl, "[%d] 0x%016x out of partition\n",
+                DSid, addr);
+        return false;
+    }
+
+    remapped = it->second[idx] + addr % granule;
+    DPRINTF(PARDMemoryCtrl, "[%d] 0x%016x ==> 0x%016x\n",
+            DSid, addr, remapped);
+    return true;
+}
+
+void
+PARDMemoryCtrl::faultAccess(PacketPtr pkt)
+{
+    warn_once("%s: DSid#%d access to %#x outside its partition.\n",
+              name(), pkt->getDSid(), pkt->getAddr());
+    cp->recordFault(pkt->getDSid());
+
+    if (pkt->isRead())
+        memset(pkt->getPtr<uint8_t>(), 0xFF, pkt->getSize());
+    pkt->firstWordDelay = pkt->lastWordDelay = 0;
+    if (pkt->needsResponse())
+        pkt->makeResponse();
+}
+
+void
+PARDMemoryCtrl::sendFaultResponses()
+{
+    while (!faultResponses.empty()) {
+        if (!port.sendTimingResp(faultResponses.front())) {
+            faultRetry = true;
+            return;
+        }
+        faultResponses.pop_front();
+    }
+}
+
+void
+PARDMemoryCtrl::recvRespRetry()
+{
+    if (faultRetry) {
+        faultRetry = false;
+        sendFaultResponses();
+        if (faultRetry)
+            return;
+    }
+
+    if (internalRetry) {
+        internalRetry = false;
+        internal_port.sendRetry();
     }
 }
 
@@ -52,7 +201,16 @@ Tick
 PARDMemoryCtrl::recvAtomic(PacketPtr pkt)
 {
     Addr orig_addr = pkt->getAddr();
-    pkt->setAddr(remapAddr(pkt->getDSid(), orig_addr));
+    Addr remapped;
+    if (!remapAddr(pkt->getDSid(), orig_addr, remapped)) {
+        faultAccess(pkt);
+        return 0;
+    }
+    if (lazyCount)
+        fillLazy(remapped, pkt->getSize());
+    if (pkt->isWrite() && !pkt->memInhibitAsserted())
+        markDirty(remapped, pkt->getSize());
+    pkt->setAddr(remapped);
     pkt->firstWordDelay = pkt->lastWordDelay = 0;
     Tick ret_tick = internal_port.sendAtomic(pkt);
     pkt->setAddr(orig_addr);
@@ -66,11 +224,35 @@ PARDMemoryCtrl::recvTimingReq(PacketPtr pkt)
     bool needsResponse = pkt->needsResponse();
     bool memInhibitAsserted = pkt->memInhibitAsserted();
 
+    for (auto p : pendingDelete)
+        delete p;
+    pendingDelete.clear();
+
+    Addr remapped;
+    if (!remapAddr(pkt->getDSid(), orig_addr, remapped)) {
+        if (memInhibitAsserted || !needsResponse) {
+            if (!memInhibitAsserted)
+                faultAccess(pkt);
+            pendingDelete.push_back(pkt);
+            return true;
+        }
+        faultAccess(pkt);
+        faultResponses.push_back(pkt);
+        if (!faultRespEvent.scheduled() && !faultRetry)
+            schedule(faultRespEvent, clockEdge(Cycles(1)));
+        return true;
+    }
+
+    if (lazyCount)
+        fillLazy(remapped, pkt->getSize());
+    if (pkt->isWrite() && !memInhibitAsserted)
+        markDirty(remapped, pkt->getSize());
+
     if (!memInhibitAsserted && needsResponse)
         pkt->pushSenderState(new RequestState(pkt->getSrc(), orig_addr));
     pkt->firstWordDelay = pkt->lastWordDelay = 0;
 
-    pkt->setAddr(remapAddr(pkt->getDSid(), orig_addr));
+    pkt->setAddr(remapped);
 
     // Attempt to send the packet (always succeeds for inhibited
     // packets)
@@ -87,7 +269,16 @@ void
 PARDMemoryCtrl::recvFunctional(PacketPtr pkt)
 {
     Addr orig_addr = pkt->getAddr();
-    pkt->setAddr(remapAddr(pkt->getDSid(), orig_addr));
+    Addr remapped;
+    if (!remapAddr(pkt->getDSid(), orig_addr, remapped)) {
+        faultAccess(pkt);
+        return;
+    }
+    if (lazyCount)
+        fillLazy(remapped, pkt->getSize());
+    if (pkt->isWrite())
+        markDirty(remapped, pkt->getSize());
+    pkt->setAddr(remapped);
     pkt->firstWordDelay = pkt->lastWordDelay = 0;
     internal_port.sendFunctional(pkt);
     pkt->setAddr(orig_addr);
@@ -125,11 +316,426 @@ PARDMemoryCtrl::recvTimingResp(PacketPtr pkt)
         pkt->pushSenderState(req_state);
         pkt->setDest(dest);
         pkt->setAddr(remapped_addr);
+        internalRetry = true;
     }
 
     return successful;
 }
 
+void
+PARDMemoryCtrl::serialize(std::ostream &os)
+{
+    // Partitions as parallel arrays: DSid, extent count, extents
+    std::vector<uint16_t> dsids;
+    std::vector<uint64_t> counts;
+    std::vector<Addr> extents;
+    for (auto &part : partitions) {
+        dsids.push_back(part.first);
+        counts.push_back(part.second.size());
+        extents.insert(extents.end(), part.second.begin(), part.second.end());
+    }
+    arrayParamOut(os, "dsids", dsids);
+    arrayParamOut(os, "counts", counts);
+    arrayParamOut(os, "extents", extents);
+
+    // Pages not restored yet keep referring to their LDomain images,
+    // the backing store saved by gem5 does not hold them
+    std::vector<uint64_t> lazyIndex, lazyOffsets;
+    std::vector<int> lazyFile;
+    std::vector<uint32_t> lazyRunIndex;
+    std::vector<uint64_t> lazyZero;
+    for (uint64_t idx = 0; lazyCount && idx < lazyPending.size(); idx++) {
+        if (!lazyPending[idx])
+            continue;
+        auto it = lazyPages.find(idx);
+        if (it == lazyPages.end()) {
+            lazyZero.push_back(idx);
+            continue;
+        }
+        lazyIndex.push_back(idx);
+        lazyFile.push_back(it->second.file);
+        lazyOffsets.push_back(it->second.offset);
+        lazyRunIndex.push_back(it->second.index);
+    }
+    arrayParamOut(os, "lazyFiles", lazyFiles);
+    arrayParamOut(os, "lazyZero", lazyZero);
+    arrayParamOut(os, "lazyIndex", lazyIndex);
+    arrayParamOut(os, "lazyFile", lazyFile);
+    arrayParamOut(os, "lazyOffsets", lazyOffsets);
+    arrayParamOut(os, "lazyRunIndex", lazyRunIndex);
+}
+
+void
+PARDMemoryCtrl::unserialize(Checkpoint *cp, const std::string &section)
+{
+    std::vector<uint16_t> dsids;
+    std::vector<uint64_t> counts;
+    std::vector<Addr> extents;
+    arrayParamIn(cp, section, "dsids", dsids);
+    arrayParamIn(cp, section, "counts", counts);
+    arrayParamIn(cp, section, "extents", extents);
+
+    // Rebuild the free pool from scratch
+    freeExtents.clear();
+    Addr base = memories[0]->getAddrRange().start();
+    for (uint64_t off = 0; off < getTotalSize(); off += granule)
+        freeExtents.insert(base + off);
+
+    partitions.clear();
+    auto ext = extents.begin();
+    for (int i = 0; i < dsids.size(); i++) {
+        std::vector<Addr> &part = partitions[dsids[i]];
+        for (int j = 0; j < counts[i]; j++, ++ext) {
+            part.push_back(*ext);
+            freeExtents.erase(*ext);
+        }
+    }
+
+    // No dirty pages were saved, the next LDomain images are full ones
+    imageChain.clear();
+    dirtyPages.assign(dirtyPages.size(), false);
+
+    std::vector<uint64_t> lazyIndex, lazyOffsets;
+    std::vector<int> lazyFile;
+    std::vector<uint32_t> lazyRunIndex;
+    std::vector<uint64_t> lazyZero;
+    arrayParamIn(cp, section, "lazyFiles", lazyFiles);
+    arrayParamIn(cp, section, "lazyZero", lazyZero);
+    arrayParamIn(cp, section, "lazyIndex", lazyIndex);
+    arrayParamIn(cp, section, "lazyFile", lazyFile);
+    arrayParamIn(cp, section, "lazyOffsets", lazyOffsets);
+    arrayParamIn(cp, section, "lazyRunIndex", lazyRunIndex);
+
+    lazyPending.assign(lazyPending.size(), false);
+    lazyPages.clear();
+    lazyCount = 0;
+    runCacheFile = -1;
+    for (auto idx : lazyZero) {
+        lazyPending[idx] = true;
+        lazyCount++;
+    }
+    for (int i = 0; i < lazyIndex.size(); i++) {
+        LazyPage lazy = { lazyFile[i], lazyOffsets[i], lazyRunIndex[i] };
+        lazyPages[lazyIndex[i]] = lazy;
+        lazyPending[lazyIndex[i]] = true;
+        lazyCount++;
+    }
+}
+
+void
+PARDMemoryCtrl::accessHost(Addr host, uint8_t *data, unsigned size,
+                           bool write)
+{
+    Request req(host, size, 0, Request::funcMasterId);
+    Packet pkt(&req, write ? MemCmd::WriteReq : MemCmd::ReadReq);
+    pkt.dataStatic(data);
+    internal_port.sendFunctional(&pkt);
+}
+
+void
+PARDMemoryCtrl::markDirty(Addr host, unsigned size)
+{
+    for (uint64_t idx = pageIndex(host); idx <= pageIndex(host + size - 1);
+         idx++)
+        dirtyPages[idx] = true;
+}
+
+void
+PARDMemoryCtrl::fillLazy(Addr host, unsigned size)
+{
+    for (uint64_t idx = pageIndex(host); idx <= pageIndex(host + size - 1);
+         idx++) {
+        if (lazyPending[idx])
+            fillPage(idx);
+    }
+}
+
+void
+PARDMemoryCtrl::fillPage(uint64_t idx)
+{
+    std::vector<uint8_t> page(PageSize, 0);
+
+    // Pages without a saved run were zero when the image was taken
+    auto it = lazyPages.find(idx);
+    if (it != lazyPages.end()) {
+        const uint8_t *run = loadPageRun(it->second.file, it->second.offset);
+        memcpy(&page[0], run + it->second.index * PageSize, PageSize);
+        lazyPages.erase(it);
+    }
+
+    lazyPending[idx] = false;
+    lazyCount--;
+    accessHost(memBase + idx * PageSize, &page[0], PageSize, true);
+}
+
+void
+PARDMemoryCtrl::resetExtent(Addr extent, bool dirty)
+{
+    // Memory is still all zero while the initial partitions are built
+    bool zero = internal_port.isConnected();
+    std::vector<uint8_t> page(zero ? PageSize : 0, 0);
+
+    for (uint64_t idx = pageIndex(extent);
+         idx < pageIndex(extent) + granule / PageSize; idx++) {
+        dirtyPages[idx] = dirty;
+        if (lazyPending[idx]) {
+            lazyPending[idx] = false;
+            lazyCount--;
+            lazyPages.erase(idx);
+        }
+        if (zero)
+            accessHost(memBase + idx * PageSize, &page[0], PageSize, true);
+    }
+}
+
+const uint8_t *
+PARDMemoryCtrl::loadPageRun(int file, uint64_t offset)
+{
+    if (runCacheFile == file && runCacheOffset == offset)
+        return &runCache[0];
+
+    const std::string &path = lazyFiles[file];
+    std::ifstream in(path.c_str(), std::ios::binary);
+    PageRunHeader hdr;
+    in.seekg(offset);
+    in.read((char *)&hdr, sizeof(hdr));
+    std::vector<uint8_t> packed(hdr.length);
+    in.read((char *)&packed[0], hdr.length);
+    if (!in)
+        fatal("%s: failed to read page run @ %#x of %s.\n",
+              name(), offset, path);
+
+    uLongf size = hdr.count * PageSize;
+    runCache.resize(size);
+    if (uncompress(&runCache[0], &size, &packed[0], hdr.length) != Z_OK ||
+        size != hdr.count * PageSize)
+        fatal("%s: corrupted page run @ %#x of %s.\n", name(), offset, path);
+
+    runCacheFile = file;
+    runCacheOffset = offset;
+    return &runCache[0];
+}
+
+void
+PARDMemoryCtrl::writePageRun(std::ostream &out, uint64_t page,
+                             uint32_t count, const uint8_t *data)
+{
+    PageRunHeader hdr;
+    hdr.page = page;
+    hdr.count = count;
+    hdr.length = 0;
+
+    // Speed over ratio, most of the win comes from skipping pages
+    std::vector<uint8_t> packed;
+    if (data) {
+        uLongf size = compressBound(count * PageSize);
+        packed.resize(size);
+        if (compress2(&packed[0], &size, data, count * PageSize,
+                      Z_BEST_SPEED) != Z_OK)
+            fatal("%s: failed to compress page run.\n", name());
+        hdr.length = size;
+    }
+
+    out.write((char *)&hdr, sizeof(hdr));
+    if (hdr.length)
+        out.write((char *)&packed[0], hdr.length);
+}
+
+static bool
+isZeroPage(const uint8_t *page, uint64_t size)
+{
+    const uint64_t *word = (const uint64_t *)page;
+    for (uint64_t i = 0; i < size / sizeof(uint64_t); i++) {
+        if (word[i])
+            return false;
+    }
+    return true;
+}
+
+void
+PARDMemoryCtrl::serializeLDom(uint16_t DSid, const std::string &dir,
+                              std::ostream &os)
+{
+    uint64_t memSize = getPartitionSize(DSid);
+    std::string memFile = "memory.pages";
+    std::string path = dir + "/" + memFile;
+
+    // Reusing an image id of the chain would overwrite an ancestor and
+    // make the chain point at itself, start over with a full image
+    std::vector<std::string> &chain = imageChain[DSid];
+    if (std::find(chain.begin(), chain.end(), dir) != chain.end()) {
+        DPRINTF(PARDMemoryCtrl, "DSid#%d: %s reused, full image\n",
+                DSid, dir);
+        chain.clear();
+    }
+    std::string parent = chain.empty() ? "" : chain.back();
+    SERIALIZE_SCALAR(memSize);
+    SERIALIZE_SCALAR(memFile);
+    SERIALIZE_SCALAR(parent);
+
+    // Pages still waiting to be restored from the file being replaced
+    // must be read in before it is truncated
+    auto ref = std::find(lazyFiles.begin(), lazyFiles.end(), path);
+    if (ref != lazyFiles.end()) {
+        int file = ref - lazyFiles.begin();
+        std::vector<uint64_t> pending;
+        for (auto &lazy : lazyPages) {
+            if (lazy.second.file == file)
+                pending.push_back(lazy.first);
+        }
+        for (auto idx : pending)
+            fillPage(idx);
+        runCacheFile = -1;
+    }
+
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if (!out.is_open())
+        fatal("%s: can't open LDomain memory image %s.\n", name(), path);
+    out.write((const char *)&LDomImageMagic, sizeof(LDomImageMagic));
+
+    // A full image skips zero pages, an incremental one keeps only the
+    // pages written since its parent, zero runs included
+    std::vector<uint8_t> run(MaxRunPages * PageSize);
+    std::vector<uint8_t> page(PageSize);
+    uint64_t runStart = 0;
+    uint32_t runCount = 0;
+    bool runZero = false;
+    uint64_t saved = 0;
+
+    for (uint64_t p = 0; p < memSize / PageSize; p++) {
+        Addr host;
+        remapAddr(DSid, p * PageSize, host);
+        uint64_t idx = pageIndex(host);
+
+        bool changed = parent.empty() || dirtyPages[idx];
+        bool zero = false;
+        dirtyPages[idx] = false;
+        if (changed) {
+            if (lazyPending[idx])
+                fillPage(idx);
+            accessHost(host, &page[0], PageSize, false);
+            zero = isZeroPage(&page[0], PageSize);
+            if (zero && parent.empty())
+                changed = false;
+        }
+
+        bool extend = changed && runCount && runZero == zero &&
+                      runStart + runCount == p &&
+                      (zero || runCount < MaxRunPages);
+        if (runCount && !extend) {
+            writePageRun(out, runStart, runCount, runZero ? NULL : &run[0]);
+            runCount = 0;
+        }
+        if (!changed)
+            continue;
+
+        if (!runCount) {
+            runStart = p;
+            runZero = zero;
+        }
+        if (!zero)
+            memcpy(&run[runCount * PageSize], &page[0], PageSize);
+        runCount++;
+        saved++;
+    }
+    if (runCount)
+        writePageRun(out, runStart, runCount, runZero ? NULL : &run[0]);
+
+    if (!out)
+        fatal("%s: failed to write LDomain memory image %s.\n", name(), path);
+
+    DPRINTF(PARDMemoryCtrl, "DSid#%d: %d of %d pages saved to %s%s\n",
+            DSid, saved, memSize / PageSize, path,
+            parent.empty() ? "" : " (incremental)");
+
+    chain.push_back(dir);
+}
+
+void
+PARDMemoryCtrl::unserializeLDom(uint16_t DSid, Checkpoint *cp,
+                                const std::string &section)
+{
+    uint64_t memSize;
+    std::string memFile, parent;
+    UNSERIALIZE_SCALAR(memSize);
+    UNSERIALIZE_SCALAR(memFile);
+    UNSERIALIZE_SCALAR(parent);
+
+    uint64_t granted = requestPartition(DSid, memSize);
+    if (granted < memSize) {
+        warn("%s: DSid#%d only %#x of %#x bytes restored.\n",
+             name(), DSid, granted, memSize);
+    }
+
+    // Image chain, newest first
+    std::vector<std::string> chain, dirs;
+    chain.push_back(cp->cptDir + "/" + memFile);
+    dirs.push_back(cp->cptDir);
+    while (!parent.empty()) {
+        if (std::find(dirs.begin(), dirs.end(), parent) != dirs.end())
+            fatal("%s: DSid#%d image chain of %s loops at %s.\n",
+                  name(), DSid, cp->cptDir, parent);
+        Checkpoint parentCpt(parent);
+        std::string file;
+        paramIn(&parentCpt, section, "memFile", file);
+        chain.push_back(parent + "/" + file);
+        dirs.push_back(parent);
+        paramIn(&parentCpt, section, "parent", parent);
+    }
+
+    // Replay the chain oldest first, so newer runs override older ones
+    std::unordered_map<uint64_t, LazyPage> guestPages;
+    for (int i = chain.size() - 1; i >= 0; i--) {
+        int file = std::find(lazyFiles.begin(), lazyFiles.end(), chain[i]) -
+                   lazyFiles.begin();
+        if (file == lazyFiles.size())
+            lazyFiles.push_back(chain[i]);
+
+        std::ifstream in(chain[i].c_str(), std::ios::binary);
+        uint64_t magic = 0;
+        in.read((char *)&magic, sizeof(magic));
+        if (!in || magic != LDomImageMagic)
+            fatal("%s: %s is not an LDomain memory image.\n",
+                  name(), chain[i]);
+
+        PageRunHeader hdr;
+        while (in.read((char *)&hdr, sizeof(hdr))) {
+            uint64_t offset = (uint64_t)in.tellg() - sizeof(hdr);
+            for (uint32_t j = 0; j < hdr.count; j++) {
+                LazyPage lazy = { file, offset, j };
+                if (hdr.length)
+                    guestPages[hdr.page + j] = lazy;
+                else
+                    guestPages.erase(hdr.page + j);
+            }
+            in.seekg(hdr.length, std::ios::cur);
+        }
+    }
+
+    // Nothing is copied yet, every page is filled on first access
+    for (uint64_t p = 0; p < granted / PageSize; p++) {
+        Addr host;
+        remapAddr(DSid, p * PageSize, host);
+        uint64_t idx = pageIndex(host);
+
+        dirtyPages[idx] = false;
+        if (!lazyPending[idx]) {
+            lazyPending[idx] = true;
+            lazyCount++;
+        }
+        auto it = guestPages.find(p);
+        if (it != guestPages.end())
+            lazyPages[idx] = it->second;
+        else
+            lazyPages.erase(idx);
+    }
+
+    DPRINTF(PARDMemoryCtrl, "DSid#%d: %d pages restored lazily from %d "
+            "images\n", DSid, guestPages.size(), chain.size());
+
+    imageChain[DSid].assign(dirs.rbegin(), dirs.rend());
+}
+
 PARDMemoryCtrl*
 PARDMemoryCtrlParams::create()
 {
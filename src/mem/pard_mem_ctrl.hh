@@ -1,10 +1,21 @@
 #ifndef __MEM_PARD_MEMORYCTRL_HH__
 #define __MEM_PARD_MEMORYCTRL_HH__
 
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "mem/abstract_mem.hh"
 #include "params/PARDMemoryCtrl.hh"
+#include "prm/interfaces.hh"
+#include "sim/eventq.hh"
+
+class PARDMemoryCtrlCP;
 
-class PARDMemoryCtrl : public MemObject
+class PARDMemoryCtrl : public MemObject, public ILDomSerializable
 {
   private:
 
@@ -49,7 +60,7 @@ class PARDMemoryCtrl : public MemObject
         { return memory.getAddrRanges(); }
 
         virtual void recvRetry()
-        { internalPort.sendRetry(); }
+        { memory.recvRespRetry(); }
     };
 
     class InternalPort : public MasterPort
@@ -76,12 +87,98 @@ class PARDMemoryCtrl : public MemObject
     InternalPort internal_port;
     std::vector<AbstractMemory *> memories;
 
+    PARDMemoryCtrlCP *cp;
+
+    /**
+     * Memory partitions. Each DSid owns a list of granule-sized host
+     * extents, mapped in order from guest address 0. Extents not owned
+     * by any DSid stay in the shared free pool.
+     */
+    const uint64_t granule;
+    std::map<uint16_t, std::vector<Addr> > partitions;
+    std::set<Addr> freeExtents;
+
+    /**
+     * LDomain memory images. Writes mark host pages dirty, so an image
+     * only holds the pages written since the previous image of the same
+     * DSid, which it names as its parent. Pages of a restored partition
+     * are filled from the image chain on first access.
+     */
+    static const int PageShift = 12;
+    static const uint64_t PageSize = 1 << PageShift;
+    static const int MaxRunPages = 64;
+
+    struct PageRunHeader {
+        uint64_t page;      // first guest page of the run
+        uint32_t count;     // pages in the run
+        uint32_t length;    // compressed bytes that follow, 0 if zero
+    };
+
+    struct LazyPage {
+        int file;           // index into lazyFiles
+        uint64_t offset;    // file offset of the page run
+        uint32_t index;     // page within the run
+    };
+
+    Addr memBase;
+    std::vector<bool> dirtyPages;
+    /** Image directories of each DSid, oldest first */
+    std::map<uint16_t, std::vector<std::string> > imageChain;
+
+    std::vector<bool> lazyPending;
+    uint64_t lazyCount;
+    std::unordered_map<uint64_t, LazyPage> lazyPages;
+    std::vector<std::string> lazyFiles;
+
+    /** Last decompressed page run */
+    int runCacheFile;
+    uint64_t runCacheOffset;
+    std::vector<uint8_t> runCache;
+
+    uint64_t pageIndex(Addr host) const
+    { return (host - memBase) >> PageShift; }
+    void markDirty(Addr host, unsigned size);
+    void fillLazy(Addr host, unsigned size);
+    void fillPage(uint64_t idx);
+    /** Zero the pages of extent and reset their image state */
+    void resetExtent(Addr extent, bool dirty);
+    const uint8_t *loadPageRun(int file, uint64_t offset);
+    void writePageRun(std::ostream &out, uint64_t page, uint32_t count,
+                      const uint8_t *data);
+    void accessHost(Addr host, uint8_t *data, unsigned size, bool write);
+
   public:
 
     PARDMemoryCtrl(const PARDMemoryCtrlParams* p);
 
     virtual void init();
 
+    virtual void serialize(std::ostream &os);
+    virtual void unserialize(Checkpoint *cp, const std::string &section);
+
+    // Partition size and contents of a single LDomain
+    virtual void serializeLDom(uint16_t DSid, const std::string &dir,
+                               std::ostream &os);
+    virtual void unserializeLDom(uint16_t DSid, Checkpoint *cp,
+                                 const std::string &section);
+
+  public:
+    /**
+     * Grow or shrink the partition of DSid to size, rounded up to the
+     * granule. Shrinking drops extents from the top of the partition,
+     * growing takes them from the free pool while it lasts.
+     * @return size actually granted
+     */
+    uint64_t resizePartition(uint16_t DSid, uint64_t size);
+    uint64_t getPartitionSize(uint16_t DSid) const;
+    /** Resize through the control plane, keeping its tables in sync */
+    uint64_t requestPartition(uint16_t DSid, uint64_t size);
+    std::vector<uint16_t> getPartitions() const;
+
+    uint64_t getTotalSize() const;
+    uint64_t getFreeSize() const { return freeExtents.size() * granule; }
+    uint64_t getGranule() const { return granule; }
+
     virtual BaseSlavePort&
     getSlavePort(const std::string& if_name, PortID idx = InvalidPortID)
     {
@@ -108,9 +205,28 @@ class PARDMemoryCtrl : public MemObject
     void recvFunctional(PacketPtr pkt);
     bool recvTimingReq(PacketPtr pkt);
     bool recvTimingResp(PacketPtr pkt);
+    void recvRespRetry();
+
+    /**
+     * Translate addr of DSid into the host memory.
+     * @return false if addr is outside the partition of DSid
+     */
+    virtual bool remapAddr(uint16_t DSid, Addr addr, Addr &remapped) const;
+
+    /**
+     * Out of partition accesses are completed here like an unpopulated
+     * region: reads return all ones, writes are dropped.
+     */
+    void faultAccess(PacketPtr pkt);
+    void sendFaultResponses();
+    EventWrapper<PARDMemoryCtrl, &PARDMemoryCtrl::sendFaultResponses>
+        faultRespEvent;
+    std::deque<PacketPtr> faultResponses;
+    /** Packets of inhibited or posted faults, freed on next request */
+    std::vector<PacketPtr> pendingDelete;
+    bool faultRetry;
+    bool internalRetry;
 
-    virtual Addr remapAddr(uint16_t DSid, Addr addr) const;
-   
 };
 
 #endif	// __MEM_PARD_MEMORYCTRL_HH__
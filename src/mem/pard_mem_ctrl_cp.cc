@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2014 ACS, ICT
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+#include "debug/ControlPlane.hh"
+#include "mem/pard_mem_ctrl.hh"
+#include "mem/pard_mem_ctrl_cp.hh"
+#include "sim/serialize.hh"
+
+PARDMemoryCtrlCP::PARDMemoryCtrlCP(const Params *p)
+    : ControlPlane(p),
+      param_table_entries(p->param_table_entries),
+      stat_table_entries(p->param_table_entries),
+      memctrl(NULL)
+{
+    memset(&memInfo, 0, sizeof(memInfo));
+
+    // Allocate ConfigTable
+    paramTable = new struct MemCtrlParamEntry[param_table_entries];
+    statTable  = new struct MemCtrlStatEntry[stat_table_entries];
+    memset(paramTable, 0,
+           sizeof(struct MemCtrlParamEntry) * param_table_entries);
+    memset(statTable, 0,
+           sizeof(struct MemCtrlStatEntry) * stat_table_entries);
+
+    // Per-DSid counters, updated on resize and fault
+    sizeCounter = registerCounter("mem_size");
+    resizesCounter = registerCounter("mem_resizes");
+    faultsCounter = registerCounter("mem_faults");
+}
+
+PARDMemoryCtrlCP::~PARDMemoryCtrlCP()
+{
+    delete[] statTable;
+    delete[] paramTable;
+}
+
+void
+PARDMemoryCtrlCP::regMemoryCtrl(PARDMemoryCtrl *_memctrl)
+{
+    panic_if(memctrl, "%s already reg to %s\n", name(), memctrl->name());
+    memctrl = _memctrl;
+
+    memInfo.totalSize = memctrl->getTotalSize();
+    memInfo.granule = memctrl->getGranule();
+
+    // Publish partitions created by the memory controller at startup
+    std::vector<uint16_t> dsids = memctrl->getPartitions();
+    panic_if(dsids.size() > param_table_entries,
+             "%s: %d initial partitions, only %d table entries.\n",
+             name(), dsids.size(), param_table_entries);
+    for (int i = 0; i < dsids.size(); i++) {
+        uint64_t size = memctrl->getPartitionSize(dsids[i]);
+        paramTable[i].flags = MEMCTRL_FLAG_VALID;
+        paramTable[i].DSid = dsids[i];
+        paramTable[i].size = size;
+        statTable[i].flags = MEMCTRL_FLAG_VALID;
+        statTable[i].DSid = dsids[i];
+        statTable[i].size = size;
+    }
+}
+
+int
+PARDMemoryCtrlCP::findRow(uint16_t DSid) const
+{
+    for (int i = 0; i < param_table_entries; i++) {
+        if ((paramTable[i].flags & MEMCTRL_FLAG_VALID) &&
+            paramTable[i].DSid == DSid)
+            return i;
+    }
+    return -1;
+}
+
+void
+PARDMemoryCtrlCP::recordFault(uint16_t DSid)
+{
+    int row = findRow(DSid);
+    if (row >= 0)
+        statTable[row].faults++;
+    incrCounter(DSid, faultsCounter, 1);
+}
+
+uint64_t
+PARDMemoryCtrlCP::requestSize(uint16_t DSid, uint64_t size)
+{
+    int row = findRow(DSid);
+    for (int i = 0; row < 0 && i < param_table_entries; i++) {
+        if (!(paramTable[i].flags & MEMCTRL_FLAG_VALID))
+            row = i;
+    }
+    if (row < 0) {
+        warn("%s: no free row for DSid#%d.\n", name(), DSid);
+        return memctrl->getPartitionSize(DSid);
+    }
+
+    MemCtrlParamEntry old = paramTable[row];
+    paramTable[row].flags |= MEMCTRL_FLAG_VALID;
+    paramTable[row].DSid = DSid;
+    paramTable[row].size = size;
+    applyRow(row, old);
+    return statTable[row].size;
+}
+
+uint64_t
+PARDMemoryCtrlCP::queryTable(uint16_t DSid, uint32_t addr)
+{
+    uint64_t *pdata;
+    DPRINTF(ControlPlane, "queryTable(DSid=%d, addr=0x%x)\n",
+            DSid, addr);
+
+    memInfo.freeSize = memctrl ? memctrl->getFreeSize() : 0;
+
+    pdata = parseAddr(addr);
+    if (!pdata) {
+        warn("PARDMemoryCtrlCP: unknown addr 0x%x", addr);
+        return 0xFFFFFFFFFFFFFFFF;
+    }
+    return *pdata;
+}
+
+void
+PARDMemoryCtrlCP::updateTable(uint16_t DSid, uint32_t addr, uint64_t data)
+{
+    uint64_t *pdata;
+
+    DPRINTF(ControlPlane, "updateTable(DSid=%d, addr=0x%x, data=0x%x)\n",
+            DSid, addr, data);
+
+    pdata = parseAddr(addr);
+    if (!pdata) {
+        warn("PARDMemoryCtrlCP: unknown addr 0x%x", addr);
+        return;
+    }
+
+    if ((char *)pdata < (char *)paramTable ||
+        (char *)pdata >= (char *)&paramTable[param_table_entries]) {
+        // stat table and system info are read-only
+        warn("PARDMemoryCtrlCP: write to read-only addr 0x%x", addr);
+        return;
+    }
+
+    int row = ((char *)pdata - (char *)paramTable) /
+              sizeof(struct MemCtrlParamEntry);
+    MemCtrlParamEntry old = paramTable[row];
+    *pdata = data;
+    applyRow(row, old);
+}
+
+void
+PARDMemoryCtrlCP::applyRow(int row, const MemCtrlParamEntry &old)
+{
+    MemCtrlParamEntry &entry = paramTable[row];
+    MemCtrlStatEntry &stat = statTable[row];
+    bool was_valid = old.flags & MEMCTRL_FLAG_VALID;
+    bool is_valid = entry.flags & MEMCTRL_FLAG_VALID;
+
+    panic_if(!memctrl, "%s: no memory controller registered.\n", name());
+
+    if (was_valid && (!is_valid || old.DSid != entry.DSid)) {
+        memctrl->resizePartition(old.DSid, 0);
+        updateCounter(old.DSid, sizeCounter, 0);
+        memset(&stat, 0, sizeof(stat));
+    }
+
+    if (!is_valid)
+        return;
+
+    if (was_valid && old.DSid == entry.DSid && old.size == entry.size)
+        return;
+
+    uint64_t granted = memctrl->resizePartition(entry.DSid, entry.size);
+    if (granted != entry.size) {
+        warn("%s: DSid#%d requested %#x bytes, granted %#x.\n",
+             name(), entry.DSid, entry.size, granted);
+    }
+
+    stat.flags = MEMCTRL_FLAG_VALID;
+    stat.DSid = entry.DSid;
+    stat.size = granted;
+    stat.generation++;
+    updateCounter(entry.DSid, sizeCounter, granted >> 20);
+    incrCounter(entry.DSid, resizesCounter, 1);
+}
+
+int
+PARDMemoryCtrlCP::snapshotStats(uint16_t DSid, uint8_t *buf, int size)
+{
+    int row = findRow(DSid);
+    if (row < 0)
+        return 0;
+    return copyStatRow(&statTable[row], sizeof(struct MemCtrlStatEntry),
+                       buf, size);
+}
+
+uint64_t *
+PARDMemoryCtrlCP::parseAddr(uint32_t addr)
+{
+    char *ptr = NULL;
+    int offset;
+
+    switch (addr & ADDRTYPE_MASK) {
+    // Access ConfigTable
+    case ADDRTYPE_CFGTBL:
+        {
+            int row = cfgtbl_addr2row(addr);
+            offset = cfgtbl_addr2offset(addr);
+
+            switch (cfgtbl_addr2type(addr)) {
+              case CFGTBL_TYPE_PARAM:
+                if ((row < param_table_entries) &&
+                    (offset <= sizeof(struct MemCtrlParamEntry) -
+                               sizeof(uint64_t)))
+                    ptr = (char *)&paramTable[row];
+                break;
+              case CFGTBL_TYPE_STAT:
+                if ((row < stat_table_entries) &&
+                    (offset <= sizeof(struct MemCtrlStatEntry) -
+                               sizeof(uint64_t)))
+                    ptr = (char *)&statTable[row];
+                break;
+            }
+        }
+        break;
+    // Access memory info
+    case ADDRTYPE_SYSINFO:
+        offset = sysinfo_addr2offset(addr);
+        if (offset <= sizeof(memInfo) - sizeof(uint64_t))
+            ptr = (char *)&memInfo;
+        break;
+    }
+
+    return (ptr ? ((uint64_t *)(ptr + offset)) : NULL);
+}
+
+void
+PARDMemoryCtrlCP::serialize(std::ostream &os)
+{
+    arrayParamOut(os, "paramTable", (uint8_t *)paramTable,
+                  sizeof(struct MemCtrlParamEntry) * param_table_entries);
+    arrayParamOut(os, "statTable", (uint8_t *)statTable,
+                  sizeof(struct MemCtrlStatEntry) * stat_table_entries);
+}
+
+void
+PARDMemoryCtrlCP::unserialize(Checkpoint *cp, const std::string &section)
+{
+    arrayParamIn(cp, section, "paramTable", (uint8_t *)paramTable,
+                 sizeof(struct MemCtrlParamEntry) * param_table_entries);
+    arrayParamIn(cp, section, "statTable", (uint8_t *)statTable,
+                 sizeof(struct MemCtrlStatEntry) * stat_table_entries);
+}
+
+PARDMemoryCtrlCP *
+PARDMemoryCtrlCPParams::create()
+{
+    return new PARDMemoryCtrlCP(this);
+}
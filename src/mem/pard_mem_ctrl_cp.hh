@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2014 ACS, ICT
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/**
+ * @file
+ * Declaration of PARD memory controller control plane.
+ *
+ * Each param table row assigns a memory partition to one DSid. Writing
+ * the size field of a valid row grows or shrinks the partition at
+ * runtime, clearing FLAG_VALID releases it back to the shared pool.
+ * The stat table row with the same index reports the size actually
+ * granted, which is smaller than requested when the pool runs out.
+ *
+ * A guest balloon driver learns about a resize by polling the
+ * generation field of its stat entry (via PRM or config memory).
+ */
+
+#ifndef __MEM_PARD_MEMORYCTRL_CP_HH__
+#define __MEM_PARD_MEMORYCTRL_CP_HH__
+
+#include "params/PARDMemoryCtrlCP.hh"
+#include "prm/ControlPlane.hh"
+
+class PARDMemoryCtrl;
+
+/**
+ * Param Table
+ */
+struct MemCtrlParamEntry {
+    uint16_t flags;
+    uint16_t DSid;
+    uint32_t __padding;
+    uint64_t size;          // requested partition size in bytes
+};
+#define MEMCTRL_FLAG_VALID	0x0001
+
+/**
+ * Stat Table, same row as param table
+ */
+struct MemCtrlStatEntry {
+    uint16_t flags;
+    uint16_t DSid;
+    uint32_t generation;    // bumped on every resize
+    uint64_t size;          // granted partition size in bytes
+    uint64_t faults;        // out of partition accesses
+};
+
+/**
+ * SystemInfo Table
+ */
+struct MemCtrlInfo {
+    uint64_t totalSize;
+    uint64_t freeSize;
+    uint64_t granule;
+};
+
+class PARDMemoryCtrlCP : public ControlPlane
+{
+  protected:
+    int param_table_entries;
+    int stat_table_entries;
+
+    struct MemCtrlParamEntry *paramTable;
+    struct MemCtrlStatEntry *statTable;
+    struct MemCtrlInfo memInfo;
+
+    PARDMemoryCtrl *memctrl;
+
+    /** Counter indexes, see ControlPlane::registerCounter() */
+    int sizeCounter;
+    int resizesCounter;
+    int faultsCounter;
+
+  public:
+    typedef PARDMemoryCtrlCPParams Params;
+    PARDMemoryCtrlCP(const Params *p);
+    ~PARDMemoryCtrlCP();
+
+    void regMemoryCtrl(PARDMemoryCtrl *_memctrl);
+
+  public:
+    /** Called by the memory controller on out of partition access */
+    void recordFault(uint16_t DSid);
+    /**
+     * Resize the partition of DSid as if PRM wrote its param table row,
+     * taking a free row for a DSid without partition.
+     * @return size actually granted
+     */
+    uint64_t requestSize(uint16_t DSid, uint64_t size);
+
+    virtual uint64_t queryTable(uint16_t DSid, uint32_t addr);
+    virtual void updateTable(uint16_t DSid, uint32_t addr, uint64_t data);
+    virtual int snapshotStats(uint16_t DSid, uint8_t *buf, int size);
+
+    virtual void serialize(std::ostream &os);
+    virtual void unserialize(Checkpoint *cp, const std::string &section);
+
+  private:
+    uint64_t *parseAddr(uint32_t addr);
+    int findRow(uint16_t DSid) const;
+    void applyRow(int row, const MemCtrlParamEntry &old);
+};
+
+#endif	// __MEM_PARD_MEMORYCTRL_CP_HH__
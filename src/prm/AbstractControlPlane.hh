@@ -10,13 +10,13 @@ class AbstractControlPlane : public ClockedObject
 {
   public:
     virtual void updateStat(int16_t DSid, const std::string &stat,
-                            uint32_t value)
+                            uint64_t value)
     {
         checkTrigger(DSid, stat);
     }
 
     virtual void incrStat(int16_t DSid, const std::string &stat,
-                          int32_t delta)
+                          int64_t delta)
     {
         checkTrigger(DSid, stat);
     }
@@ -28,7 +28,16 @@
  * Authors: Jiuyue Ma
  */
 
+#include <algorithm>
+#include <cstddef>
+
+#include "base/intmath.hh"
+#include "debug/CPAdaptor.hh"
+#include "debug/Drain.hh"
 #include "prm/CPAdaptor.hh"
+#include "prm/CPConnector.hh"
+#include "sim/core.hh"
+#include "sim/system.hh"
 
 struct REGISTER_MAP {
     uint32_t base;
@@ -52,8 +61,20 @@ REGISTER_MAP cpRegisterMap[] = {
 
 CPAdaptor::CPAdaptor(Params *p)
     : PciDevice(p),
-      masterPort(p->name + ".master", this)
+      masterPort(p->name + ".master", this),
+      cpnHopLatency(p->cpn_latency), cpnHops(p->cpn_hops),
+      cpnBandwidth(p->cpn_bandwidth),
+      reqLinkFree(p->cpn_hops, 0), respLinkFree(p->cpn_hops, 0),
+      snapProbed(false), snapOverflow(false), snapStart(0),
+      snapProbing(false), snapPending(false), snapCursor(0), snapDSid(0),
+      snapFirstDSid(0), snapLastDSid(0), snapRecords(0), snapLen(0),
+      snapshotStepEvent(this), snapshotEvent(this),
+      ringCP(0), ringStart(0), ringHdrValid(false), ringOpIdx(0),
+      ringDoorbell(1),
+      ringFetchEvent(this), ringStepEvent(this), ringDoneEvent(this),
+      drainManager(NULL)
 {
+    memset(&cpaRegs, 0, sizeof(cpaRegs));
 }
 
 void
@@ -62,12 +83,111 @@ CPAdaptor::init()
     PciDevice::init();
 }
 
+void
+CPAdaptor::regStats()
+{
+    using namespace Stats;
+
+    PciDevice::regStats();
+
+    cpnAccesses
+        .name(name() + ".cpnAccesses")
+        .desc("Number of accesses sent to CPN")
+        ;
+    cpnRoundTrip
+        .init(16)
+        .name(name() + ".cpnRoundTrip")
+        .desc("Round-trip latency of CPN accesses")
+        .flags(pdf)
+        ;
+    cmdRoundTrip
+        .init(16)
+        .name(name() + ".cmdRoundTrip")
+        .desc("Round-trip latency of CP commands issued by PRM")
+        .flags(pdf)
+        ;
+    snapshots
+        .name(name() + ".snapshots")
+        .desc("Number of statistics snapshots")
+        ;
+    snapshotLatency
+        .init(16)
+        .name(name() + ".snapshotLatency")
+        .desc("Latency from snapshot start to completion interrupt")
+        .flags(pdf)
+        ;
+    ringBatches
+        .name(name() + ".ringBatches")
+        .desc("Number of command ring batches")
+        ;
+    ringDescs
+        .name(name() + ".ringDescs")
+        .desc("Number of command ring descriptors executed")
+        ;
+    ringLatency
+        .init(16)
+        .name(name() + ".ringLatency")
+        .desc("Latency from ring doorbell to descriptor write back")
+        .flags(pdf)
+        ;
+}
+
 Tick
 CPAdaptor::recvResponse(PacketPtr pkt)
 {
+    CPNState *state = dynamic_cast<CPNState *>(pkt->popSenderState());
+    assert(state);
+
+    // reply crosses the links back before the engine sees it
+    unsigned bytes = cpnHeaderBytes + (pkt->isRead() ? pkt->getSize() : 0);
+    Tick arrive = crossLinks(respLinkFree, bytes, curTick());
+
+    cpnAccesses++;
+    cpnRoundTrip.sample(arrive - state->start);
+    schedule(state->done, arrive);
+
+    delete state;
+    delete pkt->req;
+    delete pkt;
     return 0;
 }
 
+bool
+CPAdaptor::busy() const
+{
+    return (cpaRegs.snapCtrl & CPA_SNAP_BUSY) ||
+           (cpaRegs.ringCtrl & CPA_RING_BUSY);
+}
+
+void
+CPAdaptor::checkDrain()
+{
+    if (!drainManager || busy())
+        return;
+
+    DPRINTF(Drain, "%s done draining CPN accesses\n", name());
+    drainManager->signalDrainDone();
+    drainManager = NULL;
+}
+
+unsigned int
+CPAdaptor::drain(DrainManager *dm)
+{
+    unsigned int count = PciDevice::drain(dm) + masterPort.drain(dm);
+
+    // Snapshot and command ring run to completion first
+    if (busy()) {
+        drainManager = dm;
+        count++;
+    }
+
+    if (count)
+        setDrainState(Drainable::Draining);
+    else
+        setDrainState(Drainable::Drained);
+    return count;
+}
+
 
 // method to access cpaRegs
 void
@@ -81,6 +201,63 @@ CPAdaptor::accessCommand(Addr offset, int size, uint8_t *data, bool read)
         else
             cpaRegs.command = *(uint32_t *)data;
         break;
+      case CPA_SNAPCTRL_OFFSET:
+        assert (size == sizeof(uint32_t));
+        if (read) {
+            *(uint32_t *)data = cpaRegs.snapCtrl;
+            // reading the status of a finished snapshot acks its interrupt
+            if (cpaRegs.snapCtrl & CPA_SNAP_DONE) {
+                cpaRegs.snapCtrl = 0;
+                intrClear();
+            }
+        } else if (*(uint32_t *)data & CPA_SNAP_START)
+            startSnapshot();
+        break;
+      case CPA_SNAPDSID_OFFSET:
+        assert (size == sizeof(uint32_t));
+        if (read) {
+            *(uint32_t *)data = ((uint32_t)cpaRegs.snapLastDSid << 16) |
+                                cpaRegs.snapFirstDSid;
+        } else {
+            cpaRegs.snapFirstDSid = *(uint32_t *)data & 0xFFFF;
+            cpaRegs.snapLastDSid  = *(uint32_t *)data >> 16;
+        }
+        break;
+      case CPA_SNAPSIZE_OFFSET:
+        assert (size == sizeof(uint32_t));
+        if (read)
+            *(uint32_t *)data = cpaRegs.snapSize;
+        else
+            cpaRegs.snapSize = *(uint32_t *)data;
+        break;
+      case CPA_SNAPADDR_OFFSET:
+        assert (size == sizeof(uint64_t));
+        if (read)
+            *(uint64_t *)data = cpaRegs.snapAddr;
+        else
+            cpaRegs.snapAddr = *(uint64_t *)data;
+        break;
+      case CPA_RINGCTRL_OFFSET:
+        assert (size == sizeof(uint32_t));
+        if (read)
+            *(uint32_t *)data = cpaRegs.ringCtrl;
+        else if (*(uint32_t *)data & CPA_RING_START)
+            startRing();
+        break;
+      case CPA_RINGCOUNT_OFFSET:
+        assert (size == sizeof(uint32_t));
+        if (read)
+            *(uint32_t *)data = cpaRegs.ringCount;
+        else
+            cpaRegs.ringCount = *(uint32_t *)data;
+        break;
+      case CPA_RINGADDR_OFFSET:
+        assert (size == sizeof(uint64_t));
+        if (read)
+            *(uint64_t *)data = cpaRegs.ringAddr;
+        else
+            cpaRegs.ringAddr = *(uint64_t *)data;
+        break;
       default:
         panic("Invalid CPAdaptor command register offset: %#x data %#x\n",
               offset, *data);
@@ -88,7 +265,7 @@ CPAdaptor::accessCommand(Addr offset, int size, uint8_t *data, bool read)
 }
 
 // method to access selected CPC's register space
-void
+Tick
 CPAdaptor::accessData(Addr offset, int size, uint8_t *data, bool read)
 {
     bool check_ok = false;
@@ -107,21 +284,335 @@ CPAdaptor::accessData(Addr offset, int size, uint8_t *data, bool read)
     if (!check_ok)
         panic("Invalid CPAdaptor data offset: %#x size: %#x \n", offset, size);
 
-    // Build request to CPN
-    Addr paddr = cpaRegs.command.selectCP*32 + offset;
-    RequestPtr req = new Request(paddr, size, Request::UNCACHEABLE,
-                                 Request::funcMasterId);
-    PacketPtr pkt = new Packet(req, read ? MemCmd::ReadReq : MemCmd::WriteReq);
+    Tick lat = sendToCPN(cpaRegs.command.selectCP*32 + offset,
+                         size, data, read);
+    if (offset == CPA_CP_CMD_OFFSET && !read)
+        cmdRoundTrip.sample(lat);
+
+    return lat;
+}
+
+Tick
+CPAdaptor::crossLinks(std::vector<Tick> &linkFree, unsigned bytes,
+                      Tick when)
+{
+    Tick xfer = bytes * cpnBandwidth;
+    for (int hop = 0; hop < linkFree.size(); hop++) {
+        Tick start = std::max(when, linkFree[hop]);
+        linkFree[hop] = start + xfer;
+        when = start + xfer + cpnHopLatency;
+    }
+    return when;
+}
+
+Tick
+CPAdaptor::sendToCPN(Addr paddr, int size, uint8_t *data, bool read,
+                     uint16_t DSid)
+{
+    Request req(paddr, size, Request::UNCACHEABLE, Request::funcMasterId);
+    req.setDSid(DSid);
+    Packet pkt(&req, read ? MemCmd::ReadReq : MemCmd::WriteReq);
+    pkt.dataStatic(data);
+
+    // request and reply wait for busy links on the way, queueing and
+    // service time are reported by the CP
+    Tick arrive = crossLinks(reqLinkFree,
+                             cpnHeaderBytes + (read ? 0 : size), curTick());
+    Tick served = arrive + masterPort.sendAtomic(&pkt);
+    Tick lat = crossLinks(respLinkFree,
+                          cpnHeaderBytes + (read ? size : 0), served) -
+               curTick();
+
+    cpnAccesses++;
+    cpnRoundTrip.sample(lat);
+    return lat;
+}
+
+void
+CPAdaptor::accessCPN(Addr paddr, int size, uint8_t *data, bool read,
+                     uint16_t DSid, Event *done)
+{
+    if (!sys->isTimingMode()) {
+        schedule(done, curTick() + sendToCPN(paddr, size, data, read, DSid));
+        return;
+    }
+
+    Request *req = new Request(paddr, size, Request::UNCACHEABLE,
+                               Request::funcMasterId);
+    req->setDSid(DSid);
+    PacketPtr pkt = new Packet(req, read ? MemCmd::ReadReq
+                                         : MemCmd::WriteReq);
     pkt->dataStatic(data);
-    masterPort.sendAtomic(pkt);
-    delete pkt;
-    delete req;
+    pkt->pushSenderState(new CPNState(done, curTick()));
 
-    // maybe not response immediately, check dispatchAccess()
+    // CPN takes the request once it has crossed the links
+    Tick arrive = crossLinks(reqLinkFree,
+                             cpnHeaderBytes + (read ? 0 : size), curTick());
+    masterPort.schedTimingReq(pkt, arrive);
+}
+
+void
+CPAdaptor::startSnapshot()
+{
+    if (cpaRegs.snapCtrl & CPA_SNAP_BUSY) {
+        warn("CPAdaptor: snapshot already in progress, ignored.\n");
+        return;
+    }
+
+    int size = cpaRegs.snapSize;
+    if (size < (int)sizeof(CPASnapHeader)) {
+        warn("CPAdaptor: snapshot buffer too small (%d bytes).\n", size);
+        cpaRegs.snapCtrl = CPA_SNAP_DONE | CPA_SNAP_OVERFLOW;
+        intrPost();
+        return;
+    }
+
+    // Gather stat tables of all CPs into one packed buffer, one CPN
+    // access at a time, then DMA it to PRM memory
+    snapBuffer.assign(size, 0);
+    snapOverflow = false;
+    snapFirstDSid = cpaRegs.snapFirstDSid;
+    snapLastDSid = cpaRegs.snapLastDSid;
+    snapRecords = 0;
+    snapLen = sizeof(CPASnapHeader);
+
+    // Same as PRM driver: unconnected CP IDs hit the CPN default
+    // responder and read back as all ones.
+    if (!snapProbed)
+        snapCPs.clear();
+    snapProbing = !snapProbed;
+    snapPending = false;
+    snapCursor = 0;
+    snapDSid = snapFirstDSid;
+
+    snapshots++;
+    snapStart = curTick();
+    cpaRegs.snapCtrl = CPA_SNAP_BUSY;
+    snapshotStep();
+}
+
+void
+CPAdaptor::snapshotStep()
+{
+    if (snapProbing) {
+        if (snapPending) {
+            uint32_t cp_type;
+            memcpy(&cp_type, snapReply, sizeof(cp_type));
+            if (cp_type != 0xFFFFFFFF)
+                snapCPs.push_back(snapCursor);
+            snapCursor++;
+        }
+        if (snapCursor < params()->snapshot_max_cps) {
+            snapPending = true;
+            accessCPN(snapCursor*32, sizeof(uint32_t), snapReply, true, 0,
+                      &snapshotStepEvent);
+            return;
+        }
+
+        snapProbed = true;
+        snapProbing = false;
+        snapPending = false;
+        snapCursor = 0;
+        DPRINTF(CPAdaptor, "snapshot: %d control planes found\n",
+                snapCPs.size());
+    }
+
+    if (snapPending) {
+        snapPending = false;
+        if (!gatherSnapshot())
+            snapCursor = snapCPs.size();
+        else if (++snapDSid > snapLastDSid) {
+            snapDSid = snapFirstDSid;
+            snapCursor++;
+        }
+    }
+
+    if (snapCursor < snapCPs.size() && snapFirstDSid <= snapLastDSid) {
+        Addr paddr = CPCONN_SNAP_BASE + snapCPs[snapCursor] *
+                     CPCONN_SNAP_SIZE;
+        snapPending = true;
+        accessCPN(paddr, CPCONN_SNAP_SIZE, snapReply, true, snapDSid,
+                  &snapshotStepEvent);
+        return;
+    }
+
+    CPASnapHeader hdr;
+    hdr.magic = CPA_SNAP_MAGIC;
+    hdr.firstDSid = snapFirstDSid;
+    hdr.lastDSid = snapLastDSid;
+    hdr.records = snapRecords;
+    hdr.bytes = snapLen;
+    hdr.tick = snapStart;
+    memcpy(&snapBuffer[0], &hdr, sizeof(hdr));
+
+    DPRINTF(CPAdaptor, "snapshot DSid [%d, %d]: %d records, %d bytes "
+            "to 0x%x\n", hdr.firstDSid, hdr.lastDSid, hdr.records, snapLen,
+            cpaRegs.snapAddr);
+
+    // DMA starts once all CPs have been read
+    dmaWrite(cpaRegs.snapAddr, snapLen, &snapshotEvent, &snapBuffer[0]);
+}
+
+bool
+CPAdaptor::gatherSnapshot()
+{
+    uint32_t n;
+    memcpy(&n, snapReply, sizeof(n));
+    if (n & CPCONN_SNAP_TRUNCATED) {
+        warn_once("CPAdaptor: stats of DSid %d on CP %d do not fit "
+                  "in snapshot window.\n", snapDSid, snapCPs[snapCursor]);
+        snapOverflow = true;
+        return true;
+    }
+    if (!n || n > CPCONN_SNAP_SIZE - sizeof(n))
+        return true;
+
+    int rec_len = sizeof(CPASnapRecord) + roundUp(n, 8);
+    if (snapLen + rec_len > (int)snapBuffer.size()) {
+        snapOverflow = true;
+        return false;
+    }
+
+    CPASnapRecord rec;
+    rec.cpid = snapCPs[snapCursor];
+    rec.DSid = snapDSid;
+    rec.size = n;
+    memcpy(&snapBuffer[snapLen], &rec, sizeof(rec));
+    memcpy(&snapBuffer[snapLen + sizeof(rec)], snapReply + sizeof(n), n);
+    snapLen += rec_len;
+    snapRecords++;
+    return true;
+}
+
+void
+CPAdaptor::snapshotDone()
+{
+    snapshotLatency.sample(curTick() - snapStart);
+
+    cpaRegs.snapCtrl = CPA_SNAP_DONE | (snapOverflow ? CPA_SNAP_OVERFLOW : 0);
+    intrPost();
+    checkDrain();
 }
 
-// access dispatcher
 void
+CPAdaptor::startRing()
+{
+    if (cpaRegs.ringCtrl & CPA_RING_BUSY) {
+        warn("CPAdaptor: command ring already running, ignored.\n");
+        return;
+    }
+
+    unsigned count = cpaRegs.ringCount;
+    if (!count || count > CPA_RING_MAX_ENTRIES) {
+        warn("CPAdaptor: bad command ring batch of %d descriptors.\n",
+             count);
+        cpaRegs.ringCtrl = CPA_RING_DONE | CPA_RING_ERROR;
+        return;
+    }
+
+    ringBatches++;
+    ringStart = curTick();
+    ringCP = cpaRegs.command.selectCP;
+    ringBuffer.resize(count * sizeof(CPMboxDesc));
+    cpaRegs.ringCtrl = CPA_RING_BUSY;
+    dmaRead(cpaRegs.ringAddr, ringBuffer.size(), &ringFetchEvent,
+            &ringBuffer[0]);
+}
+
+void
+CPAdaptor::queueMailbox(Addr mbox, uint32_t idx, uint8_t *descs,
+                        unsigned n, bool read)
+{
+    // Descriptors that wrap around the ring take a second access
+    while (n) {
+        unsigned part = std::min<unsigned>(n, CPCONN_MBOX_ENTRIES - idx);
+        CPNAccess op = { mbox + sizeof(CPMboxHeader) +
+                         idx * sizeof(CPMboxDesc),
+                         (int)(part * sizeof(CPMboxDesc)), descs, read };
+        ringOps.push_back(op);
+        descs += part * sizeof(CPMboxDesc);
+        idx = (idx + part) % CPCONN_MBOX_ENTRIES;
+        n -= part;
+    }
+}
+
+void
+CPAdaptor::ringFetched()
+{
+    // Read the mailbox header of the CP first, see ringStep()
+    Addr mbox = CPCONN_MBOX_BASE + ringCP * CPCONN_MBOX_SIZE;
+    ringHdrValid = false;
+    ringOps.clear();
+    ringOpIdx = 0;
+    accessCPN(mbox, sizeof(ringHdr), (uint8_t *)&ringHdr, true, 0,
+              &ringStepEvent);
+}
+
+void
+CPAdaptor::ringStep()
+{
+    Addr mbox = CPCONN_MBOX_BASE + ringCP * CPCONN_MBOX_SIZE;
+    unsigned count = ringBuffer.size() / sizeof(CPMboxDesc);
+    CPMboxDesc *descs = (CPMboxDesc *)&ringBuffer[0];
+
+    if (!ringHdrValid) {
+        if (ringHdr.entries != CPCONN_MBOX_ENTRIES ||
+            ringHdr.head >= CPCONN_MBOX_ENTRIES) {
+            warn("CPAdaptor: CP %d has no command mailbox.\n", ringCP);
+            for (unsigned i = 0; i < count; i++)
+                descs[i].status = CPCONN_MBOX_STATUS_ERROR;
+            dmaWrite(cpaRegs.ringAddr, ringBuffer.size(), &ringDoneEvent,
+                     &ringBuffer[0]);
+            return;
+        }
+        ringHdrValid = true;
+
+        // The mailbox is drained on each doorbell, so it takes at most
+        // entries-1 descriptors at a time
+        unsigned chunk = CPCONN_MBOX_ENTRIES - 1;
+        ringHeads.resize((count + chunk - 1) / chunk);
+        uint32_t head = ringHdr.head;
+        for (unsigned i = 0, c = 0, n; i < count; i += n, c++) {
+            uint32_t first = head;
+            n = std::min<unsigned>(count - i, chunk);
+            head = (first + n) % CPCONN_MBOX_ENTRIES;
+            ringHeads[c] = head;
+
+            queueMailbox(mbox, first, (uint8_t *)&descs[i], n, false);
+            CPNAccess set_head = { mbox + offsetof(CPMboxHeader, head),
+                                   sizeof(uint32_t),
+                                   (uint8_t *)&ringHeads[c], false };
+            CPNAccess doorbell = { mbox + offsetof(CPMboxHeader, doorbell),
+                                   sizeof(uint32_t),
+                                   (uint8_t *)&ringDoorbell, false };
+            ringOps.push_back(set_head);
+            ringOps.push_back(doorbell);
+            queueMailbox(mbox, first, (uint8_t *)&descs[i], n, true);
+        }
+    }
+
+    if (ringOpIdx < ringOps.size()) {
+        const CPNAccess &op = ringOps[ringOpIdx++];
+        accessCPN(op.paddr, op.size, op.data, op.read, 0, &ringStepEvent);
+        return;
+    }
+
+    DPRINTF(CPAdaptor, "ring: %d descriptors to CP %d\n", count, ringCP);
+    ringDescs += count;
+    dmaWrite(cpaRegs.ringAddr, ringBuffer.size(), &ringDoneEvent,
+             &ringBuffer[0]);
+}
+
+void
+CPAdaptor::ringDone()
+{
+    ringLatency.sample(curTick() - ringStart);
+    cpaRegs.ringCtrl = CPA_RING_DONE;
+    checkDrain();
+}
+
+// access dispatcher
+Tick
 CPAdaptor::dispatchAccess(PacketPtr pkt, bool read)
 {
     int bar;
@@ -139,15 +630,17 @@ CPAdaptor::dispatchAccess(PacketPtr pkt, bool read)
     int size = pkt->getSize();
     uint8_t *dataPtr = pkt->getPtr<uint8_t>();
 
+    Tick lat = 0;
     if (bar == 0)
         accessCommand(addr, size, dataPtr, read);
     else if (bar == 1)
-        accessData(addr, size, dataPtr, read);
+        lat = accessData(addr, size, dataPtr, read);
     else {
         panic("CPAdaptor access to invalid address; %#x\n", addr);
     }
 
     pkt->makeAtomicResponse();
+    return lat;
 }
 
 
@@ -31,10 +31,14 @@
 #ifndef __HYPER_GM_CPADAPTOR_HH__
 #define __HYPER_GM_CPADAPTOR_HH__
 
+#include <vector>
+
+#include "base/statistics.hh"
 #include "dev/pcidev.hh"
 #include "mem/mport.hh"
 #include "mem/packet.hh"
 #include "params/CPAdaptor.hh"
+#include "prm/CPConnector.hh"
 
 class CPAdaptor : public PciDevice
 {
@@ -64,6 +68,14 @@ class CPAdaptor : public PciDevice
 
     struct CPARegs {
         CPACommandReg command;
+        uint32_t snapCtrl;
+        uint16_t snapFirstDSid;
+        uint16_t snapLastDSid;
+        uint32_t snapSize;
+        uint64_t snapAddr;
+        uint32_t ringCtrl;
+        uint32_t ringCount;
+        uint64_t ringAddr;
     } cpaRegs;
 
 /*
@@ -81,20 +93,170 @@ class CPAdaptor : public PciDevice
 
    
 
-    // access dispatcher
-    void dispatchAccess(PacketPtr pkt, bool read);
+    // access dispatcher, return CPN latency
+    Tick dispatchAccess(PacketPtr pkt, bool read);
 
     // method to access cpaRegs
     void accessCommand(Addr offset, int size, uint8_t *data, bool read);
     // method to access selected CPC's register space
-    void accessData(Addr offset, int size, uint8_t *data, bool read);
+    Tick accessData(Addr offset, int size, uint8_t *data, bool read);
+    // forward access to CPN atomically, return round-trip latency
+    Tick sendToCPN(Addr paddr, int size, uint8_t *data, bool read,
+                   uint16_t DSid = 0);
+    /**
+     * Start one CPN access of the snapshot or command ring engine, done
+     * is scheduled when its reply is back at the adaptor. In timing mode
+     * the request goes out through the queued master port once it has
+     * crossed the links, and the reply is delivered when it arrives.
+     */
+    void accessCPN(Addr paddr, int size, uint8_t *data, bool read,
+                   uint16_t DSid, Event *done);
+
+  /**
+   * CPN links
+   **/
+  protected:
+
+    /** Latency of each hop between adaptor and CP */
+    const Tick cpnHopLatency;
+    const unsigned cpnHops;
+    /** CPN link bandwidth in ticks per byte */
+    const double cpnBandwidth;
+    /** Address, DSid and command sent with each request and reply */
+    static const unsigned cpnHeaderBytes = 8;
+
+    /**
+     * Tick at which each hop is free again, for requests and replies.
+     * A transfer crosses the hops in order and waits for a busy one.
+     */
+    std::vector<Tick> reqLinkFree;
+    std::vector<Tick> respLinkFree;
+
+    /** Cross all hops of one direction, @return tick bytes arrive */
+    Tick crossLinks(std::vector<Tick> &linkFree, unsigned bytes,
+                    Tick when);
+
+    /** Engine access in flight on CPN */
+    class CPNState : public Packet::SenderState
+    {
+      public:
+        Event *done;
+        Tick start;
+        CPNState(Event *_done, Tick _start) : done(_done), start(_start)
+        { }
+    };
+
+    Stats::Scalar cpnAccesses;
+    Stats::Histogram cpnRoundTrip;
+    Stats::Histogram cmdRoundTrip;
+    Stats::Scalar snapshots;
+    Stats::Histogram snapshotLatency;
+
+  /**
+   * Statistics snapshot
+   **/
+  protected:
+
+    /** CP IDs found on CPN, probed on first snapshot */
+    std::vector<int> snapCPs;
+    bool snapProbed;
+    bool snapOverflow;
+    Tick snapStart;
+    /** Packed snapshot, must be kept until DMA completes */
+    std::vector<uint8_t> snapBuffer;
+
+    /**
+     * Snapshot progress: CP ID being probed, or index into snapCPs and
+     * DSid being gathered. snapReply holds the reply of the last access.
+     */
+    bool snapProbing;
+    bool snapPending;
+    int snapCursor;
+    int snapDSid;
+    uint16_t snapFirstDSid;
+    uint16_t snapLastDSid;
+    uint32_t snapRecords;
+    int snapLen;
+    uint8_t snapReply[CPCONN_SNAP_SIZE];
+
+    void startSnapshot();
+    void snapshotStep();
+    /** Append the stats in snapReply, @return false if buffer is full */
+    bool gatherSnapshot();
+    void snapshotDone();
+
+    friend class EventWrapper<CPAdaptor, &CPAdaptor::snapshotStep>;
+    EventWrapper<CPAdaptor, &CPAdaptor::snapshotStep> snapshotStepEvent;
+    friend class EventWrapper<CPAdaptor, &CPAdaptor::snapshotDone>;
+    EventWrapper<CPAdaptor, &CPAdaptor::snapshotDone> snapshotEvent;
+
+  /**
+   * Command ring in PRM memory
+   **/
+  protected:
+
+    /** CP the running batch goes to, selected when it started */
+    int ringCP;
+    Tick ringStart;
+    /** Descriptors of the running batch, kept until written back */
+    std::vector<uint8_t> ringBuffer;
+
+    struct CPNAccess {
+        Addr paddr;
+        int size;
+        uint8_t *data;
+        bool read;
+    };
+
+    /**
+     * Mailbox header of ringCP, then the CPN accesses running the batch
+     * in order, with the head value of each chunk they write.
+     */
+    CPMboxHeader ringHdr;
+    bool ringHdrValid;
+    std::vector<CPNAccess> ringOps;
+    unsigned ringOpIdx;
+    std::vector<uint32_t> ringHeads;
+    uint32_t ringDoorbell;
+
+    Stats::Scalar ringBatches;
+    Stats::Scalar ringDescs;
+    Stats::Histogram ringLatency;
+
+    void startRing();
+    void ringFetched();
+    void ringStep();
+    void ringDone();
+    /** Queue copy of n descriptors from/to the CP mailbox ring at idx */
+    void queueMailbox(Addr mbox, uint32_t idx, uint8_t *descs, unsigned n,
+                      bool read);
+
+    friend class EventWrapper<CPAdaptor, &CPAdaptor::ringFetched>;
+    EventWrapper<CPAdaptor, &CPAdaptor::ringFetched> ringFetchEvent;
+    friend class EventWrapper<CPAdaptor, &CPAdaptor::ringStep>;
+    EventWrapper<CPAdaptor, &CPAdaptor::ringStep> ringStepEvent;
+    friend class EventWrapper<CPAdaptor, &CPAdaptor::ringDone>;
+    EventWrapper<CPAdaptor, &CPAdaptor::ringDone> ringDoneEvent;
+
+    /** Snapshot or command ring still running */
+    bool busy() const;
+    void checkDrain();
+    DrainManager *drainManager;
 
   public:
 
     typedef CPAdaptorParams Params;
     CPAdaptor(Params *p);
 
+    const Params *
+    params() const
+    {
+        return dynamic_cast<const Params *>(_params);
+    }
+
     virtual void init();
+    virtual void regStats();
+    virtual unsigned int drain(DrainManager *dm);
 
     virtual BaseMasterPort& getMasterPort(const std::string &if_name, PortID idx) {
         return (if_name == "master") ? masterPort
@@ -106,8 +268,8 @@ class CPAdaptor : public PciDevice
    **/
   public:
 
-    virtual Tick  read(PacketPtr pkt) { dispatchAccess(pkt, true); return pioDelay; }
-    virtual Tick write(PacketPtr pkt) { dispatchAccess(pkt, false); return pioDelay; }
+    virtual Tick  read(PacketPtr pkt) { return pioDelay + dispatchAccess(pkt, true); }
+    virtual Tick write(PacketPtr pkt) { return pioDelay + dispatchAccess(pkt, false); }
 
 
   /**
@@ -119,6 +281,74 @@ class CPAdaptor : public PciDevice
 
 };
 
-#define CPA_COMMAND_OFFSET	(0)
+/**
+ * CPA command registers (BAR0)
+ *
+ *   63                 31                 0
+ *   +------------------+------------------+  0h
+ *   |     snapCtrl     |     command      |
+ *   +------------------+--------+---------+  8h
+ *   |     snapSize     |lastDSid|firstDSid|
+ *   +------------------+--------+---------+ 10h
+ *   |               snapAddr              |
+ *   +------------------+------------------+ 18h
+ *   |     ringCount    |     ringCtrl     |
+ *   +------------------+------------------+ 20h
+ *   |               ringAddr              |
+ *   +-------------------------------------+ 28h
+ *
+ * Writing CPA_SNAP_START to snapCtrl gathers statistics of DSid range
+ * [firstDSid, lastDSid] from all CPs into a CPASnapHeader followed by
+ * CPASnapRecords, DMAs it to snapAddr (at most snapSize bytes) and
+ * raises one interrupt on completion, with CPA_SNAP_OVERFLOW set if the
+ * buffer or a CP snapshot window was too small for some records. Reading
+ * snapCtrl once it is done clears it and acknowledges the interrupt.
+ *
+ * Writing CPA_RING_START to ringCtrl runs a batch of ringCount command
+ * descriptors (CPMboxDesc) kept in PRM memory at ringAddr: the adaptor
+ * fetches them by DMA, executes them through the mailbox of the
+ * selected CP and DMAs them back with status and data filled in.
+ */
+#define CPA_COMMAND_OFFSET	(0x00)
+#define CPA_SNAPCTRL_OFFSET	(0x04)
+#define CPA_SNAPDSID_OFFSET	(0x08)
+#define CPA_SNAPSIZE_OFFSET	(0x0C)
+#define CPA_SNAPADDR_OFFSET	(0x10)
+#define CPA_RINGCTRL_OFFSET	(0x18)
+#define CPA_RINGCOUNT_OFFSET	(0x1C)
+#define CPA_RINGADDR_OFFSET	(0x20)
+
+// command register in selected CP's register space (BAR1)
+#define CPA_CP_CMD_OFFSET	(0x10)
+
+#define CPA_SNAP_START		0x1
+#define CPA_SNAP_BUSY		0x1
+#define CPA_SNAP_DONE		0x2
+#define CPA_SNAP_OVERFLOW	0x4
+
+#define CPA_SNAP_MAGIC		0x50414E53	// "SNAP"
+
+#define CPA_RING_START		0x1
+#define CPA_RING_BUSY		0x1
+#define CPA_RING_DONE		0x2
+#define CPA_RING_ERROR		0x4
+
+#define CPA_RING_MAX_ENTRIES	0x1000
+
+struct CPASnapHeader {
+    uint32_t magic;
+    uint16_t firstDSid;
+    uint16_t lastDSid;
+    uint32_t records;
+    uint32_t bytes;
+    uint64_t tick;
+};
+
+/** Record data is padded to 8-byte boundary */
+struct CPASnapRecord {
+    uint16_t cpid;
+    uint16_t DSid;
+    uint32_t size;
+};
 
 #endif //__HYPER_GM_CPADAPTOR_HH__
@@ -7,6 +7,14 @@ class CPAdaptor(PciDevice):
     cxx_header = "prm/CPAdaptor.hh"
     master = MasterPort("Master Ports")
 
+    snapshot_max_cps = Param.Int(64, "Number of CP IDs probed for stats snapshot")
+
+    # CPN links, each hop is busy while a transfer crosses it; CP side
+    # queueing is modeled by each CPConnector
+    cpn_latency = Param.Latency('10ns', "Latency of each CPN hop")
+    cpn_hops = Param.Unsigned(2, "Number of CPN hops between adaptor and CP")
+    cpn_bandwidth = Param.MemoryBandwidth('1GB/s', "CPN link bandwidth")
+
     VendorID = 0x0A19
     DeviceID = 0x0001
     Command = 0x0
@@ -17,7 +25,7 @@ class CPAdaptor(PciDevice):
     ProgIF = 0x00
     BAR0 = 0x00000000		# CP selector register
     BAR1 = 0x00000000		# map to selected CP address space
-    BAR0Size = '4B'
+    BAR0Size = '64B'
     BAR1Size = '32B'
     InterruptLine = 0x1a
     InterruptPin = 0x01
@@ -36,12 +36,17 @@ CPConnector::CPConnector(Params *p)
     : MemObject(p),
       slavePort(p->name + ".slave", this),
       masterPort(p->name + ".master", this),
+      accessLatency(p->latency), cmdLatency(p->cmd_latency),
+      bandwidth(p->bandwidth), busyUntil(0),
       cp(NULL), cmdHandler(NULL),
       cpDevID(p->cp_dev)
 {
     memset(&regs, 0xFF, sizeof(regs));
     regs.cpType = p->Type;
     strncpy((char *)regs.cpIdent, p->IDENT.c_str(), 12);
+
+    memset(mbox, 0, sizeof(mbox));
+    mboxHeader()->entries = CPCONN_MBOX_ENTRIES;
 }
 
 void
@@ -56,6 +61,43 @@ CPConnector::init()
     slavePort.sendRangeChange();
 }
 
+void
+CPConnector::regStats()
+{
+    using namespace Stats;
+
+    MemObject::regStats();
+
+    numAccesses
+        .name(name() + ".accesses")
+        .desc("Number of CPN accesses served")
+        ;
+    numCommands
+        .name(name() + ".commands")
+        .desc("Number of commands executed, including mailbox descriptors")
+        ;
+    totQueueLat
+        .name(name() + ".totQueueLat")
+        .desc("Total ticks spent queueing behind earlier accesses")
+        ;
+    totServiceLat
+        .name(name() + ".totServiceLat")
+        .desc("Total ticks spent serving accesses")
+        ;
+    avgQueueLat
+        .name(name() + ".avgQueueLat")
+        .desc("Average queueing latency per access")
+        .precision(2)
+        ;
+    avgQueueLat = totQueueLat / numAccesses;
+    avgServiceLat
+        .name(name() + ".avgServiceLat")
+        .desc("Average service latency per access")
+        .precision(2)
+        ;
+    avgServiceLat = totServiceLat / numAccesses;
+}
+
 BaseMasterPort&
 CPConnector::getMasterPort(const std::string& if_name, PortID idx)
 {
@@ -82,6 +124,10 @@ CPConnector::getAddrRanges() const
     AddrRangeList ranges;
     Addr base = cpDevID * 32;
     ranges.push_back(RangeEx(base, base+31));   
+    base = CPCONN_MBOX_BASE + cpDevID * CPCONN_MBOX_SIZE;
+    ranges.push_back(RangeEx(base, base+CPCONN_MBOX_SIZE));
+    base = CPCONN_SNAP_BASE + cpDevID * CPCONN_SNAP_SIZE;
+    ranges.push_back(RangeEx(base, base+CPCONN_SNAP_SIZE));
     return ranges;
 }
 
@@ -99,9 +145,130 @@ CPConnector::getAddrRanges() const
 
 #define OFFSET_OF(type, field) ((long)(&((type *)0)->field))
 
+Tick
+CPConnector::occupy(Tick service)
+{
+    Tick start = std::max(curTick(), busyUntil);
+    busyUntil = start + service;
+
+    numAccesses++;
+    totQueueLat += start - curTick();
+    totServiceLat += service;
+
+    return busyUntil - curTick();
+}
+
+bool
+CPConnector::execCommand(uint8_t cmd, uint16_t DSid, uint32_t addr,
+                         uint64_t &data)
+{
+    numCommands++;
+    if (cmd == 'G')
+        data = cp->queryTable(DSid, addr);
+    else if (cmd == 'S')
+        cp->updateTable(DSid, addr, data);
+    else {
+        bool cmd_handled = false;
+        if (cmdHandler) {
+            cmd_handled = cmdHandler->handleCommand(
+                cmd, (uint64_t)DSid, (uint64_t)addr, data);
+        }
+        if (!cmd_handled) {
+            warn("Unknown ControlPlane Command: 0x%x.\n", cmd);
+            return false;
+        }
+    }
+    return true;
+}
+
+int
+CPConnector::processMailbox()
+{
+    CPMboxHeader *hdr = mboxHeader();
+    int count = 0;
+
+    if (hdr->head >= CPCONN_MBOX_ENTRIES) {
+        warn("CPConnector: invalid mailbox head %d.\n", hdr->head);
+        return 0;
+    }
+
+    while (hdr->tail != hdr->head) {
+        CPMboxDesc *desc = mboxDesc(hdr->tail);
+        desc->status = execCommand(desc->cmd, desc->DSid,
+                                   desc->addr, desc->data)
+                     ? CPCONN_MBOX_STATUS_DONE
+                     : CPCONN_MBOX_STATUS_ERROR;
+        hdr->tail = (hdr->tail + 1) % CPCONN_MBOX_ENTRIES;
+        count++;
+    }
+
+    DPRINTF(CPConnector, "mailbox: %d descriptors done, tail=%d\n",
+            count, hdr->tail);
+    return count;
+}
+
+Tick
+CPConnector::accessMailbox(PacketPtr pkt, Addr offset)
+{
+    CPMboxHeader *hdr = mboxHeader();
+
+    panic_if(offset + pkt->getSize() > CPCONN_MBOX_SIZE,
+             "CPConnector: mailbox access out of range 0x%x.\n", offset);
+
+    Tick service = accessLatency + pkt->getSize() * bandwidth;
+
+    if (pkt->isRead()) {
+        memcpy(pkt->getPtr<uint8_t>(), mbox + offset, pkt->getSize());
+        return occupy(service);
+    } else if (!pkt->isWrite()) {
+        panic("Error type\n");
+    }
+
+    // tail & entries are maintained by connector
+    if (offset < sizeof(CPMboxHeader) &&
+        offset != OFFSET_OF(CPMboxHeader, head) &&
+        offset != OFFSET_OF(CPMboxHeader, doorbell)) {
+        warn("CPConnector: write to read-only mailbox field 0x%x.\n",
+             offset);
+        return occupy(service);
+    }
+
+    memcpy(mbox + offset, pkt->getPtr<uint8_t>(), pkt->getSize());
+
+    if (offset == OFFSET_OF(CPMboxHeader, doorbell))
+        service += processMailbox() * cmdLatency;
+
+    return occupy(service);
+}
+
+Tick
+CPConnector::accessSnapshot(PacketPtr pkt)
+{
+    panic_if(!pkt->isRead() || pkt->getSize() != CPCONN_SNAP_SIZE,
+             "CPConnector: invalid snapshot access.\n");
+
+    uint8_t *data = pkt->getPtr<uint8_t>();
+    int n = cp->snapshotStats(pkt->getDSid(), data + sizeof(uint32_t),
+                              CPCONN_SNAP_SIZE - sizeof(uint32_t));
+    uint32_t len = n < 0 ? CPCONN_SNAP_TRUNCATED : n;
+    memcpy(data, &len, sizeof(len));
+
+    DPRINTF(CPConnector, "snapshot DSid=%d: %d bytes%s\n",
+            pkt->getDSid(), n < 0 ? 0 : n, n < 0 ? ", truncated" : "");
+    return occupy(accessLatency + cmdLatency +
+                  (sizeof(len) + (n < 0 ? 0 : n)) * bandwidth);
+}
+
 Tick
 CPConnector::recvAtomic(PacketPtr pkt)
 {
+    if (pkt->getAddr() >= CPCONN_SNAP_BASE)
+        return accessSnapshot(pkt);
+
+    Addr mbox_base = CPCONN_MBOX_BASE + cpDevID * CPCONN_MBOX_SIZE;
+    if (pkt->getAddr() >= mbox_base)
+        return accessMailbox(pkt, pkt->getAddr() - mbox_base);
+
     Addr offset = pkt->getAddr() - cpDevID*32;
 
     DPRINTF(CPConnector, "CPConnector::recvAtomic(offset=0x%lx, size=0x%lx)\n", offset, pkt->getSize());
@@ -126,31 +293,17 @@ CPConnector::recvAtomic(PacketPtr pkt)
     else
         panic("Error type\n");
 
+    Tick service = accessLatency + pkt->getSize() * bandwidth;
+
     // special for cpCmd register
     if (offset == OFFSET_OF(CPConnRegs, cpCmd)) {
-        if (regs.cpCmd == 'G')
-            regs.cpData = cp->queryTable(regs.cpLDomID, regs.cpDestAddr);
-        else if (regs.cpCmd == 'S')
-            cp->updateTable(regs.cpLDomID, regs.cpDestAddr, regs.cpData);
-        else {
-            bool cmd_handled = false;
-            if (cmdHandler) {
-                cmd_handled = cmdHandler->handleCommand(
-                    regs.cpCmd,
-                    (uint64_t)regs.cpLDomID,
-                    (uint64_t)regs.cpDestAddr,
-                    (uint64_t)regs.cpData
-                );
-            }
-            if (!cmd_handled) {
-                warn("Unknown ControlPlane Command: 0x%x.\n", regs.cpCmd);
-                regs.cpCmd = 0xFF;
-            }
-        }
-        return 3;
+        if (!execCommand(regs.cpCmd, regs.cpLDomID, regs.cpDestAddr,
+                         regs.cpData))
+            regs.cpCmd = 0xFF;
+        service += cmdLatency;
     }
 
-    return 1;
+    return occupy(service);
 }
 
 Tick
@@ -31,6 +31,7 @@
 #ifndef __PRM_CP_CONNECTOR_HH__
 #define __PRM_CP_CONNECTOR_HH__
 
+#include "base/statistics.hh"
 #include "mem/mem_object.hh"
 #include "mem/tport.hh"
 #include "mem/mport.hh"
@@ -40,6 +41,57 @@
 
 class ControlPlane;
 
+/**
+ * Command mailbox, each CP owns a CPCONN_MBOX_SIZE descriptor ring at
+ * CPCONN_MBOX_BASE + cpDevID * CPCONN_MBOX_SIZE on CPN.
+ *
+ *   63                 31                 0
+ *   +------------------+------------------+  0h
+ *   |       tail       |       head       |
+ *   +------------------+------------------+  8h
+ *   |     doorbell     |     entries      |
+ *   +------------------+------------------+ 10h
+ *   |        descriptor[0..entries)       |
+ *   +-------------------------------------+
+ *
+ * PRM fills descriptors from head, advances head and writes doorbell.
+ * Connector executes descriptors in [tail, head), writes status & data
+ * back in place and advances tail to head.
+ */
+#define CPCONN_MBOX_BASE	0x10000
+#define CPCONN_MBOX_SIZE	0x1000
+
+#define CPCONN_MBOX_STATUS_DONE		0x00
+#define CPCONN_MBOX_STATUS_ERROR	0xFF
+
+struct CPMboxDesc {
+    uint8_t  cmd;
+    uint8_t  status;
+    uint16_t DSid;
+    uint32_t addr;
+    uint64_t data;
+};
+
+struct CPMboxHeader {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t entries;
+    uint32_t doorbell;
+};
+
+/**
+ * Statistics snapshot window, one CPCONN_SNAP_SIZE window per CP at
+ * CPCONN_SNAP_BASE + cpDevID * CPCONN_SNAP_SIZE. A read tagged with DSid
+ * returns a 4-byte length followed by ControlPlane::snapshotStats() data,
+ * or CPCONN_SNAP_TRUNCATED alone if the rows of DSid exceed the window.
+ */
+#define CPCONN_SNAP_BASE	0x800000
+#define CPCONN_SNAP_SIZE	0x100
+#define CPCONN_SNAP_TRUNCATED	0x80000000
+
+#define CPCONN_MBOX_ENTRIES \
+    ((CPCONN_MBOX_SIZE - sizeof(CPMboxHeader)) / sizeof(CPMboxDesc))
+
 class CPConnector : public MemObject
 {
   protected:
@@ -89,6 +141,7 @@ class CPConnector : public MemObject
     CPConnector(Params *p);
 
     virtual void init();
+    virtual void regStats();
 
     virtual BaseMasterPort& getMasterPort(const std::string& if_name,
                                           PortID idx = InvalidPortID);
@@ -101,6 +154,37 @@ class CPConnector : public MemObject
     Tick recvResponse(PacketPtr pkt);
     AddrRangeList getAddrRanges() const;
 
+    // execute one G/S/other command, return false if unknown
+    bool execCommand(uint8_t cmd, uint16_t DSid, uint32_t addr,
+                     uint64_t &data);
+
+  protected:
+
+    Tick accessMailbox(PacketPtr pkt, Addr offset);
+    Tick accessSnapshot(PacketPtr pkt);
+    // process all pending descriptors, return number processed
+    int processMailbox();
+
+    /**
+     * Occupy this CP for service ticks after all queued requests,
+     * @return ticks from now until the request is served
+     */
+    Tick occupy(Tick service);
+
+    const Tick accessLatency;
+    const Tick cmdLatency;
+    /** Bandwidth in ticks per byte */
+    const double bandwidth;
+    /** Tick until which previous requests keep this CP busy */
+    Tick busyUntil;
+
+    Stats::Scalar numAccesses;
+    Stats::Scalar numCommands;
+    Stats::Scalar totQueueLat;
+    Stats::Scalar totServiceLat;
+    Stats::Formula avgQueueLat;
+    Stats::Formula avgServiceLat;
+
   protected:
 
     ControlPlane *cp;
@@ -127,6 +211,13 @@ class CPConnector : public MemObject
         uint64_t cpData;
     } regs;
 
+    // descriptor ring, header followed by descriptors
+    uint8_t mbox[CPCONN_MBOX_SIZE];
+
+    CPMboxHeader *mboxHeader() { return (CPMboxHeader *)mbox; }
+    CPMboxDesc *mboxDesc(int idx)
+    { return (CPMboxDesc *)(mbox + sizeof(CPMboxHeader)) + idx; }
+
     const Params * param() const
     { return dynamic_cast<const Params *>(_params); }
 
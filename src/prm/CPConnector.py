@@ -14,3 +14,8 @@ class CPConnector(MemObject):
     IDENT = Param.String("GenCP", "Identifier of this CP, 12-byte maximum")
     BAR0 = Param.UInt32(0x00, "Base Address Register 0")
     BAR0Size = Param.MemorySize32('0B', "Base Address Register 0 Size")
+
+    # Access latency, requests are served in order by this CP
+    latency = Param.Latency('20ns', "Register access latency")
+    cmd_latency = Param.Latency('100ns', "Latency to execute one command")
+    bandwidth = Param.MemoryBandwidth('1GB/s', "Data bandwidth of this CP")
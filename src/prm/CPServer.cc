@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2014 ACS, ICT
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "base/output.hh"
+#include "base/trace.hh"
+#include "debug/CPServer.hh"
+#include "prm/CPServer.hh"
+#include "prm/ControlPlane.hh"
+
+CPServer::CPServer(const Params *p)
+    : SimObject(p), cps(p->control_planes), maxBatch(p->max_batch),
+      listenFd(-1), listenEvent(NULL)
+{
+    path = p->path[0] == '/' ? p->path : simout.resolve(p->path);
+    listen();
+}
+
+CPServer::~CPServer()
+{
+    while (!clients.empty())
+        detach(clients.front());
+
+    if (listenEvent)
+        delete listenEvent;
+    if (listenFd != -1) {
+        close(listenFd);
+        unlink(path.c_str());
+    }
+}
+
+void
+CPServer::listen()
+{
+    struct sockaddr_un addr;
+
+    panic_if(path.size() >= sizeof(addr.sun_path),
+             "%s: socket path %s too long.\n", name(), path);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0)
+        fatal("%s: can not create socket: %s\n", name(), strerror(errno));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // remove stale socket of an earlier run
+    unlink(path.c_str());
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        ::listen(listenFd, 4) < 0)
+        fatal("%s: can not listen on %s: %s\n", name(), path,
+              strerror(errno));
+
+    ccprintf(std::cerr, "Listening for control plane connection on %s\n",
+             path);
+    listenEvent = new ListenEvent(this, listenFd, POLLIN|POLLERR);
+    pollQueue.schedule(listenEvent);
+}
+
+void
+CPServer::accept()
+{
+    // As a consequence of being called from the PollQueue, we might
+    // have been called from a different thread. Migrate to "our"
+    // thread.
+    EventQueue::ScopedMigration migrate(eventQueue());
+
+    int fd = ::accept(listenFd, NULL, NULL);
+    if (fd < 0) {
+        warn("%s: accept failed: %s\n", name(), strerror(errno));
+        return;
+    }
+
+    // replies must never block the simulation, see flush()
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        warn("%s: can not make client non-blocking: %s\n", name(),
+             strerror(errno));
+        close(fd);
+        return;
+    }
+
+    Client *client = new Client(this, fd, POLLIN|POLLOUT|POLLERR|POLLHUP);
+    clients.push_back(client);
+    pollQueue.schedule(client);
+    DPRINTF(CPServer, "client %d attached\n", fd);
+}
+
+void
+CPServer::detach(Client *client)
+{
+    int fd = client->fd;
+    DPRINTF(CPServer, "client %d detached\n", fd);
+
+    clients.remove(client);
+    delete client;
+    close(fd);
+}
+
+void
+CPServer::process(Client *client, int revent)
+{
+    EventQueue::ScopedMigration migrate(eventQueue());
+
+    // Pending replies first, then requests held back by them
+    if (!flush(client) || !serve(client)) {
+        detach(client);
+        return;
+    }
+
+    // Stop taking requests while replies are pending, the client sees
+    // its socket fill up instead
+    if (!client->output.empty())
+        return;
+
+    if (revent & POLLIN) {
+        uint8_t buf[4096];
+        ssize_t len = read(client->fd, buf, sizeof(buf));
+        if (len > 0) {
+            client->buffer.insert(client->buffer.end(), buf, buf + len);
+            if (serve(client))
+                return;
+        } else if (len < 0 && (errno == EINTR || errno == EAGAIN ||
+                               errno == EWOULDBLOCK)) {
+            // spurious wakeup, wait for the next poll event
+            return;
+        } else if (len < 0) {
+            warn("%s: read failed: %s\n", name(), strerror(errno));
+        }
+        // len == 0 means peer closed, fall through to detach
+    } else if (!(revent & (POLLERR|POLLHUP))) {
+        // only writable, nothing left to send
+        return;
+    }
+
+    detach(client);
+}
+
+bool
+CPServer::serve(Client *client)
+{
+    std::vector<uint8_t> &buffer = client->buffer;
+
+    while (client->output.empty() && buffer.size() >= sizeof(CPServerMsg)) {
+        CPServerMsg *msg = (CPServerMsg *)&buffer[0];
+        if (msg->magic != CPSERVER_MAGIC || msg->count > maxBatch) {
+            warn("%s: bad request (magic 0x%x, count %d), closing.\n",
+                 name(), msg->magic, msg->count);
+            return false;
+        }
+
+        size_t len = sizeof(CPServerMsg) + msg->count * sizeof(CPServerDesc);
+        if (buffer.size() < len)
+            break;
+
+        CPServerDesc *descs = (CPServerDesc *)&buffer[sizeof(CPServerMsg)];
+        for (int i = 0; i < msg->count; i++)
+            execute(descs[i]);
+
+        DPRINTF(CPServer, "client %d: %d descriptors done\n",
+                client->fd, msg->count);
+
+        // request is overwritten with results and sent back as reply
+        client->output.insert(client->output.end(), buffer.begin(),
+                              buffer.begin() + len);
+        buffer.erase(buffer.begin(), buffer.begin() + len);
+        if (!flush(client))
+            return false;
+    }
+
+    return true;
+}
+
+bool
+CPServer::flush(Client *client)
+{
+    std::vector<uint8_t> &output = client->output;
+
+    size_t done = 0;
+    while (done < output.size()) {
+        ssize_t ret = write(client->fd, &output[done], output.size() - done);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // socket buffer full, rest goes out on POLLOUT
+            DPRINTF(CPServer, "client %d: %d reply bytes pending\n",
+                    client->fd, output.size() - done);
+            break;
+        }
+        if (ret <= 0) {
+            warn("%s: reply failed: %s\n", name(), strerror(errno));
+            return false;
+        }
+        done += ret;
+    }
+
+    output.erase(output.begin(), output.begin() + done);
+    return true;
+}
+
+void
+CPServer::execute(CPServerDesc &desc)
+{
+    if (desc.cp >= cps.size()) {
+        warn("%s: unknown control plane %d.\n", name(), desc.cp);
+        desc.status = CPSERVER_STATUS_ERROR;
+        return;
+    }
+
+    desc.status = cps[desc.cp]->execCommand(desc.cmd, desc.DSid,
+                                            desc.addr, desc.data)
+                ? CPSERVER_STATUS_DONE : CPSERVER_STATUS_ERROR;
+}
+
+CPServer *
+CPServerParams::create()
+{
+    return new CPServer(this);
+}
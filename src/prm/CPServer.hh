@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2014 ACS, ICT
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/**
+ * @file
+ * Host-side control plane server, lets host scripts drive control planes
+ * through a Unix-domain socket without simulating the PRM.
+ *
+ * Each request is a CPServerMsg header followed by count CPServerDesc,
+ * the reply has the same layout with status and data filled in:
+ *
+ *   cmd 'G': data = queryTable(DSid, addr)
+ *   cmd 'S': updateTable(DSid, addr, data)
+ *   others : passed to command handler of the control plane
+ *
+ * cp indexes CPServer.control_planes. Requests are executed at the
+ * current simulated tick, in order. Replies the socket can not take yet
+ * are kept per client and sent when it becomes writable, no new request
+ * is executed meanwhile. See util/cpclient.py.
+ */
+
+#ifndef __PRM_CP_SERVER_HH__
+#define __PRM_CP_SERVER_HH__
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "base/pollevent.hh"
+#include "params/CPServer.hh"
+#include "sim/sim_object.hh"
+
+class ControlPlane;
+
+#define CPSERVER_MAGIC		0x50435043	// "CPCP"
+
+#define CPSERVER_STATUS_DONE	0x00
+#define CPSERVER_STATUS_ERROR	0xFF
+
+struct CPServerMsg {
+    uint32_t magic;
+    uint32_t count;
+};
+
+struct CPServerDesc {
+    uint8_t  cmd;
+    uint8_t  status;
+    uint16_t DSid;
+    uint32_t addr;
+    uint64_t data;
+    uint16_t cp;
+    uint16_t __padding[3];
+};
+
+class CPServer : public SimObject
+{
+  protected:
+
+    class ListenEvent : public PollEvent
+    {
+      protected:
+        CPServer *server;
+
+      public:
+        ListenEvent(CPServer *s, int fd, int e)
+            : PollEvent(fd, e), server(s) {}
+        virtual void process(int revent) { server->accept(); }
+    };
+
+    class Client : public PollEvent
+    {
+      protected:
+        CPServer *server;
+
+      public:
+        const int fd;
+        /** Bytes received but not yet executed */
+        std::vector<uint8_t> buffer;
+        /** Replies not yet taken by the socket */
+        std::vector<uint8_t> output;
+
+        Client(CPServer *s, int _fd, int e)
+            : PollEvent(_fd, e), server(s), fd(_fd) {}
+        virtual void process(int revent) { server->process(this, revent); }
+    };
+
+    friend class ListenEvent;
+    friend class Client;
+
+    std::vector<ControlPlane *> cps;
+    std::string path;
+    const unsigned maxBatch;
+
+    int listenFd;
+    ListenEvent *listenEvent;
+    std::list<Client *> clients;
+
+    void listen();
+    void accept();
+    void process(Client *client, int revent);
+    void detach(Client *client);
+    /** Execute all complete requests in client buffer */
+    bool serve(Client *client);
+    /** Send pending replies without blocking, false on error */
+    bool flush(Client *client);
+    void execute(CPServerDesc &desc);
+
+  public:
+    typedef CPServerParams Params;
+    CPServer(const Params *p);
+    virtual ~CPServer();
+};
+
+#endif	// __PRM_CP_SERVER_HH__
@@ -0,0 +1,12 @@
+from m5.params import *
+from m5.SimObject import SimObject
+
+class CPServer(SimObject):
+    type = 'CPServer'
+    cxx_header = 'prm/CPServer.hh'
+
+    control_planes = VectorParam.ControlPlane([],
+        "Control planes served, addressed by index in requests")
+    path = Param.String("cpserver.sock",
+        "Unix socket path, relative paths are in output directory")
+    max_batch = Param.Unsigned(4096, "Maximum descriptors per request")
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2014 ACS, ICT
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+#include <cstring>
+
+#include "base/misc.hh"
+#include "prm/ConfigMemory.hh"
+#include "sim/serialize.hh"
+
+const uint8_t ConfigMemory::zeroPage[ConfigMemory::PageSize] = { 0 };
+
+ConfigMemory::ConfigMemory(uint64_t size)
+    : _size(size), pages((size + PageSize - 1) >> PageShift, NULL),
+      touched(0)
+{
+}
+
+ConfigMemory::~ConfigMemory()
+{
+    for (int i = 0; i < pages.size(); i++)
+        delete[] pages[i];
+}
+
+const uint8_t *
+ConfigMemory::peek(uint64_t offset) const
+{
+    assert(offset < _size);
+    const uint8_t *page = pages[offset >> PageShift];
+    return (page ? page : zeroPage) + (offset & (PageSize - 1));
+}
+
+void
+ConfigMemory::read(uint64_t offset, void *buf, uint64_t len) const
+{
+    assert(valid(offset, len));
+
+    uint8_t *dst = (uint8_t *)buf;
+    while (len) {
+        uint64_t n = chunk(offset, len);
+        memcpy(dst, peek(offset), n);
+        dst += n;
+        offset += n;
+        len -= n;
+    }
+}
+
+void
+ConfigMemory::write(uint64_t offset, const void *buf, uint64_t len)
+{
+    assert(valid(offset, len));
+
+    const uint8_t *src = (const uint8_t *)buf;
+    while (len) {
+        uint64_t n = chunk(offset, len);
+        uint8_t *&page = pages[offset >> PageShift];
+
+        // zeros to an untouched page change nothing
+        if (!page && memcmp(src, zeroPage, n) != 0) {
+            page = new uint8_t[PageSize];
+            memset(page, 0, PageSize);
+            touched++;
+        }
+        if (page)
+            memcpy(page + (offset & (PageSize - 1)), src, n);
+
+        src += n;
+        offset += n;
+        len -= n;
+    }
+}
+
+void
+ConfigMemory::serialize(const std::string &base, std::ostream &os)
+{
+    std::vector<uint64_t> page_ids;
+    for (uint64_t i = 0; i < pages.size(); i++) {
+        if (pages[i])
+            page_ids.push_back(i);
+    }
+
+    arrayParamOut(os, base + ".pages", page_ids);
+    for (int i = 0; i < page_ids.size(); i++) {
+        arrayParamOut(os, csprintf("%s.page%d", base, page_ids[i]),
+                      pages[page_ids[i]], PageSize);
+    }
+}
+
+void
+ConfigMemory::unserialize(const std::string &base, Checkpoint *cp,
+                          const std::string &section)
+{
+    std::vector<uint64_t> page_ids;
+    arrayParamIn(cp, section, base + ".pages", page_ids);
+
+    for (int i = 0; i < page_ids.size(); i++) {
+        uint64_t id = page_ids[i];
+        panic_if(id >= pages.size(), "config memory page %d out of range.\n",
+                 id);
+        if (!pages[id]) {
+            pages[id] = new uint8_t[PageSize];
+            touched++;
+        }
+        arrayParamIn(cp, section, csprintf("%s.page%d", base, id),
+                     pages[id], PageSize);
+    }
+}
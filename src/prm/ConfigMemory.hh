@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2014 ACS, ICT
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/**
+ * @file
+ * Sparse config memory of control planes. Pages are allocated on first
+ * non-zero write, untouched pages read as zero from a shared page, and
+ * only touched pages go into checkpoints.
+ */
+
+#ifndef __PRM_CONFIG_MEMORY_HH__
+#define __PRM_CONFIG_MEMORY_HH__
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "base/types.hh"
+
+class Checkpoint;
+
+class ConfigMemory
+{
+  public:
+    static const int PageShift = 12;
+    static const int PageSize = 1 << PageShift;
+
+  protected:
+    const uint64_t _size;
+    /** Page table, NULL for untouched pages */
+    std::vector<uint8_t *> pages;
+    uint64_t touched;
+
+    static const uint8_t zeroPage[PageSize];
+
+  public:
+    ConfigMemory(uint64_t size);
+    ~ConfigMemory();
+
+    uint64_t size() const { return _size; }
+    uint64_t touchedPages() const { return touched; }
+
+    /** Check [offset, offset+len) is inside this memory */
+    bool valid(uint64_t offset, uint64_t len) const
+    { return offset <= _size && len <= _size - offset; }
+
+    void read(uint64_t offset, void *buf, uint64_t len) const;
+    void write(uint64_t offset, const void *buf, uint64_t len);
+
+    /**
+     * Read-only pointer to offset, valid up to the end of its page,
+     * @see chunk()
+     */
+    const uint8_t *peek(uint64_t offset) const;
+    /** Bytes from offset to the end of its page, at most len */
+    static uint64_t chunk(uint64_t offset, uint64_t len)
+    {
+        uint64_t left = PageSize - (offset & (PageSize - 1));
+        return len < left ? len : left;
+    }
+
+    void serialize(const std::string &base, std::ostream &os);
+    void unserialize(const std::string &base, Checkpoint *cp,
+                     const std::string &section);
+};
+
+#endif	// __PRM_CONFIG_MEMORY_HH__
@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include "prm/CPConnector.hh"
 #include "prm/ControlPlane.hh"
 
@@ -11,9 +13,106 @@ ControlPlane::~ControlPlane()
 {
 }
 
+int
+ControlPlane::copyStatRow(const void *row, int rowSize, uint8_t *buf,
+                          int size)
+{
+    if (size < rowSize)
+        return -1;
+    memcpy(buf, row, rowSize);
+    return rowSize;
+}
+
 void
 ControlPlane::registerCommandHandler(ICommandHandler *handler)
 {
     connector->registerCommandHandler(handler);
 }
 
+bool
+ControlPlane::execCommand(uint8_t cmd, uint16_t DSid, uint32_t addr,
+                          uint64_t &data)
+{
+    return connector->execCommand(cmd, DSid, addr, data);
+}
+
+
+int
+ControlPlane::registerCounter(const std::string &name)
+{
+    std::map<std::string, int>::iterator it = counterIndex.find(name);
+    if (it != counterIndex.end())
+        return it->second;
+
+    panic_if(!counterTable.empty(),
+             "%s: counter %s registered after first update.\n",
+             this->name(), name);
+
+    counterIndex[name] = counterNames.size();
+    counterNames.push_back(name);
+    return counterNames.size() - 1;
+}
+
+uint64_t &
+ControlPlane::findCounter(uint16_t DSid, int counter)
+{
+    CounterValues &values = counterTable[DSid];
+    if (values.empty())
+        values.resize(counterNames.size(), 0);
+    return values[counter];
+}
+
+bool
+ControlPlane::readCounter(uint16_t DSid, const std::string &name,
+                          uint64_t &value) const
+{
+    std::map<std::string, int>::const_iterator idx = counterIndex.find(name);
+    if (idx == counterIndex.end())
+        return false;
+
+    CounterTable::const_iterator it = counterTable.find(DSid);
+    value = it == counterTable.end() ? 0 : it->second[idx->second];
+    return true;
+}
+
+void
+ControlPlane::updateStat(int16_t DSid, const std::string &stat,
+                         uint64_t value)
+{
+    std::map<std::string, int>::iterator it = counterIndex.find(stat);
+    if (it == counterIndex.end()) {
+        warn("%s: unregistered counter %s.\n", name(), stat);
+        AbstractControlPlane::updateStat(DSid, stat, value);
+        return;
+    }
+    updateCounter(DSid, it->second, value);
+}
+
+void
+ControlPlane::incrStat(int16_t DSid, const std::string &stat,
+                       int64_t delta)
+{
+    std::map<std::string, int>::iterator it = counterIndex.find(stat);
+    if (it == counterIndex.end()) {
+        warn("%s: unregistered counter %s.\n", name(), stat);
+        AbstractControlPlane::incrStat(DSid, stat, delta);
+        return;
+    }
+    incrCounter(DSid, it->second, delta);
+}
+
+void
+ControlPlane::updateCounter(uint16_t DSid, int counter, uint64_t value)
+{
+    assert(counter >= 0 && counter < counterNames.size());
+    findCounter(DSid, counter) = value;
+    AbstractControlPlane::updateStat(DSid, counterNames[counter], value);
+}
+
+void
+ControlPlane::incrCounter(uint16_t DSid, int counter, int64_t delta)
+{
+    assert(counter >= 0 && counter < counterNames.size());
+    findCounter(DSid, counter) += delta;
+    AbstractControlPlane::incrStat(DSid, counterNames[counter], delta);
+}
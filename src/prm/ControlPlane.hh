@@ -1,6 +1,10 @@
 #ifndef __PRM_CONTROLPLANE_HH__
 #define __PRM_CONTROLPLANE_HH__
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include "params/ControlPlane.hh"
 #include "prm/AbstractControlPlane.hh"
 #include "prm/interfaces.hh"
@@ -27,9 +31,86 @@ class ControlPlane : public AbstractControlPlane
   public:
     void registerCommandHandler(ICommandHandler *handler);
 
+    /**
+     * Execute a G/S/other command as if issued through the connector.
+     * @return false if command is unknown
+     */
+    bool execCommand(uint8_t cmd, uint16_t DSid, uint32_t addr,
+                     uint64_t &data);
+
     virtual uint64_t queryTable(uint16_t DSid, uint32_t addr) { return 0; }
     virtual void updateTable(uint16_t DSid, uint32_t addr, uint64_t data) {}
 
+    /**
+     * Copy statistics table rows of DSid into buf for bulk snapshot.
+     * @return number of bytes copied, 0 if nothing to report, -1 if the
+     *         rows do not fit in size
+     */
+    virtual int snapshotStats(uint16_t DSid, uint8_t *buf, int size)
+    { return 0; }
+
+  protected:
+    /**
+     * Helpers for snapshotStats(): copy one statistics row, or every row
+     * of table owned by DSid with non-zero flags.
+     * @return number of bytes copied, -1 if they do not fit in buf
+     */
+    static int copyStatRow(const void *row, int rowSize, uint8_t *buf,
+                           int size);
+    template <class Entry>
+    static int copyStatRows(uint16_t DSid, const Entry *table, int entries,
+                            uint8_t *buf, int size)
+    {
+        int len = 0;
+        for (int i = 0; i < entries; i++) {
+            if (table[i].DSid != DSid || !table[i].flags)
+                continue;
+            int n = copyStatRow(&table[i], sizeof(Entry), buf + len,
+                                size - len);
+            if (n < 0)
+                return -1;
+            len += n;
+        }
+        return len;
+    }
+
+  /**
+   * Per-DSid counters, registered by name and updated through
+   * AbstractControlPlane::updateStat()/incrStat(), or by the index
+   * registerCounter() returned on hot paths.
+   */
+  public:
+    typedef std::vector<uint64_t> CounterValues;
+    typedef std::map<uint16_t, CounterValues> CounterTable;
+
+    /** Register a counter, @return its column index */
+    int registerCounter(const std::string &name);
+    const std::vector<std::string> &getCounterNames() const
+    { return counterNames; }
+    /** Counter values of all DSids that have been updated */
+    const CounterTable &getCounters() const { return counterTable; }
+    /**
+     * Current value of one counter, 0 if DSid has not been updated yet.
+     * @return false if the counter is not registered
+     */
+    bool readCounter(uint16_t DSid, const std::string &name,
+                     uint64_t &value) const;
+
+    virtual void updateStat(int16_t DSid, const std::string &stat,
+                            uint64_t value);
+    virtual void incrStat(int16_t DSid, const std::string &stat,
+                          int64_t delta);
+
+    void updateCounter(uint16_t DSid, int counter, uint64_t value);
+    void incrCounter(uint16_t DSid, int counter, int64_t delta);
+
+  private:
+    uint64_t &findCounter(uint16_t DSid, int counter);
+
+    std::vector<std::string> counterNames;
+    std::map<std::string, int> counterIndex;
+    CounterTable counterTable;
+
   protected:
     const Params * params() const
     { return dynamic_cast<const Params *>(_params); }
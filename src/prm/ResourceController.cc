@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2014 ACS, ICT
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+#include "debug/ResourceController.hh"
+#include "prm/ControlPlane.hh"
+#include "prm/ResourceController.hh"
+#include "prm/ResourcePolicy.hh"
+
+ResourceController::ResourceController(const Params *p)
+    : ClockedObject(p), cps(p->control_planes), policies(p->policies),
+      period(p->period), controlEvent(this)
+{
+    panic_if(period == 0, "%s: control period must not be 0.\n", name());
+
+    for (int i = 0; i < policies.size(); i++) {
+        panic_if(policies[i]->getCP() >= cps.size(),
+                 "%s: policy %s controls CP %d, only %d CPs given.\n",
+                 name(), policies[i]->name(), policies[i]->getCP(),
+                 cps.size());
+    }
+}
+
+void
+ResourceController::startup()
+{
+    if (policies.empty())
+        return;
+    schedule(controlEvent, clockEdge(period));
+}
+
+void
+ResourceController::regStats()
+{
+    ClockedObject::regStats();
+
+    invocations
+        .name(name() + ".invocations")
+        .desc("Number of control periods")
+        ;
+
+    paramWrites
+        .name(name() + ".paramWrites")
+        .desc("Number of param table writes issued by policies")
+        ;
+}
+
+bool
+ResourceController::readCounter(unsigned cp, uint16_t DSid,
+                                const std::string &name,
+                                uint64_t &value) const
+{
+    assert(cp < cps.size());
+    return cps[cp]->readCounter(DSid, name, value);
+}
+
+uint64_t
+ResourceController::readTable(unsigned cp, uint16_t DSid,
+                              uint32_t addr) const
+{
+    assert(cp < cps.size());
+    return cps[cp]->queryTable(DSid, addr);
+}
+
+void
+ResourceController::writeParam(unsigned cp, uint16_t DSid, uint32_t addr,
+                               uint64_t data)
+{
+    assert(cp < cps.size());
+    panic_if((addr & ADDRTYPE_MASK) != ADDRTYPE_CFGTBL ||
+             cfgtbl_addr2type(addr) != CFGTBL_TYPE_PARAM,
+             "%s: write to non-param address %#x of %s.\n",
+             name(), addr, cps[cp]->name());
+
+    DPRINTF(ResourceController, "%s: DSid#%d [%#x] <= %#x\n",
+            cps[cp]->name(), DSid, addr, data);
+    cps[cp]->updateTable(DSid, addr, data);
+    paramWrites++;
+}
+
+void
+ResourceController::control()
+{
+    for (int i = 0; i < policies.size(); i++)
+        policies[i]->control(this);
+
+    invocations++;
+    schedule(controlEvent, clockEdge(period));
+}
+
+ResourceController *
+ResourceControllerParams::create()
+{
+    return new ResourceController(this);
+}
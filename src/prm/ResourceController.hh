@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2014 ACS, ICT
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/**
+ * @file
+ * Closed-loop resource controller. Every period the controller runs its
+ * policies, which read per-DSid counters and stat tables of control
+ * planes and write back param tables.
+ */
+
+#ifndef __PRM_RESOURCE_CONTROLLER_HH__
+#define __PRM_RESOURCE_CONTROLLER_HH__
+
+#include <string>
+#include <vector>
+
+#include "base/statistics.hh"
+#include "params/ResourceController.hh"
+#include "sim/clocked_object.hh"
+#include "sim/eventq.hh"
+
+class ControlPlane;
+class ResourcePolicy;
+
+class ResourceController : public ClockedObject
+{
+  protected:
+    std::vector<ControlPlane *> cps;
+    std::vector<ResourcePolicy *> policies;
+    const Cycles period;
+
+  public:
+    typedef ResourceControllerParams Params;
+    ResourceController(const Params *p);
+
+    virtual void startup();
+    virtual void regStats();
+
+  /**
+   * Interface to policies, cp is the index into control_planes.
+   */
+  public:
+    int numControlPlanes() const { return cps.size(); }
+    Cycles getPeriod() const { return period; }
+
+    /**
+     * Current value of a per-DSid counter.
+     * @return false if the counter is not registered
+     */
+    bool readCounter(unsigned cp, uint16_t DSid, const std::string &name,
+                     uint64_t &value) const;
+    /** Query any table of the CP, param/stat/trigger alike */
+    uint64_t readTable(unsigned cp, uint16_t DSid, uint32_t addr) const;
+    /** Update a param table entry, other tables are read-only here */
+    void writeParam(unsigned cp, uint16_t DSid, uint32_t addr,
+                    uint64_t data);
+
+  protected:
+    void control();
+    EventWrapper<ResourceController, &ResourceController::control>
+        controlEvent;
+
+    Stats::Scalar invocations;
+    Stats::Scalar paramWrites;
+};
+
+#endif	// __PRM_RESOURCE_CONTROLLER_HH__
@@ -0,0 +1,50 @@
+from m5.params import *
+from m5.SimObject import SimObject
+from ClockedObject import ClockedObject
+
+# How a policy output is written to the param table:
+#   Value   - the output itself, e.g. a bandwidth cap
+#   Waymask - the output is a number of ways, written as a contiguous
+#             low-order mask, e.g. 3 -> 0b111
+class PolicyOutput(Enum): vals = ['Value', 'Waymask']
+
+class ResourcePolicy(SimObject):
+    type = 'ResourcePolicy'
+    abstract = True
+    cxx_header = 'prm/ResourcePolicy.hh'
+
+    cp = Param.Unsigned(0, "Index of the controlled CP in the controller")
+    dsid = Param.UInt16(0, "Controlled DSid")
+    counter = Param.String("Feedback counter, sampled as a per-period delta")
+    param_addr = Param.UInt32("Param table address written by the policy")
+    output = Param.PolicyOutput('Value', "Param encoding of the output")
+    initial = Param.UInt64(0, "Output before the first period")
+    min_output = Param.UInt64(0, "Lower bound of the output")
+    max_output = Param.UInt64(0xFFFFFFFF, "Upper bound of the output")
+
+class PIDPolicy(ResourcePolicy):
+    type = 'PIDPolicy'
+    cxx_header = 'prm/ResourcePolicy.hh'
+
+    # error = measured - setpoint, the output grows with a positive error,
+    # use negative gains for knobs that work the other way around
+    setpoint = Param.Float("Target counter delta per period")
+    kp = Param.Float(0.0, "Proportional gain")
+    ki = Param.Float(0.0, "Integral gain")
+    kd = Param.Float(0.0, "Derivative gain")
+
+class ThresholdPolicy(ResourcePolicy):
+    type = 'ThresholdPolicy'
+    cxx_header = 'prm/ResourcePolicy.hh'
+
+    high = Param.UInt64("Step the output up above this delta per period")
+    low = Param.UInt64(0, "Step the output down below this delta per period")
+    step = Param.UInt64(1, "Output step")
+
+class ResourceController(ClockedObject):
+    type = 'ResourceController'
+    cxx_header = 'prm/ResourceController.hh'
+
+    control_planes = VectorParam.ControlPlane([], "Controlled control planes")
+    policies = VectorParam.ResourcePolicy([], "Policies run every period")
+    period = Param.Cycles(100000, "Cycles between two policy invocations")
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2014 ACS, ICT
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+#include <cmath>
+
+#include "debug/ResourceController.hh"
+#include "prm/ResourceController.hh"
+#include "prm/ResourcePolicy.hh"
+
+ResourcePolicy::ResourcePolicy(const Params *p)
+    : SimObject(p), cp(p->cp), DSid(p->dsid), counter(p->counter),
+      paramAddr(p->param_addr), outputType(p->output),
+      minOutput(p->min_output), maxOutput(p->max_output),
+      output(p->initial), lastCount(0), primed(false)
+{
+    panic_if(minOutput > maxOutput, "%s: min_output > max_output.\n",
+             name());
+    panic_if(output < minOutput || output > maxOutput,
+             "%s: initial output %d out of [%d, %d].\n",
+             name(), output, minOutput, maxOutput);
+}
+
+void
+ResourcePolicy::regStats()
+{
+    SimObject::regStats();
+
+    periods
+        .name(name() + ".periods")
+        .desc("Number of control periods")
+        ;
+
+    changes
+        .name(name() + ".changes")
+        .desc("Number of periods the output changed")
+        ;
+
+    saturations
+        .name(name() + ".saturations")
+        .desc("Number of periods the output was clamped")
+        ;
+}
+
+uint64_t
+ResourcePolicy::encode(uint64_t value) const
+{
+    switch (outputType) {
+      case Enums::Value:
+        return value;
+      case Enums::Waymask:
+        return value >= 64 ? ~0ULL : (1ULL << value) - 1;
+      default:
+        panic("%s: unknown output type %d.\n", name(), outputType);
+    }
+}
+
+void
+ResourcePolicy::control(ResourceController *ctrl)
+{
+    uint64_t count;
+    if (!ctrl->readCounter(cp, DSid, counter, count)) {
+        warn_once("%s: no counter %s, policy disabled.\n", name(), counter);
+        return;
+    }
+
+    periods++;
+
+    // Counters are created on first update, the first sample only
+    // establishes the baseline; install the initial output meanwhile
+    if (!primed) {
+        lastCount = count;
+        primed = true;
+        ctrl->writeParam(cp, DSid, paramAddr, encode(output));
+        return;
+    }
+
+    uint64_t delta = count - lastCount;
+    lastCount = count;
+
+    int64_t next = update(delta);
+    if (next < (int64_t)minOutput || next > (int64_t)maxOutput) {
+        next = next < (int64_t)minOutput ? minOutput : maxOutput;
+        saturations++;
+    }
+
+    DPRINTF(ResourceController, "%s: DSid#%d %s +%d, output %d -> %d\n",
+            name(), DSid, counter, delta, output, next);
+
+    if (next == output)
+        return;
+
+    output = next;
+    changes++;
+    ctrl->writeParam(cp, DSid, paramAddr, encode(output));
+}
+
+PIDPolicy::PIDPolicy(const Params *p)
+    : ResourcePolicy(p), setpoint(p->setpoint),
+      kp(p->kp), ki(p->ki), kd(p->kd), base(p->initial),
+      integral(0), lastError(0)
+{
+}
+
+int64_t
+PIDPolicy::update(uint64_t delta)
+{
+    double error = (double)delta - setpoint;
+    double derivative = error - lastError;
+    lastError = error;
+
+    double out = base + kp * error + ki * (integral + error) +
+                 kd * derivative;
+    if (out >= (double)minOutput && out <= (double)maxOutput)
+        integral += error;
+
+    return (int64_t)llround(out);
+}
+
+ThresholdPolicy::ThresholdPolicy(const Params *p)
+    : ResourcePolicy(p), high(p->high), low(p->low), step(p->step)
+{
+    panic_if(low > high, "%s: low threshold above high.\n", name());
+}
+
+int64_t
+ThresholdPolicy::update(uint64_t delta)
+{
+    if (delta > high)
+        return output + step;
+    if (delta < low)
+        return (int64_t)output - (int64_t)step;
+    return output;
+}
+
+PIDPolicy *
+PIDPolicyParams::create()
+{
+    return new PIDPolicy(this);
+}
+
+ThresholdPolicy *
+ThresholdPolicyParams::create()
+{
+    return new ThresholdPolicy(this);
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2014 ACS, ICT
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/**
+ * @file
+ * Policies of the closed-loop ResourceController.
+ *
+ * A policy watches one per-DSid counter of one control plane and drives
+ * one param table entry of the same DSid. The counter is sampled as a
+ * delta per control period, so it acts as a rate (e.g. misses/period).
+ * New policies derive from ResourcePolicy and implement update().
+ */
+
+#ifndef __PRM_RESOURCE_POLICY_HH__
+#define __PRM_RESOURCE_POLICY_HH__
+
+#include <string>
+
+#include "base/statistics.hh"
+#include "params/PIDPolicy.hh"
+#include "params/ResourcePolicy.hh"
+#include "params/ThresholdPolicy.hh"
+#include "sim/sim_object.hh"
+
+class ResourceController;
+
+class ResourcePolicy : public SimObject
+{
+  protected:
+    const unsigned cp;
+    const uint16_t DSid;
+    const std::string counter;
+    const uint32_t paramAddr;
+    const Enums::PolicyOutput outputType;
+    const uint64_t minOutput;
+    const uint64_t maxOutput;
+
+    /** Current output, before encoding */
+    uint64_t output;
+    /** Counter value at the previous period */
+    uint64_t lastCount;
+    bool primed;
+
+  public:
+    typedef ResourcePolicyParams Params;
+    ResourcePolicy(const Params *p);
+
+    virtual void regStats();
+
+    unsigned getCP() const { return cp; }
+
+    /** Called by the controller once every period */
+    void control(ResourceController *ctrl);
+
+  protected:
+    /**
+     * Compute the new output from the counter delta of last period.
+     * @return the unclamped output
+     */
+    virtual int64_t update(uint64_t delta) = 0;
+
+    /** Param table encoding of output */
+    uint64_t encode(uint64_t value) const;
+
+    Stats::Scalar periods;
+    Stats::Scalar changes;
+    Stats::Scalar saturations;
+};
+
+/**
+ * Textbook PID loop on error = delta - setpoint, added to the initial
+ * output. The integral term is frozen while the output saturates to
+ * avoid wind-up.
+ */
+class PIDPolicy : public ResourcePolicy
+{
+  protected:
+    const double setpoint;
+    const double kp;
+    const double ki;
+    const double kd;
+    const double base;
+
+    double integral;
+    double lastError;
+
+  public:
+    typedef PIDPolicyParams Params;
+    PIDPolicy(const Params *p);
+
+  protected:
+    virtual int64_t update(uint64_t delta);
+};
+
+/**
+ * Step the output up while the delta is above high, down while it is
+ * below low, and hold it in between.
+ */
+class ThresholdPolicy : public ResourcePolicy
+{
+  protected:
+    const uint64_t high;
+    const uint64_t low;
+    const uint64_t step;
+
+  public:
+    typedef ThresholdPolicyParams Params;
+    ThresholdPolicy(const Params *p);
+
+  protected:
+    virtual int64_t update(uint64_t delta);
+};
+
+#endif	// __PRM_RESOURCE_POLICY_HH__
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2014 ACS, ICT
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <set>
+
+#include "base/callback.hh"
+#include "base/output.hh"
+#include "debug/StatsRecorder.hh"
+#include "prm/ControlPlane.hh"
+#include "prm/StatsRecorder.hh"
+#include "sim/core.hh"
+
+StatsRecorder::StatsRecorder(const Params *p)
+    : SimObject(p), cps(p->control_planes), columns(0),
+      interval(p->interval), filename(p->filename),
+      chunkSize(p->chunk_size),
+      fd(-1), map(NULL), mapSize(0), used(0), recordSize(0),
+      sampleEvent(this)
+{
+    panic_if(interval == 0, "%s: sampling interval must not be 0.\n",
+             name());
+
+    registerExitCallback(
+        new MakeCallback<StatsRecorder, &StatsRecorder::closeFile>(this));
+}
+
+StatsRecorder::~StatsRecorder()
+{
+    closeFile();
+}
+
+void
+StatsRecorder::startup()
+{
+    // Counters are registered by CPs on construction, fix the columns
+    columnBase.clear();
+    columnCount.clear();
+    columns = 0;
+    for (int i = 0; i < cps.size(); i++) {
+        columnBase.push_back(columns);
+        columnCount.push_back(cps[i]->getCounterNames().size());
+        columns += columnCount[i];
+    }
+    recordSize = sizeof(StatsRecord) + columns * sizeof(uint64_t);
+
+    openFile();
+
+    schedule(sampleEvent, curTick() + interval);
+}
+
+void
+StatsRecorder::openFile()
+{
+    std::string path = simout.resolve(filename);
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        fatal("%s: can not open %s: %s\n", name(), path, strerror(errno));
+
+    uint32_t header_size = sizeof(StatsFileHeader) +
+                           columns * STATS_COLUMN_NAME_LEN;
+    // keep records 8-byte aligned
+    header_size = (header_size + 7) & ~7;
+
+    uint8_t *ptr = reserve(header_size);
+    StatsFileHeader *hdr = (StatsFileHeader *)ptr;
+    strncpy(hdr->magic, STATS_FILE_MAGIC, sizeof(hdr->magic));
+    hdr->version = STATS_FILE_VERSION;
+    hdr->columns = columns;
+    hdr->headerSize = header_size;
+    hdr->recordSize = recordSize;
+    hdr->interval = interval;
+    hdr->ticksPerSecond = SimClock::Frequency;
+    hdr->records = 0;
+
+    char *names = (char *)(ptr + sizeof(StatsFileHeader));
+    for (int i = 0; i < cps.size(); i++) {
+        const std::vector<std::string> &counters = cps[i]->getCounterNames();
+        for (int j = 0; j < counters.size(); j++) {
+            std::string col = cps[i]->name() + "." + counters[j];
+            strncpy(names + (columnBase[i] + j) * STATS_COLUMN_NAME_LEN,
+                    col.c_str(), STATS_COLUMN_NAME_LEN - 1);
+        }
+    }
+
+    DPRINTF(StatsRecorder, "%s: %d columns, %d bytes per record\n",
+            path, columns, recordSize);
+}
+
+void
+StatsRecorder::closeFile()
+{
+    if (fd < 0)
+        return;
+
+    munmap(map, mapSize);
+    map = NULL;
+    mapSize = 0;
+
+    // drop unused tail of the last chunk
+    if (ftruncate(fd, used) < 0)
+        warn("%s: can not truncate output: %s\n", name(), strerror(errno));
+    close(fd);
+    fd = -1;
+}
+
+uint8_t *
+StatsRecorder::reserve(uint64_t size)
+{
+    if (used + size > mapSize) {
+        uint64_t new_size = mapSize + std::max(chunkSize, size);
+
+        if (map)
+            munmap(map, mapSize);
+        if (ftruncate(fd, new_size) < 0)
+            fatal("%s: can not grow output: %s\n", name(), strerror(errno));
+
+        void *ptr = mmap(NULL, new_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED)
+            fatal("%s: can not map output: %s\n", name(), strerror(errno));
+
+        map = (uint8_t *)ptr;
+        mapSize = new_size;
+    }
+
+    uint8_t *ptr = map + used;
+    used += size;
+    return ptr;
+}
+
+void
+StatsRecorder::sample()
+{
+    // One record per DSid seen by any control plane
+    std::set<uint16_t> dsids;
+    for (int i = 0; i < cps.size(); i++) {
+        const ControlPlane::CounterTable &table = cps[i]->getCounters();
+        ControlPlane::CounterTable::const_iterator it;
+        for (it = table.begin(); it != table.end(); ++it)
+            dsids.insert(it->first);
+    }
+
+    std::set<uint16_t>::iterator ds;
+    for (ds = dsids.begin(); ds != dsids.end(); ++ds) {
+        uint8_t *ptr = reserve(recordSize);
+        StatsRecord *rec = (StatsRecord *)ptr;
+        uint64_t *values = (uint64_t *)(ptr + sizeof(StatsRecord));
+
+        memset(ptr, 0, recordSize);
+        rec->tick = curTick();
+        rec->DSid = *ds;
+
+        for (int i = 0; i < cps.size(); i++) {
+            const ControlPlane::CounterTable &table = cps[i]->getCounters();
+            ControlPlane::CounterTable::const_iterator it = table.find(*ds);
+            if (it == table.end())
+                continue;
+            // counters registered after startup are not recorded
+            int n = std::min((int)it->second.size(), columnCount[i]);
+            memcpy(values + columnBase[i], &it->second[0],
+                   n * sizeof(uint64_t));
+        }
+    }
+
+    header()->records += dsids.size();
+
+    DPRINTF(StatsRecorder, "sampled %d DSids, %d records total\n",
+            dsids.size(), header()->records);
+
+    schedule(sampleEvent, curTick() + interval);
+}
+
+StatsRecorder *
+StatsRecorderParams::create()
+{
+    return new StatsRecorder(this);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2014 ACS, ICT
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Jiuyue Ma
+ */
+
+/**
+ * @file
+ * Record per-DSid counters of control planes into a binary file.
+ *
+ * File layout, all fields are little-endian:
+ *
+ *   StatsFileHeader
+ *   char name[STATS_COLUMN_NAME_LEN] * columns     "<cp name>.<counter>"
+ *   StatsRecord * records                          at headerSize
+ *
+ * Every record is recordSize bytes: a StatsRecord followed by one
+ * uint64_t per column, so a column can be read by striding the file.
+ * Use util/dsid_stats.py to read it.
+ */
+
+#ifndef __PRM_STATS_RECORDER_HH__
+#define __PRM_STATS_RECORDER_HH__
+
+#include <string>
+#include <vector>
+
+#include "params/StatsRecorder.hh"
+#include "sim/eventq.hh"
+#include "sim/sim_object.hh"
+
+class ControlPlane;
+
+#define STATS_FILE_MAGIC	"PARDSTS"
+#define STATS_FILE_VERSION	1
+#define STATS_COLUMN_NAME_LEN	64
+
+struct StatsFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t columns;
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint64_t interval;
+    uint64_t ticksPerSecond;
+    uint64_t records;
+};
+
+struct StatsRecord {
+    uint64_t tick;
+    uint16_t DSid;
+    uint16_t __padding[3];
+};
+
+class StatsRecorder : public SimObject
+{
+  protected:
+    std::vector<ControlPlane *> cps;
+    /** First column and number of columns of each control plane */
+    std::vector<int> columnBase;
+    std::vector<int> columnCount;
+    int columns;
+
+    const Tick interval;
+    const std::string filename;
+    const uint64_t chunkSize;
+
+    int fd;
+    uint8_t *map;
+    uint64_t mapSize;
+    /** Bytes used in file */
+    uint64_t used;
+    uint32_t recordSize;
+
+  public:
+    typedef StatsRecorderParams Params;
+    StatsRecorder(const Params *p);
+    ~StatsRecorder();
+
+    virtual void startup();
+
+  protected:
+    void openFile();
+    void closeFile();
+    /** Make room for size more bytes, remapping the file if needed */
+    uint8_t *reserve(uint64_t size);
+    StatsFileHeader *header() { return (StatsFileHeader *)map; }
+
+    void sample();
+    EventWrapper<StatsRecorder, &StatsRecorder::sample> sampleEvent;
+};
+
+#endif	// __PRM_STATS_RECORDER_HH__
@@ -0,0 +1,12 @@
+from m5.params import *
+from m5.SimObject import SimObject
+
+class StatsRecorder(SimObject):
+    type = 'StatsRecorder'
+    cxx_header = 'prm/StatsRecorder.hh'
+
+    control_planes = VectorParam.ControlPlane([], "Control planes to sample")
+    interval = Param.Latency('100us', "Sampling interval")
+    filename = Param.String("dsid_stats.bin",
+                            "Output file, relative to output directory")
+    chunk_size = Param.MemorySize('16MB', "Output file grows by this size")
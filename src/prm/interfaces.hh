@@ -1,6 +1,11 @@
 #ifndef __PRM_INTERFACES_HH__
 #define __PRM_INTERFACES_HH__
 
+#include <iostream>
+#include <string>
+
+class Checkpoint;
+
 class ICommandHandler
 {
   public:
@@ -8,4 +13,19 @@ class ICommandHandler
         uint64_t arg1, uint64_t arg2, uint64_t arg3) = 0;
 };
 
+/**
+ * State owned by a single LDomain, saved and restored by per-LDomain
+ * checkpoints. The restoring DSid need not be the one that was saved.
+ */
+class ILDomSerializable
+{
+  public:
+    /** Save state of DSid, extra files go to directory dir */
+    virtual void serializeLDom(uint16_t DSid, const std::string &dir,
+                               std::ostream &os) = 0;
+    /** Restore state of a saved LDomain into DSid */
+    virtual void unserializeLDom(uint16_t DSid, Checkpoint *cp,
+                                 const std::string &section) = 0;
+};
+
 #endif	// __PRM_INTERFACES_HH__
@@ -56,6 +56,163 @@ int cpn_bus_write_command(struct control_plane_bus *bus,
     return 0;
 }
 
+/*
+ * Execute one descriptor through the register interface, CP leaves 0xFF
+ * in its command register if the command failed.
+ */
+static void __cpn_exec_desc_unsafe(struct control_plane_adaptor *adaptor,
+                                   struct cpn_desc *desc)
+{
+    cpa_writew(  CP_LDOMID_OFFSET, adaptor->data_virtual, desc->ldom);
+    cpa_writel(CP_DESTADDR_OFFSET, adaptor->data_virtual, desc->addr);
+    if (desc->cmd != CP_CMD_GETENTRY)
+        cpa_writeq(CP_DATA_OFFSET, adaptor->data_virtual, desc->value);
+    cpa_writeb(     CP_CMD_OFFSET, adaptor->data_virtual, desc->cmd);
+    if (cpa_readb(CP_CMD_OFFSET, adaptor->data_virtual) == 0xFF) {
+        desc->status = CPN_DESC_ERROR;
+        return;
+    }
+    if (desc->cmd == CP_CMD_GETENTRY)
+        desc->value = cpa_readq(CP_DATA_OFFSET, adaptor->data_virtual);
+    desc->status = CPN_DESC_DONE;
+}
+
+/*
+ * Run one ring of descriptors: the adaptor fetches them from RAM by DMA,
+ * executes them and writes them back before it reports DONE in RINGCTRL.
+ * Only the doorbell takes adaptor->lock, the adaptor latches the selected
+ * CP when the ring starts, so RINGCTRL is polled with the lock dropped.
+ * Caller holds adaptor->ring_lock.
+ */
+static int __cpn_exec_ring(struct control_plane_adaptor *adaptor,
+                           uint16_t cpid, struct cpn_desc *descs, int count)
+{
+    unsigned long timeout;
+    uint32_t ctrl;
+    int i;
+
+    memcpy(adaptor->ring, descs, count * sizeof(struct cpn_desc));
+    for (i=0; i<count; i++)
+        adaptor->ring[i].status = CPN_DESC_PENDING;
+    wmb();
+
+    spin_lock(&adaptor->lock);
+    // select CP
+    cpa_writel(0, adaptor->cmd_virtual, cpid);
+    cpa_writel(CPA_RINGCOUNT_OFFSET, adaptor->cmd_virtual, count);
+    cpa_writel(CPA_RINGCTRL_OFFSET,  adaptor->cmd_virtual, CPA_RING_START);
+    spin_unlock(&adaptor->lock);
+
+    timeout = jiffies + CPA_RING_TIMEOUT;
+    for (;;) {
+        ctrl = cpa_readl(CPA_RINGCTRL_OFFSET, adaptor->cmd_virtual);
+        if (ctrl & CPA_RING_ERROR)
+            return -EIO;
+        if (ctrl & CPA_RING_DONE)
+            break;
+        if (time_after(jiffies, timeout))
+            return -ETIMEDOUT;
+        cond_resched();
+    }
+    rmb();
+    memcpy(descs, adaptor->ring, count * sizeof(struct cpn_desc));
+    return 0;
+}
+
+/*
+ * Submit a batch of descriptors to CP with one doorbell per ring, fall
+ * back to register interface if adaptor has no command ring. Returns the
+ * number of descriptors completed with CPN_DESC_DONE, or -EIO/-ETIMEDOUT
+ * if the adaptor failed or did not finish a ring. May sleep.
+ */
+int cpn_bus_submit_batch(struct control_plane_bus *bus,
+                         struct control_plane_adaptor *adaptor,
+                         uint16_t cpid, struct cpn_desc *descs, int count)
+{
+    int i, n, err = 0, done = 0;
+
+    if (adaptor->ring) {
+        mutex_lock(&adaptor->ring_lock);
+        for (i=0; i<count && !err; i+=n) {
+            n = min_t(int, count - i, CPA_RING_ENTRIES);
+            err = __cpn_exec_ring(adaptor, cpid, &descs[i], n);
+        }
+        mutex_unlock(&adaptor->ring_lock);
+        if (err)
+            return err;
+    } else {
+        spin_lock(&adaptor->lock);
+        // select CP
+        cpa_writel(0, adaptor->cmd_virtual, cpid);
+        for (i=0; i<count; i++)
+            __cpn_exec_desc_unsafe(adaptor, &descs[i]);
+        spin_unlock(&adaptor->lock);
+    }
+
+    for (i=0; i<count; i++)
+        if (descs[i].status == CPN_DESC_DONE)
+            done++;
+    return done;
+}
+
+/*
+ * Stats snapshot interrupt, reading SNAPCTRL acknowledges it.
+ */
+irqreturn_t cpa_snapshot_isr(int irq, void *dev_id)
+{
+    struct control_plane_adaptor *adaptor = dev_id;
+    uint32_t ctrl;
+
+    ctrl = cpa_readl(CPA_SNAPCTRL_OFFSET, adaptor->cmd_virtual);
+    if (!(ctrl & CPA_SNAP_DONE))
+        return IRQ_NONE;
+    adaptor->snap_status = ctrl;
+    complete(&adaptor->snap_done);
+    return IRQ_HANDLED;
+}
+
+/*
+ * Gather stats of ldom range [first, last] from all CPs with one DMA and
+ * one interrupt, instead of a register access per stat entry.
+ */
+int cpn_bus_snapshot(struct control_plane_adaptor *adaptor,
+                     uint16_t first, uint16_t last, void *buf, size_t size)
+{
+    struct cpa_snap_header *hdr = adaptor->snap;
+    int len;
+
+    if (!adaptor->snap)
+        return -ENODEV;
+
+    mutex_lock(&adaptor->snap_lock);
+    init_completion(&adaptor->snap_done);
+
+    spin_lock(&adaptor->lock);
+    cpa_writel(CPA_SNAPDSID_OFFSET, adaptor->cmd_virtual,
+               ((uint32_t)last << 16) | first);
+    cpa_writel(CPA_SNAPSIZE_OFFSET, adaptor->cmd_virtual, CPA_SNAP_BUF_SIZE);
+    cpa_writeq(CPA_SNAPADDR_OFFSET, adaptor->cmd_virtual, adaptor->snap_dma);
+    cpa_writel(CPA_SNAPCTRL_OFFSET, adaptor->cmd_virtual, CPA_SNAP_START);
+    spin_unlock(&adaptor->lock);
+
+    if (!wait_for_completion_timeout(&adaptor->snap_done, HZ)) {
+        len = -ETIMEDOUT;
+        goto out;
+    }
+    if (adaptor->snap_status & CPA_SNAP_OVERFLOW)
+        printk(KERN_WARNING "cpa: snapshot of ldom %d-%d truncated\n",
+               first, last);
+
+    rmb();
+    len = min_t(size_t, hdr->bytes, size);
+    memcpy(buf, adaptor->snap, len);
+out:
+    mutex_unlock(&adaptor->snap_lock);
+    return len;
+}
+
 EXPORT_SYMBOL(cpn_bus_read_config_qword);
 EXPORT_SYMBOL(cpn_bus_write_config_qword);
 EXPORT_SYMBOL(cpn_bus_write_command);
+EXPORT_SYMBOL(cpn_bus_submit_batch);
+EXPORT_SYMBOL(cpn_bus_snapshot);
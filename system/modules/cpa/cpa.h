@@ -8,13 +8,17 @@
 #define MODULE
 
 #include <linux/cdev.h>
+#include <linux/completion.h>
 #include <linux/device.h>
 #include <linux/fs.h>
 #include <linux/list.h>
 #include <linux/init.h>		// included for __init and __exit macros
+#include <linux/interrupt.h>
 #include <linux/kernel.h>	// included for KERN_INFO
 #include <linux/module.h>	// included for all kernel modules
+#include <linux/mutex.h>
 #include <linux/pci.h>
+#include <linux/sched.h>
 #include <linux/spinlock.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
@@ -42,6 +46,8 @@ extern struct class *cpa_device_class;
 extern dev_t g_cpa_first_devno;
 extern struct list_head g_adaptor_list;
 
+struct cpn_desc;
+
 #define CP_ANY_ID (~0)
 struct control_plane_id {
     __u32 vendor, device;	/* Vendor and device ID or CP_ANY_ID */
@@ -55,6 +61,14 @@ struct control_plane_adaptor {
     int                bars;         /* enabled bars' mask */
     u8 __iomem        *cmd_virtual;  /* BAR0: cmd */
     u8 __iomem        *data_virtual; /* BAR1: data */
+    struct cpn_desc   *ring;         /* command ring in RAM, optional */
+    dma_addr_t         ring_dma;     /* bus address of command ring */
+    void              *snap;         /* stats snapshot buffer, optional */
+    dma_addr_t         snap_dma;     /* bus address of snapshot buffer */
+    uint32_t           snap_status;  /* SNAPCTRL latched by interrupt */
+    struct mutex       snap_lock;    /* one snapshot at a time */
+    struct completion  snap_done;    /* signalled by snapshot interrupt */
+    struct mutex       ring_lock;    /* one command ring at a time */
     struct control_plane_bus *bus;   /* cpn bus this adaptor connected */
 };
 
@@ -143,5 +157,67 @@ void unregister_cp_driver (struct control_plane_driver *);
 #define CP_CMD_GETENTRY		'G'
 #define CP_CMD_SETENTRY		'S'
 
+/**
+ * CPA Stats Snapshot (BAR0), ref "prm/CPAdaptor.hh"
+ *
+ * Program DSid range/buffer, write CPA_SNAP_START to SNAPCTRL, the
+ * adaptor DMAs a packed snapshot to SNAPADDR and raises its interrupt.
+ **/
+#define CPA_SNAPCTRL_OFFSET	0x04
+#define CPA_SNAPDSID_OFFSET	0x08
+#define CPA_SNAPSIZE_OFFSET	0x0c
+#define CPA_SNAPADDR_OFFSET	0x10
+
+#define CPA_SNAP_REGS_END	0x18
+
+#define CPA_SNAP_START		0x1
+#define CPA_SNAP_BUSY		0x1
+#define CPA_SNAP_DONE		0x2
+#define CPA_SNAP_OVERFLOW	0x4
+
+#define CPA_SNAP_BUF_SIZE	(4 * PAGE_SIZE)
+
+struct cpa_snap_header {
+    uint32_t magic;
+    uint16_t first_ldom;
+    uint16_t last_ldom;
+    uint32_t records;
+    uint32_t bytes;		/* header and records */
+    uint64_t tick;
+};
+
+irqreturn_t cpa_snapshot_isr(int irq, void *dev_id);
+
+/**
+ * CPA Command Ring (BAR0), ref "prm/CPAdaptor.hh"
+ *
+ * Descriptors live in a coherent page at RINGADDR, write their number to
+ * RINGCOUNT and CPA_RING_START to RINGCTRL, the adaptor fetches them by
+ * DMA, runs them on the selected CP and writes them back with status,
+ * then reports DONE (or ERROR) in RINGCTRL.
+ **/
+#define CPA_RINGCTRL_OFFSET	0x18
+#define CPA_RINGCOUNT_OFFSET	0x1c
+#define CPA_RINGADDR_OFFSET	0x20
+#define CPA_RING_REGS_END	0x28
+
+#define CPA_RING_START		0x1
+#define CPA_RING_BUSY		0x1
+#define CPA_RING_DONE		0x2
+#define CPA_RING_ERROR		0x4
+#define CPA_RING_ENTRIES	(PAGE_SIZE / sizeof(struct cpn_desc))
+#define CPA_RING_TIMEOUT	HZ
+
+struct cpn_desc {
+    uint8_t  cmd;
+    uint8_t  status;
+    uint16_t ldom;
+    uint32_t addr;
+    uint64_t value;
+};
+#define CPN_DESC_DONE	0x00
+#define CPN_DESC_PENDING	0x01
+#define CPN_DESC_ERROR	0xFF
+
 #endif	// __PARDg5V_CPA_H__
 
@@ -289,6 +289,58 @@ out:
     return err;
 }
 
+/*
+ * Command ring and stats snapshot buffer live in RAM, allocate them if
+ * the adaptor has their registers, use register interface otherwise.
+ */
+static void
+__alloc_adaptor_buffers(struct control_plane_adaptor *adaptor,
+                        unsigned long mmio_cmd_len)
+{
+    struct pci_dev *dev = adaptor->dev;
+
+    mutex_init(&adaptor->snap_lock);
+    mutex_init(&adaptor->ring_lock);
+    init_completion(&adaptor->snap_done);
+
+    if (mmio_cmd_len >= CPA_RING_REGS_END) {
+        adaptor->ring = dma_alloc_coherent(&dev->dev, PAGE_SIZE,
+                                           &adaptor->ring_dma, GFP_KERNEL);
+        if (adaptor->ring)
+            cpa_writeq(CPA_RINGADDR_OFFSET, adaptor->cmd_virtual,
+                       adaptor->ring_dma);
+    }
+
+    if (mmio_cmd_len >= CPA_SNAP_REGS_END && dev->irq) {
+        adaptor->snap = dma_alloc_coherent(&dev->dev, CPA_SNAP_BUF_SIZE,
+                                           &adaptor->snap_dma, GFP_KERNEL);
+        if (adaptor->snap &&
+            request_irq(dev->irq, cpa_snapshot_isr, IRQF_SHARED,
+                        CPA_MODULE_NAME, adaptor)) {
+            printk(KERN_WARNING "cpa: can not get irq %d, no snapshot\n",
+                   dev->irq);
+            dma_free_coherent(&dev->dev, CPA_SNAP_BUF_SIZE, adaptor->snap,
+                              adaptor->snap_dma);
+            adaptor->snap = NULL;
+        }
+    }
+}
+
+static void
+__free_adaptor_buffers(struct control_plane_adaptor *adaptor)
+{
+    struct pci_dev *dev = adaptor->dev;
+
+    if (adaptor->snap) {
+        free_irq(dev->irq, adaptor);
+        dma_free_coherent(&dev->dev, CPA_SNAP_BUF_SIZE, adaptor->snap,
+                          adaptor->snap_dma);
+    }
+    if (adaptor->ring)
+        dma_free_coherent(&dev->dev, PAGE_SIZE, adaptor->ring,
+                          adaptor->ring_dma);
+}
+
 static int __devinit
 cpa_adaptor_probe(struct pci_dev *dev, const struct pci_device_id *id)
 {
@@ -307,6 +359,8 @@ cpa_adaptor_probe(struct pci_dev *dev, const struct pci_device_id *id)
         printk(KERN_ERR "cpa: couldn't enable device!\n");
         return err;
     }
+    // command ring and stats snapshot are fetched by DMA
+    pci_set_master(dev);
 
     // Reserve selected PCI I/O and memory resource
     err = pci_request_selected_regions(dev, bars, CPA_MODULE_NAME);
@@ -337,6 +391,7 @@ cpa_adaptor_probe(struct pci_dev *dev, const struct pci_device_id *id)
         goto err_ioremap_cmd;
     if (!(adaptor->data_virtual = ioremap_nocache(mmio_data_start, mmio_data_len)))
         goto err_ioremap_data;
+    __alloc_adaptor_buffers(adaptor, mmio_cmd_len);
 
     // register control plane network bus
     adaptor->bus = __alloc_cpn_bus(adaptor_nr);
@@ -362,6 +417,7 @@ cpa_adaptor_probe(struct pci_dev *dev, const struct pci_device_id *id)
 err_probe_control_planes:
     __free_cpn_bus(adaptor->bus);
 err_create_cpn_bus:
+    __free_adaptor_buffers(adaptor);
     iounmap(adaptor->data_virtual);
 err_ioremap_data:
     iounmap(adaptor->cmd_virtual);
@@ -399,6 +455,7 @@ found_adaptor:
         __free_control_plane(cp);
     }
     __free_cpn_bus(adaptor->bus);
+    __free_adaptor_buffers(adaptor);
     iounmap(adaptor->data_virtual);
     iounmap(adaptor->cmd_virtual);
     pci_release_selected_regions(adaptor->dev, adaptor->bars);
@@ -1,8 +1,12 @@
 #ifndef __PARDg5V_CPA_H__
 #define __PARDg5V_CPA_H__
 
+#include <linux/completion.h>
 #include <linux/device.h>
 #include <linux/list.h>
+#include <linux/mutex.h>
+
+struct cpn_desc;
 
 #define CP_ANY_ID (~0)
 struct control_plane_id {
@@ -17,6 +21,14 @@ struct control_plane_adaptor {
     int                bars;         /* enabled bars' mask */
     u8 __iomem        *cmd_virtual;  /* BAR0: cmd */
     u8 __iomem        *data_virtual; /* BAR1: data */
+    struct cpn_desc   *ring;         /* command ring in RAM, optional */
+    dma_addr_t         ring_dma;     /* bus address of command ring */
+    void              *snap;         /* stats snapshot buffer, optional */
+    dma_addr_t         snap_dma;     /* bus address of snapshot buffer */
+    uint32_t           snap_status;  /* SNAPCTRL latched by interrupt */
+    struct mutex       snap_lock;    /* one snapshot at a time */
+    struct completion  snap_done;    /* signalled by snapshot interrupt */
+    struct mutex       ring_lock;    /* one command ring at a time */
     struct control_plane_bus *bus;   /* cpn bus this adaptor connected */
 };
 
@@ -80,6 +92,33 @@ int cpn_bus_write_command(struct control_plane_bus *bus,
                           uint16_t cpid, uint16_t ldom, uint32_t addr,
                           uint64_t value);
 
+/**
+ * Batched command, ref "prm/CPConnector.hh"
+ * status is CPN_DESC_DONE or CPN_DESC_ERROR on return
+ */
+struct cpn_desc {
+    uint8_t  cmd;
+    uint8_t  status;
+    uint16_t ldom;
+    uint32_t addr;
+    uint64_t value;
+};
+#define CPN_DESC_DONE	0x00
+#define CPN_DESC_PENDING	0x01
+#define CPN_DESC_ERROR	0xFF
+
+/* Returns number of CPN_DESC_DONE descriptors or -errno, may sleep */
+int cpn_bus_submit_batch(struct control_plane_bus *bus,
+                         struct control_plane_adaptor *adaptor,
+                         uint16_t cpid, struct cpn_desc *descs, int count);
+
+/**
+ * Stats snapshot of ldom range [first, last] from all CPs on the adaptor,
+ * ref "prm/CPAdaptor.hh". Returns bytes copied to buf or -errno.
+ */
+int cpn_bus_snapshot(struct control_plane_adaptor *adaptor,
+                     uint16_t first, uint16_t last, void *buf, size_t size);
+
 static inline int cpn_read_config_qword(struct control_plane_device *dev,
                                         uint16_t ldom, uint32_t addr, uint64_t *value)
 {
@@ -101,6 +140,20 @@ static inline int cpn_write_command(struct control_plane_device *dev, uint8_t cm
                                      dev->cpid, ldom, addr, value);
 }
 
+static inline int cpn_submit_batch(struct control_plane_device *dev,
+                                   struct cpn_desc *descs, int count)
+{
+    return cpn_bus_submit_batch(dev->adaptor->bus, dev->adaptor,
+                                dev->cpid, descs, count);
+}
+
+static inline int cpn_snapshot(struct control_plane_device *dev,
+                               uint16_t first, uint16_t last,
+                               void *buf, size_t size)
+{
+    return cpn_bus_snapshot(dev->adaptor, first, last, buf, size);
+}
+
 
 #endif	// __PARDg5V_CPA_H__
 
@@ -16,6 +16,28 @@ struct cp_ioctl_args_t {
     unsigned long long value;
 };
 
+/* same layout as struct cpn_desc, status filled in on return */
+struct cp_ioctl_desc_t {
+    unsigned char cmd;
+    unsigned char status;
+    unsigned short ldom;
+    unsigned int addr;
+    unsigned long long value;
+};
+
+struct cp_ioctl_batch_t {
+    unsigned int count;
+    struct cp_ioctl_desc_t *descs;
+};
+
+/* stats snapshot of ldom range, size is updated to the bytes copied */
+struct cp_ioctl_snap_t {
+    unsigned short first;
+    unsigned short last;
+    unsigned int size;
+    void *buf;
+};
+
 
 /**
  * CPA ioctl opcode
@@ -26,8 +48,13 @@ struct cp_ioctl_args_t {
 #define CPA_IOCSENTRY	_IOW(CPA_IOC_MAGIC, 1, struct cp_ioctl_args_t)
 #define CPA_IOCGENTRY	_IOR(CPA_IOC_MAGIC, 2, struct cp_ioctl_args_t)
 #define CPA_IOCCMD      _IOW(CPA_IOC_MAGIC, 3, struct cp_ioctl_args_t)
+#define CPA_IOCBATCH	_IOWR(CPA_IOC_MAGIC, 4, struct cp_ioctl_batch_t)
+#define CPA_IOCSNAP	_IOWR(CPA_IOC_MAGIC, 5, struct cp_ioctl_snap_t)
+
+#define CPA_IOC_MAXNR	5
 
-#define CPA_IOC_MAXNR	3
+#define CPA_IOC_BATCH_MAX	256
+#define CPA_IOC_SNAP_MAX	0x4000
 
 
 /**
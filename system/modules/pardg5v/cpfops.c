@@ -1,5 +1,6 @@
 #include <linux/fs.h>
 #include <linux/mm.h>
+#include <linux/slab.h>
 #include <linux/uaccess.h>
 
 #include "cpa.h"
@@ -133,6 +134,10 @@ generic_cp_ioctl(struct inode *inode, struct file *filp, unsigned int cmd, unsig
 {
     struct control_plane_device *cp;
     struct cp_ioctl_args_t args;
+    struct cp_ioctl_batch_t batch;
+    struct cpn_desc *descs;
+    struct cp_ioctl_snap_t snap;
+    void *buf;
     int err = 0;
     int retval = 0;
 
@@ -185,6 +190,55 @@ generic_cp_ioctl(struct inode *inode, struct file *filp, unsigned int cmd, unsig
             return -EFAULT;
         break;
 
+      case CPA_IOCBATCH:
+        // copy batch and its descriptors from user to kernel
+        if (copy_from_user(&batch, (void __user *)data, sizeof(batch)) != 0)
+            return -EFAULT;
+        if (!batch.count || batch.count > CPA_IOC_BATCH_MAX)
+            return -EINVAL;
+        descs = kmalloc(batch.count * sizeof(*descs), GFP_KERNEL);
+        if (!descs)
+            return -ENOMEM;
+        if (copy_from_user(descs, (void __user *)batch.descs,
+                           batch.count * sizeof(*descs)) != 0) {
+            kfree(descs);
+            return -EFAULT;
+        }
+        retval = cpn_submit_batch(cp, descs, batch.count);
+        if (retval < 0) {
+            kfree(descs);
+            return retval;
+        }
+        retval = 0;
+        err = copy_to_user((void __user *)batch.descs, descs,
+                           batch.count * sizeof(*descs));
+        kfree(descs);
+        if (err)
+            return -EFAULT;
+        break;
+
+      case CPA_IOCSNAP:
+        // copy args from user to kernel
+        if (copy_from_user(&snap, (void __user *)data, sizeof(snap)) != 0)
+            return -EFAULT;
+        if (!snap.size || snap.size > CPA_IOC_SNAP_MAX)
+            return -EINVAL;
+        buf = kmalloc(snap.size, GFP_KERNEL);
+        if (!buf)
+            return -ENOMEM;
+        retval = cpn_snapshot(cp, snap.first, snap.last, buf, snap.size);
+        if (retval < 0) {
+            kfree(buf);
+            return retval;
+        }
+        snap.size = retval;
+        err = copy_to_user((void __user *)snap.buf, buf, snap.size) ||
+              copy_to_user((void __user *)data, &snap, sizeof(snap));
+        kfree(buf);
+        if (err)
+            return -EFAULT;
+        break;
+
       default:
         return -ENOTTY;
     }
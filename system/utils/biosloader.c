@@ -80,6 +80,22 @@ struct Segment {
     uint8_t *ptr;
 };
 
+/*
+ * Segments beyond the inline ones go to a descriptor chain in config memory
+ */
+#define PARAMTABLE_SEGMENT_COUNT  4
+#define PARAMTABLE_SEGCHAIN_OFFSET 88
+#define FLAG_SEGCHAIN  0x40000000
+#define SEGDESC_END    0xFFFFFFFF
+
+struct SegmentDesc {
+    uint64_t base;
+    uint32_t size;
+    uint32_t offset;
+    uint32_t next;
+    uint32_t __padding;
+};
+
 #define realModeData   0x90200
 #define e820MapNrPointer (realModeData + 0x1e8)
 #define e820MapPointer   (realModeData + 0x2d0)
@@ -119,26 +135,38 @@ int
 write_config_memory(int fd, int base, const char *buf, int size)
 {
     union CPADDR addr;
-    struct cp_ioctl_args_t args;
+    struct cp_ioctl_desc_t descs[CPA_IOC_BATCH_MAX];
+    struct cp_ioctl_batch_t batch;
+    int offset = 0;
 
     assert(size % sizeof(uint64_t) == 0);
 
     addr.data = 0;
     addr.cfgmem.type = 1;
-    memset((void *)&args, 0, sizeof(args));
-
-    for (int offset = 0; offset<size; offset+=sizeof(uint64_t)) {
-        addr.cfgmem.offset = base + offset;
-        args.addr = addr.data;
-        args.value = *(uint64_t *)(buf + offset);
-        if (ioctl(fd, CPA_IOCSENTRY, &args) != 0)
+    memset((void *)descs, 0, sizeof(descs));
+    batch.descs = descs;
+
+    // one ioctl per CPA_IOC_BATCH_MAX qwords instead of one per qword
+    while (offset < size) {
+        batch.count = 0;
+        while (offset < size && batch.count < CPA_IOC_BATCH_MAX) {
+            struct cp_ioctl_desc_t *desc = &descs[batch.count++];
+            addr.cfgmem.offset = base + offset;
+            desc->cmd = 'S';
+            desc->addr = addr.data;
+            desc->value = *(uint64_t *)(buf + offset);
+            offset += sizeof(uint64_t);
+        }
+        if (ioctl(fd, CPA_IOCBATCH, &batch) != 0)
             return -1;
+        for (unsigned int i = 0; i < batch.count; i++)
+            if (descs[i].status != 0)
+                return -1;
     }
 
     return size;
 }
 
-
 int main(int argc, char *argv[])
 {
     char *filename;
@@ -217,7 +245,13 @@ int main(int argc, char *argv[])
     uint32_t offset = 0;
     while (seg->size != 0) {
         seg->offset = offset;
-        offset += write_config_memory(fd, offset, seg->ptr, seg->size);
+        ret = write_config_memory(fd, offset, seg->ptr, seg->size);
+        if (ret < 0) {
+            fprintf(stderr, "Failed to write config memory at 0x%x\n",
+                    offset);
+            return -EIO;
+        }
+        offset += ret;
         seg++;
     }
 
@@ -225,7 +259,8 @@ int main(int argc, char *argv[])
     seg = all_segments;
     addr.cfgtbl.offset = 24;
     args.ldom = DSid;
-    while (seg->size != 0) {
+    int nsegs = 0;
+    while (seg->size != 0 && nsegs < PARAMTABLE_SEGMENT_COUNT) {
         args.addr = addr.data;
         args.value = seg->base;
         ret = ioctl(fd, CPA_IOCSENTRY, &args);
@@ -235,6 +270,30 @@ int main(int argc, char *argv[])
         ret = ioctl(fd, CPA_IOCSENTRY, &args);
         addr.cfgtbl.offset += 8;
         seg++;
+        nsegs++;
+    }
+
+    // remaining segments: descriptor chain after segment data
+    uint64_t flags = 0;
+    if (seg->size != 0) {
+        uint32_t chain = offset;
+        while (seg->size != 0) {
+            struct SegmentDesc desc;
+            memset((void *)&desc, 0, sizeof(desc));
+            desc.base = seg->base;
+            desc.size = seg->size;
+            desc.offset = seg->offset;
+            seg++;
+            desc.next = seg->size ? offset + sizeof(desc) : SEGDESC_END;
+            offset += write_config_memory(fd, offset,
+                                          (const char *)&desc, sizeof(desc));
+        }
+
+        addr.cfgtbl.offset = PARAMTABLE_SEGCHAIN_OFFSET;
+        args.addr = addr.data;
+        args.value = chain;
+        ret = ioctl(fd, CPA_IOCSENTRY, &args);
+        flags = FLAG_SEGCHAIN;
     }
 
     // paramTable->cpuMask
@@ -252,7 +311,7 @@ int main(int argc, char *argv[])
     memset((void *)&args, 0, sizeof(args));
     args.ldom = DSid;
     args.addr = addr.data;
-    args.value = 0x0000000080000000 | (DSid & 0xFFFF);
+    args.value = 0x0000000080000000 | flags | (DSid & 0xFFFF);
     ret = ioctl(fd, CPA_IOCSENTRY, &args);
     fprintf(stderr, "Init ParamTable for DSid=0x%x\n", DSid);
 
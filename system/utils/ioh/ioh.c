@@ -27,13 +27,19 @@ static struct option ioh_options[] = {
     { "list",    no_argument,       0,  'l' },
     { "assign",  no_argument,       0,  'a' },
     { "release", no_argument,       0,  'r' },
+    { "set-io",  no_argument,       0,  'i' },
+    { "show-io", no_argument,       0,  'o' },
     { "device",  required_argument, 0,  'd' },
     { "DSid",    required_argument, 0,  's' },
+    { "weight",  required_argument, 0,  'w' },
+    { "iops",    required_argument, 0,  'p' },
+    { "bps",     required_argument, 0,  'b' },
     { 0,         0,                 0,   0  }
 };
 
 static const char *ioh_cmd_string[] = {
-    "--help/-h", "--list/-l", "--assign/-a", "--release/-r", ""
+    "--help/-h", "--list/-l", "--assign/-a", "--release/-r",
+    "--set-io/-i", "--show-io/-o", ""
 };
 
 static const char * helptext =
@@ -47,7 +53,12 @@ static const char * helptext =
     "  assign device    ioh --device=/dev/cp1 --assign --DSid=0 00:06.0 00:07.0\n"
     "                   ioh       -d /dev/cp1 -a       --DSid=0 00:06.0 00:07.0\n"
     "  release device   ioh --device=/dev/cp1 --release --DSid=0 00:07.0\n"
-    "                   ioh       -d /dev/cp1 -r        --DSid=0 00:07.0\n";
+    "                   ioh       -d /dev/cp1 -r        --DSid=0 00:07.0\n"
+    "  release all      ioh --device=/dev/cp1 --release --DSid=0\n"
+    "  set I/O shares   ioh --device=/dev/cp1 --set-io --DSid=0 --weight=2 --iops=1000 --bps=10485760\n"
+    "                   ioh       -d /dev/cp1 -i       --DSid=0 -w 2 -p 1000 -b 10485760\n"
+    "  show I/O shares  ioh --device=/dev/cp1 --show-io [--DSid=0]\n"
+    "                   ioh       -d /dev/cp1 -o       [-s 0]\n";
 
 static uint16_t parsePciID(const char *pciid)
 {
@@ -58,55 +69,89 @@ static uint16_t parsePciID(const char *pciid)
     return (ret == 3) ? ((bus&0xFF)<<8|(dev&0xF)<<4|(fun&0xF)) : 0xFFFF;
 }
 
+static int64_t parseShare(const char *name, const char *value)
+{
+    char *end;
+    unsigned long long share = strtoull(value, &end, 0);
+
+    if (*value == '\0' || *end != '\0' || *value == '-') {
+        fprintf(stderr, "error: invalid --%s value %s\n", name, value);
+        return -1;
+    }
+    return share;
+}
+
 /**
  * All Parameters
  */
 enum IOH_COMMAND cmd = IOH_NONE;
 int DSid = -1;
 const char *devName = NULL;
-uint16_t pciids[32];
+uint16_t pciids[IOH_MAX_PCIIDS];
 int pciids_nr = 0;
+int64_t io_weight = -1;
+int64_t io_iops = -1;
+int64_t io_bps = -1;
+
+static int setCommand(enum IOH_COMMAND new_cmd)
+{
+    if (cmd != IOH_NONE) {
+        fprintf(stderr, "Only support one command:\n"
+                        "   --help/--list/--assign/--release/"
+                        "--set-io/--show-io\n");
+        return -EINVAL;
+    }
+    cmd = new_cmd;
+    return 0;
+}
 
 int parseArgs(int argc, char *argv[])
 {
     while (1) {
         int option_index = 0;
-        int c = getopt_long(argc, argv, "hlard:s:", ioh_options, &option_index);
+        int c = getopt_long(argc, argv, "hlariod:s:w:p:b:", ioh_options,
+                            &option_index);
         if (c == -1)
             break;
 
         switch (c) {
         case 'h':
-            if (cmd != IOH_NONE) {
-                fprintf(stderr, "Only support one command:\n"
-                                "   --help/--list/--assign/--release\n");
+            if (setCommand(IOH_HELP) != 0)
                 return -EINVAL;
-            }
-            cmd = IOH_HELP;
             break;
         case 'l':
-            if (cmd != IOH_NONE) {
-                fprintf(stderr, "Only support one command:\n"
-                                "   --help/--list/--assign/--release\n");
+            if (setCommand(IOH_LIST) != 0)
                 return -EINVAL;
-            }
-            cmd = IOH_LIST;
             break;
         case 'a':
-            if (cmd != IOH_NONE) {
-                fprintf(stderr, "Only support one command:\n"
-                                "   --help/--list/--assign/--release\n");
+            if (setCommand(IOH_ASSIGN) != 0)
                 return -EINVAL;
-            }
-            cmd = IOH_ASSIGN;
             break;
         case 'r':
-            if (cmd != IOH_NONE) {
-                fprintf(stderr, "Only support one command:\n"
-                                "   --help/--list/--assign/--release\n");
+            if (setCommand(IOH_RELEASE) != 0)
+                return -EINVAL;
+            break;
+        case 'i':
+            if (setCommand(IOH_SET_IO) != 0)
+                return -EINVAL;
+            break;
+        case 'o':
+            if (setCommand(IOH_SHOW_IO) != 0)
+                return -EINVAL;
+            break;
+        case 'w':
+            if ((io_weight = parseShare("weight", optarg)) < 0 ||
+                io_weight > UINT32_MAX)
+                return -EINVAL;
+            break;
+        case 'p':
+            if ((io_iops = parseShare("iops", optarg)) < 0 ||
+                io_iops > UINT32_MAX)
+                return -EINVAL;
+            break;
+        case 'b':
+            if ((io_bps = parseShare("bps", optarg)) < 0)
                 return -EINVAL;
-            }
-            cmd = IOH_RELEASE;
             break;
         case 's':
             if (DSid != -1) {
@@ -132,6 +177,11 @@ int parseArgs(int argc, char *argv[])
 
     if (optind < argc) {
         while (optind < argc) {
+            if (pciids_nr == IOH_MAX_PCIIDS) {
+                fprintf(stderr, "error: at most %d devices at a time\n",
+                        IOH_MAX_PCIIDS);
+                return -EINVAL;
+            }
             if ((pciids[pciids_nr] = parsePciID(argv[optind])) == 0xFFFF) {
                 printf("Error device %s\n", argv[optind]);
                 return -EINVAL;
@@ -152,6 +202,13 @@ int parseArgs(int argc, char *argv[])
                     ioh_cmd_string[cmd]);
             return -EINVAL;
         }
+      case IOH_SET_IO:
+        if (cmd == IOH_SET_IO &&
+            io_weight < 0 && io_iops < 0 && io_bps < 0) {
+            fprintf(stderr, "error: --weight, --iops or --bps is required "
+                            "for command %s\n", ioh_cmd_string[cmd]);
+            return -EINVAL;
+        }
       case IOH_RELEASE:
         if (DSid == -1) {
             fprintf(stderr, "error: option --DSid/-s is required for command %s\n",
@@ -159,6 +216,7 @@ int parseArgs(int argc, char *argv[])
             return -EINVAL;
         }
       case IOH_LIST:
+      case IOH_SHOW_IO:
         if (devName == NULL) {
             fprintf(stderr, "error: option --device/-d is required for command %s\n",
                     ioh_cmd_string[cmd]);
@@ -185,6 +243,14 @@ int parseArgs(int argc, char *argv[])
  *
  *   release device	ioh --device=/dev/cp1 --release --DSid=0 00:07.0
  *                  	ioh       -d /dev/cp1 -r        --DSid=0 00:07.0
+ *
+ *   release all	ioh --device=/dev/cp1 --release --DSid=0
+ *
+ *   set I/O shares	ioh --device=/dev/cp1 --set-io --DSid=0 --weight=2
+ *                      ioh       -d /dev/cp1 -i       --DSid=0 -w 2
+ *
+ *   show I/O shares	ioh --device=/dev/cp1 --show-io [--DSid=0]
+ *                      ioh       -d /dev/cp1 -o       [-s 0]
  */
 int main(int argc, char *argv[])
 {
@@ -217,6 +283,12 @@ int main(int argc, char *argv[])
     case IOH_RELEASE:
         ret = ioh_release(devices, DSid, pciids, pciids_nr);
         break;
+    case IOH_SET_IO:
+        ret = ioh_set_io(DSid, io_weight, io_iops, io_bps);
+        break;
+    case IOH_SHOW_IO:
+        ret = ioh_show_io(DSid);
+        break;
     default:
         break;
     }
@@ -235,7 +307,7 @@ static int fixupDevices(struct DEVICE *devices)
     struct ParamEntry param;
     while (1) {
         // read param entry data
-        cpdev->ops->cfgtbl_param_read_qword(cpdev, row++, 0, (uint64_t *)&param);
+        cpdev->ops->cfgtbl_param_read_qword(cpdev, row, 0, (uint64_t *)&param);
         // EOF detected
         if (*((uint64_t *)&param) == (uint64_t)0xFFFFFFFFFFFFFFFF)
             break;
@@ -243,14 +315,20 @@ static int fixupDevices(struct DEVICE *devices)
         if (param.flags & FLAG_VALID) {
             struct DEVICE *pDev = devices;
             while (pDev != NULL) {
-                if (param.device_mask & (1<<pDev->info.id)) {
+                uint64_t word;
+                int id = pDev->info.id;
+                cpdev->ops->cfgtbl_param_read_qword(cpdev, row,
+                    IOH_DEVSET_OFFSET + id/64*8, &word);
+                if ((word & (uint64_t)1<<(id%64)) && pDev->guests_nr < 128) {
                     pDev->guests[pDev->guests_nr] = param.DSid;
                     pDev->guests_nr ++;
                 }
                 pDev = pDev->next;
             }
         }
+        row++;
     }
+    return 0;
 }
 
 int
@@ -270,25 +348,39 @@ queryDevices(struct cpdev_t *cpdev, struct DEVICE **ppFirstDev)
         return -1;
     }
 
-    int pos = iohinfo.device_ptr;
-    // Query all devices
-    while(pos != 0xFFFF) {
-        pDev = (struct DEVICE *)malloc(sizeof(struct DEVICE));
-        memset(pDev, 0, sizeof(struct DEVICE));
-        if (!pDev ||
-            cpdev->ops->sysinfo_read(cpdev, pos, (char *)&pDev->info,
-                                     sizeof(pDev->info)) < 0)
+    // Query all devices, one page at a time
+    for (int page = 0; iohinfo.page_devices &&
+                       page * iohinfo.page_devices < iohinfo.device_total;
+         page++) {
+        iohinfo.device_page = page;
+        if (cpdev->ops->sysinfo_write_qword(cpdev, 0,
+                                            *(uint64_t *)&iohinfo) != 0 ||
+            cpdev->ops->sysinfo_read(cpdev, 0, (char *)&iohinfo,
+                                     sizeof(iohinfo)) != sizeof(iohinfo))
             goto err;
-        pos = pDev->info.next_ptr;
 
-        if (pLast == NULL) {
-            pDev->next = NULL;
-            *ppFirstDev = pLast = pDev;
-        }
-        else {
-            pDev->next = pLast->next;
-            pLast->next = pDev;
-            pLast = pDev;
+        int pos = iohinfo.device_ptr;
+        while(pos != 0xFFFF) {
+            pDev = (struct DEVICE *)malloc(sizeof(struct DEVICE));
+            if (!pDev)
+                goto err;
+            memset(pDev, 0, sizeof(struct DEVICE));
+            if (cpdev->ops->sysinfo_read(cpdev, pos, (char *)&pDev->info,
+                                         sizeof(pDev->info)) < 0) {
+                free(pDev);
+                goto err;
+            }
+            pos = pDev->info.next_ptr;
+
+            if (pLast == NULL) {
+                pDev->next = NULL;
+                *ppFirstDev = pLast = pDev;
+            }
+            else {
+                pDev->next = pLast->next;
+                pLast->next = pDev;
+                pLast = pDev;
+            }
         }
     }
 
@@ -302,4 +394,3 @@ err:
     }
     return -1;
 }
-
@@ -5,38 +5,61 @@
 #include "cpa_ioctl.h"
 
 enum IOH_COMMAND {
-    IOH_HELP = 0, IOH_LIST, IOH_ASSIGN, IOH_RELEASE, IOH_NONE
+    IOH_HELP = 0, IOH_LIST, IOH_ASSIGN, IOH_RELEASE, IOH_SET_IO, IOH_SHOW_IO,
+    IOH_NONE
 };
 
 /**
- * SystemInfo Table
+ * SystemInfo Table, devices are listed one page at a time
  */
 struct IOHubDevice {
     uint16_t next_ptr;
-    uint8_t id;
-    uint8_t flags;
+    uint16_t id;
     uint16_t pciid;
-    uint8_t interrupt;
-    uint8_t reserved;
+    uint8_t  flags;
+    uint8_t  interrupt;
+    uint8_t  num_vfs;
+    uint8_t  reserved[7];
     char ident[32];
 };
 
 struct IOHubInfo
 {
     uint16_t device_ptr;
-    uint8_t device_nr;
-    uint8_t  __res[5];
+    uint8_t  device_nr;
+    uint8_t  page_devices;
+    uint16_t device_page;
+    uint16_t device_total;
 };
 
 /**
- * Config Table
+ * Config Table, the device set of a row follows at IOH_DEVSET_OFFSET
  */
 struct ParamEntry {
     uint16_t flags;
     uint16_t DSid;
     uint32_t device_mask;
+    uint32_t io_weight;     // share of the shared disk, 0 counts as 1
+    uint32_t io_iops;       // disk requests per second, 0 for no limit
+    uint64_t io_bps;        // disk bytes per second, 0 for no limit
 };
 #define FLAG_VALID      0x0001
+#define IOH_DEVSET_OFFSET   0x40
+#define IOH_IO_SHARE_OFFSET 0x08    // io_weight and io_iops
+#define IOH_IO_BPS_OFFSET   0x10
+
+/**
+ * Stat Table, same row as param table
+ */
+struct StatEntry {
+    uint16_t flags;
+    uint16_t DSid;
+    uint32_t __padding;
+    uint64_t io_requests;   // requests served by the shared disk
+    uint64_t io_bytes;
+    uint64_t io_latency;    // total ticks from queueing to completion
+    uint64_t io_throttled;  // requests held back by io_bps or io_iops
+};
 
 /**
  * In-memory devices structure
@@ -63,6 +86,8 @@ struct cpdev_ops_t {
             (struct cpdev_t *, int rowid, int offset, uint64_t  data);
     int (*sysinfo_read)
             (struct cpdev_t *, int base, char *buf, int size);
+    int (*sysinfo_write_qword)
+            (struct cpdev_t *, int base, uint64_t data);
 };
 
 struct cpdev_t {
@@ -75,8 +100,13 @@ void close_iohcp_dev(struct cpdev_t *cpdev);
 
 
 // IOH command
+#define IOH_MAX_PCIIDS  256
 int ioh_list(struct DEVICE *devices);
 int ioh_assign(struct DEVICE *devices, uint16_t DSid, uint16_t *pciids, int pciids_nr);
 int ioh_release(struct DEVICE *devices, uint16_t DSid, uint16_t *pciids, int pciids_nr);
 
+// I/O shares, a negative value keeps the current one
+int ioh_set_io(uint16_t DSid, int64_t weight, int64_t iops, int64_t bps);
+int ioh_show_io(int DSid);
+
 #endif	// __IOH_H__
@@ -8,10 +8,11 @@ extern struct cpdev_t *cpdev;
 
 typedef char column_string_t [21];
 
-column_string_t data[32][7] = {
+static const column_string_t header[2][7] = {
     {  "",       "", "    PCI", "   ", "      PARD", "Support", "    "},
     {"ID", "Device", "Address", "IRQ", "Compatible", "  Guest", "DSid"},
 };
+column_string_t (*data)[7];
 int currow = 2;
 
 void add_device(struct DEVICE *device)
@@ -74,6 +75,14 @@ void print_table(int max_row, int max_col, column_string_t data[][7],
 int ioh_list(struct DEVICE *devices)
 {
     struct DEVICE *pDev = devices;
+    int rows = 2;
+
+    for (pDev = devices; pDev != NULL; pDev = pDev->next)
+        rows++;
+    data = (column_string_t (*)[7])calloc(rows, sizeof(*data));
+    if (!data)
+        return -ENOMEM;
+    memcpy(data, header, sizeof(header));
 
     pDev = devices;
     while(pDev != NULL) {
@@ -85,18 +94,28 @@ int ioh_list(struct DEVICE *devices)
     print_table(currow, 7, data, 2, NULL, NULL);
     printf("\n");
 
+    free(data);
     return 0;
 }
 
-uint32_t pciids_to_devmask(struct DEVICE *devices, uint16_t *pciids, int pciids_nr)
+/**
+ * Set the bits of pciids in devset, which has room for every device.
+ * @return number of words of devset in use, -ENODEV if a pciid is not
+ * a device of the IOHub
+ */
+int pciids_to_devset(struct DEVICE *devices, uint16_t *pciids, int pciids_nr,
+                     uint64_t *devset)
 {
-    uint32_t devmask = 0;
+    int words = 0;
 
     for (int i=0; i<pciids_nr; i++) {
         struct DEVICE *pDev;
         for (pDev = devices; pDev != NULL; pDev = pDev->next) {
             if (pciids[i] == pDev->info.pciid) {
-                devmask |= 1<<pDev->info.id;
+                int id = pDev->info.id;
+                devset[id/64] |= (uint64_t)1<<(id%64);
+                if (id/64 >= words)
+                    words = id/64 + 1;
                 break;
             }
         }
@@ -105,10 +124,79 @@ uint32_t pciids_to_devmask(struct DEVICE *devices, uint16_t *pciids, int pciids_
             int dev = (pciids[i]>>4) & 0xF;
             int fun = (pciids[i]   ) & 0xF;
             fprintf(stderr, "error: unknown device %02d:%02d.%d\n", bus, dev, fun);
+            return -ENODEV;
         }
     }
 
-    return devmask;
+    return words;
+}
+
+/**
+ * Find the param row of DSid.
+ * @param free_row first invalid row, may be NULL
+ * @return row, -1 if DSid has none
+ */
+static int find_row(uint16_t DSid, int *free_row)
+{
+    struct ParamEntry param;
+
+    if (free_row)
+        *free_row = -1;
+    for (int row = 0; ; row++) {
+        // read param entry data until EOF detected
+        if (cpdev->ops->cfgtbl_param_read_qword(cpdev, row, 0,
+                                                (uint64_t *)&param) < 0)
+            break;
+        if (*((uint64_t *)&param) == (uint64_t)0xFFFFFFFFFFFFFFFF)
+            break;
+        if ((param.flags & FLAG_VALID) && (param.DSid == DSid))
+            return row;
+        if (!(param.flags & FLAG_VALID) && free_row && *free_row == -1)
+            *free_row = row;
+    }
+    return -1;
+}
+
+/** Words of a device set with a bit for every device */
+static int devset_words(struct DEVICE *devices)
+{
+    int nr = 0;
+    for (struct DEVICE *pDev = devices; pDev != NULL; pDev = pDev->next)
+        if (pDev->info.id >= nr)
+            nr = pDev->info.id + 1;
+    return (nr + 63) / 64;
+}
+
+static uint64_t *alloc_devset(struct DEVICE *devices)
+{
+    return (uint64_t *)calloc(devset_words(devices) + 1, sizeof(uint64_t));
+}
+
+/**
+ * Update the device set of row word by word, set or clear the bits
+ * of devset.
+ */
+static int update_devset(int row, uint64_t *devset, int words, int assign)
+{
+    for (int w=0; w<words; w++) {
+        uint64_t word;
+        int ret;
+        if (!devset[w])
+            continue;
+        ret = cpdev->ops->cfgtbl_param_read_qword(cpdev, row,
+                  IOH_DEVSET_OFFSET + w*8, &word);
+        if (ret < 0)
+            return ret;
+        printf("DSid set word %d: 0x%016llX %s 0x%016llX\n", w,
+               (unsigned long long)word, assign ? "+" : "-",
+               (unsigned long long)devset[w]);
+        word = assign ? (word | devset[w]) : (word & ~devset[w]);
+        ret = cpdev->ops->cfgtbl_param_write_qword(cpdev, row,
+                  IOH_DEVSET_OFFSET + w*8, word);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
 }
 
 int
@@ -120,11 +208,19 @@ ioh_assign(
     int row = 0;
     int free_row = -1;
     int select_row = -1;
-    uint32_t assign_mask = 0;
+    uint64_t *assign_set;
+    int words, ret;
 
-    assign_mask = pciids_to_devmask(devices, pciids, pciids_nr);
-    if (!assign_mask) {
+    if (!(assign_set = alloc_devset(devices)))
+        return -ENOMEM;
+    words = pciids_to_devset(devices, pciids, pciids_nr, assign_set);
+    if (words < 0) {
+        free(assign_set);
+        return words;
+    }
+    if (!words) {
         fprintf(stderr, "error: no valid pcidevice assigned.\n");
+        free(assign_set);
         return -ENODEV;
     }
 
@@ -149,20 +245,27 @@ ioh_assign(
 
     // if it is a new DSid, register a new param entry
     if (select_row == -1) {
-        if (free_row == -1)
+        if (free_row == -1) {
+            free(assign_set);
             return -ENOMEM;
+        }
         param.flags = FLAG_VALID;
         param.DSid = DSid;
         param.device_mask = 0;
         select_row = free_row;
+        ret = cpdev->ops->cfgtbl_param_write_qword(cpdev, select_row, 0,
+                                                   *(uint64_t*)&param);
+        if (ret < 0) {
+            free(assign_set);
+            return ret;
+        }
     }
 
-    // update select row's device mask
-    printf("DSid: %d  row: %d   0x%08X + 0x%08X ==> 0x%08X\n",
-           DSid, select_row,
-           param.device_mask, assign_mask, param.device_mask|assign_mask);
-    param.device_mask |= assign_mask;
-    return cpdev->ops->cfgtbl_param_write_qword(cpdev, select_row, 0, *(uint64_t*)&param);
+    // update select row's device set
+    printf("DSid: %d  row: %d\n", DSid, select_row);
+    ret = update_devset(select_row, assign_set, words, 1);
+    free(assign_set);
+    return ret;
 }
 
 int
@@ -170,39 +273,136 @@ ioh_release(
     struct DEVICE *devices,
     uint16_t DSid, uint16_t *pciids, int pciids_nr)
 {
-    struct ParamEntry param;
-    int row = 0;
-    int select_row = -1;
-    uint32_t release_mask = 0;
+    int select_row;
+    uint64_t *release_set;
+    int words, ret;
 
-    // get release mask form pciids
-    release_mask = pciids_to_devmask(devices, pciids, pciids_nr);
-    if (release_mask)
-        release_mask = ~release_mask;
-
-    while (1) {
-        // read param entry data until EOF detected
-        cpdev->ops->cfgtbl_param_read_qword(cpdev, row, 0, (uint64_t *)&param);
-        if (*((uint64_t *)&param) == (uint64_t)0xFFFFFFFFFFFFFFFF)
-            break;
-        // VALID entry
-        if ((param.flags & FLAG_VALID) && (param.DSid == DSid)) {
-            select_row = row;
-            break;
+    // get release set form pciids, all devices without any
+    if (!(release_set = alloc_devset(devices)))
+        return -ENOMEM;
+    if (pciids_nr == 0) {
+        words = devset_words(devices);
+        memset(release_set, 0xFF, words * sizeof(uint64_t));
+    } else {
+        words = pciids_to_devset(devices, pciids, pciids_nr, release_set);
+        if (words < 0) {
+            free(release_set);
+            return words;
         }
-        row++;
     }
 
+    select_row = find_row(DSid, NULL);
+
     // if DSid not found, just return
     if (select_row == -1) {
         fprintf(stderr, "warn: DSid#%d not found.\n", DSid);
+        free(release_set);
         return -ENODEV;
     }
 
-    // update select row's device mask
-    printf("DSid: %d  row: %d   0x%08X & 0x%08X ==> 0x%08X\n",
-           DSid, select_row,
-           param.device_mask, release_mask, param.device_mask&release_mask);
-    param.device_mask &= release_mask;
-    return cpdev->ops->cfgtbl_param_write_qword(cpdev, select_row, 0, *(uint64_t*)&param);
+    // update select row's device set
+    printf("DSid: %d  row: %d\n", DSid, select_row);
+    ret = update_devset(select_row, release_set, words, 0);
+    free(release_set);
+    return ret;
+}
+
+int
+ioh_set_io(uint16_t DSid, int64_t weight, int64_t iops, int64_t bps)
+{
+    struct ParamEntry param;
+    int row, free_row, ret;
+    uint64_t word;
+
+    // a DSid without devices may still get its shares
+    if ((row = find_row(DSid, &free_row)) == -1) {
+        if (free_row == -1)
+            return -ENOMEM;
+        memset(&param, 0, sizeof(param));
+        param.flags = FLAG_VALID;
+        param.DSid = DSid;
+        row = free_row;
+        ret = cpdev->ops->cfgtbl_param_write_qword(cpdev, row, 0,
+                                                   *(uint64_t *)&param);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (weight >= 0 || iops >= 0) {
+        ret = cpdev->ops->cfgtbl_param_read_qword(cpdev, row,
+                  IOH_IO_SHARE_OFFSET, &word);
+        if (ret < 0)
+            return ret;
+        param.io_weight = word & 0xFFFFFFFF;
+        param.io_iops = word >> 32;
+        if (weight >= 0)
+            param.io_weight = weight;
+        if (iops >= 0)
+            param.io_iops = iops;
+        word = (uint64_t)param.io_iops << 32 | param.io_weight;
+        ret = cpdev->ops->cfgtbl_param_write_qword(cpdev, row,
+                  IOH_IO_SHARE_OFFSET, word);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (bps >= 0) {
+        ret = cpdev->ops->cfgtbl_param_write_qword(cpdev, row,
+                  IOH_IO_BPS_OFFSET, bps);
+        if (ret < 0)
+            return ret;
+    }
+
+    printf("DSid: %d  row: %d\n", DSid, row);
+    return 0;
+}
+
+int ioh_show_io(int DSid)
+{
+    struct ParamEntry param;
+    struct StatEntry stat;
+
+    printf("I/O Shares:\n");
+    printf("%5s  %6s  %10s  %12s  %10s  %14s  %12s  %10s\n",
+           "DSid", "Weight", "IOPS", "Bytes/s",
+           "Requests", "Bytes", "Latency(us)", "Throttled");
+    for (int i=0; i<93; i++) printf("-");
+    printf("\n");
+
+    for (int row = 0; ; row++) {
+        // read param entry data until EOF detected
+        if (cpdev->ops->cfgtbl_param_read_qword(cpdev, row, 0,
+                                                (uint64_t *)&param) < 0)
+            return -EIO;
+        if (*((uint64_t *)&param) == (uint64_t)0xFFFFFFFFFFFFFFFF)
+            break;
+        if (!(param.flags & FLAG_VALID) ||
+            (DSid != -1 && param.DSid != DSid))
+            continue;
+
+        // shares follow the first qword, the stat row has the same index
+        for (int off = 8; off < sizeof(param); off += 8) {
+            if (cpdev->ops->cfgtbl_param_read_qword(cpdev, row, off,
+                    (uint64_t *)((char *)&param + off)) < 0)
+                return -EIO;
+        }
+        memset(&stat, 0, sizeof(stat));
+        for (int off = 8; off < sizeof(stat); off += 8) {
+            if (cpdev->ops->cfgtbl_stat_read_qword(cpdev, row, off,
+                    (uint64_t *)((char *)&stat + off)) < 0)
+                return -EIO;
+        }
+
+        printf("%5d  %6u  %10u  %12llu  %10llu  %14llu  %12.2f  %10llu\n",
+               param.DSid, param.io_weight ? param.io_weight : 1,
+               param.io_iops, (unsigned long long)param.io_bps,
+               (unsigned long long)stat.io_requests,
+               (unsigned long long)stat.io_bytes,
+               stat.io_requests ?
+                   stat.io_latency / 1e6 / stat.io_requests : 0.0,
+               (unsigned long long)stat.io_throttled);
+    }
+    printf("\n");
+
+    return 0;
 }
@@ -124,6 +124,21 @@ iohcp_sysinfo_read(
     return size;
 }
 
+static int
+iohcp_sysinfo_write_qword(
+    struct cpdev_t *cpdev,
+    int base, uint64_t data)
+{
+    struct cp_ioctl_args_t args;
+
+    assert(base % sizeof(uint64_t) == 0);
+
+    memset((void *)&args, 0, sizeof(args));
+    args.addr  = base + 0x80000000;
+    args.value = data;
+    return ioctl(cpdev->fd, CPA_IOCSENTRY, &args);
+}
+
 static struct cpdev_ops_t iohcpdev_ops = {
     .read                     = iohcp_read,
     .write                    = iohcp_write,
@@ -132,6 +147,7 @@ static struct cpdev_ops_t iohcpdev_ops = {
     .cfgtbl_stat_read_qword   = iohcp_cfgtbl_stat_read_qword,
     .cfgtbl_stat_write_qword  = iohcp_cfgtbl_stat_write_qword,
     .sysinfo_read             = iohcp_sysinfo_read,
+    .sysinfo_write_qword      = iohcp_sysinfo_write_qword,
 };
 
 void close_iohcp_dev(struct cpdev_t *cpdev)
@@ -0,0 +1,128 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2015 Institute of Computing Technology, CAS
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met: redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer;
+# redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the
+# documentation and/or other materials provided with the distribution;
+# neither the name of the copyright holders nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+# Authors: Jiuyue Ma
+
+# Client of CPServer, drives control planes of a running simulation
+# through its Unix socket, see src/prm/CPServer.hh for the protocol.
+#
+#   cpclient.py m5out/cpserver.sock get 0 1 0x10000000
+#   cpclient.py m5out/cpserver.sock set 0 1 0x8 0xf
+#   cpclient.py m5out/cpserver.sock cmd 0 B 1
+#
+# or as a module:
+#
+#   c = CPClient('m5out/cpserver.sock')
+#   res = c.batch([('G', 0, 1, 0x10000000, 0), ('S', 0, 1, 0x8, 0xf)])
+
+import socket
+import struct
+import sys
+
+MAGIC = 0x50435043
+MSG = struct.Struct('<II')
+DESC = struct.Struct('<BBHIQH6x')
+STATUS_DONE = 0x00
+
+class CPError(Exception):
+    pass
+
+class CPClient(object):
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+
+    def close(self):
+        self.sock.close()
+
+    def _recv(self, size):
+        data = b''
+        while len(data) < size:
+            chunk = self.sock.recv(size - len(data))
+            if not chunk:
+                raise CPError("connection closed by simulator")
+            data += chunk
+        return data
+
+    def batch(self, requests):
+        """requests: [(cmd, cp, dsid, addr, data)],
+        returns [(status, data)] in the same order"""
+        msg = MSG.pack(MAGIC, len(requests))
+        for (cmd, cp, dsid, addr, data) in requests:
+            msg += DESC.pack(ord(cmd), 0, dsid, addr, data, cp)
+        self.sock.sendall(msg)
+
+        self._recv(MSG.size)
+        reply = self._recv(DESC.size * len(requests))
+        results = []
+        for i in range(len(requests)):
+            (cmd, status, dsid, addr, data, cp) = \
+                DESC.unpack_from(reply, i * DESC.size)
+            results.append((status, data))
+        return results
+
+    def _one(self, cmd, cp, dsid, addr, data):
+        status, data = self.batch([(cmd, cp, dsid, addr, data)])[0]
+        if status != STATUS_DONE:
+            raise CPError("command '%s' failed on cp %d" % (cmd, cp))
+        return data
+
+    def get(self, cp, dsid, addr):
+        return self._one('G', cp, dsid, addr, 0)
+
+    def set(self, cp, dsid, addr, value):
+        self._one('S', cp, dsid, addr, value)
+
+    def command(self, cp, cmd, dsid, addr=0, value=0):
+        self._one(cmd, cp, dsid, addr, value)
+
+def main():
+    if len(sys.argv) < 5:
+        print("usage: %s <socket> get <cp> <dsid> <addr>\n"
+              "       %s <socket> set <cp> <dsid> <addr> <value>\n"
+              "       %s <socket> cmd <cp> <cmd> <dsid> [addr] [value]"
+              % ((sys.argv[0],) * 3))
+        sys.exit(1)
+
+    num = lambda s: int(s, 0)
+    c = CPClient(sys.argv[1])
+    op, args = sys.argv[2], sys.argv[3:]
+    if op == 'get':
+        print("0x%x" % c.get(num(args[0]), num(args[1]), num(args[2])))
+    elif op == 'set':
+        c.set(num(args[0]), num(args[1]), num(args[2]), num(args[3]))
+    elif op == 'cmd':
+        extra = [num(a) for a in args[3:5]]
+        c.command(num(args[0]), args[1], num(args[2]), *extra)
+    else:
+        print("unknown operation %s" % op)
+        sys.exit(1)
+    c.close()
+
+if __name__ == '__main__':
+    main()
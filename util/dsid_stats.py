@@ -0,0 +1,120 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2015 Institute of Computing Technology, CAS
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met: redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer;
+# redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the
+# documentation and/or other materials provided with the distribution;
+# neither the name of the copyright holders nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+# Authors: Jiuyue Ma
+
+# Reader for per-DSid statistics recorded by StatsRecorder,
+# see src/prm/StatsRecorder.hh for the file layout.
+#
+#   dsid_stats.py m5out/dsid_stats.bin --list
+#   dsid_stats.py m5out/dsid_stats.bin --dsid 1 --column system.cp.boots
+
+import mmap
+import optparse
+import struct
+import sys
+
+HEADER = struct.Struct('<8sIIIIQQQ')
+RECORD = struct.Struct('<QH6x')
+NAME_LEN = 64
+
+class StatsFile(object):
+    def __init__(self, path):
+        self.file = open(path, 'rb')
+        self.map = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+        (magic, self.version, ncols, self.header_size, self.record_size,
+         self.interval, self.ticks_per_second, self.records) = \
+            HEADER.unpack_from(self.map, 0)
+        if magic.rstrip(b'\0') != b'PARDSTS':
+            raise ValueError("%s is not a PARD stats file" % path)
+
+        self.columns = []
+        for i in range(ncols):
+            off = HEADER.size + i * NAME_LEN
+            name = self.map[off:off + NAME_LEN].split(b'\0')[0]
+            self.columns.append(name.decode('ascii'))
+
+        # trust file size over header if simulation was killed
+        avail = (len(self.map) - self.header_size) // self.record_size
+        self.records = min(self.records, avail)
+
+    def record(self, idx):
+        off = self.header_size + idx * self.record_size
+        tick, dsid = RECORD.unpack_from(self.map, off)
+        values = struct.unpack_from('<%dQ' % len(self.columns), self.map,
+                                    off + RECORD.size)
+        return tick, dsid, values
+
+    def column(self, name, dsid=None):
+        """Return [(tick, dsid, value)] of one column"""
+        col = self.columns.index(name)
+        off = self.header_size + RECORD.size + col * 8
+        result = []
+        for i in range(self.records):
+            base = self.header_size + i * self.record_size
+            tick, rec_dsid = RECORD.unpack_from(self.map, base)
+            if dsid is not None and rec_dsid != dsid:
+                continue
+            value, = struct.unpack_from('<Q', self.map,
+                                        off + i * self.record_size)
+            result.append((tick, rec_dsid, value))
+        return result
+
+def main():
+    parser = optparse.OptionParser(usage="%prog [options] <file>")
+    parser.add_option("--list", action="store_true",
+                      help="List columns and exit")
+    parser.add_option("--dsid", type="int", default=None,
+                      help="Only print records of this DSid")
+    parser.add_option("--column", action="append", default=[],
+                      help="Column to print, may be given more than once")
+    (options, args) = parser.parse_args()
+    if len(args) != 1:
+        parser.error("need exactly one stats file")
+
+    stats = StatsFile(args[0])
+
+    if options.list:
+        print("# interval %d ticks, %d records" %
+              (stats.interval, stats.records))
+        for name in stats.columns:
+            print(name)
+        return
+
+    cols = options.column or stats.columns
+    idx = [stats.columns.index(c) for c in cols]
+    print(",".join(["tick", "dsid"] + cols))
+    for i in range(stats.records):
+        tick, dsid, values = stats.record(i)
+        if options.dsid is not None and dsid != options.dsid:
+            continue
+        print(",".join([str(tick), str(dsid)] +
+                       [str(values[j]) for j in idx]))
+
+if __name__ == '__main__':
+    main()